@@ -1023,6 +1023,10 @@ OPENVPN_CLIENT_EXPORT void OpenVPNClient::connect_setup(Status &status, bool &se
     }
 #endif
 
+    // data path histograms
+    if (state->clientconf.dataPathStats)
+        state->stats->enable_datapath_stats();
+
     // build client options object
     ClientOptions::Ptr client_options = new ClientOptions(state->options, cc);
 
@@ -1291,6 +1295,44 @@ OPENVPN_CLIENT_EXPORT TransportStats OpenVPNClient::transport_stats() const
     return ret;
 }
 
+OPENVPN_CLIENT_EXPORT std::vector<DataPathHistogram> OpenVPNClient::datapath_stats() const
+{
+    std::vector<DataPathHistogram> ret;
+    if (state->is_foreign_thread_access())
+    {
+        MySessionStats *stats = state->stats.get();
+        const DataPathStats *dps = stats ? stats->datapath_stats() : nullptr;
+        if (dps)
+        {
+            for (size_t i = 0; i < DataPathStats::N_TYPES; ++i)
+            {
+                const LogLinearHistogram::Snapshot snap = dps->get(i).snapshot();
+                DataPathHistogram h;
+                h.name = DataPathStats::type_name(i);
+                h.unit = DataPathStats::is_latency(i) ? "ns" : "packets";
+                h.count = snap.count;
+                h.min = snap.min;
+                h.max = snap.max;
+                h.mean = static_cast<long long>(snap.mean());
+                h.p50 = snap.percentile(50.0);
+                h.p90 = snap.percentile(90.0);
+                h.p99 = snap.percentile(99.0);
+                h.p999 = snap.percentile(99.9);
+                for (size_t b = 0; b < snap.buckets.size(); ++b)
+                {
+                    if (snap.buckets[b])
+                    {
+                        h.bucketUpper.push_back(LogLinearHistogram::bucket_upper(b));
+                        h.bucketCount.push_back(snap.buckets[b]);
+                    }
+                }
+                ret.push_back(std::move(h));
+            }
+        }
+    }
+    return ret;
+}
+
 OPENVPN_CLIENT_EXPORT void OpenVPNClient::stop()
 {
     if (state->is_foreign_thread_access())
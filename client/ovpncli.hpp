@@ -340,6 +340,10 @@ struct ConfigCommon
     // with all tun builder properties pushed by server.
     // Currently only implemented on Linux.
     bool generateTunBuilderCaptureEvent = false;
+
+    // Record per-packet data path latency and queue depth
+    // histograms, retrieved with OpenVPNClient::datapath_stats().
+    bool dataPathStats = false;
 };
 
 // OpenVPN config-file/profile. Includes a few settings that we do not just
@@ -480,6 +484,27 @@ struct TransportStats
     int lastPacketReceived;
 };
 
+// used to pass one data path histogram
+struct DataPathHistogram
+{
+    std::string name; // TUN_TO_TRANSPORT, TRANSPORT_TO_TUN, ENCRYPT, DECRYPT, TUN_WRITE, TCP_SEND_QUEUE
+    std::string unit; // "ns" or "packets"
+
+    long long count = 0;
+    long long min = 0;
+    long long max = 0;
+    long long mean = 0;
+    long long p50 = 0;
+    long long p90 = 0;
+    long long p99 = 0;
+    long long p999 = 0;
+
+    // non-empty buckets only, bucketCount[i] values were
+    // <= bucketUpper[i] and > the upper bound of the previous bucket
+    std::vector<long long> bucketUpper;
+    std::vector<long long> bucketCount;
+};
+
 // return value of merge_config methods
 struct MergeConfig
 {
@@ -687,6 +712,10 @@ class OpenVPNClient : public TunBuilderBase,             // expose tun builder v
     // return transport stats only
     TransportStats transport_stats() const;
 
+    // return data path histograms, empty unless
+    // Config::dataPathStats was set
+    std::vector<DataPathHistogram> datapath_stats() const;
+
     // post control channel message
     void post_cc_msg(const std::string &msg);
 
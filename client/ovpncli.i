@@ -47,6 +47,7 @@ namespace std {
   %template(ClientAPI_ServerEntryVector) vector<openvpn::ClientAPI::ServerEntry>;
   %template(ClientAPI_LLVector) vector<long long>;
   %template(ClientAPI_StringVec) vector<string>;
+  %template(ClientAPI_DataPathHistogramVector) vector<openvpn::ClientAPI::DataPathHistogram>;
 };
 
 // interface to be bridged between C++ and target language
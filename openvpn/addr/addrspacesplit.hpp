@@ -26,6 +26,7 @@
 
 #include <openvpn/common/exception.hpp>
 #include <openvpn/addr/route.hpp>
+#include <openvpn/addr/routetrie.hpp>
 
 namespace openvpn {
 namespace IP {
@@ -49,10 +50,11 @@ class AddressSpaceSplitter : public RouteList
     AddressSpaceSplitter(const RouteList &in, const Addr::VersionMask vermask)
     {
         in.verify_canonical();
+        const RouteTrie<bool> trie(in, true);
         if (vermask & Addr::V4_MASK)
-            descend(in, Route(Addr::from_zero(Addr::V4), 0));
+            descend(trie, Route(Addr::from_zero(Addr::V4), 0));
         if (vermask & Addr::V6_MASK)
-            descend(in, Route(Addr::from_zero(Addr::V6), 0));
+            descend(trie, Route(Addr::from_zero(Addr::V6), 0));
     }
 
   private:
@@ -71,7 +73,7 @@ class AddressSpaceSplitter : public RouteList
      * @param route The route we currently are looking at and split if it does
      *	      not meet the requirements
      */
-    void descend(const RouteList &in, const Route &route)
+    void descend(const RouteTrie<bool> &in, const Route &route)
     {
         switch (find(in, route))
         {
@@ -94,18 +96,11 @@ class AddressSpaceSplitter : public RouteList
         }
     }
 
-    static Type find(const RouteList &in, const Route &route)
+    static Type find(const RouteTrie<bool> &in, const Route &route)
     {
-        Type type = LEAF;
-        for (RouteList::const_iterator i = in.begin(); i != in.end(); ++i)
-        {
-            const Route &r = *i;
-            if (route == r)
-                type = EQUAL;
-            else if (route.contains(r))
-                return SUBROUTE;
-        }
-        return type;
+        if (in.contains_more_specific(route))
+            return SUBROUTE;
+        return in.find(route) ? EQUAL : LEAF;
     }
 };
 } // namespace IP
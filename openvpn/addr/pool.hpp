@@ -23,12 +23,13 @@
 #define OPENVPN_ADDR_POOL_H
 
 #include <string>
-#include <sstream>
-#include <deque>
-#include <unordered_map>
+#include <vector>
+#include <map>
+#include <iterator>
 
 #include <openvpn/common/size.hpp>
 #include <openvpn/common/exception.hpp>
+#include <openvpn/common/ffs.hpp>
 
 #include <openvpn/addr/ip.hpp>
 #include <openvpn/addr/range.hpp>
@@ -38,6 +39,12 @@ namespace IP {
 
 // Maintain a pool of IP addresses.
 // A should be IP::Addr, IPv4::Addr, or IPv6::Addr.
+//
+// The pool is kept as a list of address ranges, each with a sparse
+// bitmap of in-use addresses, so memory is proportional to the number
+// of addresses in use rather than to the size of the configured ranges.  Acquisition scans for the first free
+// bit starting after the most recently acquired address and wraps
+// around, so released addresses are not immediately reused.
 template <typename ADDR>
 class PoolType
 {
@@ -45,76 +52,102 @@ class PoolType
     PoolType() = default;
 
     // Add range of addresses to pool (pool will own the addresses).
+    // Addresses already owned by the pool are skipped.
     void add_range(const RangeType<ADDR> &range)
     {
-        auto iter = range.iterator();
-        while (iter.more())
+        ADDR start = range.start();
+        size_t extent = range.extent();
+        while (extent)
         {
-            const ADDR &a = iter.addr();
-            add_addr(a);
-            iter.next();
+            const ADDR last = start + long(extent - 1);
+
+            // skip addresses already covered by an existing block
+            auto next = index.upper_bound(start);
+            if (next != index.begin())
+            {
+                const Block &b = blocks[std::prev(next)->second];
+                if (start <= b.last)
+                {
+                    const size_t n = b.last <= last ? offset(start, b.last) + 1 : extent;
+                    start += long(n);
+                    extent -= n;
+                    continue;
+                }
+            }
+
+            // add the gap up to the next existing block
+            size_t n = extent;
+            if (next != index.end() && blocks[next->second].start <= last)
+                n = offset(start, blocks[next->second].start);
+            add_block(start, n);
+            start += long(n);
+            extent -= n;
         }
     }
 
     // Add single address to pool (pool will own the address).
     void add_addr(const ADDR &addr)
     {
-        auto e = map.find(addr);
-        if (e == map.end())
-        {
-            freelist.push_back(addr);
-            map[addr] = false;
-        }
+        add_range(RangeType<ADDR>(addr, 1));
     }
 
     // Return number of pool addresses currently in use.
     size_t n_in_use() const
     {
-        return map.size() - freelist.size();
+        return n_used;
     }
 
-    // Return number of pool addresses currently in use.
+    // Return number of pool addresses currently free.
     size_t n_free() const
     {
-        return freelist.size();
+        return n_addrs - n_used;
     }
 
     // Acquire an address from pool.  Returns true if successful,
     // with address placed in dest, or false if pool depleted.
     bool acquire_addr(ADDR &dest)
     {
-        while (true)
-        {
+        if (!n_free())
             freelist_fill();
-            if (freelist.empty())
-                return false;
-            const ADDR &a = freelist.front();
-            auto e = map.find(a);
-            if (e == map.end()) // any address in freelist must exist in map
-                throw Exception("PoolType: address in freelist doesn't exist in map");
-            if (!e->second)
+        if (!n_free())
+            return false;
+
+        // Visit every block once starting at the cursor, then the
+        // cursor block again from its beginning to wrap around.
+        for (size_t i = 0; i <= blocks.size(); ++i)
+        {
+            const size_t bi = (cursor_block + i) % blocks.size();
+            Block &b = blocks[bi];
+            size_t off;
+            if (b.n_used < b.extent && b.find_free(i ? 0 : cursor_offset, off))
             {
-                e->second = true;
-                dest = a;
-                freelist.pop_front();
+                b.set(off);
+                ++n_used;
+                cursor_block = bi;
+                cursor_offset = off + 1;
+                dest = b.start + long(off);
                 return true;
             }
-            freelist.pop_front();
         }
+        throw Exception("PoolType: free address count is inconsistent with bitmap");
     }
 
     // Acquire a specific address from pool, returning true if
     // successful, or false if the address is not available.
     bool acquire_specific_addr(const ADDR &addr)
     {
-        auto e = map.find(addr);
-        if (e != map.end() && !e->second)
+        Block *b = find_block(addr);
+        if (b)
         {
-            e->second = true;
-            return true;
+            const size_t off = offset(b->start, addr);
+            if (!b->test(off))
+            {
+                b->set(off);
+                ++n_used;
+                return true;
+            }
         }
-        else
-            return false;
+        return false;
     }
 
     // Return a previously acquired address to the pool.  Does nothing if
@@ -122,21 +155,28 @@ class PoolType
     // (b) the address is not owned by the pool.
     void release_addr(const ADDR &addr)
     {
-        auto e = map.find(addr);
-        if (e != map.end() && e->second)
+        Block *b = find_block(addr);
+        if (b)
         {
-            freelist.push_back(addr);
-            e->second = false;
+            const size_t off = offset(b->start, addr);
+            if (b->test(off))
+            {
+                b->clear(off);
+                --n_used;
+            }
         }
     }
 
-    // DEBUGGING -- get the map load factor
+    // DEBUGGING -- get the fraction of pool addresses backed by bitmap storage
     float load_factor() const
     {
-        return map.load_factor();
+        size_t n_bits = 0;
+        for (const auto &b : blocks)
+            n_bits += b.chunks.size() * Block::chunk_bits;
+        return n_addrs ? float(n_bits) / float(n_addrs) : 0.0f;
     }
 
-    // Override to refill freelist on demand
+    // Override to add addresses on demand when the pool is depleted
     virtual void freelist_fill()
     {
     }
@@ -144,12 +184,19 @@ class PoolType
     std::string to_string() const
     {
         std::string ret;
-        for (const auto &e : map)
+        for (const auto &b : blocks)
         {
-            if (e.second)
+            for (const auto &c : b.chunks)
             {
-                ret += e.first.to_string();
-                ret += '\n';
+                for (size_t bit = 0; bit < Block::chunk_bits; ++bit)
+                {
+                    const size_t off = c.first * Block::chunk_bits + bit;
+                    if (b.test(off))
+                    {
+                        ret += (b.start + long(off)).to_string();
+                        ret += '\n';
+                    }
+                }
             }
         }
         return ret;
@@ -158,8 +205,136 @@ class PoolType
     virtual ~PoolType<ADDR>() = default;
 
   private:
-    std::deque<ADDR> freelist;
-    std::unordered_map<ADDR, bool> map;
+    struct Block
+    {
+        typedef unsigned int word_t;
+        static constexpr size_t word_bits = sizeof(word_t) * 8;
+        static constexpr size_t chunk_words = 32;
+        static constexpr size_t chunk_bits = chunk_words * word_bits;
+
+        // Bitmap for chunk_bits consecutive addresses.  Chunks are only
+        // allocated while at least one of their addresses is in use.
+        struct Chunk
+        {
+            word_t bits[chunk_words] = {};
+            size_t n_used = 0;
+
+            // find the first free bit >= from, or return false
+            bool find_free(const size_t from, size_t &bit) const
+            {
+                size_t w = from / word_bits;
+                if (w >= chunk_words)
+                    return false;
+
+                // ignore bits below from in the first word
+                word_t free = ~bits[w] & (~word_t(0) << (from % word_bits));
+                while (true)
+                {
+                    if (free)
+                    {
+                        bit = w * word_bits + find_first_set(free) - 1;
+                        return true;
+                    }
+                    if (++w >= chunk_words)
+                        return false;
+                    free = ~bits[w];
+                }
+            }
+        };
+
+        Block(const ADDR &start_arg, const size_t extent_arg)
+            : start(start_arg),
+              last(start_arg + long(extent_arg - 1)),
+              extent(extent_arg)
+        {
+        }
+
+        bool test(const size_t off) const
+        {
+            auto c = chunks.find(off / chunk_bits);
+            if (c == chunks.end())
+                return false;
+            const size_t bit = off % chunk_bits;
+            return c->second.bits[bit / word_bits] & (word_t(1) << (bit % word_bits));
+        }
+
+        void set(const size_t off)
+        {
+            Chunk &c = chunks[off / chunk_bits];
+            const size_t bit = off % chunk_bits;
+            c.bits[bit / word_bits] |= word_t(1) << (bit % word_bits);
+            ++c.n_used;
+            ++n_used;
+        }
+
+        void clear(const size_t off)
+        {
+            auto c = chunks.find(off / chunk_bits);
+            const size_t bit = off % chunk_bits;
+            c->second.bits[bit / word_bits] &= ~(word_t(1) << (bit % word_bits));
+            if (!--c->second.n_used)
+                chunks.erase(c);
+            --n_used;
+        }
+
+        // Find the first free offset >= from.  Addresses in chunks
+        // that are not allocated are free.
+        bool find_free(size_t from, size_t &off) const
+        {
+            size_t ci = from / chunk_bits;
+            auto c = chunks.lower_bound(ci);
+            while (c != chunks.end() && c->first == ci)
+            {
+                size_t bit;
+                if (c->second.find_free(from % chunk_bits, bit))
+                {
+                    off = ci * chunk_bits + bit;
+                    return off < extent;
+                }
+                ++c;
+                from = ++ci * chunk_bits;
+            }
+            off = from;
+            return off < extent;
+        }
+
+        ADDR start;
+        ADDR last;
+        size_t extent;
+        size_t n_used = 0;
+        std::map<size_t, Chunk> chunks; // chunk index -> bitmap
+    };
+
+    void add_block(const ADDR &start, const size_t extent)
+    {
+        index.emplace(start, blocks.size());
+        blocks.emplace_back(start, extent);
+        n_addrs += extent;
+    }
+
+    Block *find_block(const ADDR &addr)
+    {
+        auto next = index.upper_bound(addr);
+        if (next == index.begin())
+            return nullptr;
+        Block &b = blocks[std::prev(next)->second];
+        if (addr <= b.last)
+            return &b;
+        return nullptr;
+    }
+
+    // number of addresses from a to b, where a <= b and both are in the same range
+    static size_t offset(const ADDR &a, const ADDR &b)
+    {
+        return (b - a).to_ulong();
+    }
+
+    std::vector<Block> blocks;    // in the order they were added
+    std::map<ADDR, size_t> index; // block start address -> index in blocks
+    size_t n_addrs = 0;
+    size_t n_used = 0;
+    size_t cursor_block = 0; // where the next acquire_addr search starts
+    size_t cursor_offset = 0;
 };
 
 typedef PoolType<IP::Addr> Pool;
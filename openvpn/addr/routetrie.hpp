@@ -0,0 +1,335 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Longest-prefix-match table of routes, implemented as a path-compressed
+// binary (Patricia) trie.  Lookups cost O(address bits) regardless of the
+// number of routes in the table.  IPv4 and IPv6 routes are kept in
+// separate tries when ADDR is IP::Addr.
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include <openvpn/common/exception.hpp>
+#include <openvpn/common/ffs.hpp>
+#include <openvpn/addr/ip.hpp>
+#include <openvpn/addr/route.hpp>
+
+namespace openvpn {
+namespace IP {
+
+template <typename ADDR, typename T>
+class RouteTrieType
+{
+  public:
+    typedef RouteType<ADDR> Route;
+
+    OPENVPN_EXCEPTION(route_trie_error);
+
+    RouteTrieType()
+    {
+        roots[0] = roots[1] = npos;
+    }
+
+    template <typename LIST>
+    explicit RouteTrieType(const LIST &routes, const T &value = T())
+        : RouteTrieType()
+    {
+        for (const auto &r : routes)
+            insert(r, value);
+    }
+
+    // Add route to table, replacing the value of an identical route.
+    // Host bits of route.addr are ignored.  Returns true if the
+    // route was not already in the table.
+    bool insert(const Route &route, const T &value)
+    {
+        const Key k(route.addr, route.prefix_len);
+        size_t parent = npos;
+        unsigned int dir = 0;
+        size_t i = roots[k.root];
+        while (i != npos)
+        {
+            const Node &n = nodes[i];
+            const unsigned int common = k.common_prefix_len(n.key, std::min(k.prefix_len, n.key.prefix_len));
+            if (common < n.key.prefix_len)
+            {
+                // route diverges from, or is a prefix of, node i
+                const size_t leaf = common == k.prefix_len ? npos : new_leaf(k, value);
+                const size_t r = new_node(k.truncate(common));
+                Node &rn = nodes[r];
+                rn.child[nodes[i].key.bit(common)] = i;
+                if (leaf == npos)
+                {
+                    rn.value = value;
+                    rn.has_value = true;
+                }
+                else
+                    rn.child[k.bit(common)] = leaf;
+                link(k.root, parent, dir, r);
+                ++n_routes;
+                return true;
+            }
+            if (k.prefix_len == n.key.prefix_len)
+            {
+                Node &en = nodes[i];
+                en.value = value;
+                if (en.has_value)
+                    return false;
+                en.has_value = true;
+                ++n_routes;
+                return true;
+            }
+            parent = i;
+            dir = k.bit(n.key.prefix_len);
+            i = n.child[dir];
+        }
+        link(k.root, parent, dir, new_leaf(k, value));
+        ++n_routes;
+        return true;
+    }
+
+    // Return the value of the route identical to route, or nullptr.
+    const T *find(const Route &route) const
+    {
+        const Key k(route.addr, route.prefix_len);
+        const size_t i = longest(k);
+        if (i != npos && nodes[i].key.prefix_len == k.prefix_len)
+            return &nodes[i].value;
+        return nullptr;
+    }
+
+    // Return the value of the longest route containing addr, or nullptr.
+    // If matched is not null, the matching route is stored there.
+    const T *match(const ADDR &addr, Route *matched = nullptr) const
+    {
+        return match(Route(addr, addr.size()), matched);
+    }
+
+    // Return the value of the longest route containing route, or nullptr.
+    const T *match(const Route &route, Route *matched = nullptr) const
+    {
+        const size_t i = longest(Key(route.addr, route.prefix_len));
+        if (i == npos)
+            return nullptr;
+        if (matched)
+        {
+            *matched = Route(route.addr, nodes[i].key.prefix_len);
+            matched->force_canonical();
+        }
+        return &nodes[i].value;
+    }
+
+    // Look up a batch of addresses, storing the match() result
+    // for each address in [begin, end) to out.
+    template <typename ITER, typename OUT>
+    void match_batch(ITER begin, const ITER end, OUT out) const
+    {
+        for (; begin != end; ++begin)
+            *out++ = match(*begin);
+    }
+
+    // Return true if the table contains a route that is strictly
+    // contained in (i.e. more specific than) route.
+    bool contains_more_specific(const Route &route) const
+    {
+        const Key k(route.addr, route.prefix_len);
+        size_t i = roots[k.root];
+        while (i != npos)
+        {
+            const Node &n = nodes[i];
+            const unsigned int len = std::min(k.prefix_len, n.key.prefix_len);
+            if (k.common_prefix_len(n.key, len) < len)
+                return false;
+            if (n.key.prefix_len > k.prefix_len)
+                return true; // every subtree holds at least one route
+            if (n.key.prefix_len == k.prefix_len)
+                return n.child[0] != npos || n.child[1] != npos;
+            i = n.child[k.bit(n.key.prefix_len)];
+        }
+        return false;
+    }
+
+    size_t size() const
+    {
+        return n_routes;
+    }
+
+    bool empty() const
+    {
+        return n_routes == 0;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        roots[0] = roots[1] = npos;
+        n_routes = 0;
+    }
+
+  private:
+    static constexpr size_t npos = ~size_t(0);
+
+    // Address bits left-aligned in 4 host-order 32-bit words.
+    struct Key
+    {
+        Key() = default;
+
+        Key(const ADDR &addr, const unsigned int prefix_len_arg)
+        {
+            unsigned char bytes[16] = {};
+            load(addr, bytes);
+            for (unsigned int i = 0; i < 4; ++i)
+                w[i] = (std::uint32_t(bytes[i * 4]) << 24)
+                       | (std::uint32_t(bytes[i * 4 + 1]) << 16)
+                       | (std::uint32_t(bytes[i * 4 + 2]) << 8)
+                       | std::uint32_t(bytes[i * 4 + 3]);
+            if (prefix_len_arg > addr.size())
+                throw route_trie_error("prefix length " + std::to_string(prefix_len_arg) + " exceeds address size");
+            prefix_len = prefix_len_arg;
+            mask();
+        }
+
+        // number of leading bits (up to limit) that are equal in *this and other
+        unsigned int common_prefix_len(const Key &other, const unsigned int limit) const
+        {
+            for (unsigned int i = 0; i < 4 && i * 32 < limit; ++i)
+            {
+                const std::uint32_t x = w[i] ^ other.w[i];
+                if (x)
+                    return std::min(i * 32 + 32 - find_last_set(x), limit);
+            }
+            return limit;
+        }
+
+        unsigned int bit(const unsigned int pos) const
+        {
+            return (w[pos / 32] >> (31 - pos % 32)) & 1;
+        }
+
+        Key truncate(const unsigned int len) const
+        {
+            Key ret = *this;
+            ret.prefix_len = len;
+            ret.mask();
+            return ret;
+        }
+
+        std::uint32_t w[4] = {};
+        unsigned int prefix_len = 0;
+        unsigned int root = 0;
+
+      private:
+        void mask()
+        {
+            for (unsigned int i = 0; i < 4; ++i)
+            {
+                if (prefix_len <= i * 32)
+                    w[i] = 0;
+                else if (prefix_len < i * 32 + 32)
+                    w[i] &= ~std::uint32_t(0) << (i * 32 + 32 - prefix_len);
+            }
+        }
+
+        void load(const IPv4::Addr &addr, unsigned char *bytes)
+        {
+            addr.to_byte_string(bytes);
+        }
+
+        void load(const IPv6::Addr &addr, unsigned char *bytes)
+        {
+            addr.to_byte_string(bytes);
+            root = 1;
+        }
+
+        void load(const IP::Addr &addr, unsigned char *bytes)
+        {
+            if (!addr.defined())
+                throw route_trie_error("address unspecified");
+            addr.to_byte_string_variable(bytes);
+            root = addr.is_ipv6() ? 1 : 0;
+        }
+    };
+
+    struct Node
+    {
+        Key key;
+        size_t child[2] = {npos, npos};
+        bool has_value = false;
+        T value{};
+    };
+
+    // index of the node holding the longest route containing k, or npos
+    size_t longest(const Key &k) const
+    {
+        size_t best = npos;
+        size_t i = roots[k.root];
+        while (i != npos)
+        {
+            const Node &n = nodes[i];
+            if (n.key.prefix_len > k.prefix_len
+                || k.common_prefix_len(n.key, n.key.prefix_len) < n.key.prefix_len)
+                break;
+            if (n.has_value)
+                best = i;
+            if (n.key.prefix_len == k.prefix_len)
+                break;
+            i = n.child[k.bit(n.key.prefix_len)];
+        }
+        return best;
+    }
+
+    size_t new_node(const Key &k)
+    {
+        nodes.emplace_back();
+        nodes.back().key = k;
+        return nodes.size() - 1;
+    }
+
+    size_t new_leaf(const Key &k, const T &value)
+    {
+        const size_t i = new_node(k);
+        nodes[i].value = value;
+        nodes[i].has_value = true;
+        return i;
+    }
+
+    void link(const unsigned int root, const size_t parent, const unsigned int dir, const size_t i)
+    {
+        if (parent == npos)
+            roots[root] = i;
+        else
+            nodes[parent].child[dir] = i;
+    }
+
+    std::vector<Node> nodes;
+    size_t roots[2]; // IPv4, IPv6
+    size_t n_routes = 0;
+};
+
+template <typename T>
+using RouteTrie = RouteTrieType<IP::Addr, T>;
+
+} // namespace IP
+} // namespace openvpn
@@ -63,6 +63,7 @@
 #include <openvpn/common/exception.hpp>
 #include <openvpn/common/rc.hpp>
 #include <openvpn/buffer/bufclamp.hpp>
+#include <openvpn/buffer/bufpool.hpp>
 
 #ifdef OPENVPN_BUFFER_ABORT
 #define OPENVPN_BUFFER_THROW(exc) \
@@ -808,6 +809,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
         DESTRUCT_ZERO = (1 << 1),  // if enabled, destructor will zero data before deletion
         GROW = (1 << 2),           // if enabled, buffer will grow (otherwise buffer_full exception will be thrown)
         ARRAY = (1 << 3),          // if enabled, use as array
+        POOL = (1 << 4),           // if enabled, data is allocated from and released to the thread's BufferPool
     };
 
     BufferAllocatedType()
@@ -822,7 +824,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
         capacity_ = capacity;
         if (capacity)
         {
-            data_ = new T[capacity];
+            data_ = alloc_(capacity);
             if (flags & CONSTRUCT_ZERO)
                 std::memset(data_, 0, capacity * sizeof(T));
             if (flags & ARRAY)
@@ -836,7 +838,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
         size_ = capacity_ = size;
         if (size)
         {
-            data_ = new T[size];
+            data_ = alloc_(size);
             std::memcpy(data_, data, size * sizeof(T));
         }
     }
@@ -849,7 +851,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
         flags_ = other.flags_;
         if (capacity_)
         {
-            data_ = new T[capacity_];
+            data_ = alloc_(capacity_);
             if (size_)
                 std::memcpy(data_ + offset_, other.data_ + offset_, size_ * sizeof(T));
         }
@@ -865,7 +867,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
         flags_ = flags;
         if (capacity_)
         {
-            data_ = new T[capacity_];
+            data_ = alloc_(capacity_);
             if (size_)
                 std::memcpy(data_ + offset_, other.data_ + offset_, size_ * sizeof(T));
         }
@@ -879,8 +881,9 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
             if (capacity_ != other.capacity_)
             {
                 erase_();
+                flags_ = other.flags_;
                 if (other.capacity_)
-                    data_ = new T[other.capacity_];
+                    data_ = alloc_(other.capacity_);
                 capacity_ = other.capacity_;
             }
             offset_ = other.offset_;
@@ -900,7 +903,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
             erase_();
             if (capacity)
             {
-                data_ = new T[capacity];
+                data_ = alloc_(capacity);
             }
             capacity_ = capacity;
         }
@@ -918,7 +921,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
         {
             erase_();
             if (size)
-                data_ = new T[size];
+                data_ = alloc_(size);
             capacity_ = size;
         }
         size_ = size;
@@ -1024,6 +1027,7 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
 
     void realloc_(const size_t newcap)
     {
+        // not pooled, grown capacities don't match a pool size class
         T *data = new T[newcap];
         if (size_)
             std::memcpy(data + offset_, data_ + offset_, size_ * sizeof(T));
@@ -1056,11 +1060,22 @@ class BufferAllocatedType : public BufferType<T>, public RC<R>
         capacity_ = 0;
     }
 
+    T *alloc_(const size_t capacity)
+    {
+        if (flags_ & POOL)
+            return BufferPoolType<T>::alloc(capacity);
+        else
+            return new T[capacity];
+    }
+
     void delete_()
     {
         if (size_ && (flags_ & DESTRUCT_ZERO))
             std::memset(data_, 0, capacity_ * sizeof(T));
-        delete[] data_;
+        if (flags_ & POOL)
+            BufferPoolType<T>::release(data_, capacity_);
+        else
+            delete[] data_;
     }
 
     unsigned int flags_;
@@ -0,0 +1,209 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Per-thread pool of buffer data blocks.
+//
+// BufferAllocated objects created with the POOL flag take their data
+// block from the pool of the calling thread and give it back when
+// released, rather than going to the general-purpose allocator for
+// every packet.  Blocks are kept in a small number of size classes,
+// keyed by exact capacity, which are created on demand by the first
+// pooled allocation of each capacity.  Frame contexts normally share
+// one standardized capacity (see Frame::standardize_capacity), so a
+// single class serves all packet buffers.
+//
+// Pooled blocks are ordinary new[] allocations, so a block may be
+// released on a thread other than the one that allocated it, and
+// blocks that don't fit a size class are simply deleted.
+
+#ifndef OPENVPN_BUFFER_BUFPOOL_H
+#define OPENVPN_BUFFER_BUFPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+namespace openvpn {
+
+// maximum number of free blocks retained per size class and thread
+#ifndef OPENVPN_BUFFER_POOL_LIMIT
+#define OPENVPN_BUFFER_POOL_LIMIT 256
+#endif
+
+template <typename T>
+class BufferPoolType
+{
+  public:
+    enum
+    {
+        N_CLASSES = 4,
+        LIMIT = OPENVPN_BUFFER_POOL_LIMIT,
+    };
+
+    // counters for the calling thread
+    struct Stats
+    {
+        size_t hits = 0;      // allocations served from the pool
+        size_t misses = 0;    // allocations passed to new[]
+        size_t recycled = 0;  // releases retained by the pool
+        size_t discarded = 0; // releases passed to delete[]
+    };
+
+    static T *alloc(const size_t capacity)
+    {
+        Pool *p = pool();
+        if (p)
+        {
+            SizeClass *sc = p->find(capacity, true);
+            if (sc && !sc->free.empty())
+            {
+                T *data = sc->free.back();
+                sc->free.pop_back();
+                ++p->stats.hits;
+                return data;
+            }
+            ++p->stats.misses;
+        }
+        return new T[capacity];
+    }
+
+    static void release(T *data, const size_t capacity)
+    {
+        Pool *p = pool();
+        if (p)
+        {
+            SizeClass *sc = p->find(capacity, false);
+            if (sc && sc->free.size() < LIMIT)
+            {
+                sc->free.push_back(data);
+                ++p->stats.recycled;
+                return;
+            }
+            ++p->stats.discarded;
+        }
+        delete[] data;
+    }
+
+    static Stats stats()
+    {
+        const Pool *p = pool();
+        return p ? p->stats : Stats();
+    }
+
+    static void reset_stats()
+    {
+        Pool *p = pool();
+        if (p)
+            p->stats = Stats();
+    }
+
+    // number of free blocks held by the calling thread
+    static size_t size()
+    {
+        const Pool *p = pool();
+        size_t ret = 0;
+        if (p)
+            for (const auto &sc : p->classes)
+                ret += sc.free.size();
+        return ret;
+    }
+
+    // delete free blocks held by the calling thread
+    static void purge()
+    {
+        Pool *p = pool();
+        if (p)
+            p->purge();
+    }
+
+  private:
+    struct SizeClass
+    {
+        size_t capacity = 0;
+        std::vector<T *> free;
+    };
+
+    struct Pool
+    {
+        ~Pool()
+        {
+            purge();
+        }
+
+        // Return the size class for capacity, creating it if create
+        // is true and a slot is available.
+        SizeClass *find(const size_t capacity, const bool create)
+        {
+            for (auto &sc : classes)
+            {
+                if (sc.capacity == capacity)
+                    return &sc;
+                if (!sc.capacity)
+                {
+                    if (!create)
+                        return nullptr;
+                    sc.capacity = capacity;
+                    sc.free.reserve(LIMIT);
+                    return &sc;
+                }
+            }
+            return nullptr;
+        }
+
+        void purge()
+        {
+            for (auto &sc : classes)
+            {
+                for (T *data : sc.free)
+                    delete[] data;
+                sc.free.clear();
+            }
+        }
+
+        SizeClass classes[N_CLASSES];
+        Stats stats;
+    };
+
+    // Return the pool of the calling thread, or nullptr if the
+    // thread is exiting and its pool was already destroyed.
+    static Pool *pool()
+    {
+        static thread_local bool dead = false;
+        if (dead)
+            return nullptr;
+
+        struct Holder
+        {
+            ~Holder()
+            {
+                dead = true;
+            }
+            Pool pool;
+        };
+        static thread_local Holder holder;
+        return &holder.pool;
+    }
+};
+
+typedef BufferPoolType<unsigned char> BufferPool;
+
+} // namespace openvpn
+
+#endif
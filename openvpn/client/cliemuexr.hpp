@@ -27,6 +27,7 @@
 #include <openvpn/common/exception.hpp>
 #include <openvpn/tun/client/emuexr.hpp>
 #include <openvpn/addr/addrspacesplit.hpp>
+#include <openvpn/addr/routetrie.hpp>
 
 namespace openvpn {
 class EmulateExcludeRouteImpl : public EmulateExcludeRoute
@@ -105,11 +106,14 @@ class EmulateExcludeRouteImpl : public EmulateExcludeRoute
             return;
         }
 
+        const IP::RouteTrie<bool> includeTrie(include, true);
+        const IP::RouteTrie<bool> excludeTrie(*excludedRoutes, true);
+
         // Complete address space (0.0.0.0/0 or ::/0) split into smaller networks
         // Figure out which parts of this non overlapping address we want to install
         for (const auto &r : IP::AddressSpaceSplitter(rl, ip_ver_flags))
         {
-            if (check_route_should_be_installed(r, *excludedRoutes))
+            if (check_route_should_be_installed(r, includeTrie, excludeTrie))
                 if (!tb->tun_builder_add_route(r.addr.to_string(), r.prefix_len, -1, r.addr.version() == IP::Addr::V6))
                     throw emulate_exclude_route_error("tun_builder_add_route failed");
         }
@@ -117,7 +121,9 @@ class EmulateExcludeRouteImpl : public EmulateExcludeRoute
         ipv.set_emulate_exclude_routes();
     }
 
-    bool check_route_should_be_installed(const IP::Route &r, const IP::RouteList &excludedRoutes) const
+    static bool check_route_should_be_installed(const IP::Route &r,
+                                                const IP::RouteTrie<bool> &includeTrie,
+                                                const IP::RouteTrie<bool> &excludeTrie)
     {
         // The whole address space was partioned into NON-overlapping routes that
         // we get one by one with the parameter r.
@@ -125,28 +131,19 @@ class EmulateExcludeRouteImpl : public EmulateExcludeRoute
         // excluded IPs.
         // Figure out if this particular route should be installed or not
 
-        IP::Route const *bestroute = nullptr;
         // Get the best (longest-prefix/smallest) route from included routes that completely
         // matches this route
-        for (const auto &incRoute : include)
+        IP::Route bestroute;
+        if (!includeTrie.match(r, &bestroute))
         {
-            if (incRoute.contains(r))
-            {
-                if (!bestroute || bestroute->prefix_len < incRoute.prefix_len)
-                    bestroute = &incRoute;
-            }
-        }
-
-        // No positive route matches the route at all, do not install it
-        if (!bestroute)
+            // No positive route matches the route at all, do not install it
             return false;
+        }
 
         // Check if there is a more specific exclude route
-        for (const auto &exclRoute : excludedRoutes)
-        {
-            if (exclRoute.contains(r) && exclRoute.prefix_len > bestroute->prefix_len)
-                return false;
-        }
+        IP::Route bestexclude;
+        if (excludeTrie.match(r, &bestexclude) && bestexclude.prefix_len > bestroute.prefix_len)
+            return false;
         return true;
     }
 
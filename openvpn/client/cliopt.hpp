@@ -171,6 +171,11 @@ class ClientOptions : public RC<thread_unsafe_refcount>
         HTTPProxyTransport::Options::Ptr http_proxy_options;
         bool alt_proxy = false;
         bool synchronous_dns_lookup = false;
+        unsigned int udp_batch_size = 0;
+        bool udp_gso = false;
+        unsigned int dc_threads = 0;
+        unsigned int tun_queues = 0;
+        bool tun_vnet_hdr = false;
         bool disable_client_cert = false;
         int default_key_direction = -1;
         bool autologin_sessions = false;
@@ -214,6 +219,9 @@ class ClientOptions : public RC<thread_unsafe_refcount>
           cli_events(config.cli_events),
           server_poll_timeout_(10),
           tcp_queue_limit(64),
+          udp_batch_size(config.udp_batch_size),
+          udp_gso(config.udp_gso),
+          dc_threads(config.dc_threads),
           proto_context_options(config.proto_context_options),
           http_proxy_options(config.http_proxy_options),
           autologin(false),
@@ -448,6 +456,9 @@ class ClientOptions : public RC<thread_unsafe_refcount>
                 tunconf->tun_prop.remote_list = remote_list;
                 tunconf->frame = frame;
                 tunconf->stats = cli_stats;
+                if (config.tun_queues)
+                    tunconf->n_queues = static_cast<int>(config.tun_queues);
+                tunconf->vnet_hdr = config.tun_vnet_hdr;
                 if (config.clientconf.tunPersist)
                     tunconf->tun_persist.reset(new TunLinux::TunPersist(true, TunWrapObjRetain::NO_RETAIN, nullptr));
                 tunconf->load(opt);
@@ -1118,6 +1129,7 @@ class ClientOptions : public RC<thread_unsafe_refcount>
         cli_config->creds = creds;
         cli_config->pushed_options_filter = pushed_options_filter;
         cli_config->tcp_queue_limit = tcp_queue_limit;
+        cli_config->dc_threads = dc_threads;
         cli_config->echo = clientconf.echo;
         cli_config->info = clientconf.info;
         cli_config->autologin_sessions = autologin_sessions;
@@ -1356,6 +1368,8 @@ class ClientOptions : public RC<thread_unsafe_refcount>
                 udpconf->stats = cli_stats;
                 udpconf->socket_protect = socket_protect;
                 udpconf->server_addr_float = server_addr_float;
+                udpconf->batch_size = udp_batch_size;
+                udpconf->gso = udp_gso;
 #ifdef OPENVPN_GREMLIN
                 udpconf->gremlin_config = gremlin_config;
 #endif
@@ -1410,6 +1424,9 @@ class ClientOptions : public RC<thread_unsafe_refcount>
     ClientCreds::Ptr creds;
     unsigned int server_poll_timeout_;
     unsigned int tcp_queue_limit;
+    unsigned int udp_batch_size;
+    bool udp_gso;
+    unsigned int dc_threads;
     ProtoContextCompressionOptions::Ptr proto_context_options;
     HTTPProxyTransport::Options::Ptr http_proxy_options;
 #ifdef OPENVPN_GREMLIN
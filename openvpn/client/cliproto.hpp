@@ -67,6 +67,7 @@
 #include <openvpn/error/excode.hpp>
 
 #include <openvpn/ssl/proto.hpp>
+#include <openvpn/ssl/dcpipeline.hpp>
 
 #ifdef OPENVPN_DEBUG_CLIPROTO
 #define OPENVPN_LOG_CLIPROTO(x) OPENVPN_LOG(x)
@@ -95,6 +96,7 @@ struct NotifyCallback
 class Session : ProtoContext,
                 TransportClientParent,
                 TunClientParent,
+                DataChannelPipelineParent,
                 public RC<thread_unsafe_refcount>
 {
     typedef ProtoContext Base;
@@ -144,6 +146,7 @@ class Session : ProtoContext,
         OptionList::Limits pushed_options_limit;
         OptionList::FilterBase::Ptr pushed_options_filter;
         unsigned int tcp_queue_limit = 0;
+        unsigned int dc_threads = 0; // data channel pipeline threads, 0 to disable
         bool echo = false;
         bool info = false;
         bool autologin_sessions = false;
@@ -183,6 +186,9 @@ class Session : ProtoContext,
         // Base::enable_strict_openvpn_2x();
 
         info_hold.reset(new std::vector<ClientEvent::Base::Ptr>());
+
+        if (config.dc_threads)
+            dc_pipeline.reset(new DataChannelPipeline(io_context_arg, this, config.dc_threads));
     }
 
     bool first_packet_received() const
@@ -263,6 +269,8 @@ class Session : ProtoContext,
             push_request_timer.cancel();
             inactive_timer.cancel();
             info_hold_timer.cancel();
+            if (dc_pipeline)
+                dc_pipeline->stop();
             if (notify_callback && call_terminate_callback)
                 notify_callback->client_proto_terminate();
             if (tun)
@@ -326,6 +334,10 @@ class Session : ProtoContext,
         {
             OPENVPN_LOG_CLIPROTO("Transport RECV " << server_endpoint_render() << ' ' << Base::dump_packet(buf));
 
+            // start data path timing, if enabled
+            DataPathStats *dps = cli_stats->datapath_stats();
+            const std::uint64_t t_recv = dps ? DataPathStats::now_ns() : 0;
+
             // update current time
             Base::update_now();
 
@@ -344,10 +356,22 @@ class Session : ProtoContext,
             Base::PacketType pt = Base::packet_type(buf);
 
             // process packet
-            if (pt.is_data())
+            if (pt.is_data() && dc_pipeline)
+            {
+                // data packet, delivered to tun by dc_pipeline_done()
+                std::unique_ptr<DataChannelPipeline::Job> job = dc_pipeline->alloc();
+                job->buf.swap(buf);
+                Base::data_decrypt_job(pt, *job, dc_pipeline->n_threads());
+                job->start_ns = t_recv;
+                dc_pipeline->submit(std::move(job));
+            }
+            else if (pt.is_data())
             {
                 // data packet
+                const std::uint64_t t_crypt = dps ? DataPathStats::now_ns() : 0;
                 Base::data_decrypt(pt, buf);
+                if (dps)
+                    dps->record_since(DataPathStats::DECRYPT, t_crypt);
                 if (buf.size())
                 {
 #ifdef OPENVPN_PACKET_LOG
@@ -358,6 +382,8 @@ class Session : ProtoContext,
                     {
                         OPENVPN_LOG_CLIPROTO("TUN send, size=" << buf.size());
                         tun->tun_send(buf);
+                        if (dps)
+                            dps->record_since(DataPathStats::TRANSPORT_TO_TUN, t_recv);
                     }
                 }
 
@@ -407,6 +433,10 @@ class Session : ProtoContext,
         {
             OPENVPN_LOG_CLIPROTO("TUN recv, size=" << buf.size());
 
+            // start data path timing, if enabled
+            DataPathStats *dps = cli_stats->datapath_stats();
+            const std::uint64_t t_recv = dps ? DataPathStats::now_ns() : 0;
+
             // update current time
             Base::update_now();
 
@@ -439,9 +469,21 @@ class Session : ProtoContext,
                     Ptb::generate_icmp_ptb(buf, clamp_to_typerange<unsigned short>(mss_no_tcp_ip_encap));
                     tun->tun_send(buf);
                 }
+                else if (dc_pipeline)
+                {
+                    // sent to transport by dc_pipeline_done()
+                    std::unique_ptr<DataChannelPipeline::Job> job = dc_pipeline->alloc();
+                    job->buf.swap(buf);
+                    Base::data_encrypt_job(*job, dc_pipeline->n_threads());
+                    job->start_ns = t_recv;
+                    dc_pipeline->submit(std::move(job));
+                }
                 else
                 {
+                    const std::uint64_t t_crypt = dps ? DataPathStats::now_ns() : 0;
                     Base::data_encrypt(buf);
+                    if (dps)
+                        dps->record_since(DataPathStats::ENCRYPT, t_crypt);
                     if (buf.size())
                     {
                         // send packet via transport to destination
@@ -450,6 +492,8 @@ class Session : ProtoContext,
                             Base::update_last_sent();
                         else if (halt)
                             return;
+                        if (dps)
+                            dps->record_since(DataPathStats::TUN_TO_TRANSPORT, t_recv);
                     }
                 }
             }
@@ -466,6 +510,62 @@ class Session : ProtoContext,
         }
     }
 
+    // data channel pipeline returns completed packets here, in order
+    void dc_pipeline_done(ProtoContext::DataJob &job) override
+    {
+        try
+        {
+            // update current time
+            Base::update_now();
+
+            DataPathStats *dps = cli_stats->datapath_stats();
+
+            if (job.encrypt)
+            {
+                Base::data_encrypt_finish(job);
+                if (job.buf.size())
+                {
+                    // send packet via transport to destination
+                    OPENVPN_LOG_CLIPROTO("Transport SEND " << server_endpoint_render() << ' ' << Base::dump_packet(job.buf));
+                    if (transport->transport_send(job.buf))
+                        Base::update_last_sent();
+                    else if (halt)
+                        return;
+                    if (dps && job.start_ns)
+                        dps->record_since(DataPathStats::TUN_TO_TRANSPORT, job.start_ns);
+                }
+            }
+            else
+            {
+                Base::data_decrypt_finish(job);
+                if (job.buf.size())
+                {
+#ifdef OPENVPN_PACKET_LOG
+                    log_packet(job.buf, false);
+#endif
+                    // make packet appear as incoming on tun interface
+                    if (tun)
+                    {
+                        OPENVPN_LOG_CLIPROTO("TUN send, size=" << job.buf.size());
+                        tun->tun_send(job.buf);
+                        if (dps && job.start_ns)
+                            dps->record_since(DataPathStats::TRANSPORT_TO_TUN, job.start_ns);
+                    }
+                }
+            }
+
+            // do a lightweight flush
+            Base::flush(false);
+
+            // schedule housekeeping wakeup
+            set_housekeeping_timer();
+        }
+        catch (const std::exception &e)
+        {
+            process_exception(e, "dc_pipeline");
+        }
+    }
+
     // Return true if keepalive parameter(s) are enabled.
     bool is_keepalive_enabled() const override
     {
@@ -1413,6 +1513,8 @@ class Session : ProtoContext,
     unsigned int tcp_queue_limit;
     bool transport_has_send_queue = false;
 
+    DataChannelPipeline::Ptr dc_pipeline;
+
     NotifyCallback *notify_callback;
 
     CoarseTime housekeeping_schedule;
@@ -0,0 +1,204 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// A log-linear (HDR-style) histogram of unsigned 64-bit values.
+// Values are grouped into power-of-two ranges, each divided into
+// SUB_BUCKETS linear sub-buckets, so the relative error of any
+// reported value is bounded by 1/SUB_BUCKETS regardless of its
+// magnitude.  record() is lock-free and may be called concurrently
+// from several threads while another thread takes a snapshot().
+
+#ifndef OPENVPN_COMMON_HISTOGRAM_H
+#define OPENVPN_COMMON_HISTOGRAM_H
+
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <limits>
+
+#include <openvpn/common/size.hpp>
+#include <openvpn/common/ffs.hpp>
+
+namespace openvpn {
+
+class LogLinearHistogram
+{
+  public:
+    enum
+    {
+        SUB_BITS = 4,
+        SUB_BUCKETS = 1 << SUB_BITS,
+        MAX_BITS = 36, // larger values are counted in the last bucket
+    };
+
+    static constexpr std::uint64_t MAX_VALUE = (std::uint64_t(1) << MAX_BITS) - 1;
+    static constexpr size_t N_BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    // A copy of the histogram at one point in time
+    struct Snapshot
+    {
+        // Smallest value v such that pct percent of all recorded
+        // values are <= v, to within the bucket resolution.
+        std::uint64_t percentile(const double pct) const
+        {
+            if (!count)
+                return 0;
+            std::uint64_t target;
+            if (pct <= 0.0)
+                target = 1;
+            else if (pct >= 100.0)
+                target = count;
+            else
+            {
+                const double t = pct * static_cast<double>(count) / 100.0;
+                target = static_cast<std::uint64_t>(t);
+                if (static_cast<double>(target) < t)
+                    ++target;
+                if (!target)
+                    target = 1;
+            }
+
+            std::uint64_t cum = 0;
+            for (size_t i = 0; i < buckets.size(); ++i)
+            {
+                cum += buckets[i];
+                if (cum >= target)
+                {
+                    const std::uint64_t v = bucket_upper(i);
+                    if (v > max)
+                        return max;
+                    if (v < min)
+                        return min;
+                    return v;
+                }
+            }
+            return max;
+        }
+
+        double mean() const
+        {
+            return count ? static_cast<double>(sum) / static_cast<double>(count) : 0.0;
+        }
+
+        std::uint64_t count = 0;
+        std::uint64_t sum = 0;
+        std::uint64_t min = 0;
+        std::uint64_t max = 0;
+        std::vector<std::uint64_t> buckets; // N_BUCKETS entries
+    };
+
+    LogLinearHistogram()
+    {
+        reset();
+    }
+
+    LogLinearHistogram(const LogLinearHistogram &) = delete;
+    LogLinearHistogram &operator=(const LogLinearHistogram &) = delete;
+
+    void record(const std::uint64_t value) noexcept
+    {
+        counts[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        std::uint64_t m = min_.load(std::memory_order_relaxed);
+        while (value < m && !min_.compare_exchange_weak(m, value, std::memory_order_relaxed))
+            ;
+        m = max_.load(std::memory_order_relaxed);
+        while (value > m && !max_.compare_exchange_weak(m, value, std::memory_order_relaxed))
+            ;
+    }
+
+    // Not atomic with respect to concurrent record() calls
+    void reset() noexcept
+    {
+        for (auto &c : counts)
+            c.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        min_.store(std::numeric_limits<std::uint64_t>::max(), std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    Snapshot snapshot() const
+    {
+        Snapshot ret;
+        ret.buckets.resize(N_BUCKETS);
+        for (size_t i = 0; i < N_BUCKETS; ++i)
+        {
+            ret.buckets[i] = counts[i].load(std::memory_order_relaxed);
+            ret.count += ret.buckets[i];
+        }
+        if (ret.count)
+        {
+            ret.sum = sum_.load(std::memory_order_relaxed);
+            ret.min = min_.load(std::memory_order_relaxed);
+            ret.max = max_.load(std::memory_order_relaxed);
+        }
+        return ret;
+    }
+
+    static size_t bucket_index(std::uint64_t value) noexcept
+    {
+        if (value < SUB_BUCKETS)
+            return static_cast<size_t>(value);
+        if (value > MAX_VALUE)
+            value = MAX_VALUE;
+        const int shift = msb(value) - SUB_BITS;
+        const size_t sub = static_cast<size_t>(value >> shift) & (SUB_BUCKETS - 1);
+        return static_cast<size_t>(shift + 1) * SUB_BUCKETS + sub;
+    }
+
+    // smallest value counted in bucket i
+    static std::uint64_t bucket_lower(const size_t i) noexcept
+    {
+        if (i < SUB_BUCKETS)
+            return i;
+        const int shift = static_cast<int>(i / SUB_BUCKETS) - 1;
+        return (std::uint64_t(SUB_BUCKETS) + i % SUB_BUCKETS) << shift;
+    }
+
+    // largest value counted in bucket i
+    static std::uint64_t bucket_upper(const size_t i) noexcept
+    {
+        if (i < SUB_BUCKETS)
+            return i;
+        const int shift = static_cast<int>(i / SUB_BUCKETS) - 1;
+        return bucket_lower(i) + (std::uint64_t(1) << shift) - 1;
+    }
+
+  private:
+    // zero-based position of the most significant 1 bit, value != 0
+    static int msb(const std::uint64_t value) noexcept
+    {
+        const unsigned int hi = static_cast<unsigned int>(value >> 32);
+        if (hi)
+            return 31 + find_last_set(hi);
+        return find_last_set(static_cast<unsigned int>(value)) - 1;
+    }
+
+    std::atomic<std::uint64_t> counts[N_BUCKETS];
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> min_;
+    std::atomic<std::uint64_t> max_;
+};
+
+} // namespace openvpn
+
+#endif // OPENVPN_COMMON_HISTOGRAM_H
@@ -48,6 +48,7 @@
 #define OPENVPN_COMMON_OPTIONS_H
 
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <vector>
 #include <algorithm>   // for std::sort, std::min
@@ -528,7 +529,21 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
   public:
     typedef RCPtr<OptionList> Ptr;
     typedef std::vector<unsigned int> IndexList;
-    typedef std::unordered_map<std::string, IndexList> IndexMap;
+
+    // Transparent hash so that, with C++20 heterogeneous lookup,
+    // map().find() can take a string_view or literal without
+    // constructing a temporary std::string.
+    struct IndexHash
+    {
+        typedef void is_transparent;
+
+        size_t operator()(const std::string_view s) const noexcept
+        {
+            return std::hash<std::string_view>()(s);
+        }
+    };
+
+    typedef std::unordered_map<std::string, IndexList, IndexHash, std::equal_to<>> IndexMap;
     typedef std::pair<std::string, IndexList> IndexPair;
 
     static bool is_comment(const char c)
@@ -911,6 +926,33 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
     {
         if (lim)
             lim->add_string(str);
+        if (is_plain(str))
+        {
+            // fast path: without quotes or escapes, commas always
+            // split and each item can be tokenized in place
+            std::string_view in(str);
+            while (true)
+            {
+                const size_t comma = in.find(',');
+                if (lim)
+                    lim->add_term();
+                Option opt;
+                split_plain<false>(opt, in.substr(0, comma), lim);
+                if (opt.size())
+                {
+                    if (lim)
+                    {
+                        lim->add_opt();
+                        lim->validate_directive(opt);
+                    }
+                    push_back(std::move(opt));
+                }
+                if (comma == std::string_view::npos)
+                    break;
+                in.remove_prefix(comma + 1);
+            }
+            return;
+        }
         std::vector<std::string> list = Split::by_char<std::vector<std::string>, Lex, Limits>(str, ',', 0, ~0, lim);
         for (std::vector<std::string>::const_iterator i = list.begin(); i != list.end(); ++i)
         {
@@ -996,9 +1038,14 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
         }
     }
 
-    static Option parse_option_from_line(const std::string &line, Limits *lim)
+    static Option parse_option_from_line(const std::string_view line, Limits *lim)
     {
-        return Split::by_space<Option, LexComment, SpaceMatch, Limits>(line, lim);
+        {
+            Option opt;
+            if (split_plain<true>(opt, line, lim))
+                return opt;
+        }
+        return Split::by_space<Option, LexComment, SpaceMatch, Limits>(std::string(line), lim);
     }
 
     // caller should call update_map() after this function
@@ -1007,16 +1054,18 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
         if (lim)
             lim->add_string(str);
 
-        SplitLines in(str, lim ? lim->get_max_line_len() : 0);
+        std::string_view in(str);
+        const size_t max_line_len = lim ? lim->get_max_line_len() : 0;
         int line_num = 0;
         bool in_multiline = false;
         Option multiline;
-        while (in(true))
+        while (!in.empty())
         {
             ++line_num;
-            if (in.line_overflow())
+            bool overflow;
+            const std::string_view line = next_line(in, max_line_len, overflow);
+            if (overflow)
                 line_too_long(line_num);
-            const std::string &line = in.line_ref();
             if (in_multiline)
             {
                 if (is_close_tag(line, multiline.ref(0)))
@@ -1034,7 +1083,7 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
                 else
                 {
                     std::string &mref = multiline.ref(1);
-                    mref += line;
+                    mref.append(line);
                     mref += '\n';
                 }
             }
@@ -1598,11 +1647,10 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
     }
 
     // return true if line is blank or a comment
-    static bool ignore_line(const std::string &line)
+    static bool ignore_line(const std::string_view line)
     {
-        for (std::string::const_iterator i = line.begin(); i != line.end(); ++i)
+        for (const char c : line)
         {
-            const char c = *i;
             if (!SpaceMatch::is_space(c))
                 return is_comment(c);
         }
@@ -1619,7 +1667,7 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
     }
 
     // return true if string is a close tag, e.g. "</ca>"
-    static bool is_close_tag(const std::string &str, const std::string &tag)
+    static bool is_close_tag(const std::string_view str, const std::string_view tag)
     {
         const size_t n = str.length();
         return n >= 4 && str[0] == '<' && str[1] == '/' && str.substr(2, n - 3) == tag && str[n - 1] == '>';
@@ -1703,6 +1751,77 @@ class OptionList : public std::vector<Option>, public RCCopyable<thread_unsafe_r
         OPENVPN_THROW(option_error, "line " << line_num << " is too long");
     }
 
+    // Return the next line of in without its trailing \r/\n and advance
+    // in past it.  Follows SplitLines: overflow is set when the raw line,
+    // newline included, is longer than a non-zero max_line_len.
+    static std::string_view next_line(std::string_view &in, const size_t max_line_len, bool &overflow)
+    {
+        const size_t nl = in.find('\n');
+        const size_t len = (nl == std::string_view::npos) ? in.length() : nl + 1;
+        overflow = max_line_len && len > max_line_len;
+        std::string_view line = in.substr(0, len);
+        in.remove_prefix(len);
+        while (!line.empty() && (line.back() == '\r' || line.back() == '\n'))
+            line.remove_suffix(1);
+        return line;
+    }
+
+    static bool is_lex_special(const char c)
+    {
+        return c == '\"' || c == '\\';
+    }
+
+    // true if str has no quoting or escapes for the lexer to handle
+    static bool is_plain(const std::string_view str)
+    {
+        for (const char c : str)
+        {
+            if (is_lex_special(c))
+                return false;
+        }
+        return true;
+    }
+
+    // Tokenize line into opt, producing the same terms as Split::by_space
+    // with Lex, or LexComment if COMMENTS, but copying each term out of
+    // the line in one step.  Returns false, leaving opt in an unspecified
+    // state, if the line needs the lexer for quoting or escapes.
+    template <bool COMMENTS>
+    static bool split_plain(Option &opt, const std::string_view line, Limits *lim)
+    {
+        const size_t n = line.length();
+        size_t i = 0;
+        size_t nterms = 0;
+        while (i < n)
+        {
+            const char c = line[i];
+            if (COMMENTS && is_comment(c))
+                break;
+            if (SpaceMatch::is_space(c))
+            {
+                ++i;
+                continue;
+            }
+            const size_t start = i;
+            for (; i < n; ++i)
+            {
+                const char tc = line[i];
+                if (is_lex_special(tc))
+                    return false;
+                if (SpaceMatch::is_space(tc) || (COMMENTS && is_comment(tc)))
+                    break;
+            }
+            opt.push_back(std::string(line.substr(start, i - start)));
+            ++nterms;
+        }
+        if (lim)
+        {
+            while (nterms--)
+                lim->add_term();
+        }
+        return true;
+    }
+
     void from_list(Option opt)
     {
         push_back(std::move(opt));
@@ -0,0 +1,177 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Adaptive compression bypass.  Tracks how well recent packets of
+// each flow (hashed 5-tuple of the uncompressed IP packet) have
+// compressed, and lets compressors skip flows that have proven
+// incompressible, such as TLS or QUIC.  Bypassed flows are probed
+// again after a number of packets that doubles each time the probe
+// still fails to compress, up to MAX_BACKOFF.
+
+#ifndef OPENVPN_COMPRESS_COMPADAPT_H
+#define OPENVPN_COMPRESS_COMPADAPT_H
+
+#include <cstdint>
+#include <algorithm> // for std::min
+
+#include <openvpn/common/size.hpp>
+#include <openvpn/buffer/buffer.hpp>
+#include <openvpn/ip/ipcommon.hpp>
+
+// Number of flow slots, must be a power of 2
+#ifndef OPENVPN_COMPRESS_ADAPT_SLOTS
+#define OPENVPN_COMPRESS_ADAPT_SLOTS 256
+#endif
+
+namespace openvpn {
+
+class CompressAdapt
+{
+  public:
+    enum
+    {
+        N_SLOTS = OPENVPN_COMPRESS_ADAPT_SLOTS,
+        RATIO_ONE = 1024,      // fixed point 1.0 for compressed/original ratio
+        RATIO_THRESHOLD = 973, // ~0.95, flows saving less are incompressible
+        MIN_SAMPLES = 4,       // samples required before bypassing a flow
+        MIN_BACKOFF = 16,      // packets bypassed after a flow is first judged incompressible
+        MAX_BACKOFF = 1024,    // upper bound on packets bypassed between probes
+    };
+
+    struct Flow
+    {
+        // Returns true if the next packet of this flow should
+        // be compressed, false if it should bypass compression.
+        bool probe()
+        {
+            if (skip)
+            {
+                --skip;
+                return false;
+            }
+            return true;
+        }
+
+        // Report the result of a compression attempt, out_size
+        // should equal in_size if the packet didn't shrink.
+        void update(const size_t in_size, const size_t out_size)
+        {
+            if (!in_size)
+                return;
+            const unsigned int r = out_size >= in_size
+                                       ? static_cast<unsigned int>(RATIO_ONE)
+                                       : static_cast<unsigned int>(out_size * RATIO_ONE / in_size);
+            if (backoff && r < RATIO_THRESHOLD)
+            {
+                // probe succeeded, relearn the flow from scratch
+                ratio = r;
+                samples = 1;
+                backoff = 0;
+                return;
+            }
+
+            // exponentially weighted moving average, alpha = 1/4
+            ratio = samples ? (ratio * 3 + r) / 4 : r;
+            if (samples < MIN_SAMPLES)
+                ++samples;
+
+            if (samples >= MIN_SAMPLES && ratio >= RATIO_THRESHOLD)
+            {
+                backoff = backoff ? std::min(backoff * 2, static_cast<unsigned int>(MAX_BACKOFF)) : MIN_BACKOFF;
+                skip = backoff;
+            }
+        }
+
+        bool bypassed() const
+        {
+            return skip != 0;
+        }
+
+        std::uint32_t tag = 0;
+        unsigned int ratio = 0;   // EWMA of compressed/original size, RATIO_ONE == 1.0
+        unsigned int samples = 0; // number of compression attempts, saturates at MIN_SAMPLES
+        unsigned int skip = 0;    // packets left to bypass before the next probe
+        unsigned int backoff = 0; // current bypass length, 0 if the flow compresses
+    };
+
+    // Find the flow that buf belongs to.  Packets that are
+    // not TCP or UDP over IPv4/IPv6 are grouped by protocol.
+    Flow &lookup(const Buffer &buf)
+    {
+        const std::uint64_t h = flow_hash(buf.c_data(), buf.size());
+        Flow &f = slots[h & (N_SLOTS - 1)];
+        const std::uint32_t tag = static_cast<std::uint32_t>(h >> 32) | 1;
+        if (f.tag != tag)
+        {
+            // new flow, or a collision evicting an older one
+            f = Flow();
+            f.tag = tag;
+        }
+        return f;
+    }
+
+    static std::uint64_t flow_hash(const unsigned char *data, const size_t size)
+    {
+        std::uint64_t h = 0xcbf29ce484222325ull; // FNV-1a
+        auto mix = [&h](const unsigned char *p, const size_t n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                h ^= p[i];
+                h *= 0x100000001b3ull;
+            }
+        };
+
+        if (!size)
+            return h;
+        const unsigned int ver = IPCommon::version(data[0]);
+        unsigned int proto = 0;
+        size_t ports = 0; // offset of transport ports, 0 if none
+        if (ver == IPCommon::IPv4 && size >= 20)
+        {
+            const size_t ihl = (data[0] & 0x0F) * 4;
+            const bool fragment = ((data[6] & 0x1F) | data[7]) != 0;
+            proto = data[9];
+            mix(data + 12, 8); // saddr, daddr
+            if (!fragment && ihl >= 20)
+                ports = ihl;
+        }
+        else if (ver == IPCommon::IPv6 && size >= 40)
+        {
+            proto = data[6];
+            mix(data + 8, 32); // saddr, daddr
+            ports = 40;
+        }
+
+        const unsigned char pv[2] = {static_cast<unsigned char>(ver), static_cast<unsigned char>(proto)};
+        mix(pv, sizeof(pv));
+        if (ports && (proto == IPCommon::TCP || proto == IPCommon::UDP) && size >= ports + 4)
+            mix(data + ports, 4);
+        return h;
+    }
+
+  private:
+    Flow slots[N_SLOTS];
+};
+
+} // namespace openvpn
+
+#endif // OPENVPN_COMPRESS_COMPADAPT_H
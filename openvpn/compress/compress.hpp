@@ -25,6 +25,8 @@
 #ifndef OPENVPN_COMPRESS_COMPRESS_H
 #define OPENVPN_COMPRESS_COMPRESS_H
 
+#include <chrono>
+
 #include <openvpn/common/size.hpp>
 #include <openvpn/common/exception.hpp>
 #include <openvpn/common/rc.hpp>
@@ -32,6 +34,7 @@
 #include <openvpn/buffer/buffer.hpp>
 #include <openvpn/frame/frame.hpp>
 #include <openvpn/log/sessionstats.hpp>
+#include <openvpn/compress/compadapt.hpp>
 
 #define OPENVPN_LOG_COMPRESS(x)
 #define OPENVPN_LOG_COMPRESS_VERBOSE(x)
@@ -95,6 +98,34 @@ class Compress : public RC<thread_unsafe_refcount>
         buf.reset_size();
     }
 
+    // Adaptive bypass, see compadapt.hpp.  Called before a
+    // compression attempt, returns nullptr if buf belongs to a flow
+    // that should not be compressed.  Otherwise the caller reports
+    // the outcome with adapt_end().
+    CompressAdapt::Flow *adapt_begin(const Buffer &buf)
+    {
+        CompressAdapt::Flow &flow = adapt.lookup(buf);
+        if (!flow.probe())
+        {
+            stats->inc_stat(SessionStats::COMPRESS_BYPASS, 1);
+            return nullptr;
+        }
+        adapt_start = std::chrono::steady_clock::now();
+        return &flow;
+    }
+
+    // out_size should equal in_size if compression didn't
+    // reduce the packet size
+    void adapt_end(CompressAdapt::Flow *flow, const size_t in_size, const size_t out_size)
+    {
+        const auto elapsed = std::chrono::steady_clock::now() - adapt_start;
+        flow->update(in_size, out_size);
+        stats->inc_stat(SessionStats::COMPRESS_BYTES_IN, in_size);
+        if (out_size < in_size)
+            stats->inc_stat(SessionStats::COMPRESS_BYTES_SAVED, in_size - out_size);
+        stats->inc_stat(SessionStats::COMPRESS_NS, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+    }
+
     void do_swap(Buffer &buf, unsigned char op)
     {
         if (buf.size())
@@ -142,6 +173,10 @@ class Compress : public RC<thread_unsafe_refcount>
 
     Frame::Ptr frame;
     SessionStats::Ptr stats;
+
+  private:
+    CompressAdapt adapt;
+    std::chrono::steady_clock::time_point adapt_start;
 };
 } // namespace openvpn
 
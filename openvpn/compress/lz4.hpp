@@ -68,6 +68,11 @@ class CompressLZ4Base : public Compress
 
     bool do_compress(BufferAllocated &buf)
     {
+        // skip flows that don't compress
+        CompressAdapt::Flow *flow = adapt_begin(buf);
+        if (!flow)
+            return false;
+
         // initialize work buffer
         frame->prepare(Frame::COMPRESS_WORK, work);
 
@@ -93,12 +98,16 @@ class CompressLZ4Base : public Compress
                 return false;
             }
             OPENVPN_LOG_COMPRESS_VERBOSE("LZ4 compress " << buf.size() << " -> " << comp_size);
+            adapt_end(flow, buf.size(), comp_size);
             work.set_size(comp_size);
             buf.swap(work);
             return true;
         }
         else
+        {
+            adapt_end(flow, buf.size(), buf.size());
             return false;
+        }
     }
 
     // Worst case size expansion on compress.
@@ -88,7 +88,8 @@ class CompressLZO : public Compress
         if (!buf.size())
             return;
 
-        if (hint && !asym)
+        CompressAdapt::Flow *flow = hint && !asym ? adapt_begin(buf) : nullptr;
+        if (flow)
         {
             // initialize work buffer
             frame->prepare(Frame::COMPRESS_WORK, work);
@@ -115,6 +116,7 @@ class CompressLZO : public Compress
             if (zlen < buf.size())
             {
                 OPENVPN_LOG_COMPRESS_VERBOSE("LZO compress " << buf.size() << " -> " << zlen);
+                adapt_end(flow, buf.size(), zlen);
                 work.set_size(zlen);
                 if (support_swap)
                     do_swap(work, LZO_COMPRESS_SWAP);
@@ -123,6 +125,7 @@ class CompressLZO : public Compress
                 buf.swap(work);
                 return;
             }
+            adapt_end(flow, buf.size(), buf.size());
         }
 
         // indicate that we didn't compress
@@ -56,7 +56,8 @@ class CompressSnappy : public Compress
         if (!buf.size())
             return;
 
-        if (hint && !asym)
+        CompressAdapt::Flow *flow = hint && !asym ? adapt_begin(buf) : nullptr;
+        if (flow)
         {
             // initialize work buffer
             frame->prepare(Frame::COMPRESS_WORK, work);
@@ -76,11 +77,13 @@ class CompressSnappy : public Compress
             if (comp_size < buf.size())
             {
                 OPENVPN_LOG_COMPRESS_VERBOSE("SNAPPY compress " << buf.size() << " -> " << comp_size);
+                adapt_end(flow, buf.size(), comp_size);
                 work.set_size(comp_size);
                 do_swap(work, SNAPPY_COMPRESS);
                 buf.swap(work);
                 return;
             }
+            adapt_end(flow, buf.size(), buf.size());
         }
 
         // indicate that we didn't compress
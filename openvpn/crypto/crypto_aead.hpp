@@ -105,6 +105,21 @@ class Crypto : public CryptoDCInstance
                 ad_op32 = false;
         }
 
+        // for pipelined encrypt/decrypt, restore a nonce saved by save()
+        explicit Nonce(const CryptoDCJob &job)
+        {
+            static_assert(sizeof(job.nonce) == sizeof(data), "CryptoDCJob nonce size inconsistency");
+            std::memcpy(data, job.nonce, sizeof(data));
+            ad_op32 = (job.flags & CryptoDCJob::OP32_DEFINED) != 0;
+        }
+
+        // for pipelined encrypt/decrypt
+        void save(CryptoDCJob &job) const
+        {
+            std::memcpy(job.nonce, data, sizeof(data));
+            job.flags |= CryptoDCJob::NONCE_DEFINED;
+        }
+
         // for decrypt
         bool verify_packet_id(PacketIDReceive &pid_recv, const PacketID::time_t now)
         {
@@ -153,6 +168,66 @@ class Crypto : public CryptoDCInstance
         BufferAllocated work;
     };
 
+    // Pipeline worker with its own cipher contexts and work
+    // buffers.  Packet ID assignment and verification remain
+    // with the parent Crypto object on the session thread.
+    class Worker : public CryptoDCWorker
+    {
+      public:
+        Worker(SSLLib::Ctx libctx,
+               const CryptoAlgs::Type cipher,
+               const StaticKey &encrypt_key,
+               const StaticKey &decrypt_key,
+               const Nonce &decrypt_nonce,
+               const Frame &frame)
+            : enc_fc(frame[Frame::ENCRYPT_WORK]),
+              dec_fc(frame[Frame::DECRYPT_WORK]),
+              dec_nonce(decrypt_nonce)
+        {
+            enc_impl.init(libctx,
+                          cipher,
+                          encrypt_key.data(),
+                          clamp_to_default<unsigned int>(encrypt_key.size(), 0),
+                          CRYPTO_API::CipherContextAEAD::ENCRYPT);
+            dec_impl.init(libctx,
+                          cipher,
+                          decrypt_key.data(),
+                          clamp_to_default<unsigned int>(decrypt_key.size(), 0),
+                          CRYPTO_API::CipherContextAEAD::DECRYPT);
+        }
+
+        void encrypt(BufferAllocated &buf, CryptoDCJob &job) override
+        {
+            if (buf.size() && (job.flags & CryptoDCJob::NONCE_DEFINED))
+            {
+                const Nonce nonce(job);
+                seal(enc_impl, enc_work, buf, nonce, enc_fc, enc_impl.requires_authtag_at_end());
+                nonce.prepend_ad(buf);
+            }
+        }
+
+        void decrypt(BufferAllocated &buf, CryptoDCJob &job) override
+        {
+            if (buf.size())
+            {
+                const Nonce nonce(dec_nonce, buf, (job.flags & CryptoDCJob::OP32_DEFINED) ? job.op32 : nullptr);
+                if (open(dec_impl, dec_work, buf, nonce, dec_fc, dec_impl.requires_authtag_at_end()))
+                    nonce.save(job);
+                else
+                    job.err = Error::DECRYPT_ERROR;
+            }
+        }
+
+      private:
+        typename CRYPTO_API::CipherContextAEAD enc_impl;
+        typename CRYPTO_API::CipherContextAEAD dec_impl;
+        const Frame::Context enc_fc;
+        const Frame::Context dec_fc;
+        const Nonce dec_nonce;
+        BufferAllocated enc_work;
+        BufferAllocated dec_work;
+    };
+
   public:
     typedef CryptoDCInstance Base;
 
@@ -172,96 +247,68 @@ class Crypto : public CryptoDCInstance
     // returns true if packet ID is close to wrapping
     bool encrypt(BufferAllocated &buf, const PacketID::time_t now, const unsigned char *op32) override
     {
-        // only process non-null packets
-        if (buf.size())
-        {
-            // build nonce/IV/AD
-            Nonce nonce(e.nonce, e.pid_send, now, op32);
-
-            // encrypt to work buf
-            frame->prepare(Frame::ENCRYPT_WORK, e.work);
-            if (e.work.max_size() < buf.size())
-                throw aead_error("encrypt work buffer too small");
+        encrypt_(buf, now, op32, (*frame)[Frame::ENCRYPT_WORK], e.impl.requires_authtag_at_end());
+        return e.pid_send.wrap_warning();
+    }
 
-            // alloc auth tag in buffer
-            unsigned char *auth_tag = e.work.prepend_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+    Error::Type decrypt(BufferAllocated &buf, const PacketID::time_t now, const unsigned char *op32) override
+    {
+        return decrypt_(buf, now, op32, (*frame)[Frame::DECRYPT_WORK], e.impl.requires_authtag_at_end());
+    }
 
-            unsigned char *auth_tag_end;
+    // Batch versions look up the work frame context and the cipher's
+    // auth tag placement once per batch rather than once per packet.
 
-            // prepare output buffer
-            unsigned char *work_data = e.work.write_alloc(buf.size());
-            if (e.impl.requires_authtag_at_end())
-            {
-                auth_tag_end = e.work.write_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
-            }
+    bool encrypt_batch(BufferAllocated *bufs, const size_t n, const PacketID::time_t now, const unsigned char *op32) override
+    {
+        const Frame::Context &fc = (*frame)[Frame::ENCRYPT_WORK];
+        const bool tag_at_end = e.impl.requires_authtag_at_end();
+        for (size_t i = 0; i < n; ++i)
+            encrypt_(bufs[i], now, op32, fc, tag_at_end);
+        return e.pid_send.wrap_warning();
+    }
 
-            // encrypt
-            e.impl.encrypt(buf.data(), work_data, buf.size(), nonce.iv(), auth_tag, nonce.ad(), nonce.ad_len());
+    void decrypt_batch(BufferAllocated *bufs,
+                       const size_t n,
+                       const PacketID::time_t now,
+                       const unsigned char *const *op32,
+                       Error::Type *errs) override
+    {
+        const Frame::Context &fc = (*frame)[Frame::DECRYPT_WORK];
+        const bool tag_at_end = e.impl.requires_authtag_at_end();
+        for (size_t i = 0; i < n; ++i)
+            errs[i] = decrypt_(bufs[i], now, op32 ? op32[i] : nullptr, fc, tag_at_end);
+    }
 
-            if (e.impl.requires_authtag_at_end())
-            {
-                /* move the auth tag to the front */
-                std::memcpy(auth_tag, auth_tag_end, CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
-                /* Ignore the auth tag at the end */
-                e.work.inc_size(-CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
-            }
+    // Pipelined Encrypt/Decrypt
 
-            buf.swap(e.work);
+    CryptoDCWorker::Ptr new_worker() override
+    {
+        return new Worker(libctx, cipher, encrypt_key_, decrypt_key_, d.nonce, *frame);
+    }
 
-            // prepend additional data
-            nonce.prepend_ad(buf);
+    bool encrypt_assign(const BufferAllocated &buf, CryptoDCJob &job, const PacketID::time_t now) override
+    {
+        if (buf.size())
+        {
+            const Nonce nonce(e.nonce, e.pid_send, now, (job.flags & CryptoDCJob::OP32_DEFINED) ? job.op32 : nullptr);
+            nonce.save(job);
         }
         return e.pid_send.wrap_warning();
     }
 
-    Error::Type decrypt(BufferAllocated &buf, const PacketID::time_t now, const unsigned char *op32) override
+    Error::Type decrypt_verify(BufferAllocated &buf, CryptoDCJob &job, const PacketID::time_t now) override
     {
-        // only process non-null packets
-        if (buf.size())
+        if (job.err == Error::SUCCESS && (job.flags & CryptoDCJob::NONCE_DEFINED))
         {
-            // get nonce/IV/AD
-            Nonce nonce(d.nonce, buf, op32);
-
-            // get auth tag
-            unsigned char *auth_tag = buf.read_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
-
-            // initialize work buffer
-            frame->prepare(Frame::DECRYPT_WORK, d.work);
-            if (d.work.max_size() < buf.size())
-                throw aead_error("decrypt work buffer too small");
-
-            if (e.impl.requires_authtag_at_end())
-            {
-                unsigned char *auth_tag_end = buf.write_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
-                std::memcpy(auth_tag_end, auth_tag, CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
-            }
-
-            // decrypt from buf -> work
-            if (!d.impl.decrypt(buf.c_data(), d.work.data(), buf.size(), nonce.iv(), auth_tag, nonce.ad(), nonce.ad_len()))
-            {
-                buf.reset_size();
-                return Error::DECRYPT_ERROR;
-            }
-            if (e.impl.requires_authtag_at_end())
-            {
-                d.work.set_size(buf.size() - CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
-            }
-            else
-            {
-                d.work.set_size(buf.size());
-            }
-
-            // verify packet ID
+            Nonce nonce(job);
             if (!nonce.verify_packet_id(d.pid_recv, now))
             {
                 buf.reset_size();
-                return Error::REPLAY_ERROR;
+                job.err = Error::REPLAY_ERROR;
             }
-
-            // return cleartext result in buf
-            buf.swap(d.work);
         }
-        return Error::SUCCESS;
+        return job.err;
     }
 
     // Initialization
@@ -279,6 +326,10 @@ class Crypto : public CryptoDCInstance
                     decrypt_key.data(),
                     clamp_to_default<unsigned int>(decrypt_key.size(), 0),
                     CRYPTO_API::CipherContextAEAD::DECRYPT);
+
+        // retained for new_worker()
+        encrypt_key_ = std::move(encrypt_key);
+        decrypt_key_ = std::move(decrypt_key);
     }
 
     void init_hmac(StaticKey &&encrypt_key,
@@ -324,12 +375,142 @@ class Crypto : public CryptoDCInstance
     }
 
   private:
+    void encrypt_(BufferAllocated &buf,
+                  const PacketID::time_t now,
+                  const unsigned char *op32,
+                  const Frame::Context &fc,
+                  const bool tag_at_end)
+    {
+        // only process non-null packets
+        if (buf.size())
+        {
+            // build nonce/IV/AD
+            Nonce nonce(e.nonce, e.pid_send, now, op32);
+
+            seal(e.impl, e.work, buf, nonce, fc, tag_at_end);
+
+            // prepend additional data
+            nonce.prepend_ad(buf);
+        }
+    }
+
+    Error::Type decrypt_(BufferAllocated &buf,
+                         const PacketID::time_t now,
+                         const unsigned char *op32,
+                         const Frame::Context &fc,
+                         const bool tag_at_end)
+    {
+        // only process non-null packets
+        if (buf.size())
+        {
+            // get nonce/IV/AD
+            Nonce nonce(d.nonce, buf, op32);
+
+            if (!open(d.impl, d.work, buf, nonce, fc, tag_at_end))
+                return Error::DECRYPT_ERROR;
+
+            // verify packet ID
+            if (!nonce.verify_packet_id(d.pid_recv, now))
+            {
+                buf.reset_size();
+                return Error::REPLAY_ERROR;
+            }
+        }
+        return Error::SUCCESS;
+    }
+
+    // Encrypt buf in place (by way of work), leaving the auth tag
+    // at the head of buf.
+    static void seal(typename CRYPTO_API::CipherContextAEAD &impl,
+                     BufferAllocated &work,
+                     BufferAllocated &buf,
+                     const Nonce &nonce,
+                     const Frame::Context &fc,
+                     const bool tag_at_end)
+    {
+        // encrypt to work buf
+        fc.prepare(work);
+        if (work.max_size() < buf.size())
+            throw aead_error("encrypt work buffer too small");
+
+        // alloc auth tag in buffer
+        unsigned char *auth_tag = work.prepend_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+
+        unsigned char *auth_tag_end;
+
+        // prepare output buffer
+        unsigned char *work_data = work.write_alloc(buf.size());
+        if (tag_at_end)
+        {
+            auth_tag_end = work.write_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+        }
+
+        // encrypt
+        impl.encrypt(buf.data(), work_data, buf.size(), nonce.iv(), auth_tag, nonce.ad(), nonce.ad_len());
+
+        if (tag_at_end)
+        {
+            /* move the auth tag to the front */
+            std::memcpy(auth_tag, auth_tag_end, CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+            /* Ignore the auth tag at the end */
+            work.inc_size(-CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+        }
+
+        buf.swap(work);
+    }
+
+    // Authenticate and decrypt buf (with the packet ID already
+    // consumed into nonce) in place, by way of work.  On failure,
+    // buf is emptied and false is returned.
+    static bool open(typename CRYPTO_API::CipherContextAEAD &impl,
+                     BufferAllocated &work,
+                     BufferAllocated &buf,
+                     const Nonce &nonce,
+                     const Frame::Context &fc,
+                     const bool tag_at_end)
+    {
+        // get auth tag
+        unsigned char *auth_tag = buf.read_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+
+        // initialize work buffer
+        fc.prepare(work);
+        if (work.max_size() < buf.size())
+            throw aead_error("decrypt work buffer too small");
+
+        if (tag_at_end)
+        {
+            unsigned char *auth_tag_end = buf.write_alloc(CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+            std::memcpy(auth_tag_end, auth_tag, CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+        }
+
+        // decrypt from buf -> work
+        if (!impl.decrypt(buf.c_data(), work.data(), buf.size(), nonce.iv(), auth_tag, nonce.ad(), nonce.ad_len()))
+        {
+            buf.reset_size();
+            return false;
+        }
+        if (tag_at_end)
+        {
+            work.set_size(buf.size() - CRYPTO_API::CipherContextAEAD::AUTH_TAG_LEN);
+        }
+        else
+        {
+            work.set_size(buf.size());
+        }
+
+        // return cleartext result in buf
+        buf.swap(work);
+        return true;
+    }
+
     CryptoAlgs::Type cipher;
     Frame::Ptr frame;
     SessionStats::Ptr stats;
     SSLLib::Ctx libctx;
     Encrypt e;
     Decrypt d;
+    StaticKey encrypt_key_;
+    StaticKey decrypt_key_;
 };
 
 template <typename CRYPTO_API>
@@ -39,6 +39,43 @@
 
 namespace openvpn {
 
+// Per-packet state carried between the serialized and the
+// parallel stages of a pipelined data channel operation.
+// The layout of nonce is defined by the CryptoDCInstance
+// implementation.
+struct CryptoDCJob
+{
+    enum
+    {
+        NONCE_DEFINED = (1 << 0), // nonce holds a valid nonce
+        OP32_DEFINED = (1 << 1),  // op32 holds the packet's op32 header (decrypt)
+    };
+
+    unsigned int flags = 0;
+    Error::Type err = Error::SUCCESS;
+    unsigned char op32[4];
+    unsigned char nonce[16];
+};
+
+// Data channel worker, owning its own cipher state for one key
+// so that the cipher operation of a packet can run on a thread
+// other than the session thread.  A worker must only be used by
+// one thread at a time.
+class CryptoDCWorker : public RC<thread_safe_refcount>
+{
+  public:
+    typedef RCPtr<CryptoDCWorker> Ptr;
+
+    // Encrypt buf using the nonce assigned by
+    // CryptoDCInstance::encrypt_assign().
+    virtual void encrypt(BufferAllocated &buf, CryptoDCJob &job) = 0;
+
+    // Decrypt and authenticate buf, leaving the packet ID check to
+    // CryptoDCInstance::decrypt_verify().  On failure, sets job.err
+    // and empties buf.
+    virtual void decrypt(BufferAllocated &buf, CryptoDCJob &job) = 0;
+};
+
 // Base class for encryption/decryption of data channel
 class CryptoDCInstance : public RC<thread_unsafe_refcount>
 {
@@ -52,6 +89,56 @@ class CryptoDCInstance : public RC<thread_unsafe_refcount>
 
     virtual Error::Type decrypt(BufferAllocated &buf, const PacketID::time_t now, const unsigned char *op32) = 0;
 
+    // Batch Encrypt/Decrypt of n buffers per call.  Implementations
+    // may override these to hoist per-packet setup out of the loop;
+    // the default versions simply iterate over encrypt/decrypt.
+
+    // op32 is shared by all packets in the batch.
+    // Returns true if packet ID is close to wrapping.
+    virtual bool encrypt_batch(BufferAllocated *bufs, const size_t n, const PacketID::time_t now, const unsigned char *op32)
+    {
+        bool pid_wrap = false;
+        for (size_t i = 0; i < n; ++i)
+            pid_wrap |= encrypt(bufs[i], now, op32);
+        return pid_wrap;
+    }
+
+    // op32 is an array of n per-packet op32 pointers (or nullptr
+    // if no packet uses op32), results are returned in errs[n].
+    virtual void decrypt_batch(BufferAllocated *bufs,
+                               const size_t n,
+                               const PacketID::time_t now,
+                               const unsigned char *const *op32,
+                               Error::Type *errs)
+    {
+        for (size_t i = 0; i < n; ++i)
+            errs[i] = decrypt(bufs[i], now, op32 ? op32[i] : nullptr);
+    }
+
+    // Pipelined Encrypt/Decrypt
+
+    // Return a new worker for this key, or an undefined pointer if
+    // the implementation does not support pipelining.
+    virtual CryptoDCWorker::Ptr new_worker()
+    {
+        return CryptoDCWorker::Ptr();
+    }
+
+    // Serialized stage of encryption, called on the session thread
+    // before CryptoDCWorker::encrypt: assigns the packet ID and nonce.
+    // Returns true if packet ID is close to wrapping.
+    virtual bool encrypt_assign(const BufferAllocated &buf, CryptoDCJob &job, const PacketID::time_t now)
+    {
+        return false;
+    }
+
+    // Serialized stage of decryption, called on the session thread
+    // after CryptoDCWorker::decrypt: performs the replay check.
+    virtual Error::Type decrypt_verify(BufferAllocated &buf, CryptoDCJob &job, const PacketID::time_t now)
+    {
+        return job.err;
+    }
+
     // Initialization
 
     // return value of defined()
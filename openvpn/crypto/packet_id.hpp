@@ -24,6 +24,7 @@
 #ifndef OPENVPN_CRYPTO_PACKET_ID_H
 #define OPENVPN_CRYPTO_PACKET_ID_H
 
+#include <algorithm>
 #include <string>
 #include <cstring>
 #include <sstream>
@@ -240,6 +241,9 @@ class PacketIDSend
  *
  * Replay window sizing in bytes = 2^REPLAY_WINDOW_ORDER.
  * PKTID_RECV_EXPIRE is backtrack expire in seconds.
+ *
+ * The window is kept in 64-bit words, so that slots skipped over by
+ * a forward jump are cleared a word at a time.
  */
 template <unsigned int REPLAY_WINDOW_ORDER,
           unsigned int PKTID_RECV_EXPIRE>
@@ -249,6 +253,8 @@ class PacketIDReceiveType
     static constexpr unsigned int REPLAY_WINDOW_BYTES = 1 << REPLAY_WINDOW_ORDER;
     static constexpr unsigned int REPLAY_WINDOW_SIZE = REPLAY_WINDOW_BYTES * 8;
 
+    static_assert(REPLAY_WINDOW_ORDER >= 3, "replay window must hold at least one 64-bit word");
+
     // mode
     enum
     {
@@ -349,7 +355,7 @@ class PacketIDReceiveType
             if (!mod)
                 return Error::SUCCESS;
             base = REPLAY_INDEX(-1);
-            history[base / 8] |= static_cast<uint8_t>(1 << (base % 8));
+            set_bit(base);
             if (extent < REPLAY_WINDOW_SIZE)
                 ++extent;
             id_high = pin.id;
@@ -363,22 +369,20 @@ class PacketIDReceiveType
             if (delta < REPLAY_WINDOW_SIZE)
             {
                 base = REPLAY_INDEX(-delta);
-                history[base / 8] |= static_cast<uint8_t>(1 << (base % 8));
+                set_bit(base);
                 extent += delta;
                 if (extent > REPLAY_WINDOW_SIZE)
                     extent = REPLAY_WINDOW_SIZE;
-                for (unsigned i = 1; i < delta; ++i)
-                {
-                    const unsigned int newbase = REPLAY_INDEX(i);
-                    history[newbase / 8] &= static_cast<uint8_t>(~(1 << (newbase % 8)));
-                }
+
+                // clear the slots of the IDs skipped over
+                clear_bits(REPLAY_INDEX(1), delta - 1);
             }
             else
             {
                 base = 0;
                 extent = REPLAY_WINDOW_SIZE;
                 std::memset(history, 0, sizeof(history));
-                history[0] = 1;
+                set_bit(0);
             }
             id_high = pin.id;
         }
@@ -393,13 +397,13 @@ class PacketIDReceiveType
                 if (pin.id > id_floor)
                 {
                     const unsigned int ri = REPLAY_INDEX(delta);
-                    std::uint8_t *p = &history[ri / 8];
-                    const std::uint8_t mask = static_cast<uint8_t>(1 << (ri % 8));
-                    if (*p & mask)
+                    std::uint64_t &word = history[ri / 64];
+                    const std::uint64_t mask = std::uint64_t(1) << (ri % 64);
+                    if (word & mask)
                         return Error::PKTID_REPLAY;
                     if (!mod)
                         return Error::SUCCESS;
-                    *p |= mask;
+                    word |= mask;
                 }
                 else
                     return Error::PKTID_EXPIRE;
@@ -433,6 +437,38 @@ class PacketIDReceiveType
         return (base + i) & (REPLAY_WINDOW_SIZE - 1);
     }
 
+    void set_bit(const unsigned int i)
+    {
+        history[i / 64] |= std::uint64_t(1) << (i % 64);
+    }
+
+    // Clear n bits of the circular history starting at bit index i,
+    // n < REPLAY_WINDOW_SIZE.
+    void clear_bits(unsigned int i, unsigned int n)
+    {
+        while (n)
+        {
+            const unsigned int bit = i % 64;
+            if (bit == 0 && n >= 64)
+            {
+                // whole words up to the end of the history or range
+                const unsigned int words = std::min(n / 64, (REPLAY_WINDOW_SIZE - i) / 64);
+                std::memset(&history[i / 64], 0, words * sizeof(std::uint64_t));
+                i += words * 64;
+                n -= words * 64;
+            }
+            else
+            {
+                const unsigned int len = std::min(n, 64 - bit);
+                const std::uint64_t mask = (len == 64) ? ~std::uint64_t(0) : ((std::uint64_t(1) << len) - 1) << bit;
+                history[i / 64] &= ~mask;
+                i += len;
+                n -= len;
+            }
+            i &= REPLAY_WINDOW_SIZE - 1;
+        }
+    }
+
     bool initialized_;
 
     unsigned int base;          // bit position of deque base in history
@@ -450,12 +486,18 @@ class PacketIDReceiveType
 
     SessionStats::Ptr stats;
 
-    std::uint8_t history[REPLAY_WINDOW_BYTES]; /* "sliding window" bitmask of recent packet IDs received */
+    std::uint64_t history[REPLAY_WINDOW_BYTES / 8]; /* "sliding window" bitmask of recent packet IDs received */
 };
 
-// Our standard packet ID window with order=8 (window size=2048).
-// and recv expire=30 seconds.
-typedef PacketIDReceiveType<8, 30> PacketIDReceive;
+// Order of the standard packet ID window.  The default of 8 gives a
+// window of 2048 packets; links with heavy reordering, such as
+// multi-path or multi-queue receive, may want 10 (8192) or more.
+#ifndef OPENVPN_REPLAY_WINDOW_ORDER
+#define OPENVPN_REPLAY_WINDOW_ORDER 8
+#endif
+
+// Our standard packet ID window with recv expire=30 seconds.
+typedef PacketIDReceiveType<OPENVPN_REPLAY_WINDOW_ORDER, 30> PacketIDReceive;
 
 } // namespace openvpn
 
@@ -120,6 +120,14 @@ class Frame : public RC<thread_unsafe_refcount>
         {
             return buffer_flags_;
         }
+        size_t align_adjust() const
+        {
+            return align_adjust_;
+        }
+        size_t align_block() const
+        {
+            return align_block_;
+        }
 
         // Calculate a starting offset into a buffer object, dealing with
         // headroom and alignment issues.
@@ -39,7 +39,7 @@ inline Frame::Ptr frame_init(const bool align_adjust_3_1,
     const size_t headroom = 512;
     const size_t tailroom = 512;
     const size_t align_block = 16;
-    const unsigned int buffer_flags = 0;
+    const unsigned int buffer_flags = BufferAllocated::POOL;
 
     Frame::Ptr frame(new Frame(Frame::Context(headroom, payload, tailroom, 0, align_block, buffer_flags)));
     if (align_adjust_3_1)
@@ -73,7 +73,7 @@ inline Frame::Context frame_init_context_simple(const size_t payload)
     const size_t headroom = 512;
     const size_t tailroom = 512;
     const size_t align_block = 16;
-    const unsigned int buffer_flags = 0;
+    const unsigned int buffer_flags = BufferAllocated::POOL;
     return Frame::Context(headroom, payload, tailroom, 0, align_block, buffer_flags);
 }
 
@@ -19,16 +19,33 @@
 //    along with this program in the COPYING file.
 //    If not, see <http://www.gnu.org/licenses/>.
 
-// IP checksum based on Linux kernel implementation
+// IP checksum.
+//
+// The bulk of compute() is summed with SIMD instructions where the
+// CPU has them: AVX2 (detected at runtime) or SSE2 on x86-64, NEON on
+// ARM64.  Define OPENVPN_CSUM_NO_SIMD to use the portable version
+// everywhere.
 
 #pragma once
 
 #include <cstdint>
+#include <cstring>
+#include <algorithm>
 
 #include <openvpn/common/endian.hpp>
 #include <openvpn/common/socktypes.hpp>
 #include <openvpn/common/size.hpp>
 
+#if !defined(OPENVPN_CSUM_NO_SIMD)
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define OPENVPN_CSUM_X86
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define OPENVPN_CSUM_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 namespace openvpn {
 namespace IPChecksum {
 
@@ -54,66 +71,164 @@ inline std::uint32_t cunfold(const std::uint16_t sum)
     return ~unfold(sum);
 }
 
-inline std::uint32_t compute(const std::uint8_t *buf, size_t len)
+namespace internal {
+
+// Since 2^16 == 1 (mod 0xffff), the native 16-bit words of a buffer
+// may be summed in any grouping and lane width, and folded down with
+// end-around carry afterwards, without changing the ones' complement
+// result.  The routines below return such a wide sum for an even
+// number of bytes.
+
+// Vector lanes are 32 bits wide and take at most 2 * 0xffff per
+// iteration, so they are drained into the 64-bit sum after this
+// many iterations.
+enum
 {
-    std::uint32_t result = 0;
+    LANE_ITER = 0x8000,
+};
 
-    if (!len)
-        return 0;
+inline std::uint32_t fold64(std::uint64_t sum)
+{
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    sum = (sum & 0xffffffff) + (sum >> 32);
+    return static_cast<std::uint32_t>(sum);
+}
 
-    const bool odd = size_t(buf) & 1;
-    if (odd)
+inline std::uint64_t add_words_generic(const std::uint8_t *buf, size_t len)
+{
+    std::uint64_t sum = 0;
+    for (; len >= 8; buf += 8, len -= 8)
     {
-#ifdef OPENVPN_LITTLE_ENDIAN
-        result += (*buf << 8);
-#else
-        result = *buf;
-#endif
-        len--;
-        buf++;
+        std::uint64_t w;
+        std::memcpy(&w, buf, sizeof(w));
+        sum += (w & 0xffffffff) + (w >> 32);
+    }
+    if (len >= 4)
+    {
+        std::uint32_t w;
+        std::memcpy(&w, buf, sizeof(w));
+        sum += w;
+        buf += 4;
+        len -= 4;
     }
-
     if (len >= 2)
     {
-        if (size_t(buf) & 2)
+        std::uint16_t w;
+        std::memcpy(&w, buf, sizeof(w));
+        sum += w;
+    }
+    return sum;
+}
+
+#if defined(OPENVPN_CSUM_X86)
+
+inline std::uint64_t add_words_sse2(const std::uint8_t *buf, size_t len)
+{
+    const __m128i mask = _mm_set1_epi32(0xffff);
+    std::uint64_t sum = 0;
+    while (len >= 16)
+    {
+        size_t n = std::min(len / 16, size_t(LANE_ITER));
+        len -= n * 16;
+        __m128i acc = _mm_setzero_si128();
+        do
         {
-            result += *(std::uint16_t *)buf;
-            len -= 2;
-            buf += 2;
-        }
-        if (len >= 4)
+            const __m128i v = _mm_loadu_si128((const __m128i *)buf);
+            acc = _mm_add_epi32(acc, _mm_and_si128(v, mask));
+            acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+            buf += 16;
+        } while (--n);
+        std::uint32_t lanes[4];
+        _mm_storeu_si128((__m128i *)lanes, acc);
+        sum += std::uint64_t(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+    return sum + add_words_generic(buf, len);
+}
+
+__attribute__((target("avx2"))) inline std::uint64_t add_words_avx2(const std::uint8_t *buf, size_t len)
+{
+    const __m256i mask = _mm256_set1_epi32(0xffff);
+    std::uint64_t sum = 0;
+    while (len >= 32)
+    {
+        size_t n = std::min(len / 32, size_t(LANE_ITER));
+        len -= n * 32;
+        __m256i acc = _mm256_setzero_si256();
+        do
         {
-            const uint8_t *end = buf + (len & ~3);
-            std::uint32_t carry = 0;
-            do
-            {
-                std::uint32_t w = *(std::uint32_t *)buf;
-                buf += 4;
-                result += carry;
-                result += w;
-                carry = (w > result);
-            } while (buf < end);
-            result += carry;
-            result = (result & 0xffff) + (result >> 16);
-        }
-        if (len & 2)
+            const __m256i v = _mm256_loadu_si256((const __m256i *)buf);
+            acc = _mm256_add_epi32(acc, _mm256_and_si256(v, mask));
+            acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+            buf += 32;
+        } while (--n);
+        std::uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i *)lanes, acc);
+        for (const std::uint32_t l : lanes)
+            sum += l;
+    }
+    return sum + add_words_generic(buf, len);
+}
+
+inline bool have_avx2()
+{
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2;
+}
+
+#elif defined(OPENVPN_CSUM_NEON)
+
+inline std::uint64_t add_words_neon(const std::uint8_t *buf, size_t len)
+{
+    std::uint64_t sum = 0;
+    while (len >= 16)
+    {
+        size_t n = std::min(len / 16, size_t(LANE_ITER));
+        len -= n * 16;
+        uint32x4_t acc = vdupq_n_u32(0);
+        do
         {
-            result += *(std::uint16_t *)buf;
-            buf += 2;
-        }
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(buf)));
+            buf += 16;
+        } while (--n);
+        sum += vaddlvq_u32(acc);
     }
+    return sum + add_words_generic(buf, len);
+}
+
+#endif
+
+// below this size the vector setup costs more than it saves
+enum
+{
+    SIMD_MIN = 64,
+};
+
+inline std::uint64_t add_words(const std::uint8_t *buf, const size_t len)
+{
+#if defined(OPENVPN_CSUM_X86)
+    if (len >= SIMD_MIN)
+        return have_avx2() ? add_words_avx2(buf, len) : add_words_sse2(buf, len);
+#elif defined(OPENVPN_CSUM_NEON)
+    if (len >= SIMD_MIN)
+        return add_words_neon(buf, len);
+#endif
+    return add_words_generic(buf, len);
+}
+
+} // namespace internal
+
+inline std::uint32_t compute(const std::uint8_t *buf, size_t len)
+{
+    std::uint64_t result = internal::add_words(buf, len & ~size_t(1));
     if (len & 1)
     {
 #ifdef OPENVPN_LITTLE_ENDIAN
-        result += *buf;
+        result += buf[len - 1];
 #else
-        result += (*buf << 8);
+        result += (buf[len - 1] << 8);
 #endif
     }
-    result = fold(result);
-    if (odd)
-        result = ((result >> 8) & 0xff) | ((result & 0xff) << 8);
-    return result;
+    return fold(internal::fold64(result));
 }
 
 inline std::uint32_t compute(const void *buf, const size_t len)
@@ -170,5 +285,28 @@ inline std::uint16_t checksum(const void *data, const size_t size)
 {
     return cfold(compute(data, size));
 }
+
+// Incremental checksum update (RFC 1624, eqn. 3) for a change of a
+// 16-bit word of the covered data from m to m':
+//
+//   HC' = ~(~HC + ~m + m')
+//
+// All values are in the byte order in which they appear in the packet.
+inline std::uint16_t update16(const std::uint16_t check,
+                              const std::uint16_t old_,
+                              const std::uint16_t new_)
+{
+    return cfold(std::uint32_t(std::uint16_t(~check)) + std::uint16_t(~old_) + new_);
+}
+
+// As update16() for a 32-bit field, such as an IPv4 address.
+inline std::uint16_t update32(const std::uint16_t check,
+                              const std::uint32_t old_,
+                              const std::uint32_t new_)
+{
+    return cfold(std::uint32_t(std::uint16_t(~check))
+                 + (~old_ >> 16) + (~old_ & 0xffff)
+                 + (new_ >> 16) + (new_ & 0xffff));
+}
 } // namespace IPChecksum
 } // namespace openvpn
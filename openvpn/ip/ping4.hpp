@@ -107,7 +107,7 @@ inline void generate_echo_reply(Buffer &buf,
     std::swap(icmp->head.saddr, icmp->head.daddr);
     const std::uint16_t old_type_code = icmp->type_code;
     icmp->type = ICMPv4::ECHO_REPLY;
-    icmp->checksum = IPChecksum::cfold(IPChecksum::diff2(old_type_code, icmp->type_code, IPChecksum::cunfold(icmp->checksum)));
+    icmp->checksum = IPChecksum::update16(icmp->checksum, old_type_code, icmp->type_code);
 
     if (log_info)
         *log_info = "ECHO4_REPLY size=" + std::to_string(buf.size()) + ' ' + IPv4::Addr::from_uint32_net(icmp->head.saddr).to_string() + " -> " + IPv4::Addr::from_uint32_net(icmp->head.daddr).to_string();
@@ -0,0 +1,505 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// io_uring based packet reader for Linux, used by TunIO and UDPLink
+// when built with OPENVPN_IO_URING.
+//
+// Rather than waiting for readiness and then issuing a read (two
+// system calls per packet), a number of reads are kept in flight on
+// the file descriptor at all times, using buffers and a file that
+// are registered with the ring.  Completions are signalled through
+// an eventfd watched by the asio reactor, so that the read handler
+// still runs on the io_context thread.
+//
+// The ring is driven through the raw system call interface, so that
+// no dependency on liburing is needed.
+
+#ifndef OPENVPN_LINUX_IO_URING_H
+#define OPENVPN_LINUX_IO_URING_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+#include <openvpn/io/io.hpp>
+#include <openvpn/common/exception.hpp>
+#include <openvpn/common/rc.hpp>
+#include <openvpn/common/strerror.hpp>
+
+namespace openvpn {
+
+OPENVPN_EXCEPTION(io_uring_error);
+
+// A minimal io_uring instance with one submission and one
+// completion queue.  Not thread safe.
+class IoUring
+{
+  public:
+    explicit IoUring(const unsigned int entries)
+    {
+        struct io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &p));
+        if (ring_fd < 0)
+            throw io_uring_error("io_uring_setup: " + strerror_str(errno));
+        try
+        {
+            map(p);
+        }
+        catch (...)
+        {
+            unmap();
+            ::close(ring_fd);
+            throw;
+        }
+    }
+
+    ~IoUring()
+    {
+        unmap();
+        ::close(ring_fd);
+    }
+
+    IoUring(const IoUring &) = delete;
+    IoUring &operator=(const IoUring &) = delete;
+
+    // Return a zeroed submission queue entry, or nullptr if the
+    // submission queue is full.  Entries are passed to the kernel
+    // by the next submit().
+    struct io_uring_sqe *get_sqe()
+    {
+        const unsigned int head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+        if (sqe_tail - head >= sq_entries)
+            return nullptr;
+        const unsigned int index = sqe_tail & sq_mask;
+        struct io_uring_sqe *sqe = &sqes[index];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array[index] = index;
+        ++sqe_tail;
+        return sqe;
+    }
+
+    // Submit pending entries and optionally wait for wait_nr
+    // completions.  Returns the number of entries submitted, or a
+    // negative errno value.
+    int submit(const unsigned int wait_nr = 0)
+    {
+        const unsigned int to_submit = sqe_tail - *sq_tail;
+        __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+        if (!to_submit && !wait_nr)
+            return 0;
+        int ret;
+        do
+        {
+            ret = static_cast<int>(::syscall(__NR_io_uring_enter,
+                                             ring_fd,
+                                             to_submit,
+                                             wait_nr,
+                                             wait_nr ? IORING_ENTER_GETEVENTS : 0,
+                                             nullptr,
+                                             0));
+        } while (ret < 0 && errno == EINTR);
+        return ret < 0 ? -errno : ret;
+    }
+
+    // Call func(user_data, res) for each available completion.
+    // Returns the number of completions processed.
+    template <typename FUNC>
+    unsigned int reap(FUNC func)
+    {
+        unsigned int head = *cq_head;
+        const unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        const unsigned int n = tail - head;
+        for (; head != tail; ++head)
+        {
+            const struct io_uring_cqe &cqe = cqes[head & cq_mask];
+            const std::uint64_t user_data = cqe.user_data;
+            const int res = cqe.res;
+            __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+            func(user_data, res);
+        }
+        return n;
+    }
+
+    // IORING_REGISTER_x wrapper, returns 0 or a negative errno value
+    int register_op(const unsigned int opcode, const void *arg, const unsigned int nr_args)
+    {
+        const int ret = static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+        return ret < 0 ? -errno : ret;
+    }
+
+  private:
+    void map(const struct io_uring_params &p)
+    {
+        sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+        cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        const bool single_mmap = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap)
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+        sq_ring = mmap_ring(sq_ring_size, IORING_OFF_SQ_RING);
+        cq_ring = single_mmap ? sq_ring : mmap_ring(cq_ring_size, IORING_OFF_CQ_RING);
+        sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = static_cast<struct io_uring_sqe *>(mmap_ring(sqes_size, IORING_OFF_SQES));
+
+        unsigned char *sq = static_cast<unsigned char *>(sq_ring);
+        sq_head = reinterpret_cast<unsigned int *>(sq + p.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned int *>(sq + p.sq_off.tail);
+        sq_array = reinterpret_cast<unsigned int *>(sq + p.sq_off.array);
+        sq_mask = *reinterpret_cast<unsigned int *>(sq + p.sq_off.ring_mask);
+        sq_entries = *reinterpret_cast<unsigned int *>(sq + p.sq_off.ring_entries);
+        sqe_tail = *sq_tail;
+
+        unsigned char *cq = static_cast<unsigned char *>(cq_ring);
+        cq_head = reinterpret_cast<unsigned int *>(cq + p.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned int *>(cq + p.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned int *>(cq + p.cq_off.ring_mask);
+        cqes = reinterpret_cast<struct io_uring_cqe *>(cq + p.cq_off.cqes);
+    }
+
+    void *mmap_ring(const size_t size, const off_t offset)
+    {
+        void *ret = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, offset);
+        if (ret == MAP_FAILED)
+            throw io_uring_error("io_uring mmap: " + strerror_str(errno));
+        return ret;
+    }
+
+    void unmap()
+    {
+        if (sqes)
+            ::munmap(sqes, sqes_size);
+        if (cq_ring && cq_ring != sq_ring)
+            ::munmap(cq_ring, cq_ring_size);
+        if (sq_ring)
+            ::munmap(sq_ring, sq_ring_size);
+        sqes = nullptr;
+        cq_ring = sq_ring = nullptr;
+    }
+
+    int ring_fd = -1;
+
+    void *sq_ring = nullptr;
+    void *cq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    size_t cq_ring_size = 0;
+    size_t sqes_size = 0;
+
+    unsigned int *sq_head = nullptr;
+    unsigned int *sq_tail = nullptr;
+    unsigned int *sq_array = nullptr;
+    unsigned int sq_mask = 0;
+    unsigned int sq_entries = 0;
+    unsigned int sqe_tail = 0; // local tail, published by submit()
+    struct io_uring_sqe *sqes = nullptr;
+
+    unsigned int *cq_head = nullptr;
+    unsigned int *cq_tail = nullptr;
+    unsigned int cq_mask = 0;
+    struct io_uring_cqe *cqes = nullptr;
+};
+
+// Keeps n_parallel reads in flight on a tun device or socket.
+// The file descriptor is not owned by the reader, but must stay
+// open until stop() has returned.
+class IoUringReader : public RC<thread_unsafe_refcount>
+{
+  public:
+    typedef RCPtr<IoUringReader> Ptr;
+
+    struct Completion
+    {
+        const unsigned char *data = nullptr;
+        size_t size = 0;
+        const struct sockaddr *from = nullptr; // only if want_from
+        socklen_t fromlen = 0;
+        int error = 0; // errno value
+    };
+
+    // The data referenced by a Completion is only valid for the
+    // duration of the handler call.
+    typedef std::function<void(const Completion &)> Handler;
+
+    // Return a reader, or an undefined pointer if io_uring is not
+    // available, in which case the caller should fall back to asio.
+    // If want_from is true, reads are done with recvmsg() to return
+    // the sender address of each datagram.
+    static Ptr create(openvpn_io::io_context &io_context,
+                      const int fd,
+                      const size_t buf_size,
+                      const unsigned int n_parallel,
+                      const bool want_from)
+    {
+        try
+        {
+            return new IoUringReader(io_context, fd, buf_size, n_parallel, want_from);
+        }
+        catch (const io_uring_error &)
+        {
+            return Ptr();
+        }
+    }
+
+    ~IoUringReader()
+    {
+        stop();
+    }
+
+    void start(Handler handler_arg)
+    {
+        handler = std::move(handler_arg);
+        for (size_t i = 0; i < slots.size(); ++i)
+            queue_read(i);
+        ring.submit();
+        queue_wait();
+    }
+
+    // Cancel outstanding reads and wait for the kernel to release
+    // the buffers.  No handler calls are made after stop().
+    void stop()
+    {
+        if (!halt)
+        {
+            halt = true;
+            event_desc.cancel();
+            if (!in_handler)
+                cancel_reads(); // else deferred to handle_events()
+        }
+    }
+
+    bool fixed_buffers() const
+    {
+        return fixed_bufs;
+    }
+
+    bool fixed_file() const
+    {
+        return fixed_fd;
+    }
+
+  private:
+    enum : std::uint64_t
+    {
+        CANCEL_USER_DATA = ~std::uint64_t(0),
+    };
+
+    struct Slot
+    {
+        struct iovec iov;
+        struct msghdr msg;
+        struct sockaddr_storage from;
+        bool in_flight = false;
+    };
+
+    IoUringReader(openvpn_io::io_context &io_context,
+                  const int fd_arg,
+                  const size_t buf_size_arg,
+                  const unsigned int n_parallel,
+                  const bool want_from_arg)
+        : ring(std::max(n_parallel, 1u) * 2),
+          event_desc(io_context),
+          fd(fd_arg),
+          buf_size(buf_size_arg),
+          want_from(want_from_arg),
+          arena(new unsigned char[std::max(n_parallel, 1u) * buf_size_arg]),
+          slots(std::max(n_parallel, 1u))
+    {
+        std::vector<struct iovec> iovs(slots.size());
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            Slot &s = slots[i];
+            s.iov.iov_base = arena.get() + i * buf_size;
+            s.iov.iov_len = buf_size;
+            iovs[i] = s.iov;
+        }
+
+        // registration may fail because of RLIMIT_MEMLOCK or an old
+        // kernel, in which case plain reads are used
+        fixed_bufs = !want_from && ring.register_op(IORING_REGISTER_BUFFERS, iovs.data(), static_cast<unsigned int>(iovs.size())) == 0;
+        fixed_fd = ring.register_op(IORING_REGISTER_FILES, &fd, 1) == 0;
+
+        const int efd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (efd < 0)
+            throw io_uring_error("eventfd: " + strerror_str(errno));
+        event_desc.assign(efd);
+        const int status = ring.register_op(IORING_REGISTER_EVENTFD, &efd, 1);
+        if (status < 0)
+            throw io_uring_error("IORING_REGISTER_EVENTFD: " + strerror_str(-status));
+    }
+
+    void queue_read(const size_t index)
+    {
+        struct io_uring_sqe *sqe = ring.get_sqe();
+        if (!sqe)
+            return; // cannot happen, the ring has room for every slot
+        Slot &s = slots[index];
+        if (want_from)
+        {
+            std::memset(&s.msg, 0, sizeof(s.msg));
+            s.msg.msg_name = &s.from;
+            s.msg.msg_namelen = sizeof(s.from);
+            s.msg.msg_iov = &s.iov;
+            s.msg.msg_iovlen = 1;
+            sqe->opcode = IORING_OP_RECVMSG;
+            sqe->addr = reinterpret_cast<std::uint64_t>(&s.msg);
+            sqe->len = 1;
+        }
+        else
+        {
+            sqe->opcode = fixed_bufs ? IORING_OP_READ_FIXED : IORING_OP_READ;
+            sqe->addr = reinterpret_cast<std::uint64_t>(s.iov.iov_base);
+            sqe->len = static_cast<std::uint32_t>(s.iov.iov_len);
+            if (fixed_bufs)
+                sqe->buf_index = static_cast<std::uint16_t>(index);
+        }
+        if (fixed_fd)
+        {
+            sqe->fd = 0;
+            sqe->flags |= IOSQE_FIXED_FILE;
+        }
+        else
+            sqe->fd = fd;
+        sqe->user_data = index;
+        s.in_flight = true;
+    }
+
+    void queue_wait()
+    {
+        event_desc.async_wait(openvpn_io::posix::stream_descriptor::wait_read,
+                              [self = Ptr(this)](const openvpn_io::error_code &error)
+                              {
+            if (!error && !self->halt)
+                self->handle_events(); });
+    }
+
+    void handle_events()
+    {
+        std::uint64_t count;
+        if (::read(event_desc.native_handle(), &count, sizeof(count)) < 0)
+        {
+            // EAGAIN: already drained by an earlier wakeup
+        }
+
+        in_handler = true;
+        ring.reap([this](const std::uint64_t user_data, const int res)
+                  { handle_completion(user_data, res); });
+        in_handler = false;
+        if (halt)
+            cancel_reads();
+        else
+        {
+            ring.submit();
+            queue_wait();
+        }
+    }
+
+    void handle_completion(const std::uint64_t user_data, const int res)
+    {
+        if (user_data >= slots.size())
+            return;
+        Slot &s = slots[user_data];
+        s.in_flight = false;
+        if (halt)
+            return;
+
+        Completion c;
+        if (res >= 0)
+        {
+            c.data = static_cast<const unsigned char *>(s.iov.iov_base);
+            c.size = static_cast<size_t>(res);
+            if (want_from)
+            {
+                c.from = reinterpret_cast<const struct sockaddr *>(&s.from);
+                c.fromlen = s.msg.msg_namelen;
+            }
+        }
+        else
+            c.error = -res;
+        handler(c);
+
+        if (!halt)
+            queue_read(user_data);
+    }
+
+    // The kernel may write into the buffers until each read has
+    // completed, so wait for all of them before returning.
+    void cancel_reads()
+    {
+        size_t n_in_flight = 0;
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            if (slots[i].in_flight)
+            {
+                struct io_uring_sqe *sqe = ring.get_sqe();
+                if (!sqe && ring.submit() >= 0)
+                    sqe = ring.get_sqe();
+                if (!sqe)
+                    break; // kernel isn't taking entries, wait for those queued
+                ++n_in_flight;
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = i;
+                sqe->user_data = CANCEL_USER_DATA;
+            }
+        }
+        while (n_in_flight)
+        {
+            if (ring.submit(1) < 0)
+                break;
+            ring.reap([this, &n_in_flight](const std::uint64_t user_data, const int res)
+                      {
+                if (user_data < slots.size() && slots[user_data].in_flight)
+                {
+                    slots[user_data].in_flight = false;
+                    --n_in_flight;
+                } });
+        }
+    }
+
+    IoUring ring;
+    openvpn_io::posix::stream_descriptor event_desc;
+    int fd;
+    size_t buf_size;
+    bool want_from;
+    bool fixed_bufs = false;
+    bool fixed_fd = false;
+    bool halt = false;
+    bool in_handler = false;
+    std::unique_ptr<unsigned char[]> arena;
+    std::vector<Slot> slots;
+    Handler handler;
+};
+
+} // namespace openvpn
+
+#endif
@@ -0,0 +1,112 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Optional data channel timing and queue depth histograms.
+// A DataPathStats object is attached to SessionStats only when
+// enabled, so the hot path pays a single pointer test otherwise.
+
+#ifndef OPENVPN_LOG_DATAPATHSTATS_H
+#define OPENVPN_LOG_DATAPATHSTATS_H
+
+#include <cstdint>
+#include <chrono>
+
+#include <openvpn/common/size.hpp>
+#include <openvpn/common/rc.hpp>
+#include <openvpn/common/histogram.hpp>
+
+namespace openvpn {
+
+class DataPathStats : public RC<thread_safe_refcount>
+{
+  public:
+    typedef RCPtr<DataPathStats> Ptr;
+
+    enum Type
+    {
+        TUN_TO_TRANSPORT = 0, // ns from tun read to transport send
+        TRANSPORT_TO_TUN,     // ns from transport recv to tun write
+        ENCRYPT,              // ns to encrypt one packet
+        DECRYPT,              // ns to decrypt one packet
+        TUN_WRITE,            // ns spent in tun device write
+        TCP_SEND_QUEUE,       // TCP send queue depth in packets, sampled at enqueue
+        N_TYPES,
+    };
+
+    // monotonic timestamp in nanoseconds, never 0
+    static std::uint64_t now_ns()
+    {
+        const auto t = std::chrono::steady_clock::now().time_since_epoch();
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count()) | 1;
+    }
+
+    void record(const Type type, const std::uint64_t value)
+    {
+        hist[type].record(value);
+    }
+
+    // record the time elapsed since start, as returned by now_ns()
+    void record_since(const Type type, const std::uint64_t start)
+    {
+        const std::uint64_t now = now_ns();
+        hist[type].record(now > start ? now - start : 0);
+    }
+
+    const LogLinearHistogram &get(const size_t type) const
+    {
+        return hist[type];
+    }
+
+    void reset()
+    {
+        for (auto &h : hist)
+            h.reset();
+    }
+
+    static bool is_latency(const size_t type)
+    {
+        return type < TCP_SEND_QUEUE;
+    }
+
+    static const char *type_name(const size_t type)
+    {
+        static const char *names[] = {
+            "TUN_TO_TRANSPORT",
+            "TRANSPORT_TO_TUN",
+            "ENCRYPT",
+            "DECRYPT",
+            "TUN_WRITE",
+            "TCP_SEND_QUEUE",
+        };
+
+        if (type < N_TYPES)
+            return names[type];
+        else
+            return "UNKNOWN_DATAPATH_STAT";
+    }
+
+  private:
+    LogLinearHistogram hist[N_TYPES];
+};
+
+} // namespace openvpn
+
+#endif // OPENVPN_LOG_DATAPATHSTATS_H
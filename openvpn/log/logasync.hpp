@@ -0,0 +1,311 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Asynchronous log backend.  log() copies each preformatted record
+// into a bounded lock-free MPSC ring and returns immediately, a
+// dedicated thread drains the ring into the wrapped LogBase.  Records
+// arriving faster than the configured rate, or while the ring is
+// full, are dropped and counted, and the drain thread periodically
+// reports how many were lost.  This keeps bursts of data path errors
+// (replay, decrypt failures) from stalling packet processing on a
+// slow log sink.
+
+#ifndef OPENVPN_LOG_LOGASYNC_H
+#define OPENVPN_LOG_LOGASYNC_H
+
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+
+#include <openvpn/common/size.hpp>
+#include <openvpn/common/count.hpp>
+#include <openvpn/common/to_string.hpp>
+#include <openvpn/log/logbase.hpp>
+
+namespace openvpn {
+
+// Bounded multi-producer, single-consumer ring of strings, after
+// Dmitry Vyukov's bounded MPMC queue.  Each slot carries a sequence
+// number that tells producers and the consumer whose turn it is.
+class LogRing
+{
+  public:
+    // capacity is rounded up to a power of 2
+    explicit LogRing(const size_t capacity)
+        : mask(round_up(capacity) - 1),
+          slots(new Slot[mask + 1])
+    {
+        for (size_t i = 0; i <= mask; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    LogRing(const LogRing &) = delete;
+    LogRing &operator=(const LogRing &) = delete;
+
+    // May be called from any thread, returns false if full
+    bool push(const std::string &rec)
+    {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot *slot;
+        while (true)
+        {
+            slot = &slots[pos & mask];
+            const size_t seq = slot->seq.load(std::memory_order_acquire);
+            const std::ptrdiff_t dif = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (dif == 0)
+            {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (dif < 0)
+                return false;
+            else
+                pos = tail.load(std::memory_order_relaxed);
+        }
+        slot->rec = rec;
+        slot->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread only, returns false if empty
+    bool pop(std::string &rec)
+    {
+        Slot &slot = slots[head & mask];
+        if (slot.seq.load(std::memory_order_acquire) != head + 1)
+            return false;
+        rec.swap(slot.rec);
+        slot.seq.store(head + mask + 1, std::memory_order_release);
+        ++head;
+        return true;
+    }
+
+    size_t capacity() const
+    {
+        return mask + 1;
+    }
+
+  private:
+    struct Slot
+    {
+        std::atomic<size_t> seq{0};
+        std::string rec;
+    };
+
+    static size_t round_up(const size_t capacity)
+    {
+        size_t n = 2;
+        while (n < capacity)
+            n <<= 1;
+        return n;
+    }
+
+    const size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;
+};
+
+class LogAsync : public LogBase
+{
+  public:
+    typedef RCPtr<LogAsync> Ptr;
+
+    struct Config
+    {
+        size_t capacity = 4096;        // records buffered before dropping
+        unsigned int rate = 1000;      // records accepted per second, 0 for no limit
+        unsigned int drop_report = 10; // seconds between dropped-record reports
+    };
+
+    LogAsync(const LogBase::Ptr &sink_arg, const Config &config_arg)
+        : sink(sink_arg),
+          config(config_arg),
+          ring(config_arg.capacity),
+          start_time(std::chrono::steady_clock::now())
+    {
+        thread = std::thread([this]()
+                             { drain_thread(); });
+    }
+
+    explicit LogAsync(const LogBase::Ptr &sink_arg)
+        : LogAsync(sink_arg, Config())
+    {
+    }
+
+    ~LogAsync()
+    {
+        stop();
+    }
+
+    void log(const std::string &str) override
+    {
+        if (halt.load(std::memory_order_relaxed) || !rate_allow() || !ring.push(str))
+        {
+            // only the first drop since the last report needs to wake
+            // the drain thread, so that it schedules the next report
+            if (dropped_.fetch_add(1) == reported.load())
+                wake();
+            return;
+        }
+        pushed.fetch_add(1);
+        wake();
+    }
+
+    // Wait until all records logged before this call have been
+    // passed to the sink.
+    void flush()
+    {
+        const count_t target = pushed.load(std::memory_order_acquire);
+        while (written.load(std::memory_order_acquire) < target && !halt.load(std::memory_order_relaxed))
+        {
+            cv.notify_one();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    // Drain remaining records and stop the drain thread.  Records
+    // logged from now on are counted as dropped.
+    void stop()
+    {
+        if (thread.joinable())
+        {
+            halt.store(true);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                cv.notify_one();
+            }
+            thread.join();
+
+            // records pushed after the drain thread's last pass
+            std::string rec;
+            while (ring.pop(rec))
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    count_t dropped() const
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    // Fixed one-second windows, approximate under contention
+    bool rate_allow()
+    {
+        if (!config.rate)
+            return true;
+        const auto elapsed = std::chrono::steady_clock::now() - start_time;
+        const std::uint64_t sec = std::chrono::duration_cast<std::chrono::seconds>(elapsed).count();
+        if (window.load(std::memory_order_relaxed) != sec)
+        {
+            window.store(sec, std::memory_order_relaxed);
+            window_count.store(0, std::memory_order_relaxed);
+        }
+        return window_count.fetch_add(1, std::memory_order_relaxed) < config.rate;
+    }
+
+    // Called by producers after updating pushed or dropped_.  Those
+    // updates and the sleeping flag are sequentially consistent, so
+    // either the drain thread sees the update before it sleeps, or we
+    // see it sleeping and notify it.  Notifying under the mutex keeps
+    // the notify from landing between its last check and its wait.
+    void wake()
+    {
+        if (sleeping.load())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            cv.notify_one();
+        }
+    }
+
+    bool pending() const
+    {
+        return halt.load() || pushed.load() != written.load(std::memory_order_relaxed);
+    }
+
+    void drain_thread()
+    {
+        std::string rec;
+        auto last_report = std::chrono::steady_clock::now();
+        while (true)
+        {
+            const bool halting = halt.load(std::memory_order_relaxed);
+            while (ring.pop(rec))
+            {
+                sink->log(rec);
+                written.fetch_add(1, std::memory_order_release);
+            }
+
+            const count_t d = dropped();
+            const count_t r = reported.load(std::memory_order_relaxed);
+            const auto now = std::chrono::steady_clock::now();
+            if (d != r && (halting || now - last_report >= std::chrono::seconds(config.drop_report)))
+            {
+                sink->log("LogAsync: " + openvpn::to_string(d - r) + " log messages dropped\n");
+                reported.store(d);
+                last_report = now;
+            }
+
+            if (halting)
+                break;
+
+            // sleep until there is something to do, only waking on a
+            // timer while a drop report is due
+            std::unique_lock<std::mutex> lock(mutex);
+            sleeping.store(true);
+            if (dropped_.load() != reported.load())
+                cv.wait_until(lock, last_report + std::chrono::seconds(config.drop_report), [this]()
+                              { return pending(); });
+            else
+                cv.wait(lock, [this]()
+                        { return pending() || dropped_.load() != reported.load(); });
+            sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    LogBase::Ptr sink;
+    const Config config;
+    LogRing ring;
+
+    const std::chrono::steady_clock::time_point start_time;
+    std::atomic<std::uint64_t> window{0};
+    std::atomic<unsigned int> window_count{0};
+
+    std::atomic<count_t> dropped_{0};
+    std::atomic<count_t> reported{0}; // drops already reported to the sink
+    std::atomic<count_t> pushed{0};
+    std::atomic<count_t> written{0};
+
+    std::atomic<bool> halt{false};
+    std::atomic<bool> sleeping{false};
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread thread;
+};
+
+} // namespace openvpn
+
+#endif // OPENVPN_LOG_LOGASYNC_H
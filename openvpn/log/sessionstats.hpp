@@ -24,16 +24,28 @@
 #ifndef OPENVPN_LOG_SESSIONSTATS_H
 #define OPENVPN_LOG_SESSIONSTATS_H
 
-#include <cstring>
+#include <atomic>
 
 #include <openvpn/common/size.hpp>
 #include <openvpn/common/count.hpp>
 #include <openvpn/common/rc.hpp>
 #include <openvpn/error/error.hpp>
 #include <openvpn/time/time.hpp>
+#include <openvpn/log/datapathstats.hpp>
+
+// Number of cache-line-sized counter shards per SessionStats object.
+// Each thread that increments a counter is bound to one shard.
+#ifndef OPENVPN_SESSION_STATS_SHARDS
+#define OPENVPN_SESSION_STATS_SHARDS 8
+#endif
 
 namespace openvpn {
 
+// Counters may be incremented concurrently from several threads
+// (transport, tun, crypto).  To keep the hot path free of contention,
+// every thread increments its own cache-line-padded shard and readers
+// sum the shards.  All counters are monotonic, so successive reads
+// never go backwards, even while writers are active.
 class SessionStats : public RC<thread_safe_refcount>
 {
   public:
@@ -50,13 +62,29 @@ class SessionStats : public RC<thread_safe_refcount>
         TUN_BYTES_OUT,   // tun/tap bytes out
         TUN_PACKETS_IN,  // tun/tap packets in
         TUN_PACKETS_OUT, // tun/tap packets out
+
+        // compression stats
+        COMPRESS_BYTES_IN,    // bytes offered to the compressor
+        COMPRESS_BYTES_SAVED, // bytes saved by compression
+        COMPRESS_BYPASS,      // packets not compressed because their flow is incompressible
+        COMPRESS_NS,          // nanoseconds spent compressing
         N_STATS,
     };
 
+    // Totals of all counters at one point in time
+    struct Snapshot
+    {
+        count_t operator[](const size_t type) const
+        {
+            return type < N_STATS ? stats[type] : 0;
+        }
+
+        count_t stats[N_STATS] = {};
+    };
+
     SessionStats()
         : verbose_(false)
     {
-        std::memset((void *)stats_, 0, sizeof(stats_));
     }
 
     virtual void error(const size_t type, const std::string *text = nullptr)
@@ -77,20 +105,34 @@ class SessionStats : public RC<thread_safe_refcount>
         inc_stat(const size_t type, const count_t value)
     {
         if (type < N_STATS)
-            stats_[type] += value;
+            shards_[shard_index()].add(type, value);
     }
 
     count_t get_stat(const size_t type) const
     {
         if (type < N_STATS)
-            return stats_[type];
+            return get_stat_fast(type);
         else
             return 0;
     }
 
     count_t get_stat_fast(const size_t type) const
     {
-        return stats_[type];
+        count_t ret = 0;
+        for (const auto &s : shards_)
+            ret += s.get(type);
+        return ret;
+    }
+
+    // Sum all counters in a single pass over the shards,
+    // without blocking threads that are incrementing them.
+    Snapshot snapshot() const
+    {
+        Snapshot ret;
+        for (const auto &s : shards_)
+            for (size_t i = 0; i < N_STATS; ++i)
+                ret.stats[i] += s.get(i);
+        return ret;
     }
 
     static const char *stat_name(const size_t type)
@@ -104,6 +146,10 @@ class SessionStats : public RC<thread_safe_refcount>
             "TUN_BYTES_OUT",
             "TUN_PACKETS_IN",
             "TUN_PACKETS_OUT",
+            "COMPRESS_BYTES_IN",
+            "COMPRESS_BYTES_SAVED",
+            "COMPRESS_BYPASS",
+            "COMPRESS_NS",
         };
 
         if (type < N_STATS)
@@ -122,6 +168,20 @@ class SessionStats : public RC<thread_safe_refcount>
         return last_packet_received_;
     }
 
+    // Data path histograms are off by default.  Enable before the
+    // session starts, the pointer is read without synchronization.
+    void enable_datapath_stats()
+    {
+        if (!datapath_)
+            datapath_.reset(new DataPathStats());
+    }
+
+    // nullptr unless enabled
+    DataPathStats *datapath_stats() const
+    {
+        return datapath_.get();
+    }
+
     struct DCOTransportSource : public virtual RC<thread_unsafe_refcount>
     {
         typedef RCPtr<DCOTransportSource> Ptr;
@@ -209,14 +269,15 @@ class SessionStats : public RC<thread_safe_refcount>
         if (dco_)
         {
             const DCOTransportSource::Data data = dco_->dco_transport_stats_delta();
-            stats_[BYTES_IN] += data.transport_bytes_in;
-            stats_[BYTES_OUT] += data.transport_bytes_out;
-            stats_[TUN_BYTES_IN] += data.tun_bytes_in;
-            stats_[TUN_BYTES_OUT] += data.tun_bytes_out;
-            stats_[PACKETS_IN] += data.transport_pkts_in;
-            stats_[PACKETS_OUT] += data.transport_pkts_out;
-            stats_[TUN_PACKETS_IN] += data.tun_pkts_in;
-            stats_[TUN_PACKETS_OUT] += data.tun_pkts_out;
+            Shard &s = shards_[shard_index()];
+            s.add(BYTES_IN, data.transport_bytes_in);
+            s.add(BYTES_OUT, data.transport_bytes_out);
+            s.add(TUN_BYTES_IN, data.tun_bytes_in);
+            s.add(TUN_BYTES_OUT, data.tun_bytes_out);
+            s.add(PACKETS_IN, data.transport_pkts_in);
+            s.add(PACKETS_OUT, data.transport_pkts_out);
+            s.add(TUN_PACKETS_IN, data.tun_pkts_in);
+            s.add(TUN_PACKETS_OUT, data.tun_pkts_out);
         }
     }
 
@@ -227,10 +288,41 @@ class SessionStats : public RC<thread_safe_refcount>
     }
 
   private:
+    enum
+    {
+        N_SHARDS = OPENVPN_SESSION_STATS_SHARDS,
+        CACHE_LINE_SIZE = 64,
+    };
+
+    // One set of counters, padded so that no two shards share a cache line
+    struct alignas(CACHE_LINE_SIZE) Shard
+    {
+        void add(const size_t type, const count_t value)
+        {
+            c[type].fetch_add(value, std::memory_order_relaxed);
+        }
+
+        count_t get(const size_t type) const
+        {
+            return c[type].load(std::memory_order_relaxed);
+        }
+
+        std::atomic<count_t> c[N_STATS] = {};
+    };
+
+    // Threads are assigned shards round-robin on first use
+    static unsigned int shard_index()
+    {
+        static std::atomic<unsigned int> next_index{0};
+        thread_local const unsigned int index = next_index.fetch_add(1, std::memory_order_relaxed) % N_SHARDS;
+        return index;
+    }
+
     bool verbose_;
     Time last_packet_received_;
     DCOTransportSource::Ptr dco_;
-    volatile count_t stats_[N_STATS];
+    DataPathStats::Ptr datapath_;
+    Shard shards_[N_SHARDS];
 };
 
 } // namespace openvpn
@@ -239,6 +239,16 @@ class MbedTLSContext : public SSLFactoryAPI
             throw MbedTLSException("set_session_ticket_handler not implemented");
         }
 
+        virtual void set_session_cache(const TLSSessionCache::Ptr &session_cache_arg)
+        {
+#if MBEDTLS_VERSION_NUMBER >= 0x02130000
+            session_cache = session_cache_arg;
+#else
+            // mbedtls_ssl_session_save/load are needed to share sessions
+            throw MbedTLSException("set_session_cache requires mbed TLS 2.19 or newer");
+#endif
+        }
+
         virtual void set_client_session_tickets(const bool v)
         {
             // fixme -- this method should be implemented for client-side TLS session resumption tickets
@@ -642,7 +652,8 @@ class MbedTLSContext : public SSLFactoryAPI
         std::string tls_groups;
         X509Track::ConfigSet x509_track_config;
         bool local_cert_enabled;
-        StrongRandomAPI::Ptr rng; // random data source
+        StrongRandomAPI::Ptr rng;           // random data source
+        TLSSessionCache::Ptr session_cache; // server side only
     };
 
     // Represents an actual SSL session.
@@ -761,6 +772,10 @@ class MbedTLSContext : public SSLFactoryAPI
 
         virtual const AuthCert::Ptr &auth_cert() const override
         {
+            // Resumed sessions don't call the cert verify callback,
+            // so we must rebuild authcert from the session's peer cert.
+            if (authcert && !authcert->defined())
+                rebuild_authcert();
             return authcert;
         }
 
@@ -869,6 +884,14 @@ class MbedTLSContext : public SSLFactoryAPI
                 // in mbed TLS config.h.
                 mbedtls_ssl_conf_renegotiation(sslconf, MBEDTLS_SSL_RENEGOTIATION_DISABLED);
 
+#if MBEDTLS_VERSION_NUMBER >= 0x02130000
+                if (c.mode.is_server() && c.session_cache)
+                    mbedtls_ssl_conf_session_cache(sslconf,
+                                                   c.session_cache.get(),
+                                                   session_cache_get_callback,
+                                                   session_cache_set_callback);
+#endif
+
                 if (!c.tls_cipher_list.empty())
                 {
                     set_mbedtls_cipherlist(c.tls_cipher_list);
@@ -1090,6 +1113,66 @@ class MbedTLSContext : public SSLFactoryAPI
             }
         }
 
+        void rebuild_authcert() const
+        {
+            const mbedtls_x509_crt *cert = mbedtls_ssl_get_peer_cert(ssl);
+            if (cert)
+            {
+                // save the issuer cert fingerprint
+                load_issuer_fingerprint_into_authcert(*authcert, cert);
+
+                // save the Common Name
+                authcert->cn = MbedTLSPKI::x509_get_common_name(cert);
+
+                // save the leaf cert serial number
+                load_serial_number_into_authcert(*authcert, cert);
+
+                authcert->defined_ = true;
+            }
+        }
+
+#if MBEDTLS_VERSION_NUMBER >= 0x02130000
+        // Server-side session cache callbacks -- sessions are stored
+        // serialized so that they can be shared across SSL contexts.
+        static int session_cache_get_callback(void *arg, mbedtls_ssl_session *session)
+        {
+            try
+            {
+                TLSSessionCache *cache = (TLSSessionCache *)arg;
+                std::string data;
+                if (!cache->lookup(std::string((const char *)session->id, session->id_len), data))
+                    return 1;
+                return mbedtls_ssl_session_load(session, (const unsigned char *)data.data(), data.length()) == 0 ? 0 : 1;
+            }
+            catch (...)
+            {
+                return 1;
+            }
+        }
+
+        static int session_cache_set_callback(void *arg, const mbedtls_ssl_session *session)
+        {
+            try
+            {
+                TLSSessionCache *cache = (TLSSessionCache *)arg;
+                size_t len = 0;
+                mbedtls_ssl_session_save(session, nullptr, 0, &len);
+                if (!len)
+                    return 1;
+                std::string data(len, '\0');
+                if (mbedtls_ssl_session_save(session, (unsigned char *)&data[0], len, &len) != 0)
+                    return 1;
+                data.resize(len);
+                cache->insert(std::string((const char *)session->id, session->id_len), std::move(data));
+                return 0;
+            }
+            catch (...)
+            {
+                return 1;
+            }
+        }
+#endif
+
         // RNG callback -- return random data to mbed TLS
         static int rng_callback(void *arg, unsigned char *data, size_t len)
         {
@@ -30,6 +30,7 @@
 #include <cstdint>
 #include <sstream>
 #include <utility>
+#include <mutex>
 
 #include <openssl/crypto.h>
 #include <openssl/ssl.h>
@@ -157,6 +158,12 @@ class OpenSSLContext : public SSLFactoryAPI
             session_ticket_handler = session_ticket_handler_arg;
         }
 
+        // server side
+        void set_session_cache(const TLSSessionCache::Ptr &session_cache_arg) override
+        {
+            session_cache = session_cache_arg;
+        }
+
         // client side
         void set_client_session_tickets(const bool v) override
         {
@@ -649,7 +656,9 @@ class OpenSSLContext : public SSLFactoryAPI
         OpenSSLPKI::DH dh;                // diffie-hellman parameters (only needed in server mode)
         ExternalPKIBase *external_pki = nullptr;
         TLSSessionTicketBase *session_ticket_handler = nullptr; // server side only
+        TLSSessionCache::Ptr session_cache;                     // server side only
         SNI::HandlerBase *sni_handler = nullptr;                // server side only
+        mutable std::mutex handler_mutex;                       // serializes calls into the two handlers above
         Frame::Ptr frame;
         int ssl_debug_level = 0;
         unsigned int flags = 0; // defined in sslconsts.hpp
@@ -814,6 +823,7 @@ class OpenSSLContext : public SSLFactoryAPI
 
             ssl_data_index = SSL_get_ex_new_index(0, (char *)"OpenSSLContext::SSL", nullptr, nullptr, nullptr);
             context_data_index = SSL_get_ex_new_index(0, (char *)"OpenSSLContext", nullptr, nullptr, nullptr);
+            ssl_ctx_data_index = SSL_CTX_get_ex_new_index(0, (char *)"OpenSSLContext", nullptr, nullptr, nullptr);
 
             /*
              * We actually override some of the OpenSSL SSLv23 methods here,
@@ -875,6 +885,7 @@ class OpenSSLContext : public SSLFactoryAPI
                 {
                     SSL_set_accept_state(ssl);
                     authcert.reset(new AuthCert());
+                    keep_session = bool(ctx.config->session_cache);
                     if (!ctx.config->x509_track_config.empty())
                         authcert->x509_track.reset(new X509Track::Set);
                 }
@@ -1046,6 +1057,7 @@ class OpenSSLContext : public SSLFactoryAPI
             ct_out = nullptr;
             overflow = false;
             called_did_full_handshake = false;
+            keep_session = false;
             sess_cache_key.reset();
         }
 
@@ -1065,6 +1077,12 @@ class OpenSSLContext : public SSLFactoryAPI
                 SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
                 sess_cache_key->commit(SSL_get1_session(ssl));
             }
+            else if (keep_session)
+            {
+                // We never send close_notify, so without this SSL_free()
+                // would evict the session from the server-side cache.
+                SSL_set_shutdown(ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+            }
             SSL_free(ssl);
             openssl_clear_error_stack();
             ssl_clear();
@@ -1115,10 +1133,12 @@ class OpenSSLContext : public SSLFactoryAPI
         bool ssl_bio_linkage;
         bool overflow;
         bool called_did_full_handshake;
+        bool keep_session; // server-side session cache is enabled
 
         // Helps us to store pointer to self in ::SSL object
         inline static int ssl_data_index = -1;
         inline static int context_data_index = -1;
+        inline static int ssl_ctx_data_index = -1; // pointer to self in ::SSL_CTX object
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
         // Modified SSLv23 methods
@@ -1182,6 +1202,27 @@ class OpenSSLContext : public SSLFactoryAPI
 #endif
     }
 
+    void setup_server_session_cache() const
+    {
+        // the ticket handler, if any, has already set the session ID context
+        if (!config->session_ticket_handler)
+        {
+            const std::string &sess_id_context = config->session_cache->session_id_context();
+            if (!SSL_CTX_set_session_id_context(ctx.get(), (unsigned char *)sess_id_context.c_str(), numeric_cast<unsigned int>(sess_id_context.length())))
+                throw OpenSSLException("OpenSSLContext: SSL_CTX_set_session_id_context failed");
+        }
+
+        // Keep sessions only in the (possibly shared) external cache
+        SSL_CTX_set_session_cache_mode(ctx.get(), SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+        SSL_CTX_set_timeout(ctx.get(), config->session_cache->lifetime_seconds());
+        if (SSL::ssl_ctx_data_index < 0)
+            throw ssl_context_error("OpenSSLContext: ssl_ctx_data_index is uninitialized");
+        SSL_CTX_set_ex_data(ctx.get(), SSL::ssl_ctx_data_index, (void *)this);
+        SSL_CTX_sess_set_new_cb(ctx.get(), session_cache_new_callback);
+        SSL_CTX_sess_set_get_cb(ctx.get(), session_cache_get_callback);
+        SSL_CTX_sess_set_remove_cb(ctx.get(), session_cache_remove_callback);
+    }
+
     OpenSSLContext(Config *config_arg)
         : config(config_arg)
     {
@@ -1257,6 +1298,9 @@ class OpenSSLContext : public SSLFactoryAPI
             else
                 sslopt |= SSL_OP_NO_TICKET;
 
+            if (config->session_cache)
+                setup_server_session_cache();
+
             // send a client CA list to the client
             if (config->flags & SSLConst::SEND_CLIENT_CA_LIST)
             {
@@ -2075,6 +2119,77 @@ class OpenSSLContext : public SSLFactoryAPI
         }
     }
 
+    static std::string session_cache_key(const SSL_SESSION *sess)
+    {
+        unsigned int len = 0;
+        const unsigned char *id = SSL_SESSION_get_id(sess, &len);
+        return std::string((const char *)id, len);
+    }
+
+    // Called by OpenSSL when the server creates a new session.
+    // Returns 0 to indicate that we did not take a reference to sess.
+    static int session_cache_new_callback(::SSL *ssl, SSL_SESSION *sess)
+    {
+        const OpenSSLContext *self = (OpenSSLContext *)SSL_get_ex_data(ssl, SSL::context_data_index);
+        if (!self || !self->config->session_cache)
+            return 0;
+
+        try
+        {
+            const int len = i2d_SSL_SESSION(sess, nullptr);
+            if (len <= 0)
+                return 0;
+            std::string der(len, '\0');
+            unsigned char *p = (unsigned char *)&der[0];
+            if (i2d_SSL_SESSION(sess, &p) != len)
+                return 0;
+            self->config->session_cache->insert(session_cache_key(sess), std::move(der));
+        }
+        catch (const std::exception &e)
+        {
+            OPENVPN_LOG("OpenSSLContext::session_cache_new_callback exception: " << e.what());
+        }
+        return 0;
+    }
+
+    // Called by OpenSSL when a client asks to resume a session.
+    static SSL_SESSION *session_cache_get_callback(::SSL *ssl,
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+                                                   unsigned char *id,
+#else
+                                                   const unsigned char *id,
+#endif
+                                                   int id_len,
+                                                   int *copy)
+    {
+        *copy = 0; // the returned session is owned by the caller
+        const OpenSSLContext *self = (OpenSSLContext *)SSL_get_ex_data(ssl, SSL::context_data_index);
+        if (!self || !self->config->session_cache || id_len <= 0)
+            return nullptr;
+
+        try
+        {
+            std::string der;
+            if (!self->config->session_cache->lookup(std::string((const char *)id, id_len), der))
+                return nullptr;
+            const unsigned char *p = (const unsigned char *)der.data();
+            return d2i_SSL_SESSION(nullptr, &p, numeric_cast<long>(der.length()));
+        }
+        catch (const std::exception &e)
+        {
+            OPENVPN_LOG("OpenSSLContext::session_cache_get_callback exception: " << e.what());
+            return nullptr;
+        }
+    }
+
+    // Called by OpenSSL when a session is invalidated, e.g. after a fatal alert.
+    static void session_cache_remove_callback(::SSL_CTX *ctx, SSL_SESSION *sess)
+    {
+        const OpenSSLContext *self = (OpenSSLContext *)SSL_CTX_get_ex_data(ctx, SSL::ssl_ctx_data_index);
+        if (self && self->config->session_cache)
+            self->config->session_cache->erase(session_cache_key(sess));
+    }
+
     static int tls_ticket_key_callback(::SSL *ssl,
                                        unsigned char key_name[16],
                                        unsigned char iv[EVP_MAX_IV_LENGTH],
@@ -2092,6 +2207,10 @@ class OpenSSLContext : public SSLFactoryAPI
         if (!t)
             return -1;
 
+        // handshakes of sessions sharing this config may run concurrently
+        // on a TLSHandshakePool, and the handler need not be thread-safe
+        std::lock_guard<std::mutex> lock(self->config->handler_mutex);
+
         if (enc)
         {
             // create new ticket
@@ -2228,6 +2347,7 @@ class OpenSSLContext : public SSLFactoryAPI
                     try
                     {
                         SNI::Metadata::UPtr sm;
+                        std::lock_guard<std::mutex> lock(self->config->handler_mutex); // see tls_ticket_key_callback()
                         fapi = self->config->sni_handler->sni_hello(sni_name, sm, self->config);
                         if (self_ssl->authcert)
                             self_ssl->authcert->sni_metadata = std::move(sm);
@@ -50,37 +50,54 @@ class PushContinuationFragment : public std::vector<BufferPtr>
 
     PushContinuationFragment(const Buffer &buf)
     {
-        // size of ",push-continuation n"
-        const size_t push_continuation_len = 20;
-
         // loop over options
-        bool did_continuation = false;
         Lex lex(buf);
         while (lex.defined())
-        {
-            // get escaped opt
-            const std::string escaped_opt = lex.next();
+            append_opt(*this, lex.next());
 
-            // create first buffer on loop startup
-            if (empty())
-                append_new_buffer();
+        // push final push-continuation
+        finalize(*this);
+    }
 
-            // ready to finalize this outbut buffer and move on to next?
-            // (the +1 is for escaped_opt comma)
-            if (back()->size() + escaped_opt.size() + push_continuation_len + 1 > FRAGMENT_SIZE)
-            {
-                did_continuation = true;
-                append_push_continuation(*back(), false);
-                append_new_buffer();
-            }
+    // Append an escaped option to a list of PUSH_REPLY fragments,
+    // closing off the last fragment with push-continuation 2 and
+    // starting a new one if the option doesn't fit.
+    static void append_opt(std::vector<BufferPtr> &frags, const std::string &escaped_opt)
+    {
+        // size of ",push-continuation n"
+        const size_t push_continuation_len = 20;
+
+        // create first buffer on loop startup
+        if (frags.empty())
+            append_new_buffer(frags);
 
-            back()->push_back(',');
-            buf_append_string(*back(), escaped_opt);
+        // ready to finalize this outbut buffer and move on to next?
+        // (the +1 is for escaped_opt comma)
+        if (frags.back()->size() + escaped_opt.size() + push_continuation_len + 1 > FRAGMENT_SIZE)
+        {
+            append_push_continuation(*frags.back(), false);
+            append_new_buffer(frags);
         }
 
-        // push final push-continuation
-        if (!empty() && did_continuation)
-            append_push_continuation(*back(), true);
+        frags.back()->push_back(',');
+        buf_append_string(*frags.back(), escaped_opt);
+    }
+
+    // create a new PUSH_REPLY buffer
+    static void append_new_buffer(std::vector<BufferPtr> &frags)
+    {
+        // include extra byte for null termination
+        BufferPtr bp = new BufferAllocated(FRAGMENT_SIZE + 1, 0);
+        buf_append_string(*bp, "PUSH_REPLY");
+        frags.push_back(std::move(bp));
+    }
+
+    // Terminate the last fragment with push-continuation 1
+    // if the options were split over more than one fragment.
+    static void finalize(std::vector<BufferPtr> &frags)
+    {
+        if (frags.size() > 1)
+            append_push_continuation(*frags.back(), true);
     }
 
     static BufferPtr defragment(const std::vector<BufferPtr> &bv)
@@ -159,15 +176,6 @@ class PushContinuationFragment : public std::vector<BufferPtr>
         Buffer buf_;
     };
 
-    // create a new PUSH_REPLY buffer
-    void append_new_buffer()
-    {
-        // include extra byte for null termination
-        BufferPtr bp = new BufferAllocated(FRAGMENT_SIZE + 1, 0);
-        buf_append_string(*bp, "PUSH_REPLY");
-        push_back(std::move(bp));
-    }
-
     // append a push-continuation directive to buffer
     static void append_push_continuation(Buffer &buf, bool end)
     {
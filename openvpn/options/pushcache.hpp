@@ -0,0 +1,191 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Server-side cache of serialized, pre-fragmented PUSH_REPLY messages.
+//
+// Clients in the same group are normally pushed the same option list
+// apart from a few per-client items such as ifconfig and peer-id.
+// PushReplyTemplate escapes and fragments the common list once, and
+// render() copies the prebuilt fragments and splices the per-client
+// items onto the end, producing the same messages PushContinuationFragment
+// would for the complete list.  A reply that fits in one message is
+// sent unfragmented, as without the template.  PushReplyCache holds one template per
+// group and rebuilds it when the group's option-set version changes.
+
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+#include <openvpn/common/rc.hpp>
+#include <openvpn/buffer/buffer.hpp>
+#include <openvpn/common/options.hpp>
+#include <openvpn/options/continuation_fragment.hpp>
+
+namespace openvpn {
+
+class PushReplyTemplate : public RC<thread_safe_refcount>
+{
+  public:
+    typedef RCPtr<PushReplyTemplate> Ptr;
+
+    // push_list is usually a ServerPushList
+    PushReplyTemplate(const std::vector<std::string> &push_list, const std::uint64_t version)
+        : version_(version)
+    {
+        for (const auto &e : push_list)
+        {
+            const std::string opt = escape(e);
+            common.push_back(',');
+            common += opt;
+            PushContinuationFragment::append_opt(frags, opt);
+        }
+    }
+
+    std::uint64_t version() const
+    {
+        return version_;
+    }
+
+    // number of prebuilt fragments
+    size_t size() const
+    {
+        return frags.size();
+    }
+
+    // Return the PUSH_REPLY messages for one client, with client_items
+    // following the common options.  Safe to call concurrently, the
+    // template itself is never modified.
+    std::vector<BufferPtr> render(const std::vector<std::string> &client_items) const
+    {
+        std::vector<std::string> items;
+        items.reserve(client_items.size());
+        size_t total = std::strlen("PUSH_REPLY") + common.size();
+        for (const auto &e : client_items)
+        {
+            items.push_back(escape(e));
+            total += items.back().size() + 1;
+        }
+
+        // like the non-template path, only fragment if the whole
+        // reply doesn't fit in one message
+        if (total <= PushContinuationFragment::FRAGMENT_SIZE)
+        {
+            // keep room for the null termination added by push_reply()
+            BufferPtr bp = new BufferAllocated(PushContinuationFragment::FRAGMENT_SIZE + 1, 0);
+            buf_append_string(*bp, "PUSH_REPLY");
+            buf_append_string(*bp, common);
+            for (const auto &e : items)
+            {
+                bp->push_back(',');
+                buf_append_string(*bp, e);
+            }
+            return {bp};
+        }
+
+        std::vector<BufferPtr> ret;
+        ret.reserve(frags.size() + 1);
+        for (const auto &f : frags)
+        {
+            // keep room for the null termination added by push_reply()
+            BufferPtr bp = new BufferAllocated(PushContinuationFragment::FRAGMENT_SIZE + 1, 0);
+            bp->write(f->c_data(), f->size());
+            ret.push_back(std::move(bp));
+        }
+        for (const auto &e : items)
+            PushContinuationFragment::append_opt(ret, e);
+        PushContinuationFragment::finalize(ret);
+        return ret;
+    }
+
+  private:
+    // escape an option the same way as ServerPushList::output_arg()
+    static std::string escape(const std::string &e)
+    {
+        std::ostringstream os;
+        Option::escape_string(os, e, e.find_first_of(',') != std::string::npos);
+        return os.str();
+    }
+
+    const std::uint64_t version_;
+
+    // the common options, comma-prefixed, for replies that fit in
+    // a single message
+    std::string common;
+
+    // fragments of the common options, all but the last
+    // already closed off with push-continuation 2, for replies
+    // that must be fragmented
+    std::vector<BufferPtr> frags;
+};
+
+class PushReplyCache
+{
+  public:
+    // Return the template for group, calling build() to produce the
+    // group's push list only if there is no template yet or it
+    // was made from a different version.  The build runs under the
+    // cache lock, so a reconnect storm builds each version once.
+    template <typename BUILD>
+    PushReplyTemplate::Ptr get(const std::string &group, const std::uint64_t version, BUILD build)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        PushReplyTemplate::Ptr &tmpl = map[group];
+        if (!tmpl || tmpl->version() != version)
+        {
+            tmpl.reset(new PushReplyTemplate(build(), version));
+            ++builds_;
+        }
+        return tmpl;
+    }
+
+    void invalidate(const std::string &group)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        map.erase(group);
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        map.clear();
+    }
+
+    // number of templates built since construction
+    std::uint64_t builds() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return builds_;
+    }
+
+  private:
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, PushReplyTemplate::Ptr> map;
+    std::uint64_t builds_ = 0;
+};
+
+} // namespace openvpn
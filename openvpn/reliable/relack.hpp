@@ -31,6 +31,7 @@
 #include <openvpn/common/socktypes.hpp>
 #include <openvpn/buffer/buffer.hpp>
 #include <openvpn/crypto/packet_id.hpp>
+#include <openvpn/time/time.hpp>
 #include <openvpn/reliable/relcommon.hpp>
 
 namespace openvpn {
@@ -75,6 +76,21 @@ class ReliableAck
         return len;
     }
 
+    // As above, but also pass the time of arrival to rel_send, so that
+    // it can measure the round trip time and detect lost packets.
+    template <typename REL_SEND>
+    static size_t ack(REL_SEND &rel_send, Buffer &buf, const bool live, const Time &now)
+    {
+        const size_t len = buf.pop_front();
+        for (size_t i = 0; i < len; ++i)
+        {
+            const id_t id = read_id(buf);
+            if (live)
+                rel_send.ack(id, now);
+        }
+        return len;
+    }
+
     static size_t ack_skip(Buffer &buf)
     {
         const size_t len = buf.pop_front();
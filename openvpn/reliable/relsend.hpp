@@ -24,6 +24,8 @@
 #ifndef OPENVPN_RELIABLE_RELSEND_H
 #define OPENVPN_RELIABLE_RELSEND_H
 
+#include <algorithm>
+
 #include <openvpn/common/size.hpp>
 #include <openvpn/common/exception.hpp>
 #include <openvpn/common/msgwin.hpp>
@@ -38,6 +40,17 @@ class ReliableSendTemplate
   public:
     typedef reliable::id_t id_t;
 
+    // Number of ACKs for later packets after which an unacknowledged
+    // packet is presumed lost and retransmitted without waiting for
+    // its timer (the ACK lists of the reliability layer already name
+    // each packet received, so they double as selective ACKs).
+    static constexpr unsigned int fast_retransmit_acks = 3;
+
+    // Lower bound of the adaptive retransmit timeout (unless the
+    // configured tls-timeout is smaller), and upper bound.
+    static constexpr Time::type rto_min_ms = 200;
+    static constexpr Time::type rto_max_ms = 60000;
+
     class Message : public ReliableMessageBase<PACKET>
     {
         friend class ReliableSendTemplate;
@@ -46,13 +59,13 @@ class ReliableSendTemplate
       public:
         bool ready_retransmit(const Time &now) const
         {
-            return defined() && now >= retransmit_at_;
+            return defined() && (now >= retransmit_at_ || n_later_acks_ >= fast_retransmit_acks);
         }
 
         Time::Duration until_retransmit(const Time &now) const
         {
             Time::Duration ret;
-            if (now < retransmit_at_)
+            if (now < retransmit_at_ && n_later_acks_ < fast_retransmit_acks)
                 ret = retransmit_at_ - now;
             return ret;
         }
@@ -60,10 +73,23 @@ class ReliableSendTemplate
         void reset_retransmit(const Time &now, const Time::Duration &tls_timeout)
         {
             retransmit_at_ = now + tls_timeout;
+            timeout_ = tls_timeout;
+            n_later_acks_ = 0;
+            ++n_sent_;
+        }
+
+        // number of times the packet was sent, including the first time
+        unsigned int n_sent() const
+        {
+            return n_sent_;
         }
 
       private:
         Time retransmit_at_;
+        Time sent_at_;
+        Time::Duration timeout_;
+        unsigned int n_sent_ = 0;
+        unsigned int n_later_acks_ = 0;
     };
 
     ReliableSendTemplate()
@@ -138,15 +164,31 @@ class ReliableSendTemplate
 
     // Return a fresh Message object that can be used to
     // construct the next packet in the sequence.  Don't call
-    // unless ready() returns true.
+    // unless ready() returns true.  tls_timeout is the retransmit
+    // timeout used until an RTT has been measured.
     Message &send(const Time &now, const Time::Duration &tls_timeout)
     {
         Message &msg = window_.ref_by_id(next);
         msg.id_ = next++;
-        msg.reset_retransmit(now, tls_timeout);
+        msg.sent_at_ = now;
+        msg.n_sent_ = 0;
+        msg.reset_retransmit(now, rto(tls_timeout));
         return msg;
     }
 
+    // Reset the timer of a message that has just been retransmitted,
+    // doubling its timeout.  The backoff is capped at the larger of
+    // tls_timeout and the current RTO, so that on a lossy but fast
+    // link retransmissions never come later than with a fixed timer.
+    void retransmitted(Message &msg, const Time &now, const Time::Duration &tls_timeout)
+    {
+        Time::Duration limit = rto(tls_timeout);
+        limit.max(tls_timeout);
+        Time::Duration timeout = msg.timeout_ * 2;
+        timeout.min(limit);
+        msg.reset_retransmit(now, timeout);
+    }
+
     // Return true if send queue is ready to receive another packet
     bool ready() const
     {
@@ -159,9 +201,76 @@ class ReliableSendTemplate
         window_.rm_by_id(id);
     }
 
+    // Remove a message from send queue that has been acknowledged at
+    // time now.  Packets that were sent only once yield an RTT sample
+    // (Karn's algorithm), and the ACK counts against any earlier
+    // packets still unacknowledged, for fast retransmit.
+    void ack(const id_t id, const Time &now)
+    {
+        if (window_.in_window(id))
+        {
+            const Message &msg = window_.ref_by_id(id);
+            if (msg.defined())
+            {
+                if (msg.n_sent_ == 1)
+                    rtt_sample(now - msg.sent_at_);
+                for (id_t i = head_id(); i < id; ++i)
+                {
+                    Message &m = window_.ref_by_id(i);
+                    if (m.defined())
+                        ++m.n_later_acks_;
+                }
+            }
+        }
+        window_.rm_by_id(id);
+    }
+
+    // Retransmit timeout per RFC 6298: SRTT + 4 * RTTVAR, bounded by
+    // rto_min_ms and rto_max_ms, or tls_timeout if no RTT has been
+    // measured yet.
+    Time::Duration rto(const Time::Duration &tls_timeout) const
+    {
+        if (!rtt_valid)
+            return tls_timeout;
+        Time::Duration lower = Time::Duration::milliseconds(rto_min_ms);
+        lower.min(tls_timeout);
+        Time::Duration ret = Time::Duration::binary_ms(srtt_ + std::max(rttvar_ * 4, Time::type(1)));
+        ret.max(lower);
+        ret.min(Time::Duration::milliseconds(rto_max_ms));
+        return ret;
+    }
+
+    // Smoothed RTT, zero if no RTT has been measured yet
+    Time::Duration srtt() const
+    {
+        return Time::Duration::binary_ms(srtt_);
+    }
+
   private:
+    void rtt_sample(const Time::Duration &rtt)
+    {
+        const Time::type r = rtt.raw();
+        if (rtt_valid)
+        {
+            const Time::type delta = srtt_ > r ? srtt_ - r : r - srtt_;
+            rttvar_ = rttvar_ - rttvar_ / 4 + delta / 4;
+            srtt_ = srtt_ - srtt_ / 8 + r / 8;
+        }
+        else
+        {
+            srtt_ = r;
+            rttvar_ = r / 2;
+            rtt_valid = true;
+        }
+    }
+
     id_t next;
     MessageWindow<Message, id_t> window_;
+
+    // RTT estimator state, in Time::Duration units
+    bool rtt_valid = false;
+    Time::type srtt_ = 0;
+    Time::type rttvar_ = 0;
 };
 
 } // namespace openvpn
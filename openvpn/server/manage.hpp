@@ -39,6 +39,7 @@
 #include <openvpn/server/peerstats.hpp>
 #include <openvpn/server/peeraddr.hpp>
 #include <openvpn/auth/authcert.hpp>
+#include <openvpn/options/pushcache.hpp>
 
 
 namespace openvpn {
@@ -144,6 +145,14 @@ struct Recv : public virtual RC<thread_unsafe_refcount>
 
     virtual void push_reply(std::vector<BufferPtr> &&push_msgs) = 0;
 
+    // push a cached PUSH_REPLY template, appending per-client
+    // items such as ifconfig
+    virtual void push_reply_template(const PushReplyTemplate &tmpl,
+                                     const std::vector<std::string> &client_items)
+    {
+        push_reply(tmpl.render(client_items));
+    }
+
     // push a halt or restart message to client
     virtual void push_halt_restart_msg(const HaltRestart::Type type,
                                        const std::string &reason,
@@ -39,6 +39,7 @@
 #include <openvpn/time/coarsetime.hpp>
 #include <openvpn/crypto/cryptodc.hpp>
 #include <openvpn/ssl/proto.hpp>
+#include <openvpn/ssl/tlspool.hpp>
 #include <openvpn/transport/server/transbase.hpp>
 #include <openvpn/tun/server/tunbase.hpp>
 #include <openvpn/server/manage.hpp>
@@ -102,6 +103,10 @@ class ServerProto
         ManClientInstance::Factory::Ptr man_factory;
         TunClientInstance::Factory::Ptr tun_factory;
 
+        // if defined, TLS handshakes run on this pool rather than
+        // on the session thread
+        TLSHandshakePool::Ptr tls_pool;
+
         SessionStats::Ptr stats;
 
       private:
@@ -308,6 +313,8 @@ class ServerProto
               man_factory(std::move(man_factory_arg)),
               tun_factory(std::move(tun_factory_arg))
         {
+            if (factory.tls_pool)
+                ProtoContext::set_tls_offload(factory.tls_pool->offload(io_context_arg));
         }
 
         bool defined_() const
@@ -315,6 +322,24 @@ class ServerProto
             return !halt && TransportLink::send;
         }
 
+        // proto base class calls here when a TLS handshake step run on
+        // the factory's tls_pool has completed
+        virtual void tls_offload_ready() override
+        {
+            if (halt)
+                return;
+            try
+            {
+                ProtoContext::update_now();
+                ProtoContext::flush(true);
+                set_housekeeping_timer();
+            }
+            catch (const std::exception &e)
+            {
+                error(e);
+            }
+        }
+
         // proto base class calls here for control channel network sends
         virtual void control_net_send(const Buffer &net_buf) override
         {
@@ -430,6 +455,22 @@ class ServerProto
             }
         }
 
+        // The session knows its own peer-id, so splice it in here
+        // rather than have the management layer pass it along.
+        virtual void push_reply_template(const PushReplyTemplate &tmpl,
+                                         const std::vector<std::string> &client_items) override
+        {
+            const int peer_id = ProtoContext::conf().local_peer_id;
+            if (peer_id < 0)
+            {
+                push_reply(tmpl.render(client_items));
+                return;
+            }
+            std::vector<std::string> items(client_items);
+            items.push_back("peer-id " + std::to_string(peer_id));
+            push_reply(tmpl.render(items));
+        }
+
         virtual TunClientInstance::NativeHandle tun_native_handle() override
         {
             if (get_tun())
@@ -0,0 +1,229 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Multi-threaded data channel pipeline.
+//
+// Data channel packets are processed in three stages:
+//
+// 1. ProtoContext::data_{en,de}crypt_job on the session thread:
+//    compression, MSS fix, packet ID assignment, op header.
+// 2. ProtoContext::DataJob::process on one of N pipeline threads:
+//    the cipher operation, using a per-thread CryptoDCWorker.
+// 3. ProtoContext::data_{en,de}crypt_finish on the session thread:
+//    replay check, decompression, delivery.
+//
+// Stage 1 is run by the caller before submit().  Completed jobs are
+// returned to the session thread in submission order (separately for
+// each direction) through DataChannelPipelineParent::dc_pipeline_done,
+// which runs stage 3.  Packet IDs are therefore assigned and verified
+// serially, and packets leave the pipeline in the order they entered.
+
+#ifndef OPENVPN_SSL_DCPIPELINE_H
+#define OPENVPN_SSL_DCPIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <openvpn/io/io.hpp>
+#include <openvpn/common/rc.hpp>
+#include <openvpn/ssl/proto.hpp>
+
+namespace openvpn {
+
+struct DataChannelPipelineParent
+{
+    // Called on the session thread with each completed job, in
+    // submission order for each direction (see DataJob::encrypt).
+    // The callee may swap or move the job's buffer.
+    virtual void dc_pipeline_done(ProtoContext::DataJob &job) = 0;
+};
+
+class DataChannelPipeline : public RC<thread_safe_refcount>
+{
+  public:
+    typedef RCPtr<DataChannelPipeline> Ptr;
+
+    struct Job : public ProtoContext::DataJob
+    {
+        std::atomic<bool> done{false};
+    };
+
+    DataChannelPipeline(openvpn_io::io_context &io_context_arg,
+                        DataChannelPipelineParent *parent_arg,
+                        const unsigned int n_threads_arg)
+        : io_context(io_context_arg),
+          parent(parent_arg)
+    {
+        for (unsigned int i = 0; i < n_threads_arg; ++i)
+            threads.emplace_back([this, i]()
+                                 { thread_func(i); });
+    }
+
+    ~DataChannelPipeline()
+    {
+        stop();
+    }
+
+    // number of pipeline threads, to be passed to
+    // ProtoContext::data_{en,de}crypt_job
+    size_t n_threads() const
+    {
+        return threads.size();
+    }
+
+    // Return a job for stage 1, recycled if possible.  Called on
+    // the session thread.
+    std::unique_ptr<Job> alloc()
+    {
+        if (free_jobs.empty())
+            return std::unique_ptr<Job>(new Job());
+        std::unique_ptr<Job> job = std::move(free_jobs.back());
+        free_jobs.pop_back();
+        return job;
+    }
+
+    // Queue a job after stage 1.  Called on the session thread.
+    void submit(std::unique_ptr<Job> job)
+    {
+        if (halt)
+            return;
+        Job *j = job.get();
+        j->done.store(!j->pipelined(), std::memory_order_relaxed);
+        (j->encrypt ? encrypt_order : decrypt_order).push_back(std::move(job));
+        if (j->pipelined())
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                work.push_back(j);
+            }
+            cond.notify_one();
+        }
+        else
+            drain();
+    }
+
+    // Number of submitted jobs not yet returned to the parent
+    size_t in_flight() const
+    {
+        return encrypt_order.size() + decrypt_order.size();
+    }
+
+    // Stop and join pipeline threads, discarding in-flight jobs.
+    // Must be called by the owner on the session thread before
+    // releasing its reference.
+    void stop()
+    {
+        if (!halt)
+        {
+            halt = true;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+                work.clear();
+            }
+            cond.notify_all();
+            for (auto &t : threads)
+            {
+                if (t.get_id() == std::this_thread::get_id())
+                    t.detach(); // last reference dropped on a pipeline thread
+                else if (t.joinable())
+                    t.join();
+            }
+            encrypt_order.clear();
+            decrypt_order.clear();
+            free_jobs.clear();
+        }
+    }
+
+  private:
+    typedef std::deque<std::unique_ptr<Job>> JobQueue;
+
+    void thread_func(const unsigned int index)
+    {
+        while (true)
+        {
+            Job *job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this]()
+                          { return stopping || !work.empty(); });
+                if (stopping)
+                    return;
+                job = work.front();
+                work.pop_front();
+            }
+            job->process(index);
+            job->done.store(true, std::memory_order_release);
+
+            // coalesce wakeups of the session thread
+            if (!drain_pending.exchange(true, std::memory_order_acq_rel))
+                openvpn_io::post(io_context, [self = Ptr(this)]()
+                                 { self->drain_pending.exchange(false, std::memory_order_acq_rel);
+                                   self->drain(); });
+        }
+    }
+
+    // Return completed jobs to the parent in order.  Called on
+    // the session thread.
+    void drain()
+    {
+        drain_queue(encrypt_order);
+        drain_queue(decrypt_order);
+    }
+
+    void drain_queue(JobQueue &queue)
+    {
+        while (!halt && !queue.empty() && queue.front()->done.load(std::memory_order_acquire))
+        {
+            std::unique_ptr<Job> job = std::move(queue.front());
+            queue.pop_front();
+            parent->dc_pipeline_done(*job);
+            if (!halt)
+                free_jobs.push_back(std::move(job));
+        }
+    }
+
+    openvpn_io::io_context &io_context;
+    DataChannelPipelineParent *parent;
+    std::vector<std::thread> threads;
+
+    // shared with pipeline threads
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Job *> work;
+    bool stopping = false;
+    std::atomic<bool> drain_pending{false};
+
+    // session thread only
+    JobQueue encrypt_order;
+    JobQueue decrypt_order;
+    std::vector<std::unique_ptr<Job>> free_jobs;
+    bool halt = false;
+};
+
+} // namespace openvpn
+
+#endif
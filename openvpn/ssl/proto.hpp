@@ -32,6 +32,7 @@
 #include <cstdint>   // for std::uint32_t, etc.
 #include <memory>
 #include <optional>
+#include <vector>
 
 
 #include <openvpn/common/clamp_typerange.hpp>
@@ -367,7 +368,11 @@ class ProtoContext
         Time::Duration become_primary;   // KeyContext (that is ACTIVE) becomes primary at this time
         Time::Duration renegotiate;      // start SSL/TLS renegotiation at this time
         Time::Duration expire;           // KeyContext expires at this time
-        Time::Duration tls_timeout;      // Packet retransmit timeout on TLS control channel
+        Time::Duration tls_timeout;      // Initial packet retransmit timeout on TLS control channel
+
+        // max unacknowledged packets on TLS control channel, 0 for default
+        // (tls-send-window, config file only)
+        size_t tls_send_window = 0;
 
         // keepalive parameters
         Time::Duration keepalive_ping;          // ping xmit period
@@ -612,6 +617,14 @@ class ProtoContext
                 }
             }
 
+            // tls-send-window, max unacknowledged control channel packets,
+            // bounded by the number of IDs the peer acknowledges at once
+            {
+                const Option *o = opt.get_ptr("tls-send-window");
+                if (o)
+                    tls_send_window = o->get_num<size_t>(1, 1, ReliableAck::maximum_acks_ack_v1);
+            }
+
             // load parameters that can be present in both config file or pushed options
             load_common(opt, pco, server ? LOAD_COMMON_SERVER : LOAD_COMMON_CLIENT);
         }
@@ -1388,6 +1401,10 @@ class ProtoContext
         return out.str();
     }
 
+    // pipelined data channel packet, see data_encrypt_job()
+    struct DataJob;
+    typedef std::vector<CryptoDCWorker::Ptr> DataWorkerList;
+
   protected:
     // used for reading/writing authentication strings (username, password, etc.)
 
@@ -1682,7 +1699,8 @@ class ProtoContext
                    p.config->tls_timeout,
                    p.config->frame,
                    p.stats,
-                   psid_cookie_mode),
+                   psid_cookie_mode,
+                   p.config->tls_send_window),
               proto(p),
               state(STATE_UNDEF),
               crypto_flags(0),
@@ -1693,6 +1711,10 @@ class ProtoContext
             // reliable protocol?
             set_protocol(proto.config->protocol);
 
+            // run TLS handshake steps on another thread?
+            if (proto.tls_offload)
+                Base::set_tls_offload(proto.tls_offload);
+
             // get key_id from parent
             key_id_ = proto.next_key_id();
 
@@ -1872,6 +1894,280 @@ class ProtoContext
             }
         }
 
+        // data channel encrypt of n packets, with a single key state check
+        // and a single CryptoDCInstance call for the whole batch
+        void encrypt_batch(BufferAllocated *bufs, const size_t n)
+        {
+            if (state >= ACTIVE
+                && (crypto_flags & CryptoDCInstance::CRYPTO_DEFINED)
+                && !invalidated()
+                && is_safe_conversion<uint16_t>(proto.config->mss_fix))
+            {
+                // set MSS and compress, see do_encrypt()
+                size_t total = 0;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    BufferAllocated &buf = bufs[i];
+                    if (proto.config->mss_fix > 0)
+                        MSSFix::mssfix(buf, static_cast<uint16_t>(proto.config->mss_fix));
+                    if (compress)
+                        compress->compress(buf, true);
+                    total += buf.size();
+                }
+
+                // trigger renegotiation if we hit encrypt data limit
+                if (data_limit && !data_limit_add(DataLimit::Encrypt, total))
+                {
+                    for (size_t i = 0; i < n; ++i)
+                        bufs[i].reset_size();
+                    return;
+                }
+
+                bool pid_wrap;
+                if (enable_op32)
+                {
+                    const std::uint32_t op32 = htonl(op32_compose(DATA_V2, key_id_, remote_peer_id));
+                    pid_wrap = crypto->encrypt_batch(bufs, n, now->seconds_since_epoch(), (const unsigned char *)&op32);
+                    for (size_t i = 0; i < n; ++i)
+                        if (bufs[i].size())
+                            bufs[i].prepend((const unsigned char *)&op32, sizeof(op32));
+                }
+                else
+                {
+                    pid_wrap = crypto->encrypt_batch(bufs, n, now->seconds_since_epoch(), nullptr);
+                    const unsigned char op = op_compose(DATA_V1, key_id_);
+                    for (size_t i = 0; i < n; ++i)
+                        if (bufs[i].size())
+                            bufs[i].push_front(op);
+                }
+
+                // see encrypt() about packet ID wrapping
+                if (pid_wrap)
+                    schedule_key_limit_renegotiation();
+            }
+            else
+            {
+                for (size_t i = 0; i < n; ++i)
+                    bufs[i].reset_size(); // no crypto context available
+            }
+        }
+
+        // data channel decrypt of n packets, all of which must belong to
+        // this KeyContext
+        void decrypt_batch(BufferAllocated *bufs, const size_t n)
+        {
+            if (!(state >= ACTIVE
+                  && (crypto_flags & CryptoDCInstance::CRYPTO_DEFINED)
+                  && !invalidated()))
+            {
+                for (size_t i = 0; i < n; ++i)
+                    bufs[i].reset_size(); // no crypto context available
+                return;
+            }
+
+            batch_op32.resize(n);
+            batch_err.resize(n);
+            try
+            {
+                // Knock off leading op from each buffer, see decrypt()
+                bool any_op32 = false;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    BufferAllocated &buf = bufs[i];
+                    batch_op32[i] = nullptr;
+                    if (buf.size())
+                    {
+                        const size_t head_size = op_head_size(buf[0]);
+                        if (head_size == OP_SIZE_V2)
+                        {
+                            batch_op32[i] = buf.c_data();
+                            any_op32 = true;
+                        }
+                        buf.advance(head_size);
+                    }
+                }
+
+                crypto->decrypt_batch(bufs, n, now->seconds_since_epoch(), any_op32 ? batch_op32.data() : nullptr, batch_err.data());
+            }
+            catch (std::exception &)
+            {
+                proto.stats->error(Error::BUFFER_ERROR);
+                for (size_t i = 0; i < n; ++i)
+                    bufs[i].reset_size();
+                if (proto.is_tcp())
+                    invalidate(Error::BUFFER_ERROR);
+                return;
+            }
+
+            for (size_t i = 0; i < n; ++i)
+            {
+                BufferAllocated &buf = bufs[i];
+                try
+                {
+                    const Error::Type err = batch_err[i];
+                    if (err)
+                    {
+                        proto.stats->error(err);
+                        if (proto.is_tcp() && (err == Error::DECRYPT_ERROR || err == Error::HMAC_ERROR))
+                            invalidate(err);
+                    }
+
+                    // trigger renegotiation if we hit decrypt data limit
+                    if (data_limit)
+                        if (!data_limit_add(DataLimit::Decrypt, buf.size()))
+                            throw proto_option_error("Unable to add data limit");
+
+                    // decompress packet
+                    if (compress)
+                        compress->decompress(buf);
+
+                    // set MSS for segments server can receive
+                    if (proto.config->mss_fix > 0)
+                        MSSFix::mssfix(buf, numeric_cast<uint16_t>(proto.config->mss_fix));
+                }
+                catch (std::exception &)
+                {
+                    proto.stats->error(Error::BUFFER_ERROR);
+                    buf.reset_size();
+                    if (proto.is_tcp())
+                        invalidate(Error::BUFFER_ERROR);
+                }
+            }
+        }
+
+        // Pipelined data channel encrypt, serialized stage: set MSS,
+        // compress, and assign the packet ID, leaving the cipher
+        // operation to DataJob::process().  If the cipher doesn't
+        // support pipelining, the packet is fully encrypted here.
+        void encrypt_job(DataJob &job, const size_t n_workers)
+        {
+            if (state >= ACTIVE
+                && (crypto_flags & CryptoDCInstance::CRYPTO_DEFINED)
+                && !invalidated()
+                && is_safe_conversion<uint16_t>(proto.config->mss_fix))
+            {
+                const DataWorkerList *workers = pipeline_workers(n_workers);
+                if (!workers)
+                {
+                    encrypt(job.buf);
+                    return;
+                }
+
+                // set MSS and compress, see do_encrypt()
+                if (proto.config->mss_fix > 0)
+                    MSSFix::mssfix(job.buf, static_cast<uint16_t>(proto.config->mss_fix));
+                if (compress)
+                    compress->compress(job.buf, true);
+
+                // trigger renegotiation if we hit encrypt data limit
+                if (data_limit && !data_limit_add(DataLimit::Encrypt, job.buf.size()))
+                {
+                    job.buf.reset_size();
+                    return;
+                }
+
+                if (enable_op32)
+                {
+                    const std::uint32_t op32 = htonl(op32_compose(DATA_V2, key_id_, remote_peer_id));
+                    static_assert(sizeof(op32) == sizeof(job.cj.op32), "OP_SIZE_V2 inconsistency");
+                    std::memcpy(job.cj.op32, &op32, sizeof(op32));
+                    job.cj.flags |= CryptoDCJob::OP32_DEFINED;
+                }
+
+                // see encrypt() about packet ID wrapping
+                if (crypto->encrypt_assign(job.buf, job.cj, now->seconds_since_epoch()))
+                    schedule_key_limit_renegotiation();
+
+                job.workers = workers;
+                job.kc.reset(this);
+            }
+            else
+                job.buf.reset_size(); // no crypto context available
+        }
+
+        // Pipelined data channel encrypt, final stage: prepend op header
+        void encrypt_finish(DataJob &job)
+        {
+            if (job.cj.err)
+            {
+                proto.stats->error(job.cj.err);
+                job.buf.reset_size();
+            }
+            else if (job.cj.flags & CryptoDCJob::OP32_DEFINED)
+                job.buf.prepend(job.cj.op32, sizeof(job.cj.op32));
+            else
+                job.buf.push_front(op_compose(DATA_V1, key_id_));
+        }
+
+        // Pipelined data channel decrypt, serialized stage: knock off
+        // leading op from buffer, saving it for use as Additional Data
+        // by DataJob::process().  If the cipher doesn't support
+        // pipelining, the packet is fully decrypted here.
+        void decrypt_job(DataJob &job, const size_t n_workers)
+        {
+            if (state >= ACTIVE
+                && (crypto_flags & CryptoDCInstance::CRYPTO_DEFINED)
+                && !invalidated()
+                && job.buf.size())
+            {
+                const DataWorkerList *workers = pipeline_workers(n_workers);
+                if (!workers)
+                {
+                    decrypt(job.buf);
+                    return;
+                }
+
+                const size_t head_size = op_head_size(job.buf[0]);
+                if (head_size == OP_SIZE_V2)
+                {
+                    std::memcpy(job.cj.op32, job.buf.c_data(), OP_SIZE_V2);
+                    job.cj.flags |= CryptoDCJob::OP32_DEFINED;
+                }
+                job.buf.advance(head_size);
+
+                job.workers = workers;
+                job.kc.reset(this);
+            }
+            else
+                job.buf.reset_size(); // no crypto context available
+        }
+
+        // Pipelined data channel decrypt, final stage: replay check,
+        // decompress and set MSS, see decrypt()
+        void decrypt_finish(DataJob &job)
+        {
+            try
+            {
+                const Error::Type err = crypto->decrypt_verify(job.buf, job.cj, now->seconds_since_epoch());
+                if (err)
+                {
+                    proto.stats->error(err);
+                    if (proto.is_tcp() && (err == Error::DECRYPT_ERROR || err == Error::HMAC_ERROR))
+                        invalidate(err);
+                }
+
+                // trigger renegotiation if we hit decrypt data limit
+                if (data_limit)
+                    if (!data_limit_add(DataLimit::Decrypt, job.buf.size()))
+                        throw proto_option_error("Unable to add data limit");
+
+                // decompress packet
+                if (compress)
+                    compress->decompress(job.buf);
+
+                // set MSS for segments server can receive
+                if (proto.config->mss_fix > 0)
+                    MSSFix::mssfix(job.buf, numeric_cast<uint16_t>(proto.config->mss_fix));
+            }
+            catch (std::exception &)
+            {
+                proto.stats->error(Error::BUFFER_ERROR);
+                job.buf.reset_size();
+                if (proto.is_tcp())
+                    invalidate(Error::BUFFER_ERROR);
+            }
+        }
+
         // usually called by parent ProtoContext object when this KeyContext
         // has been retired.
         void prepare_expire(const EventType current_ev = KeyContext::KEV_NONE)
@@ -2423,6 +2719,34 @@ class ProtoContext
             return pid_wrap;
         }
 
+        // Return the per-thread workers used by pipelined encrypt/decrypt,
+        // created on first use, or nullptr if the cipher does not
+        // support pipelining.  The list is never modified once created,
+        // so that pipeline threads may index it while jobs are in flight.
+        const DataWorkerList *pipeline_workers(const size_t n)
+        {
+            if (!n || pipeline_unsupported)
+                return nullptr;
+            if (workers.empty())
+            {
+                DataWorkerList wl;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    CryptoDCWorker::Ptr w = crypto->new_worker();
+                    if (!w)
+                    {
+                        pipeline_unsupported = true;
+                        return nullptr;
+                    }
+                    wl.push_back(std::move(w));
+                }
+                workers = std::move(wl);
+            }
+            else if (workers.size() != n)
+                throw proto_error("pipeline thread count changed");
+            return &workers;
+        }
+
         // cache op32 and remote_peer_id
         void cache_op32()
         {
@@ -2457,6 +2781,12 @@ class ProtoContext
             next_event_time = next_time;
         }
 
+        void tls_offload_ready() // called by ProtoStackBase when an offloaded SSL read has completed
+        {
+            dirty = true;
+            proto.tls_offload_ready();
+        }
+
         void invalidate_callback() // called by ProtoStackBase when session is invalidated
         {
             reached_active_time_ = Time();
@@ -3025,7 +3355,7 @@ class ProtoContext
 
             // process ACKs sent by peer (if packet ID check failed,
             // read the ACK IDs, but don't modify the rel_send object).
-            if (ReliableAck::ack(rel_send, recv, pid_ok))
+            if (ReliableAck::ack(rel_send, recv, pid_ok, *now))
             {
                 // make sure that our own PSID is contained in packet received from peer
                 if (!verify_dest_psid(recv))
@@ -3180,7 +3510,7 @@ class ProtoContext
                 return false;
 
             // process ACKs sent by peer
-            if (ReliableAck::ack(rel_send, recv, true))
+            if (ReliableAck::ack(rel_send, recv, true, *now))
             {
                 // make sure that our own PSID is in packet received from peer
                 if (!verify_dest_psid(recv))
@@ -3413,11 +3743,73 @@ class ProtoContext
         std::unique_ptr<DataLimit> data_limit;
         BufferAllocated work;
 
+        // scratch space for decrypt_batch()
+        std::vector<const unsigned char *> batch_op32;
+        std::vector<Error::Type> batch_err;
+
+        // per-thread cipher workers for pipelined encrypt/decrypt
+        DataWorkerList workers;
+        bool pipeline_unsupported = false;
+
         // static member used by validate_tls_crypt()
         static BufferAllocated static_work;
     };
 
   public:
+    // A data channel packet passing through the pipelined
+    // encrypt/decrypt stages, see openvpn/ssl/dcpipeline.hpp.
+    struct DataJob
+    {
+        // Cipher stage, may be called on any thread, using the
+        // worker for pipeline thread index i.  A no-op for packets
+        // that were completely handled by the serialized stage.
+        void process(const size_t i) noexcept
+        {
+            if (!workers)
+                return;
+            try
+            {
+                CryptoDCWorker &w = *(*workers)[i];
+                if (encrypt)
+                    w.encrypt(buf, cj);
+                else
+                    w.decrypt(buf, cj);
+            }
+            catch (const std::exception &)
+            {
+                buf.reset_size();
+                cj.err = Error::BUFFER_ERROR;
+            }
+        }
+
+        // true if the cipher stage is pending
+        bool pipelined() const
+        {
+            return workers != nullptr;
+        }
+
+        // prepare for reuse
+        void reset(const bool encrypt_arg)
+        {
+            cj = CryptoDCJob();
+            workers = nullptr;
+            kc.reset();
+            encrypt = encrypt_arg;
+            start_ns = 0;
+        }
+
+        BufferAllocated buf;
+        CryptoDCJob cj;
+        bool encrypt = false;
+        std::uint64_t start_ns = 0; // DataPathStats timestamp, 0 if not sampled
+
+      private:
+        friend class ProtoContext;
+
+        const DataWorkerList *workers = nullptr; // undefined if not pipelined
+        KeyContext::Ptr kc;                  // only touched on session thread
+    };
+
     class PsidCookieHelper
     {
       public:
@@ -4048,6 +4440,125 @@ class ProtoContext
         return ret;
     }
 
+    // encrypt n data channel packets using primary KeyContext
+    void data_encrypt_batch(BufferAllocated *bufs, const size_t n)
+    {
+        if (!primary)
+            throw proto_error("data_encrypt_batch: no primary key");
+        primary->encrypt_batch(bufs, n);
+    }
+
+    // decrypt n data channel packets, selecting the primary or
+    // secondary KeyContext for each run of packets with the same
+    // key, so that a batch may straddle a key switch.  Runs that
+    // are not data channel packets for a live key are dropped and
+    // counted as KEY_STATE_ERROR rather than thrown, so the rest of
+    // the batch is still processed.  Keepalive packets are discarded.
+    // Returns true if at least one packet was successfully decrypted.
+    bool data_decrypt_batch(BufferAllocated *bufs, const size_t n)
+    {
+        bool ret = false;
+
+        size_t begin = 0;
+        while (begin < n)
+        {
+            const PacketType type = packet_type(bufs[begin]);
+            const unsigned int key = type.flags & (PacketType::DEFINED | PacketType::CONTROL | PacketType::SECONDARY);
+            size_t end = begin + 1;
+            while (end < n && (packet_type(bufs[end]).flags & (PacketType::DEFINED | PacketType::CONTROL | PacketType::SECONDARY)) == key)
+                ++end;
+
+            KeyContext *kc = nullptr;
+            if (type.is_data())
+                kc = (key & PacketType::SECONDARY) ? secondary.get() : primary.get();
+            if (kc)
+                kc->decrypt_batch(bufs + begin, end - begin);
+            else
+            {
+                stats->error(Error::KEY_STATE_ERROR);
+                for (size_t k = begin; k < end; ++k)
+                    bufs[k].reset_size();
+            }
+            begin = end;
+        }
+
+        for (size_t i = 0; i < n; ++i)
+        {
+            BufferAllocated &buf = bufs[i];
+            if (buf.size())
+                ret = true;
+
+            // discard keepalive packets
+            if (proto_context_private::is_keepalive(buf))
+                buf.reset_size();
+        }
+
+        // update time of most recent packet received
+        if (ret)
+            update_last_received();
+
+        return ret;
+    }
+
+    // Pipelined data channel.  The *_job and *_finish stages must be
+    // called on the session thread in packet order, while the cipher
+    // operation in between (DataJob::process) may run concurrently
+    // on pipeline threads.  Packet IDs are assigned and verified
+    // only in the serialized stages.
+
+    // encrypt stage 1 of 3, using primary KeyContext
+    void data_encrypt_job(DataJob &job, const size_t n_workers)
+    {
+        if (!primary)
+            throw proto_error("data_encrypt_job: no primary key");
+        job.reset(true);
+        primary->encrypt_job(job, n_workers);
+    }
+
+    // encrypt stage 3 of 3
+    void data_encrypt_finish(DataJob &job)
+    {
+        if (job.kc)
+        {
+            job.kc->encrypt_finish(job);
+            job.kc.reset();
+        }
+    }
+
+    // decrypt stage 1 of 3, see data_decrypt()
+    void data_decrypt_job(const PacketType &type, DataJob &job, const size_t n_workers)
+    {
+        job.reset(false);
+        select_key_context(type, false).decrypt_job(job, n_workers);
+    }
+
+    // decrypt stage 3 of 3, return value as in data_decrypt()
+    bool data_decrypt_finish(DataJob &job)
+    {
+        bool ret = false;
+
+        if (job.kc)
+        {
+            job.kc->decrypt_finish(job);
+            job.kc.reset();
+        }
+
+        // update time of most recent packet received
+        if (job.buf.size())
+        {
+            update_last_received();
+            ret = true;
+        }
+
+        // discard keepalive packets
+        if (proto_context_private::is_keepalive(job.buf))
+        {
+            job.buf.reset_size();
+        }
+
+        return ret;
+    }
+
     // enter disconnected state
     void disconnect(const Error::Type reason)
     {
@@ -4263,6 +4774,13 @@ class ProtoContext
         return *stats;
     }
 
+    // Run the CPU-heavy TLS handshake steps of key contexts created
+    // from now on as jobs on offload, rather than inline.
+    void set_tls_offload(const TLSOffload::Ptr &offload)
+    {
+        tls_offload = offload;
+    }
+
   protected:
     // debugging
     int primary_state() const
@@ -4319,6 +4837,15 @@ class ProtoContext
     {
     }
 
+    // Called when a TLS handshake step run on the offload object set
+    // by set_tls_offload() has completed.  Derived classes should do a
+    // full flush, handling exceptions as for control_net_recv(), and
+    // reschedule housekeeping.
+    virtual void tls_offload_ready()
+    {
+        flush(true);
+    }
+
     void update_last_received()
     {
         keepalive_expire = *now_ + (data_channel_ready() ? config->keepalive_timeout : config->keepalive_timeout_early);
@@ -4592,6 +5119,7 @@ class ProtoContext
 
     ProtoConfig::Ptr config;
     SessionStats::Ptr stats;
+    TLSOffload::Ptr tls_offload;
 
     size_t hmac_size;
     TLSWrapMode tls_wrap_mode;
@@ -22,7 +22,9 @@
 #ifndef OPENVPN_SSL_PROTOSTACK_H
 #define OPENVPN_SSL_PROTOSTACK_H
 
+#include <algorithm>
 #include <deque>
+#include <exception>
 #include <utility>
 
 #include <openvpn/common/exception.hpp>
@@ -38,6 +40,7 @@
 #include <openvpn/error/excode.hpp>
 #include <openvpn/ssl/sslconsts.hpp>
 #include <openvpn/ssl/sslapi.hpp>
+#include <openvpn/ssl/tlsoffload.hpp>
 
 // ProtoStackBase is designed to allow general-purpose protocols (including
 // but not limited to OpenVPN) to run over SSL, where the underlying transport
@@ -101,7 +104,8 @@ class ProtoStackBase
                    const Time::Duration &tls_timeout_arg, // packet retransmit timeout
                    const Frame::Ptr &frame,               // contains info on how to allocate and align buffers
                    const SessionStats::Ptr &stats_arg,    // error statistics
-                   bool psid_cookie_mode)                 // start the reliability layer at packet id 1, not 0
+                   bool psid_cookie_mode,                 // start the reliability layer at packet id 1, not 0
+                   size_t send_window = 0)                // max unacknowledged packets, 0 for ovpn_sending_window
 
         : tls_timeout(tls_timeout_arg),
           ssl_(ssl_factory.ssl()),
@@ -109,7 +113,7 @@ class ProtoStackBase
           stats(stats_arg),
           now(now_arg),
           rel_recv(ovpn_receiving_window, psid_cookie_mode ? 1 : 0),
-          rel_send(ovpn_sending_window, psid_cookie_mode ? 1 : 0)
+          rel_send(clamp_send_window(send_window), psid_cookie_mode ? 1 : 0)
     {
     }
 
@@ -124,6 +128,22 @@ class ProtoStackBase
         }
     }
 
+    // Run SSL reads, which drive the handshake, as jobs on offload
+    // rather than inline.  When a job completes, the parent's
+    // tls_offload_ready() method is called, which should then call
+    // flush() to deliver its results.
+    void set_tls_offload(const TLSOffload::Ptr &offload)
+    {
+        tls_offload_ = offload;
+    }
+
+    // True while the SSL object is in use by an offloaded job, or
+    // its results haven't been delivered by flush() yet.
+    bool ssl_offloaded() const
+    {
+        return ssl_busy_ || offload_ready_;
+    }
+
     uint32_t get_tls_warnings() const
     {
         return ssl_->get_tls_warnings();
@@ -163,6 +183,8 @@ class ProtoStackBase
     {
         if (!invalidated() && !up_stack_reentry_level)
         {
+            if (offload_ready_)
+                up_offloaded();
             down_stack_raw();
             down_stack_app();
             update_retransmit();
@@ -211,7 +233,7 @@ class ProtoStackBase
                         throw;
                     }
                     parent().net_send(pkt, NET_SEND_RETRANSMIT);
-                    m.reset_retransmit(*now, tls_timeout);
+                    rel_send.retransmitted(m, *now, tls_timeout);
                 }
             }
             update_retransmit();
@@ -316,6 +338,11 @@ class ProtoStackBase
     //
     // void invalidate_callback() {}
 
+    // called on the session thread when an SSL read offloaded by
+    // set_tls_offload() has completed, flush() delivers its results
+    //
+    // void tls_offload_ready() = 0;
+
     // END of parent methods
 
     // get reference to parent for CRTP
@@ -327,7 +354,7 @@ class ProtoStackBase
     // app data -> SSL -> protocol encapsulation -> reliability layer -> network
     void down_stack_app()
     {
-        if (ssl_started_)
+        if (ssl_started_ && !ssl_offloaded())
         {
             // push app-layer cleartext through SSL object
             while (!app_write_queue.empty())
@@ -438,8 +465,19 @@ class ProtoStackBase
                 parent().raw_recv(std::move(m.packet));
             else // SSL packet
             {
-                if (ssl_started_)
-                    ssl_->write_ciphertext(m.packet.buffer_ptr());
+                if (ssl_started_ && !ssl_offloaded())
+                {
+                    // an offloaded read drains the SSL input queue on a
+                    // worker thread, so it must not share the packet's
+                    // (thread-unsafe) buffer refcount with this thread
+                    if (tls_offload_)
+                    {
+                        const Buffer &buf = m.packet.buffer();
+                        ssl_->write_ciphertext_unbuffered(buf.c_data(), buf.size());
+                    }
+                    else
+                        ssl_->write_ciphertext(m.packet.buffer_ptr());
+                }
                 else
                     break;
             }
@@ -447,7 +485,12 @@ class ProtoStackBase
         }
 
         // read cleartext data from SSL object
-        if (ssl_started_)
+        if (ssl_started_ && tls_offload_)
+        {
+            if (!ssl_offloaded() && ssl_->read_cleartext_ready())
+                offload_read_cleartext();
+        }
+        else if (ssl_started_)
             while (ssl_->read_cleartext_ready())
             {
                 ssize_t size;
@@ -485,6 +528,124 @@ class ProtoStackBase
             }
     }
 
+    // Reads cleartext from the SSL object on a TLSOffload thread.
+    // The job holds a reference to the parent, so that the stack
+    // outlives it, but the results are dropped if the parent was
+    // released by everyone else in the meantime.
+    class SSLReadJob : public TLSOffload::Job
+    {
+      public:
+        SSLReadJob(ProtoStackBase &stack_arg)
+            : stack(stack_arg),
+              parent_ref(&stack_arg.parent()),
+              ssl(stack_arg.ssl_),
+              frame(stack_arg.frame_)
+        {
+        }
+
+        void process() override
+        {
+            try
+            {
+                while (ssl->read_cleartext_ready())
+                {
+                    BufferPtr buf(new BufferAllocated());
+                    frame->prepare(Frame::READ_SSL_CLEARTEXT, *buf);
+                    const ssize_t size = ssl->read_cleartext(buf->data(), buf->max_size());
+                    if (size < 0)
+                    {
+                        status = size;
+                        break;
+                    }
+                    buf->set_size(size);
+                    cleartext.push_back(std::move(buf));
+                }
+            }
+            catch (...)
+            {
+                eptr = std::current_exception();
+            }
+        }
+
+        void done() override
+        {
+            if (parent_ref->use_count() > 1)
+                stack.offload_done(*this);
+        }
+
+      private:
+        friend class ProtoStackBase;
+
+        ProtoStackBase &stack;
+        RCPtr<PARENT> parent_ref;
+        typename SSLAPI::Ptr ssl;
+        Frame::Ptr frame;
+
+        // results
+        std::deque<BufferPtr> cleartext;
+        ssize_t status = 0;
+        std::exception_ptr eptr;
+    };
+
+    void offload_read_cleartext()
+    {
+        ssl_busy_ = true;
+        tls_offload_->submit(std::unique_ptr<TLSOffload::Job>(new SSLReadJob(*this)));
+    }
+
+    void offload_done(SSLReadJob &job)
+    {
+        ssl_busy_ = false;
+        offload_ready_ = true;
+        offload_cleartext_ = std::move(job.cleartext);
+        offload_status_ = job.status;
+        offload_error_ = job.eptr;
+        if (!invalidated())
+            parent().tls_offload_ready();
+    }
+
+    // pass the results of an offloaded read up to the app, then
+    // move any packets received in the meantime up the stack
+    void up_offloaded()
+    {
+        UseCount use_count(up_stack_reentry_level);
+        offload_ready_ = false;
+        if (offload_error_)
+        {
+            // SSL fatal errors will invalidate the session
+            const std::exception_ptr eptr = offload_error_;
+            offload_error_ = nullptr;
+            error(Error::SSL_ERROR);
+            std::rethrow_exception(eptr);
+        }
+        while (!offload_cleartext_.empty())
+        {
+            BufferPtr buf = std::move(offload_cleartext_.front());
+            offload_cleartext_.pop_front();
+            parent().app_recv(std::move(buf));
+        }
+        if (offload_status_ == SSLConst::PEER_CLOSE_NOTIFY)
+        {
+            error(Error::SSL_ERROR);
+            throw ErrorCode(Error::CLIENT_HALT, true, "SSL Close Notify received");
+        }
+        else if (offload_status_ < 0 && offload_status_ != SSLConst::SHOULD_RETRY)
+        {
+            error(Error::SSL_ERROR);
+            throw unknown_status_from_ssl_layer();
+        }
+        up_sequenced();
+    }
+
+    // The peer drops packets beyond its receiving window, so
+    // there is no point in sending more than that.
+    static id_t clamp_send_window(const size_t send_window)
+    {
+        if (!send_window)
+            return ovpn_sending_window;
+        return static_cast<id_t>(std::min(send_window, ovpn_receiving_window));
+    }
+
     void update_retransmit()
     {
         next_retransmit_ = *now + rel_send.until_retransmit(*now);
@@ -512,6 +673,14 @@ class ProtoStackBase
     std::deque<PACKET> raw_write_queue;
     SessionStats::Ptr stats;
 
+    // SSL reads offloaded to another thread
+    TLSOffload::Ptr tls_offload_;
+    bool ssl_busy_ = false;
+    bool offload_ready_ = false;
+    std::deque<BufferPtr> offload_cleartext_;
+    ssize_t offload_status_ = 0;
+    std::exception_ptr offload_error_;
+
   protected:
     TimePtr now;
     ReliableRecv rel_recv;
@@ -0,0 +1,224 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Process-wide TLS session resumption cache.
+//
+// A single cache may be shared by the SSL contexts of every server
+// thread, so that a client which reconnects to a different thread
+// can still resume its previous session.  Sessions are stored in
+// their serialized (DER or mbed TLS save) form, keyed by session ID.
+//
+// The cache is split into shards, each with its own lock and LRU
+// list, so that threads handling different sessions rarely contend.
+// Total memory is bounded by the entry capacity given at construction;
+// inserting into a full shard evicts its least recently used entry.
+
+#ifndef OPENVPN_SSL_SESSCACHE_H
+#define OPENVPN_SSL_SESSCACHE_H
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <cstdint>
+#include <functional>
+
+#include <openvpn/common/rc.hpp>
+#include <openvpn/time/time.hpp>
+
+namespace openvpn {
+
+class TLSSessionCache : public RC<thread_safe_refcount>
+{
+  public:
+    typedef RCPtr<TLSSessionCache> Ptr;
+
+    struct Stats
+    {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t inserts = 0;
+        std::uint64_t evictions = 0;
+        std::uint64_t expirations = 0;
+    };
+
+    // capacity is the maximum number of cached sessions across all shards.
+    // lifetime is how long (in seconds) a session remains resumable.
+    TLSSessionCache(const size_t capacity,
+                    const unsigned int lifetime = 3600,
+                    const unsigned int n_shards = 16,
+                    std::string id_context_arg = "OpenVPN")
+        : shards(n_shards ? n_shards : 1),
+          shard_capacity(capacity / shards.size() + (capacity % shards.size() ? 1 : 0)),
+          session_lifetime(Time::Duration::seconds(lifetime)),
+          id_context(std::move(id_context_arg))
+    {
+        if (!shard_capacity)
+            shard_capacity = 1;
+    }
+
+    // Identifies sessions created for this cache, so that a session
+    // cached by an unrelated SSL context is never resumed.
+    const std::string &session_id_context() const
+    {
+        return id_context;
+    }
+
+    unsigned int lifetime_seconds() const
+    {
+        return static_cast<unsigned int>(session_lifetime.to_seconds());
+    }
+
+    // Add or replace the serialized session for key.
+    void insert(const std::string &key, std::string session)
+    {
+        if (key.empty() || session.empty())
+            return;
+        const Time expire = Time::now() + session_lifetime;
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto i = s.index.find(key);
+        if (i != s.index.end())
+        {
+            i->second->session = std::move(session);
+            i->second->expire = expire;
+            s.lru.splice(s.lru.begin(), s.lru, i->second);
+        }
+        else
+        {
+            if (s.index.size() >= shard_capacity)
+            {
+                s.index.erase(s.lru.back().key);
+                s.lru.pop_back();
+                ++evictions;
+            }
+            s.lru.push_front(Entry{key, std::move(session), expire});
+            s.index.emplace(key, s.lru.begin());
+        }
+        ++inserts;
+    }
+
+    // Copy the serialized session for key into session.
+    // Returns false on a miss or if the cached session has expired.
+    bool lookup(const std::string &key, std::string &session)
+    {
+        Shard &s = shard(key);
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            auto i = s.index.find(key);
+            if (i != s.index.end())
+            {
+                if (Time::now() < i->second->expire)
+                {
+                    s.lru.splice(s.lru.begin(), s.lru, i->second);
+                    session = i->second->session;
+                    ++hits;
+                    return true;
+                }
+                s.lru.erase(i->second);
+                s.index.erase(i);
+                ++expirations;
+            }
+        }
+        ++misses;
+        return false;
+    }
+
+    void erase(const std::string &key)
+    {
+        Shard &s = shard(key);
+        std::lock_guard<std::mutex> lock(s.mutex);
+        auto i = s.index.find(key);
+        if (i != s.index.end())
+        {
+            s.lru.erase(i->second);
+            s.index.erase(i);
+        }
+    }
+
+    size_t size() const
+    {
+        size_t ret = 0;
+        for (const auto &s : shards)
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            ret += s.index.size();
+        }
+        return ret;
+    }
+
+    size_t capacity() const
+    {
+        return shard_capacity * shards.size();
+    }
+
+    Stats stats() const
+    {
+        Stats ret;
+        ret.hits = hits;
+        ret.misses = misses;
+        ret.inserts = inserts;
+        ret.evictions = evictions;
+        ret.expirations = expirations;
+        return ret;
+    }
+
+  private:
+    struct Entry
+    {
+        std::string key;
+        std::string session;
+        Time expire;
+    };
+
+    typedef std::list<Entry> LRU;
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        LRU lru; // most recently used first
+        std::unordered_map<std::string, LRU::iterator> index;
+    };
+
+    Shard &shard(const std::string &key)
+    {
+        return shards[std::hash<std::string>()(key) % shards.size()];
+    }
+
+    std::vector<Shard> shards;
+    size_t shard_capacity;
+    const Time::Duration session_lifetime;
+    const std::string id_context;
+
+    std::atomic<std::uint64_t> hits{0};
+    std::atomic<std::uint64_t> misses{0};
+    std::atomic<std::uint64_t> inserts{0};
+    std::atomic<std::uint64_t> evictions{0};
+    std::atomic<std::uint64_t> expirations{0};
+};
+
+} // namespace openvpn
+
+#endif
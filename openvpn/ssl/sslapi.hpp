@@ -45,6 +45,7 @@
 #include <openvpn/ssl/tls_remote.hpp>
 #include <openvpn/ssl/tls_cert_profile.hpp>
 #include <openvpn/ssl/sess_ticket.hpp>
+#include <openvpn/ssl/sesscache.hpp>
 #include <openvpn/random/randapi.hpp>
 
 namespace openvpn {
@@ -149,6 +150,7 @@ class SSLConfigAPI : public RC<thread_unsafe_refcount>
     virtual const Mode &get_mode() const = 0;
     virtual void set_external_pki_callback(ExternalPKIBase *external_pki_arg) = 0;             // private key alternative
     virtual void set_session_ticket_handler(TLSSessionTicketBase *session_ticket_handler) = 0; // server side
+    virtual void set_session_cache(const TLSSessionCache::Ptr &session_cache) = 0;             // server side, may be shared across threads
     virtual void set_client_session_tickets(const bool v) = 0;                                 // client side
     virtual void enable_legacy_algorithms(const bool v) = 0;                                   // loads legacy+default provider in OpenSSL 3
     virtual void set_sni_handler(SNI::HandlerBase *sni_handler) = 0;                           // server side
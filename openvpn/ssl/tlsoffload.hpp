@@ -0,0 +1,64 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Interface for running the CPU-heavy steps of a TLS handshake, such
+// as signing and certificate chain verification, off the thread that
+// runs the session.
+//
+// A Job is passed to submit() on the session thread.  Its process()
+// method then runs on another thread, after which done() is called
+// back on the session thread.  The job holds everything process()
+// touches, and the session leaves those objects alone until done()
+// has been called.  See TLSHandshakePool for an implementation.
+
+#ifndef OPENVPN_SSL_TLSOFFLOAD_H
+#define OPENVPN_SSL_TLSOFFLOAD_H
+
+#include <memory>
+
+#include <openvpn/common/rc.hpp>
+
+namespace openvpn {
+
+class TLSOffload : public RC<thread_unsafe_refcount>
+{
+  public:
+    typedef RCPtr<TLSOffload> Ptr;
+
+    struct Job
+    {
+        virtual ~Job() = default;
+
+        // called on a worker thread
+        virtual void process() = 0;
+
+        // called on the session thread after process() has returned
+        virtual void done() = 0;
+    };
+
+    // Called on the session thread.  If the offload object is
+    // stopped, the job may be destroyed without being run.
+    virtual void submit(std::unique_ptr<Job> job) = 0;
+};
+
+} // namespace openvpn
+
+#endif
@@ -0,0 +1,189 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Worker thread pool for TLSOffload jobs.
+//
+// One pool is shared by all sessions of a server.  Each session gets
+// its own TLSOffload object from offload(), bound to the io_context
+// that runs the session, so that completed jobs are posted back to
+// the right thread.  Jobs run in the order they were submitted, on
+// whichever worker thread is free.
+//
+// Handshakes of different sessions therefore run concurrently, and
+// so do the SSL library callbacks they trigger.  Callbacks may only
+// touch state shared between sessions if it is read-only or guarded:
+// the OpenSSL context serializes calls into the session ticket and
+// SNI handlers, TLSSessionCache is internally locked, and the verify
+// callbacks only read the shared config and write to the session's
+// own AuthCert.  An ExternalPKIBase used by a server with a pool must
+// be thread-safe.  Worker threads log to the log context of the
+// thread that created the pool, which must be thread-safe as well.
+
+#ifndef OPENVPN_SSL_TLSPOOL_H
+#define OPENVPN_SSL_TLSPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <openvpn/io/io.hpp>
+#include <openvpn/common/rc.hpp>
+#include <openvpn/ssl/tlsoffload.hpp>
+
+namespace openvpn {
+
+class TLSHandshakePool : public RC<thread_safe_refcount>
+{
+  public:
+    typedef RCPtr<TLSHandshakePool> Ptr;
+
+    // Must be called on a thread with the log context that worker
+    // threads should use.
+    explicit TLSHandshakePool(const unsigned int n_threads)
+    {
+        for (unsigned int i = 0; i < n_threads; ++i)
+            threads.emplace_back([this]()
+                                 { thread_func(); });
+    }
+
+    ~TLSHandshakePool()
+    {
+        stop();
+    }
+
+    // Return an offload object for sessions running on io_context
+    TLSOffload::Ptr offload(openvpn_io::io_context &io_context)
+    {
+        return new Offload(this, io_context);
+    }
+
+    size_t n_threads() const
+    {
+        return threads.size();
+    }
+
+    // number of jobs waiting for a worker thread
+    size_t queued()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return work.size();
+    }
+
+    // Stop and join worker threads, discarding queued jobs.  Should
+    // be called after the io_context objects of the sessions have
+    // been stopped, so that discarded jobs are destroyed on the
+    // calling thread rather than concurrently with their session.
+    void stop()
+    {
+        std::deque<Work> discard;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+                return;
+            stopping = true;
+            discard.swap(work);
+        }
+        cond.notify_all();
+        for (auto &t : threads)
+        {
+            if (t.joinable())
+                t.join();
+        }
+    }
+
+  private:
+    struct Work
+    {
+        openvpn_io::io_context *io_context;
+        std::unique_ptr<TLSOffload::Job> job;
+    };
+
+    class Offload : public TLSOffload
+    {
+      public:
+        Offload(TLSHandshakePool *pool_arg, openvpn_io::io_context &io_context_arg)
+            : pool(pool_arg),
+              io_context(io_context_arg)
+        {
+        }
+
+        void submit(std::unique_ptr<Job> job) override
+        {
+            pool->queue(io_context, std::move(job));
+        }
+
+      private:
+        TLSHandshakePool::Ptr pool;
+        openvpn_io::io_context &io_context;
+    };
+
+    void queue(openvpn_io::io_context &io_context, std::unique_ptr<TLSOffload::Job> job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (stopping)
+                return;
+            work.push_back(Work{&io_context, std::move(job)});
+        }
+        cond.notify_one();
+    }
+
+    void thread_func()
+    {
+        Log::Context log_context(log_wrap);
+        while (true)
+        {
+            Work w;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this]()
+                          { return stopping || !work.empty(); });
+                if (stopping)
+                    return;
+                w = std::move(work.front());
+                work.pop_front();
+            }
+            w.job->process();
+
+            // the job must be released on the session thread, so move
+            // the only reference into the handler
+            std::shared_ptr<TLSOffload::Job> job(std::move(w.job));
+            openvpn_io::post(*w.io_context, [job = std::move(job)]()
+                             { job->done(); });
+        }
+    }
+
+    Log::Context::Wrapper log_wrap; // must be constructed before threads start
+    std::vector<std::thread> threads;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Work> work;
+    bool stopping = false;
+};
+
+} // namespace openvpn
+
+#endif
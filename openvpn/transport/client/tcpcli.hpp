@@ -46,6 +46,7 @@ class ClientConfig : public TransportClientFactory
 
     RemoteList::Ptr remote_list;
     size_t free_list_max_size;
+    size_t read_size; // bytes per socket read, 0 to read one packet at a time
     Frame::Ptr frame;
     SessionStats::Ptr stats;
 
@@ -76,6 +77,7 @@ class ClientConfig : public TransportClientFactory
   private:
     ClientConfig()
         : free_list_max_size(8),
+          read_size(65536),
           socket_protect(nullptr)
     {
     }
@@ -364,12 +366,17 @@ class Client : public TransportClient, AsyncResolvableTCP
                 }
                 else
 #endif
-                    impl.reset(new LinkImpl(this,
-                                            socket,
-                                            0, // send_queue_max_size is unlimited because we regulate size in cliproto.hpp
-                                            config->free_list_max_size,
-                                            (*config->frame)[Frame::READ_LINK_TCP],
-                                            config->stats));
+                {
+                    LinkImpl::Ptr link(new LinkImpl(this,
+                                                    socket,
+                                                    0, // send_queue_max_size is unlimited because we regulate size in cliproto.hpp
+                                                    config->free_list_max_size,
+                                                    (*config->frame)[Frame::READ_LINK_TCP],
+                                                    config->stats));
+                    if (parent->transport_is_openvpn_protocol())
+                        link->set_read_size(config->read_size);
+                    impl = link;
+                }
 
 #ifdef OPENVPN_GREMLIN
                 impl->gremlin_config(config->gremlin_config);
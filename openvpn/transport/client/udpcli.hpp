@@ -48,6 +48,8 @@ class ClientConfig : public TransportClientFactory
     bool server_addr_float;
     bool synchronous_dns_lookup;
     int n_parallel;
+    unsigned int batch_size; // 0 disables batched recvmmsg/sendmmsg I/O (Linux only)
+    bool gso;                // use UDP GSO/GRO segmentation offload, requires batch_size
     Frame::Ptr frame;
     SessionStats::Ptr stats;
 
@@ -75,6 +77,8 @@ class ClientConfig : public TransportClientFactory
         : server_addr_float(false),
           synchronous_dns_lookup(false),
           n_parallel(8),
+          batch_size(0),
+          gso(false),
           socket_protect(nullptr)
     {
     }
@@ -241,6 +245,12 @@ class Client : public TransportClient, AsyncResolvableUDP
             config->stats->error(Error::BAD_SRC_ADDR);
     }
 
+    void udp_read_batch_handler(PacketFrom::Batch &batch, const size_t n) // called by LinkImpl
+    {
+        for (size_t i = 0; i < n && !halt; ++i)
+            udp_read_handler(batch[i]);
+    }
+
     void stop_()
     {
         if (!halt)
@@ -316,6 +326,8 @@ class Client : public TransportClient, AsyncResolvableUDP
 #ifdef OPENVPN_GREMLIN
                 impl->gremlin_config(config->gremlin_config);
 #endif
+                impl->set_batch_size(config->batch_size);
+                impl->set_gso(config->gso);
                 impl->start(config->n_parallel);
                 parent->transport_connecting();
             }
@@ -21,12 +21,15 @@
 
 #pragma once
 
+#include <cstring>
+
 #include <openvpn/common/numeric_util.hpp>
 #include <openvpn/buffer/buffer.hpp>
 #include <openvpn/ip/ipcommon.hpp>
 #include <openvpn/ip/ip4.hpp>
 #include <openvpn/ip/ip6.hpp>
 #include <openvpn/ip/tcp.hpp>
+#include <openvpn/ip/csum.hpp>
 
 #if OPENVPN_DEBUG_PROTO >= 2
 #define OPENVPN_LOG_MSSFIX(x) OPENVPN_LOG(x)
@@ -141,11 +144,21 @@ class MSSFix
                         if (mssval > max_mss)
                         {
                             OPENVPN_LOG_MSSFIX("MTU MSS " << mssval << " -> " << max_mss);
-                            int accumulate = htons(mssval);
+                            std::uint16_t old_word, new_word;
+                            std::memcpy(&old_word, opt + 2, sizeof(old_word));
                             opt[2] = static_cast<uint8_t>((max_mss >> 8) & 0xff);
                             opt[3] = static_cast<uint8_t>(max_mss & 0xff);
-                            accumulate -= htons(max_mss);
-                            tcp_adjust_checksum(accumulate, tcphdr->check);
+                            std::memcpy(&new_word, opt + 2, sizeof(new_word));
+
+                            // after odd NOP padding the MSS value straddles two
+                            // 16-bit words of the checksum, which is the same as
+                            // summing it byte-swapped
+                            if ((opt + 2 - (uint8_t *)tcphdr) & 1)
+                            {
+                                old_word = static_cast<std::uint16_t>((old_word << 8) | (old_word >> 8));
+                                new_word = static_cast<std::uint16_t>((new_word << 8) | (new_word >> 8));
+                            }
+                            tcphdr->check = IPChecksum::update16(tcphdr->check, old_word, new_word);
                         }
                     }
                     else
@@ -23,6 +23,7 @@
 
 #include <algorithm> // for std::min
 #include <cstdint>   // for std::uint16_t, etc.
+#include <cstring>   // for std::memcpy
 #include <limits>
 
 #include <openvpn/common/exception.hpp>
@@ -109,6 +110,63 @@ class PacketStream
         }
     }
 
+    // Zero-copy variant of put()/get() for large stream reads.  Calls
+    // func(Buffer &pkt) for each complete packet in buf, where pkt
+    // refers to the packet data in place, without copying it.  Only a
+    // packet left incomplete at the end of buf is copied, to be
+    // completed by the next call, so buf may be reused for the next
+    // read on return.  A packet completed this way is passed to func
+    // from the internal buffer.  Don't mix with put()/get().
+    template <typename FUNC>
+    void put_frames(BufferAllocated &buf, const Frame::Context &frame_context, FUNC func)
+    {
+        // finish a packet carried over from the previous read
+        if (declared_size_defined() || buffer.defined())
+        {
+            put(buf, frame_context);
+            if (!ready())
+                return;
+            func(static_cast<Buffer &>(buffer));
+            buffer.reset_content();
+            declared_size = SIZE_UNDEF;
+        }
+
+        while (size_defined(buf))
+        {
+            SIZE_TYPE net_len;
+            std::memcpy(&net_len, buf.c_data(), sizeof(net_len));
+            const size_t size = network_to_host(net_len);
+            validate_size(size, frame_context);
+            if (buf.size() < sizeof(net_len) + size)
+                break;
+            Buffer pkt(buf.data() + sizeof(net_len), size, true);
+            buf.advance(sizeof(net_len) + size);
+            func(pkt);
+        }
+
+        // carry over the trailing partial packet
+        if (buf.size())
+        {
+            frame_context.prepare(buffer);
+            if (size_defined(buf))
+                extract_size(buf, frame_context);
+            buffer.write(buf.c_data(), buf.size());
+            buf.reset_content();
+        }
+    }
+
+    // returns true if buf holds exactly one complete packet and no
+    // packet is pending, in which case put() takes ownership of buf
+    // and get() returns it without a copy
+    bool single_packet(const Buffer &buf) const
+    {
+        if (declared_size_defined() || buffer.defined() || !size_defined(buf))
+            return false;
+        SIZE_TYPE net_len;
+        std::memcpy(&net_len, buf.c_data(), sizeof(net_len));
+        return buf.size() == sizeof(net_len) + network_to_host(net_len);
+    }
+
     // returns true if get() may be called to return fully formed packet
     bool ready() const
     {
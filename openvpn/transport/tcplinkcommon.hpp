@@ -6,6 +6,7 @@
 #define OPENVPN_TRANSPORT_COMMONLINK_H
 
 #include <deque>
+#include <vector>
 #include <utility> // for std::move
 #include <memory>
 
@@ -47,6 +48,34 @@ class LinkCommon : public LinkBase
 {
     typedef std::deque<BufferPtr> Queue;
 
+    // asio hands at most 64 buffers (and never more than IOV_MAX) to
+    // one gather write, so there is no point in passing more.
+    enum
+    {
+        SEND_IOV_MAX = 64,
+    };
+
+    // Non-owning view of send_iov, so that the buffer sequence asio
+    // copies into each send operation is just two pointers.
+    struct SendIOV
+    {
+        typedef openvpn_io::const_buffer value_type;
+        typedef const openvpn_io::const_buffer *const_iterator;
+
+        const_iterator begin() const
+        {
+            return begin_;
+        }
+
+        const_iterator end() const
+        {
+            return end_;
+        }
+
+        const_iterator begin_;
+        const_iterator end_;
+    };
+
   public:
     typedef RCPtr<LinkCommon<Protocol, ReadHandler, RAW_MODE_ONLY>> Ptr;
     typedef Protocol protocol;
@@ -118,6 +147,18 @@ class LinkCommon : public LinkBase
 #endif
     }
 
+    // In non-raw mode, read up to read_size bytes from the socket at a
+    // time rather than one packet's worth, and extract all complete
+    // packets from each read in place.  Must be called before start(),
+    // 0 to disable.
+    void set_read_size(const size_t read_size)
+    {
+        if (read_size)
+            read_context = Frame::Context(0, read_size, 0, 0, sizeof(size_t), 0);
+        else
+            read_context = Frame::Context();
+    }
+
     void reset_align_adjust(const size_t align_adjust)
     {
         frame_context.reset_align_adjust(align_adjust + (is_raw_mode() ? 0 : 2));
@@ -183,9 +224,10 @@ class LinkCommon : public LinkBase
         OPENVPN_LOG_TCPLINK_VERBOSE("TLSLink::queue_recv");
         if (!tcpfrom)
             tcpfrom = new PacketFrom();
-        frame_context.prepare(tcpfrom->buf);
+        const Frame::Context &fc = read_context.payload() && !is_raw_mode_read() ? read_context : frame_context;
+        fc.prepare(tcpfrom->buf);
 
-        socket.async_receive(frame_context.mutable_buffer_clamp(tcpfrom->buf),
+        socket.async_receive(fc.mutable_buffer_clamp(tcpfrom->buf),
                              [self = Ptr(this), tcpfrom = PacketFrom::SPtr(tcpfrom)](const openvpn_io::error_code &error, const size_t bytes_recvd) mutable
                              {
             OPENVPN_ASYNC_HANDLER;
@@ -270,14 +312,24 @@ class LinkCommon : public LinkBase
     void queue_send_buffer(BufferPtr &buf)
     {
         queue.push_back(std::move(buf));
+        if (DataPathStats *dps = stats->datapath_stats())
+            dps->record(DataPathStats::TCP_SEND_QUEUE, queue.size());
         if (queue.size() == 1) // send operation not currently active?
             queue_send();
     }
 
+    // Gather as many queued buffers as asio will pass to a single
+    // sendmsg()/WSASend() into one write.
     void queue_send()
     {
-        BufferAllocated &buf = *queue.front();
-        socket.async_send(buf.const_buffer_clamp(),
+        send_iov.clear();
+        for (const auto &buf : queue)
+        {
+            send_iov.push_back(buf->const_buffer_clamp());
+            if (send_iov.size() == SEND_IOV_MAX)
+                break;
+        }
+        socket.async_send(SendIOV{send_iov.data(), send_iov.data() + send_iov.size()},
                           [self = Ptr(this)](const openvpn_io::error_code &error, const size_t bytes_sent)
                           {
             OPENVPN_ASYNC_HANDLER;
@@ -293,26 +345,34 @@ class LinkCommon : public LinkBase
             {
                 OPENVPN_LOG_TCPLINK_VERBOSE("TLS-TCP send raw=" << raw_mode_write << " size=" << bytes_sent);
                 stats->inc_stat(SessionStats::BYTES_OUT, bytes_sent);
-                stats->inc_stat(SessionStats::PACKETS_OUT, 1);
 
-                BufferPtr buf = queue.front();
-                if (bytes_sent == buf->size())
+                // retire the buffers that were sent in full, the write
+                // may have ended part way through the last one
+                size_t remaining = bytes_sent;
+                size_t packets = 0;
+                while (!queue.empty() && remaining >= queue.front()->size())
                 {
+                    BufferPtr buf = std::move(queue.front());
                     queue.pop_front();
+                    remaining -= buf->size();
+                    ++packets;
                     if (free_list.size() < free_list_max_size)
                     {
                         buf->reset_content();
                         free_list.push_back(std::move(buf)); // recycle the buffer for later use
                     }
                 }
-                else if (bytes_sent < buf->size())
-                    buf->advance(bytes_sent);
-                else
+                stats->inc_stat(SessionStats::PACKETS_OUT, packets);
+                if (remaining)
                 {
-                    stats->error(Error::TCP_OVERFLOW);
-                    read_handler->tcp_error_handler("TCP_INTERNAL_ERROR"); // error sent more bytes than we asked for
-                    stop();
-                    return;
+                    if (queue.empty())
+                    {
+                        stats->error(Error::TCP_OVERFLOW);
+                        read_handler->tcp_error_handler("TCP_INTERNAL_ERROR"); // error sent more bytes than we asked for
+                        stop();
+                        return;
+                    }
+                    queue.front()->advance(remaining);
                 }
             }
             else
@@ -405,23 +465,43 @@ class LinkCommon : public LinkBase
         stats->inc_stat(SessionStats::PACKETS_IN, 1);
         if (mutate)
             mutate->post_recv(buf);
+        if (read_context.payload() && !pktstream.single_packet(buf))
+        {
+            // packets are parsed in place, but the read handler takes
+            // ownership of the buffer it is given, so each one is
+            // copied once here.  A read holding exactly one packet,
+            // the common case at low rates, goes through put()/get()
+            // below, which swap buffers instead.
+            pktstream.put_frames(buf,
+                                 frame_context,
+                                 [&](const Buffer &frame)
+                                 {
+                frame_context.prepare(pkt);
+                pkt.write(frame.c_data(), frame.size());
+                requeue = recv_packet(pkt); });
+            return requeue;
+        }
         while (buf.size())
         {
             pktstream.put(buf, frame_context);
             if (pktstream.ready())
             {
                 pktstream.get(pkt);
-#ifdef OPENVPN_GREMLIN
-                if (gremlin)
-                    requeue = gremlin_recv(pkt);
-                else
-#endif
-                    requeue = read_handler->tcp_read_handler(pkt);
+                requeue = recv_packet(pkt);
             }
         }
         return requeue;
     }
 
+    bool recv_packet(BufferAllocated &pkt)
+    {
+#ifdef OPENVPN_GREMLIN
+        if (gremlin)
+            return gremlin_recv(pkt);
+#endif
+        return read_handler->tcp_read_handler(pkt);
+    }
+
 #ifdef OPENVPN_GREMLIN
     void gremlin_queue_send_buffer(BufferPtr &buf)
     {
@@ -455,11 +535,13 @@ class LinkCommon : public LinkBase
     typename Protocol::socket &socket;
     ReadHandler read_handler;
     Frame::Context frame_context;
+    Frame::Context read_context; // socket reads, if set_read_size() was used
     SessionStats::Ptr stats;
     const size_t send_queue_max_size;
     const size_t free_list_max_size;
     Queue queue;     // send queue
     Queue free_list; // recycled free buffers for send queue
+    std::vector<openvpn_io::const_buffer> send_iov; // gather list for queue_send()
     OpenVPNPacketStream pktstream;
     TransportMutateStream::Ptr mutate;
     bool raw_mode_read;
@@ -0,0 +1,178 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Linux UDP segmentation offload helpers.
+//
+// With UDP_SEGMENT (GSO), a series of equally sized datagrams
+// (only the last one may be shorter) is passed to the kernel as
+// one "super-datagram" and split into individual datagrams as
+// late as possible, often by the NIC.  With UDP_GRO, the kernel
+// may coalesce received datagrams of the same flow into one
+// super-datagram, and reports the segment size in a control
+// message so that it can be split again by the receiver.
+
+#ifndef OPENVPN_TRANSPORT_UDPGSO_H
+#define OPENVPN_TRANSPORT_UDPGSO_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+
+#include <openvpn/common/size.hpp>
+
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+namespace openvpn {
+namespace UDPTransport {
+namespace GSO {
+
+enum
+{
+    MAX_SEGMENTS = 64,    // UDP_MAX_SEGMENTS in the kernel
+    MAX_DATAGRAM = 65507, // largest UDP payload over IPv4
+};
+
+// Ancillary data buffer large enough for a UDP_SEGMENT or UDP_GRO
+// control message.
+struct ControlBuf
+{
+    alignas(struct cmsghdr) unsigned char buf[CMSG_SPACE(sizeof(int))];
+};
+
+// Returns true if the kernel accepts UDP_SEGMENT on this socket.
+inline bool gso_supported(const int fd)
+{
+    const int gso_size = 0;
+    return ::setsockopt(fd, SOL_UDP, UDP_SEGMENT, &gso_size, sizeof(gso_size)) == 0;
+}
+
+// Ask the kernel to deliver coalesced super-datagrams on this
+// socket.  Returns false if UDP_GRO is not supported.
+inline bool enable_gro(const int fd)
+{
+    const int on = 1;
+    return ::setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) == 0;
+}
+
+// Total number of bytes described by an iovec array.
+inline size_t iov_size(const struct iovec *iov, const size_t n)
+{
+    size_t ret = 0;
+    for (size_t i = 0; i < n; ++i)
+        ret += iov[i].iov_len;
+    return ret;
+}
+
+// Given n queued datagrams described by iov, return how many of
+// them, starting with iov[0], can be sent as one GSO
+// super-datagram: all segments must have the size of the first
+// one, except for the last which may be shorter.  Always returns
+// at least 1 when n > 0.
+inline size_t segment_run(const struct iovec *iov, const size_t n)
+{
+    if (!n)
+        return 0;
+    const size_t seg_size = iov[0].iov_len;
+    size_t total = seg_size;
+    size_t i = 1;
+    while (i < n && i < MAX_SEGMENTS)
+    {
+        const size_t len = iov[i].iov_len;
+        if (len > seg_size || total + len > MAX_DATAGRAM)
+            break;
+        total += len;
+        ++i;
+        if (len < seg_size)
+            break; // a short segment terminates the run
+    }
+    return i;
+}
+
+// Attach a UDP_SEGMENT control message to mh, using cbuf as storage.
+inline void set_segment_size(struct msghdr &mh, ControlBuf &cbuf, const std::uint16_t seg_size)
+{
+    std::memset(cbuf.buf, 0, sizeof(cbuf.buf));
+    mh.msg_control = cbuf.buf;
+    mh.msg_controllen = CMSG_SPACE(sizeof(std::uint16_t));
+    struct cmsghdr *cm = CMSG_FIRSTHDR(&mh);
+    cm->cmsg_level = SOL_UDP;
+    cm->cmsg_type = UDP_SEGMENT;
+    cm->cmsg_len = CMSG_LEN(sizeof(std::uint16_t));
+    std::memcpy(CMSG_DATA(cm), &seg_size, sizeof(seg_size));
+}
+
+// Prepare mh to receive a UDP_GRO control message into cbuf.
+inline void prepare_gro(struct msghdr &mh, ControlBuf &cbuf)
+{
+    mh.msg_control = cbuf.buf;
+    mh.msg_controllen = sizeof(cbuf.buf);
+}
+
+// Return the segment size reported by UDP_GRO for a received
+// message, or 0 if the datagram was not coalesced.
+inline size_t gro_segment_size(struct msghdr &mh)
+{
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&mh); cm != nullptr; cm = CMSG_NXTHDR(&mh, cm))
+    {
+        if (cm->cmsg_level == SOL_UDP && cm->cmsg_type == UDP_GRO)
+        {
+            int seg_size = 0;
+            std::memcpy(&seg_size, CMSG_DATA(cm), sizeof(seg_size));
+            return seg_size > 0 ? static_cast<size_t>(seg_size) : 0;
+        }
+    }
+    return 0;
+}
+
+// Split a received super-datagram into segments of seg_size bytes
+// (the last one may be shorter), calling
+// func(const unsigned char *data, size_t size) for each segment.
+// A seg_size of 0 means the datagram was not coalesced.
+// Returns the number of segments.
+template <typename FUNC>
+inline size_t split(const unsigned char *data, const size_t size, size_t seg_size, FUNC func)
+{
+    if (!seg_size || seg_size > size)
+        seg_size = size;
+    size_t n = 0;
+    for (size_t off = 0; off < size; off += seg_size, ++n)
+        func(data + off, std::min(seg_size, size - off));
+    return n;
+}
+
+} // namespace GSO
+} // namespace UDPTransport
+} // namespace openvpn
+
+#endif
@@ -24,10 +24,13 @@
 #ifndef OPENVPN_TRANSPORT_UDPLINK_H
 #define OPENVPN_TRANSPORT_UDPLINK_H
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 #include <openvpn/io/io.hpp>
 
+#include <openvpn/common/platform.hpp>
 #include <openvpn/common/size.hpp>
 #include <openvpn/common/rc.hpp>
 #include <openvpn/frame/frame.hpp>
@@ -37,6 +40,22 @@
 #include <openvpn/transport/gremlin.hpp>
 #endif
 
+// On Linux, UDPLink can optionally batch datagram I/O using
+// recvmmsg/sendmmsg.  Define OPENVPN_UDPLINK_NO_MMSG to disable.
+#if defined(OPENVPN_PLATFORM_LINUX) && !defined(OPENVPN_UDPLINK_NO_MMSG)
+#define OPENVPN_UDPLINK_MMSG
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <openvpn/common/strerror.hpp>
+#include <openvpn/transport/udpgso.hpp>
+#endif
+
+#ifdef OPENVPN_IO_URING
+#include <cstring>
+#include <openvpn/linux/io_uring.hpp>
+#endif
+
 #if defined(OPENVPN_DEBUG_UDPLINK) && OPENVPN_DEBUG_UDPLINK >= 1
 #define OPENVPN_LOG_UDPLINK_ERROR(x) OPENVPN_LOG(x)
 #else
@@ -63,10 +82,23 @@ enum
 struct PacketFrom
 {
     typedef std::unique_ptr<PacketFrom> SPtr;
+    typedef std::vector<SPtr> Batch;
     BufferAllocated buf;
     AsioEndpoint sender_endpoint;
 };
 
+// ReadHandler must provide:
+//
+//   void udp_read_handler(PacketFrom::SPtr &pfp);
+//
+// and, when batched I/O is enabled (see UDPLink::set_batch_size),
+//
+//   void udp_read_batch_handler(PacketFrom::Batch &batch, const size_t n);
+//
+// which receives the first n packets of batch in a single call.
+// Handlers may take ownership of a PacketFrom by moving it out of
+// its SPtr; UDPLink will allocate a replacement.
+
 template <typename ReadHandler>
 class UDPLink : public RC<thread_unsafe_refcount>
 {
@@ -93,8 +125,60 @@ class UDPLink : public RC<thread_unsafe_refcount>
     }
 #endif
 
+    // Enable batched I/O, where up to batch_size datagrams are
+    // received per recvmmsg() call and outgoing datagrams are
+    // coalesced into sendmmsg() calls.  A batch_size of 0 or 1
+    // selects the default one-syscall-per-packet mode.  Batching
+    // is only available on Linux and is disabled by gremlin.
+    // Must be called after gremlin_config() and before start().
+    void set_batch_size(const unsigned int batch_size_arg)
+    {
+#ifdef OPENVPN_UDPLINK_MMSG
+        batch_size = batch_size_arg > 1 ? std::min(batch_size_arg, max_batch_size()) : 0;
+#ifdef OPENVPN_GREMLIN
+        if (gremlin)
+            batch_size = 0;
+#endif
+        if (batch_size)
+        {
+            recv_batch.reset(new MMsgBatch(batch_size));
+            send_batch.reset(new MMsgBatch(batch_size));
+        }
+#endif
+    }
+
+    // Enable UDP segmentation offload on top of batched I/O.
+    // Outgoing runs of equally sized packets are then handed to
+    // the kernel as UDP_SEGMENT super-datagrams, and super-datagrams
+    // coalesced by UDP_GRO are split into individual packets before
+    // they reach the read handler.  Each direction is only enabled
+    // if the kernel supports it.  Must be called after
+    // set_batch_size() and before start().
+    void set_gso(const bool enable)
+    {
+#ifdef OPENVPN_UDPLINK_MMSG
+        if (enable && batch_size)
+        {
+            gso_send = GSO::gso_supported(socket.native_handle());
+            gro_recv = GSO::enable_gro(socket.native_handle());
+            if (gro_recv)
+            {
+                // received super-datagrams are split into these
+                MMsgBatch &b = *recv_batch;
+                b.pkts.resize(b.pkts.size() * GSO::MAX_SEGMENTS);
+            }
+            OPENVPN_LOG_UDPLINK_VERBOSE("UDPLink: GSO=" << gso_send << " GRO=" << gro_recv);
+        }
+#endif
+    }
+
     // Returns 0 on success, or a system error code on error.
     // May also return SEND_PARTIAL or SEND_SOCKET_HALTED.
+    // In batched mode, the packet is queued and sent later, so
+    // the first error from a deferred sendmmsg() is returned by
+    // the next call to send() instead, which still queues its
+    // packet.  Errors from a flush triggered by a full queue are
+    // returned directly.
     int send(const Buffer &buf, const AsioEndpoint *endpoint)
     {
 #ifdef OPENVPN_GREMLIN
@@ -103,23 +187,44 @@ class UDPLink : public RC<thread_unsafe_refcount>
             gremlin_send(buf, endpoint);
             return 0;
         }
-        else
 #endif
-            return do_send(buf, endpoint);
+#ifdef OPENVPN_UDPLINK_MMSG
+        if (batch_size)
+            return batch_send(buf, endpoint);
+#endif
+        return do_send(buf, endpoint);
     }
 
     void start(const int n_parallel)
     {
         if (!halt)
         {
+#ifdef OPENVPN_UDPLINK_MMSG
+            if (batch_size)
+            {
+                // A single outstanding wait drains the socket with
+                // recvmmsg(), so n_parallel is not needed here.
+                queue_read_batch();
+                return;
+            }
+#endif
+#ifdef OPENVPN_IO_URING
+            if (start_uring(n_parallel))
+                return;
+#endif
             for (int i = 0; i < n_parallel; i++)
                 queue_read(nullptr);
         }
     }
 
+    // must be called before the socket is closed
     void stop()
     {
         halt = true;
+#ifdef OPENVPN_IO_URING
+        if (uring)
+            uring->stop();
+#endif
 #ifdef OPENVPN_GREMLIN
         if (gremlin)
             gremlin->stop();
@@ -157,29 +262,79 @@ class UDPLink : public RC<thread_unsafe_refcount>
         OPENVPN_LOG_UDPLINK_VERBOSE("UDPLink::handle_read: " << error.message());
         if (!halt)
         {
-            if (bytes_recvd)
-            {
-                if (!error)
-                {
-                    OPENVPN_LOG_UDPLINK_VERBOSE("UDP[" << bytes_recvd << "] from " << pfp->sender_endpoint);
-                    pfp->buf.set_size(bytes_recvd);
-                    stats->inc_stat(SessionStats::BYTES_IN, bytes_recvd);
-                    stats->inc_stat(SessionStats::PACKETS_IN, 1);
+            process_read(pfp, error, bytes_recvd);
+            if (!halt)
+                queue_read(pfp.release()); // reuse PacketFrom object if still available
+        }
+    }
+
+#ifdef OPENVPN_IO_URING
+    // Use io_uring with n_parallel reads in flight, if supported
+    // by the kernel.  Not used with gremlin, which has its own
+    // receive queue.
+    bool start_uring(const int n_parallel)
+    {
 #ifdef OPENVPN_GREMLIN
-                    if (gremlin)
-                        gremlin_recv(pfp);
-                    else
+        if (gremlin)
+            return false;
 #endif
-                        read_handler->udp_read_handler(pfp);
-                }
+        uring = IoUringReader::create(static_cast<openvpn_io::io_context &>(socket.get_executor().context()),
+                                      socket.native_handle(),
+                                      frame_context.payload(),
+                                      n_parallel > 0 ? n_parallel : 1,
+                                      true);
+        if (!uring)
+            return false;
+        OPENVPN_LOG_UDPLINK_VERBOSE("UDPLink: using io_uring");
+        uring->start([this](const IoUringReader::Completion &c)
+                     { handle_uring_read(c); });
+        return true;
+    }
+
+    void handle_uring_read(const IoUringReader::Completion &c)
+    {
+        if (!uring_from)
+            uring_from.reset(new PacketFrom());
+        PacketFrom &pf = *uring_from;
+        frame_context.prepare(pf.buf);
+        if (!c.error)
+        {
+            pf.buf.write(c.data, c.size);
+            if (c.fromlen <= pf.sender_endpoint.capacity())
+            {
+                std::memcpy(pf.sender_endpoint.data(), c.from, c.fromlen);
+                pf.sender_endpoint.resize(c.fromlen);
+            }
+        }
+        const openvpn_io::error_code error(c.error, openvpn_io::system_category());
+        // as with asio, errors are only reported if bytes_recvd is nonzero
+        process_read(uring_from, error, c.error ? 1 : c.size);
+    }
+#endif
+
+    // common to asio and io_uring reads, pfp may be taken by read_handler
+    void process_read(PacketFrom::SPtr &pfp, const openvpn_io::error_code &error, const size_t bytes_recvd)
+    {
+        if (bytes_recvd)
+        {
+            if (!error)
+            {
+                OPENVPN_LOG_UDPLINK_VERBOSE("UDP[" << bytes_recvd << "] from " << pfp->sender_endpoint);
+                pfp->buf.set_size(bytes_recvd);
+                stats->inc_stat(SessionStats::BYTES_IN, bytes_recvd);
+                stats->inc_stat(SessionStats::PACKETS_IN, 1);
+#ifdef OPENVPN_GREMLIN
+                if (gremlin)
+                    gremlin_recv(pfp);
                 else
-                {
-                    OPENVPN_LOG_UDPLINK_ERROR("UDP recv error: " << error.message());
-                    stats->error(Error::NETWORK_RECV_ERROR);
-                }
+#endif
+                    read_handler->udp_read_handler(pfp);
+            }
+            else
+            {
+                OPENVPN_LOG_UDPLINK_ERROR("UDP recv error: " << error.message());
+                stats->error(Error::NETWORK_RECV_ERROR);
             }
-            if (!halt)
-                queue_read(pfp.release()); // reuse PacketFrom object if still available
         }
     }
 
@@ -214,6 +369,334 @@ class UDPLink : public RC<thread_unsafe_refcount>
             return SEND_SOCKET_HALTED;
     }
 
+#ifdef OPENVPN_UDPLINK_MMSG
+    // Per-direction state for recvmmsg/sendmmsg.  The mmsghdr and
+    // iovec arrays are allocated once and reused for every batch.
+    struct MMsgBatch
+    {
+        MMsgBatch(const unsigned int size)
+            : pkts(size),
+              msgs(size),
+              iov(size),
+              ctrl(size)
+        {
+        }
+
+        PacketFrom::Batch pkts;
+        std::vector<struct mmsghdr> msgs;
+        std::vector<struct iovec> iov;
+        std::vector<GSO::ControlBuf> ctrl;
+
+        // GSO/GRO only: super-datagram buffers and messages
+        std::vector<BufferAllocated> super;
+        std::vector<AsioEndpoint> super_from;
+        std::vector<struct mmsghdr> super_msgs;
+        std::vector<unsigned int> super_segs;
+
+        unsigned int n_queued = 0;
+        bool flush_pending = false;
+
+        // first send error since the last send() call, or 0
+        int error = 0;
+    };
+
+    static unsigned int max_batch_size()
+    {
+        return 256;
+    }
+
+    void queue_read_batch()
+    {
+        OPENVPN_LOG_UDPLINK_VERBOSE("UDPLink::queue_read_batch");
+        socket.async_wait(openvpn_io::ip::udp::socket::wait_read,
+                          [self = Ptr(this)](const openvpn_io::error_code &error)
+                          {
+            OPENVPN_ASYNC_HANDLER;
+            self->handle_read_batch(error);
+        });
+    }
+
+    void handle_read_batch(const openvpn_io::error_code &error)
+    {
+        OPENVPN_LOG_UDPLINK_VERBOSE("UDPLink::handle_read_batch: " << error.message());
+        if (halt)
+            return;
+        if (error)
+        {
+            OPENVPN_LOG_UDPLINK_ERROR("UDP recv error: " << error.message());
+            stats->error(Error::NETWORK_RECV_ERROR);
+        }
+        else if (gro_recv)
+            read_gro_batch();
+        else
+        {
+            MMsgBatch &b = *recv_batch;
+            const unsigned int size = static_cast<unsigned int>(b.msgs.size());
+            for (unsigned int i = 0; i < size; ++i)
+            {
+                PacketFrom::SPtr &pf = b.pkts[i];
+                if (!pf)
+                    pf.reset(new PacketFrom());
+                frame_context.prepare(pf->buf);
+                b.iov[i].iov_base = pf->buf.data();
+                b.iov[i].iov_len = frame_context.remaining_payload(pf->buf);
+                struct msghdr &mh = b.msgs[i].msg_hdr;
+                mh = {};
+                mh.msg_name = pf->sender_endpoint.data();
+                mh.msg_namelen = static_cast<socklen_t>(pf->sender_endpoint.capacity());
+                mh.msg_iov = &b.iov[i];
+                mh.msg_iovlen = 1;
+                b.msgs[i].msg_len = 0;
+            }
+
+            const int n = ::recvmmsg(socket.native_handle(), b.msgs.data(), size, MSG_DONTWAIT, nullptr);
+            if (n > 0)
+            {
+                size_t bytes_recvd = 0;
+                for (int i = 0; i < n; ++i)
+                {
+                    PacketFrom &pf = *b.pkts[i];
+                    pf.buf.set_size(b.msgs[i].msg_len);
+                    pf.sender_endpoint.resize(b.msgs[i].msg_hdr.msg_namelen);
+                    bytes_recvd += b.msgs[i].msg_len;
+                    OPENVPN_LOG_UDPLINK_VERBOSE("UDP[" << b.msgs[i].msg_len << "] from " << pf.sender_endpoint);
+                }
+                stats->inc_stat(SessionStats::BYTES_IN, bytes_recvd);
+                stats->inc_stat(SessionStats::PACKETS_IN, n);
+                read_handler->udp_read_batch_handler(b.pkts, static_cast<size_t>(n));
+            }
+            else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                OPENVPN_LOG_UDPLINK_ERROR("UDP recvmmsg error: " << strerror_str(errno));
+                stats->error(Error::NETWORK_RECV_ERROR);
+            }
+        }
+        if (!halt)
+            queue_read_batch();
+    }
+
+    // Receive up to batch_size super-datagrams and split them into
+    // individual packets, each in its own frame-prepared buffer.
+    void read_gro_batch()
+    {
+        MMsgBatch &b = *recv_batch;
+        const unsigned int size = static_cast<unsigned int>(b.msgs.size());
+        if (b.super.size() != size)
+        {
+            b.super.resize(size);
+            b.super_from.resize(size);
+            for (auto &sb : b.super)
+                sb.init(GSO::MAX_DATAGRAM, 0);
+        }
+        for (unsigned int i = 0; i < size; ++i)
+        {
+            b.iov[i].iov_base = b.super[i].data_raw();
+            b.iov[i].iov_len = b.super[i].capacity();
+            struct msghdr &mh = b.msgs[i].msg_hdr;
+            mh = {};
+            mh.msg_name = b.super_from[i].data();
+            mh.msg_namelen = static_cast<socklen_t>(b.super_from[i].capacity());
+            mh.msg_iov = &b.iov[i];
+            mh.msg_iovlen = 1;
+            GSO::prepare_gro(mh, b.ctrl[i]);
+            b.msgs[i].msg_len = 0;
+        }
+
+        const int n = ::recvmmsg(socket.native_handle(), b.msgs.data(), size, MSG_DONTWAIT, nullptr);
+        if (n < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                OPENVPN_LOG_UDPLINK_ERROR("UDP recvmmsg error: " << strerror_str(errno));
+                stats->error(Error::NETWORK_RECV_ERROR);
+            }
+            return;
+        }
+
+        size_t n_pkts = 0;
+        size_t bytes_recvd = 0;
+        for (int i = 0; i < n; ++i)
+        {
+            struct msghdr &mh = b.msgs[i].msg_hdr;
+            const size_t len = b.msgs[i].msg_len;
+            b.super_from[i].resize(mh.msg_namelen);
+            bytes_recvd += len;
+            GSO::split(b.super[i].c_data_raw(), len, GSO::gro_segment_size(mh), [&](const unsigned char *data, const size_t seg_len)
+                       {
+                if (seg_len > frame_context.payload())
+                {
+                    OPENVPN_LOG_UDPLINK_ERROR("UDP GRO segment too large: " << seg_len);
+                    stats->error(Error::NETWORK_RECV_ERROR);
+                    return;
+                }
+                // more segments than we sized for, drop the excess
+                if (n_pkts >= b.pkts.size())
+                {
+                    OPENVPN_LOG_UDPLINK_ERROR("UDP GRO too many segments");
+                    stats->error(Error::NETWORK_RECV_ERROR);
+                    return;
+                }
+                PacketFrom::SPtr &pf = b.pkts[n_pkts++];
+                if (!pf)
+                    pf.reset(new PacketFrom());
+                frame_context.prepare(pf->buf);
+                pf->buf.write(data, seg_len);
+                pf->sender_endpoint = b.super_from[i]; });
+        }
+        if (n_pkts)
+        {
+            stats->inc_stat(SessionStats::BYTES_IN, bytes_recvd);
+            stats->inc_stat(SessionStats::PACKETS_IN, n_pkts);
+            read_handler->udp_read_batch_handler(b.pkts, n_pkts);
+        }
+    }
+
+    // Queue a copy of buf for transmission.  The queue is flushed
+    // when it fills up or, at the latest, once control returns to
+    // the io_context, so that packets generated by the same event
+    // handler go out in a single sendmmsg() call.
+    int batch_send(const Buffer &buf, const AsioEndpoint *endpoint)
+    {
+        if (halt)
+            return SEND_SOCKET_HALTED;
+
+        MMsgBatch &b = *send_batch;
+        int err = b.error;
+        b.error = 0;
+
+        PacketFrom::SPtr &pf = b.pkts[b.n_queued];
+        if (!pf)
+            pf.reset(new PacketFrom());
+        pf->buf.reset(0, buf.size(), 0);
+        pf->buf.write(buf.c_data(), buf.size());
+
+        b.iov[b.n_queued].iov_base = pf->buf.data();
+        b.iov[b.n_queued].iov_len = pf->buf.size();
+        struct msghdr &mh = b.msgs[b.n_queued].msg_hdr;
+        mh = {};
+        if (endpoint)
+        {
+            pf->sender_endpoint = *endpoint;
+            mh.msg_name = pf->sender_endpoint.data();
+            mh.msg_namelen = static_cast<socklen_t>(pf->sender_endpoint.size());
+        }
+        mh.msg_iov = &b.iov[b.n_queued];
+        mh.msg_iovlen = 1;
+
+        if (++b.n_queued == b.pkts.size())
+        {
+            flush_send_batch();
+            if (!err)
+                err = b.error;
+            b.error = 0;
+        }
+        else if (!b.flush_pending)
+        {
+            b.flush_pending = true;
+            openvpn_io::post(socket.get_executor(), [self = Ptr(this)]()
+                             {
+                OPENVPN_ASYNC_HANDLER;
+                self->send_batch->flush_pending = false;
+                self->flush_send_batch(); });
+        }
+        return err;
+    }
+
+    void flush_send_batch()
+    {
+        MMsgBatch &b = *send_batch;
+        struct mmsghdr *msgs = b.msgs.data();
+        unsigned int n_msgs = b.n_queued;
+        if (gso_send)
+        {
+            n_msgs = gso_coalesce(b);
+            msgs = b.super_msgs.data();
+        }
+
+        unsigned int sent = 0;
+        size_t bytes_sent = 0;
+        size_t packets_sent = 0;
+        while (!halt && sent < n_msgs)
+        {
+            const int n = ::sendmmsg(socket.native_handle(), &msgs[sent], n_msgs - sent, 0);
+            if (n <= 0)
+            {
+                if (n < 0 && errno == EINTR)
+                    continue;
+                // EIO means the egress device cannot checksum
+                // super-datagrams, so stop using GSO from now on
+                if (n < 0 && errno == EIO && gso_send)
+                    gso_send = false;
+                // drop the remainder of the batch, as UDP would on
+                // a full socket buffer
+                const int err = n < 0 ? errno : EAGAIN;
+                OPENVPN_LOG_UDPLINK_ERROR("UDP sendmmsg error: " << strerror_str(err));
+                stats->error(Error::NETWORK_SEND_ERROR);
+                if (!b.error)
+                    b.error = err;
+                break;
+            }
+            for (unsigned int i = sent; i < sent + static_cast<unsigned int>(n); ++i)
+            {
+                const struct msghdr &mh = msgs[i].msg_hdr;
+                bytes_sent += msgs[i].msg_len;
+                packets_sent += msgs == b.msgs.data() ? 1 : b.super_segs[i];
+                if (msgs[i].msg_len != GSO::iov_size(mh.msg_iov, mh.msg_iovlen))
+                {
+                    OPENVPN_LOG_UDPLINK_ERROR("UDP partial send error");
+                    stats->error(Error::NETWORK_SEND_ERROR);
+                    if (!b.error)
+                        b.error = SEND_PARTIAL;
+                }
+            }
+            sent += static_cast<unsigned int>(n);
+        }
+        if (sent)
+        {
+            stats->inc_stat(SessionStats::BYTES_OUT, bytes_sent);
+            stats->inc_stat(SessionStats::PACKETS_OUT, packets_sent);
+        }
+        b.n_queued = 0;
+    }
+
+    // Build b.super_msgs from the queued packets, merging runs of
+    // equally sized packets sent to the connected peer into
+    // UDP_SEGMENT super-datagrams.  Returns the number of messages.
+    unsigned int gso_coalesce(MMsgBatch &b)
+    {
+        if (b.super_msgs.size() != b.msgs.size())
+        {
+            b.super_msgs.resize(b.msgs.size());
+            b.super_segs.resize(b.msgs.size());
+        }
+        unsigned int n_msgs = 0;
+        unsigned int i = 0;
+        while (i < b.n_queued)
+        {
+            // packets with an explicit destination are sent as is
+            unsigned int run = 1;
+            if (!b.msgs[i].msg_hdr.msg_name)
+            {
+                unsigned int limit = i + 1;
+                while (limit < b.n_queued && !b.msgs[limit].msg_hdr.msg_name)
+                    ++limit;
+                run = static_cast<unsigned int>(GSO::segment_run(&b.iov[i], limit - i));
+            }
+
+            struct mmsghdr &m = b.super_msgs[n_msgs];
+            m.msg_hdr = b.msgs[i].msg_hdr;
+            m.msg_hdr.msg_iovlen = run;
+            m.msg_len = 0;
+            if (run > 1)
+                GSO::set_segment_size(m.msg_hdr, b.ctrl[n_msgs], static_cast<std::uint16_t>(b.iov[i].iov_len));
+            b.super_segs[n_msgs] = run;
+            ++n_msgs;
+            i += run;
+        }
+        return n_msgs;
+    }
+#endif
+
 #ifdef OPENVPN_GREMLIN
     void gremlin_send(const Buffer &buf, const AsioEndpoint *endpoint)
     {
@@ -241,9 +724,22 @@ class UDPLink : public RC<thread_unsafe_refcount>
     Frame::Context frame_context;
     SessionStats::Ptr stats;
 
+#ifdef OPENVPN_IO_URING
+    IoUringReader::Ptr uring;
+    PacketFrom::SPtr uring_from; // recycled across reads
+#endif
+
 #ifdef OPENVPN_GREMLIN
     std::unique_ptr<Gremlin::SendRecvQueue> gremlin;
 #endif
+
+#ifdef OPENVPN_UDPLINK_MMSG
+    unsigned int batch_size = 0;
+    bool gso_send = false;
+    bool gro_recv = false;
+    std::unique_ptr<MMsgBatch> recv_batch;
+    std::unique_ptr<MMsgBatch> send_batch;
+#endif
 };
 } // namespace UDPTransport
 } // namespace openvpn
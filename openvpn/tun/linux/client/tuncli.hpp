@@ -31,6 +31,7 @@
 #include <openvpn/tun/tunio.hpp>
 #include <openvpn/tun/persist/tunpersist.hpp>
 #include <openvpn/tun/linux/client/tunmethods.hpp>
+#include <openvpn/tun/linux/client/tunvnet.hpp>
 
 namespace openvpn {
 namespace TunLinux {
@@ -63,6 +64,22 @@ class Tun : public TunIO<ReadHandler, PacketFrom, openvpn_io::posix::stream_desc
         OPENVPN_LOG_TUN(Base::name_ << " opened");
     }
 
+    // Read with an explicit frame context, used when reads carry a
+    // virtio-net header and may return TSO super-packets.
+    Tun(openvpn_io::io_context &io_context,
+        ReadHandler read_handler_arg,
+        const Frame::Context &frame_context_arg,
+        const SessionStats::Ptr &stats_arg,
+        const int socket,
+        const std::string &name)
+        : Base(read_handler_arg, frame_context_arg, stats_arg)
+    {
+        Base::name_ = name;
+        Base::retain_stream = true;
+        Base::stream = new openvpn_io::posix::stream_descriptor(io_context, socket);
+        OPENVPN_LOG_TUN(Base::name_ << " opened");
+    }
+
     ~Tun()
     {
         Base::stop();
@@ -84,6 +101,18 @@ class ClientConfig : public TunClientFactory
     bool generate_tun_builder_capture_event = false;
 
     int n_parallel = 8;
+
+    // Number of tun queues (IFF_MULTI_QUEUE).  All queues are read
+    // on the session io_context, so this adds no parallelism of its
+    // own.  The kernel hashes flows over the queues, each with its
+    // own txqueuelen backlog, so a burst of outbound packets has more
+    // room before the tun drops them while the session thread is busy.
+    int n_queues = 1;
+
+    // Open the tun with IFF_VNET_HDR and TSO/checksum offload, so
+    // that the kernel can hand us TCP super-packets (layer 3 only)
+    bool vnet_hdr = false;
+
     Frame::Ptr frame;
     SessionStats::Ptr stats;
 
@@ -198,6 +227,8 @@ class Client : public TunClient
                     tsconf.dev_name = config->dev_name;
                     tsconf.txqueuelen = config->txqueuelen;
                     tsconf.add_bypass_routes_on_establish = true;
+                    tsconf.n_queues = config->n_queues;
+                    tsconf.vnet_hdr = config->vnet_hdr && config->tun_prop.layer() == Layer::OSI_LAYER_3;
 
                     // open/config tun
                     {
@@ -207,6 +238,10 @@ class Client : public TunClient
                         sd = tun_setup->establish(*po, &tsconf, nullptr, os);
                     }
 
+                    // extra queues are owned by us, not by tun_persist
+                    for (const int fd : tsconf.queue_fds)
+                        queue_fds.emplace_back(fd);
+
 #if defined(HAVE_JSON)
                     if (config->generate_tun_builder_capture_event)
                     {
@@ -224,13 +259,31 @@ class Client : public TunClient
                 }
 
                 // start tun
-                impl.reset(new TunImpl(io_context,
-                                       this,
-                                       config->frame,
-                                       config->stats,
-                                       sd,
-                                       state->iface_name));
+                vnet_hdr = VnetHdr::enabled(sd);
+                if (vnet_hdr)
+                {
+                    // reads may return super-packets of up to 64KB
+                    const Frame::Context &fc = (*config->frame)[Frame::READ_TUN];
+                    const Frame::Context vnet_fc(fc.headroom(),
+                                                 VnetHdr::SIZE + 65535,
+                                                 fc.tailroom(),
+                                                 fc.align_adjust(),
+                                                 fc.align_block(),
+                                                 fc.buffer_flags());
+                    impl.reset(new TunImpl(io_context, this, vnet_fc, config->stats, sd, state->iface_name));
+                    for (const auto &fd : queue_fds)
+                        queues.emplace_back(new TunImpl(io_context, this, vnet_fc, config->stats, fd(), state->iface_name));
+                    OPENVPN_LOG("TUN: virtio-net header offload enabled");
+                }
+                else
+                {
+                    impl.reset(new TunImpl(io_context, this, config->frame, config->stats, sd, state->iface_name));
+                    for (const auto &fd : queue_fds)
+                        queues.emplace_back(new TunImpl(io_context, this, config->frame, config->stats, fd(), state->iface_name));
+                }
                 impl->start(config->n_parallel);
+                for (auto &q : queues)
+                    q->start(config->n_parallel);
 
                 // signal that we are connected
                 parent.tun_connected();
@@ -323,15 +376,36 @@ class Client : public TunClient
 
     bool send(Buffer &buf)
     {
-        if (impl)
-            return impl->write(buf);
-        else
+        if (!impl)
             return false;
+        if (vnet_hdr && !VnetHdr::prepend(buf))
+        {
+            // not enough headroom, copy into a work buffer
+            (*config->frame)[Frame::READ_TUN].prepare(send_buf);
+            send_buf.write(buf.c_data(), buf.size());
+            if (!VnetHdr::prepend(send_buf))
+                return false;
+            return impl->write(send_buf);
+        }
+        return impl->write(buf);
     }
 
     void tun_read_handler(PacketFrom::SPtr &pfp) // called by TunImpl
     {
-        parent.tun_recv(pfp->buf);
+        if (vnet_hdr)
+        {
+            const Frame::Context &fc = (*config->frame)[Frame::READ_TUN];
+            if (!VnetHdr::receive(
+                    pfp->buf,
+                    seg_buf,
+                    [&fc](BufferAllocated &seg)
+                    { fc.prepare(seg); },
+                    [this](BufferAllocated &buf)
+                    { parent.tun_recv(buf); }))
+                config->stats->error(Error::TUN_FRAMING_ERROR);
+        }
+        else
+            parent.tun_recv(pfp->buf);
     }
 
     void tun_error_handler(const Error::Type errtype, // called by TunImpl
@@ -348,6 +422,10 @@ class Client : public TunClient
             // stop tun
             if (impl)
                 impl->stop();
+            for (auto &q : queues)
+                q->stop();
+            queues.clear();
+            queue_fds.clear();
 
             tun_persist.reset();
         }
@@ -358,6 +436,11 @@ class Client : public TunClient
     ClientConfig::Ptr config;
     TunClientParent &parent;
     TunImpl::Ptr impl;
+    std::vector<TunImpl::Ptr> queues;  // extra queues when n_queues > 1
+    std::vector<ScopedFD> queue_fds;   // fds of extra queues
+    bool vnet_hdr = false;             // tun reads/writes carry a virtio-net header
+    BufferAllocated seg_buf;           // segments of a TSO super-packet
+    BufferAllocated send_buf;          // copy of a write lacking vnet header headroom
     TunProp::State::Ptr state;
     TunBuilderSetup::Base::Ptr tun_setup;
     bool halt;
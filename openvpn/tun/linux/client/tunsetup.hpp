@@ -30,6 +30,8 @@
 #include <net/if.h>
 #include <linux/if_tun.h>
 
+#include <vector>
+
 #include <openvpn/common/exception.hpp>
 #include <openvpn/common/file.hpp>
 #include <openvpn/common/split.hpp>
@@ -46,6 +48,7 @@
 #include <openvpn/tun/client/tunprop.hpp>
 #include <openvpn/tun/client/tunconfigflags.hpp>
 #include <openvpn/netconf/linux/gw.hpp>
+#include <openvpn/tun/linux/client/tunvnet.hpp>
 
 namespace openvpn {
 namespace TunLinuxSetup {
@@ -83,6 +86,17 @@ class Setup : public TunBuilderSetup::Base
         bool add_bypass_routes_on_establish = false; // required when not using tunbuilder
         bool dco = false;
 
+        // Number of tun queues to open (IFF_MULTI_QUEUE when > 1).
+        // The fd of the first queue is returned by establish(), the
+        // fds of the others are returned in queue_fds, to be owned by
+        // the caller.
+        int n_queues = 1;
+        std::vector<int> queue_fds;
+
+        // Open the tun with IFF_VNET_HDR and enable checksum and TSO
+        // offload (see TunLinux::VnetHdr)
+        bool vnet_hdr = false;
+
 #ifdef HAVE_JSON
         virtual Json::Value to_json() override
         {
@@ -92,6 +106,8 @@ class Setup : public TunBuilderSetup::Base
             root["dev_name"] = Json::Value(dev_name);
             root["txqueuelen"] = Json::Value(txqueuelen);
             root["dco"] = Json::Value(dco);
+            root["n_queues"] = Json::Value(n_queues);
+            root["vnet_hdr"] = Json::Value(vnet_hdr);
             return root;
         };
 
@@ -103,6 +119,8 @@ class Setup : public TunBuilderSetup::Base
             json::to_string(root, dev_name, "dev_name", title);
             json::to_int(root, txqueuelen, "txqueuelen", title);
             json::to_bool(root, dco, "dco", title);
+            json::to_int(root, n_queues, "n_queues", title);
+            json::to_bool(root, vnet_hdr, "vnet_hdr", title);
         }
 #endif
     };
@@ -198,11 +216,22 @@ class Setup : public TunBuilderSetup::Base
             ifr.ifr_flags |= IFF_TAP;
         else
             throw tun_layer_error("unknown OSI layer");
+        if (conf->n_queues > 1)
+            ifr.ifr_flags |= IFF_MULTI_QUEUE;
+        if (conf->vnet_hdr)
+            ifr.ifr_flags |= IFF_VNET_HDR;
 
         open_unit(conf->dev_name, ifr, fd);
 
         if (fcntl(fd(), F_SETFL, O_NONBLOCK) < 0)
             throw tun_fcntl_error(errinfo(errno));
+        if (conf->vnet_hdr)
+            set_vnet_offload(fd());
+
+        // attach the remaining queues to the same interface
+        std::vector<ScopedFD> queues;
+        for (int i = 1; i < conf->n_queues; ++i)
+            queues.push_back(open_queue(ifr, conf->vnet_hdr));
 
         // Set the TX send queue size
         if (conf->txqueuelen)
@@ -224,9 +253,47 @@ class Setup : public TunBuilderSetup::Base
         conf->iface_name = ifr.ifr_name;
         tun_iface_name = ifr.ifr_name;
 
+        conf->queue_fds.clear();
+        for (auto &q : queues)
+            conf->queue_fds.push_back(q.release());
         return fd.release();
     }
 
+    ScopedFD open_queue(const struct ifreq &ifr_arg, const bool vnet_hdr)
+    {
+        static const char node[] = "/dev/net/tun";
+        ScopedFD fd(open(node, O_RDWR));
+        if (!fd.defined())
+            OPENVPN_THROW(tun_open_error, "error opening tun device " << node << ": " << errinfo(errno));
+
+        struct ifreq ifr = ifr_arg;
+        if (ioctl(fd(), TUNSETIFF, (void *)&ifr) < 0)
+        {
+            const int eno = errno;
+            OPENVPN_THROW(tun_ioctl_error, "failed to attach queue to tun device '" << ifr.ifr_name << "' : " << errinfo(eno));
+        }
+        if (fcntl(fd(), F_SETFL, O_NONBLOCK) < 0)
+            throw tun_fcntl_error(errinfo(errno));
+        if (vnet_hdr)
+            set_vnet_offload(fd());
+        return fd;
+    }
+
+    static void set_vnet_offload(const int fd)
+    {
+        int hdr_size = TunLinux::VnetHdr::SIZE;
+        if (ioctl(fd, TUNSETVNETHDRSZ, (void *)&hdr_size) < 0)
+        {
+            const int eno = errno;
+            OPENVPN_THROW(tun_ioctl_error, "failed to set tun vnet header size : " << errinfo(eno));
+        }
+        if (ioctl(fd, TUNSETOFFLOAD, (unsigned long)TunLinux::VnetHdr::OFFLOAD_FLAGS) < 0)
+        {
+            const int eno = errno;
+            OPENVPN_THROW(tun_ioctl_error, "failed to set tun offload flags : " << errinfo(eno));
+        }
+    }
+
     void open_unit(const std::string &name, struct ifreq &ifr, ScopedFD &fd)
     {
         if (!name.empty())
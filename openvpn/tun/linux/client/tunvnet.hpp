@@ -0,0 +1,261 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// virtio-net header handling for Linux tun devices opened with
+// IFF_VNET_HDR.
+//
+// Every packet read from or written to such a device is preceded by
+// a virtio-net header (struct virtio_net_hdr, in host byte order).  With TUN_F_CSUM, the kernel may hand us
+// packets whose transport checksum is not yet computed, and with
+// TUN_F_TSO4/TUN_F_TSO6 it may hand us TCP super-packets of up to
+// 64KB that must be segmented into MSS sized packets.  Reading one
+// super-packet and segmenting it in user space is considerably
+// cheaper than reading each segment from the device separately.
+
+#ifndef OPENVPN_TUN_LINUX_CLIENT_TUNVNET_H
+#define OPENVPN_TUN_LINUX_CLIENT_TUNVNET_H
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+#include <sys/ioctl.h>
+#include <net/if.h>
+#include <linux/if_tun.h>
+
+#include <openvpn/common/socktypes.hpp>
+#include <openvpn/buffer/buffer.hpp>
+#include <openvpn/ip/csum.hpp>
+#include <openvpn/ip/ip4.hpp>
+#include <openvpn/ip/ip6.hpp>
+#include <openvpn/ip/tcp.hpp>
+
+namespace openvpn {
+namespace TunLinux {
+namespace VnetHdr {
+
+// Same layout as struct virtio_net_hdr from <linux/virtio_net.h>,
+// which cannot be included from C++ (it has a member named "class").
+struct Header
+{
+    std::uint8_t flags;
+    std::uint8_t gso_type;
+    std::uint16_t hdr_len;
+    std::uint16_t gso_size;
+    std::uint16_t csum_start;
+    std::uint16_t csum_offset;
+};
+
+enum
+{
+    SIZE = sizeof(Header),
+
+    // Header::flags
+    F_NEEDS_CSUM = 1,
+
+    // Header::gso_type
+    GSO_NONE = 0,
+    GSO_TCPV4 = 1,
+    GSO_TCPV6 = 4,
+
+    // offloads requested by TunLinuxSetup when vnet_hdr is enabled
+    OFFLOAD_FLAGS = TUN_F_CSUM | TUN_F_TSO4 | TUN_F_TSO6,
+
+    // TCP flags that must only appear on the first or last segment
+    TCP_FIN = 0x01,
+    TCP_PSH = 0x08,
+    TCP_CWR = 0x80,
+};
+
+// Return true if the tun device fd was opened with IFF_VNET_HDR.
+inline bool enabled(const int fd)
+{
+    struct ifreq ifr;
+    std::memset(&ifr, 0, sizeof(ifr));
+    if (::ioctl(fd, TUNGETIFF, (void *)&ifr) < 0)
+        return false;
+    return (ifr.ifr_flags & IFF_VNET_HDR) != 0;
+}
+
+// Prepend a header describing a plain packet, for writing to the
+// device.  Returns false if buf lacks the headroom.
+inline bool prepend(Buffer &buf)
+{
+    if (buf.offset() < SIZE)
+        return false;
+    Header hdr;
+    std::memset(&hdr, 0, sizeof(hdr));
+    buf.prepend((const unsigned char *)&hdr, sizeof(hdr));
+    return true;
+}
+
+// Complete a checksum left partial by the kernel (CHECKSUM_PARTIAL):
+// the field at csum_start + csum_offset holds the pseudo-header sum,
+// and the checksum covers everything from csum_start to the end.
+inline bool finish_checksum(Buffer &buf, const size_t csum_start, const size_t csum_offset)
+{
+    if (csum_start + csum_offset + 2 > buf.size())
+        return false;
+    unsigned char *data = buf.data();
+    const std::uint16_t check = IPChecksum::cfold(IPChecksum::compute(data + csum_start, buf.size() - csum_start));
+    std::memcpy(data + csum_start + csum_offset, &check, sizeof(check));
+    return true;
+}
+
+// Full TCP checksum of the segment at data + l4_off (l4_len bytes),
+// including the IPv4 or IPv6 pseudo-header.
+inline std::uint16_t tcp_checksum(const unsigned char *data,
+                                  const size_t l4_off,
+                                  const size_t l4_len,
+                                  const bool ipv6)
+{
+    std::uint32_t sum;
+    if (ipv6)
+    {
+        const IPv6Header *ip6 = (const IPv6Header *)data;
+        unsigned char pseudo[40];
+        std::memcpy(pseudo, &ip6->saddr, 16);
+        std::memcpy(pseudo + 16, &ip6->daddr, 16);
+        const std::uint32_t len = htonl(static_cast<std::uint32_t>(l4_len));
+        std::memcpy(pseudo + 32, &len, 4);
+        pseudo[36] = pseudo[37] = pseudo[38] = 0;
+        pseudo[39] = IPCommon::TCP;
+        sum = IPChecksum::compute(pseudo, sizeof(pseudo));
+    }
+    else
+    {
+        const IPv4Header *ip = (const IPv4Header *)data;
+        unsigned char pseudo[12];
+        std::memcpy(pseudo, &ip->saddr, 4);
+        std::memcpy(pseudo + 4, &ip->daddr, 4);
+        pseudo[8] = 0;
+        pseudo[9] = IPCommon::TCP;
+        const std::uint16_t len = htons(static_cast<std::uint16_t>(l4_len));
+        std::memcpy(pseudo + 10, &len, 2);
+        sum = IPChecksum::compute(pseudo, sizeof(pseudo));
+    }
+    return IPChecksum::cfold(IPChecksum::partial(data + l4_off, l4_len, sum));
+}
+
+// Split a TCP super-packet into segments of at most mss payload
+// bytes.  Each segment is built in seg, after prepare(seg), and
+// passed to func(seg).  Returns false if the packet is malformed.
+template <typename PREPARE, typename FUNC>
+inline bool segment_tcp(const Buffer &buf,
+                        const size_t mss,
+                        const size_t l4_off,
+                        const bool ipv6,
+                        BufferAllocated &seg,
+                        PREPARE prepare,
+                        FUNC func)
+{
+    const size_t l3_min = ipv6 ? sizeof(IPv6Header) : sizeof(IPv4Header);
+    if (!mss || l4_off < l3_min || l4_off + sizeof(TCPHeader) > buf.size())
+        return false;
+    const unsigned char *data = buf.c_data();
+    const TCPHeader *th = (const TCPHeader *)(data + l4_off);
+    const size_t hdr_len = l4_off + TCPHeader::length(th->doff_res);
+    if (hdr_len < l4_off + sizeof(TCPHeader) || hdr_len > buf.size())
+        return false;
+
+    const size_t payload = buf.size() - hdr_len;
+    const std::uint32_t seq0 = ntohl(th->seq);
+    const std::uint16_t id0 = ipv6 ? 0 : ntohs(((const IPv4Header *)data)->id);
+
+    size_t off = 0;
+    for (unsigned int i = 0; off < payload || i == 0; ++i)
+    {
+        const size_t len = std::min(mss, payload - off);
+        const bool last = off + len >= payload;
+
+        prepare(seg);
+        unsigned char *p = seg.write_alloc(hdr_len + len);
+        std::memcpy(p, data, hdr_len);
+        std::memcpy(p + hdr_len, data + hdr_len + off, len);
+
+        if (ipv6)
+        {
+            IPv6Header *ip6 = (IPv6Header *)p;
+            ip6->payload_len = htons(static_cast<std::uint16_t>(hdr_len + len - sizeof(IPv6Header)));
+        }
+        else
+        {
+            IPv4Header *ip = (IPv4Header *)p;
+            ip->tot_len = htons(static_cast<std::uint16_t>(hdr_len + len));
+            ip->id = htons(static_cast<std::uint16_t>(id0 + i));
+            ip->check = 0;
+            ip->check = IPChecksum::checksum(p, IPv4Header::length(ip->version_len));
+        }
+
+        TCPHeader *tcp = (TCPHeader *)(p + l4_off);
+        tcp->seq = htonl(seq0 + static_cast<std::uint32_t>(off));
+        if (!last)
+            tcp->flags &= ~(TCP_FIN | TCP_PSH);
+        if (i)
+            tcp->flags &= ~TCP_CWR;
+        tcp->check = 0;
+        tcp->check = tcp_checksum(p, l4_off, hdr_len - l4_off + len, ipv6);
+
+        func(seg);
+        off += len;
+    }
+    return true;
+}
+
+// Strip the header from a packet read from the device and pass the
+// IP packet(s) it carries to func(BufferAllocated &).  Plain packets
+// are passed in buf itself, after completing a partial checksum if
+// needed, and super-packets are segmented into seg (see
+// segment_tcp).  Returns false if the packet is malformed or uses
+// an offload that was not requested.
+template <typename PREPARE, typename FUNC>
+inline bool receive(BufferAllocated &buf,
+                    BufferAllocated &seg,
+                    PREPARE prepare,
+                    FUNC func)
+{
+    Header hdr;
+    if (buf.size() < sizeof(hdr))
+        return false;
+    buf.read((unsigned char *)&hdr, sizeof(hdr));
+
+    switch (hdr.gso_type)
+    {
+    case GSO_NONE:
+        if ((hdr.flags & F_NEEDS_CSUM)
+            && !finish_checksum(buf, hdr.csum_start, hdr.csum_offset))
+            return false;
+        func(buf);
+        return true;
+    case GSO_TCPV4:
+        return segment_tcp(buf, hdr.gso_size, hdr.csum_start, false, seg, prepare, func);
+    case GSO_TCPV6:
+        return segment_tcp(buf, hdr.gso_size, hdr.csum_start, true, seg, prepare, func);
+    default:
+        return false;
+    }
+}
+
+} // namespace VnetHdr
+} // namespace TunLinux
+} // namespace openvpn
+
+#endif
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <utility>
+#include <type_traits>
 
 #include <openvpn/io/io.hpp>
 
@@ -36,6 +37,10 @@
 #include <openvpn/log/sessionstats.hpp>
 #include <openvpn/tun/tunlog.hpp>
 
+#ifdef OPENVPN_IO_URING
+#include <openvpn/linux/io_uring.hpp>
+#endif
+
 namespace openvpn {
 
 template <typename ReadHandler, typename PacketFrom, typename STREAM>
@@ -104,7 +109,11 @@ class TunIO : public RC<thread_unsafe_refcount>
                 }
 
                 // write data to tun device
+                DataPathStats *dps = stats ? stats->datapath_stats() : nullptr;
+                const std::uint64_t t_write = dps ? DataPathStats::now_ns() : 0;
                 const size_t wrote = stream->write_some(buf.const_buffer());
+                if (dps)
+                    dps->record_since(DataPathStats::TUN_WRITE, t_write);
                 if (stats)
                 {
                     stats->inc_stat(SessionStats::TUN_BYTES_OUT, wrote);
@@ -170,6 +179,10 @@ class TunIO : public RC<thread_unsafe_refcount>
     {
         if (!halt)
         {
+#ifdef OPENVPN_IO_URING
+            if (start_uring(n_parallel))
+                return;
+#endif
             for (int i = 0; i < n_parallel; i++)
                 queue_read(nullptr);
         }
@@ -181,6 +194,11 @@ class TunIO : public RC<thread_unsafe_refcount>
         if (!halt)
         {
             halt = true;
+#ifdef OPENVPN_IO_URING
+            // must precede close, the ring holds a reference on the fd
+            if (uring)
+                uring->stop();
+#endif
             if (stream)
             {
                 stream->cancel();
@@ -229,37 +247,78 @@ class TunIO : public RC<thread_unsafe_refcount>
         OPENVPN_LOG_TUN_VERBOSE("TunIO::handle_read: " << error.message());
         if (!halt)
         {
-            if (!error)
+            process_read(pfp, error, bytes_recvd);
+            if (!halt)
+                queue_read(pfp.release()); // reuse buffer if still available
+        }
+    }
+
+#ifdef OPENVPN_IO_URING
+    // Use io_uring with n_parallel reads in flight, if the stream
+    // is a plain file descriptor and the kernel supports it.
+    bool start_uring(const int n_parallel)
+    {
+        if constexpr (std::is_same<STREAM, openvpn_io::posix::stream_descriptor>::value)
+        {
+            uring = IoUringReader::create(static_cast<openvpn_io::io_context &>(stream->get_executor().context()),
+                                          stream->native_handle(),
+                                          frame_context.payload(),
+                                          n_parallel > 0 ? n_parallel : 1,
+                                          false);
+            if (uring)
             {
-                pfp->buf.set_size(bytes_recvd);
-                if (stats)
-                {
-                    stats->inc_stat(SessionStats::TUN_BYTES_IN, bytes_recvd);
-                    stats->inc_stat(SessionStats::TUN_PACKETS_IN, 1);
-                }
-                if (!tun_prefix)
-                {
-                    read_handler->tun_read_handler(pfp);
-                }
-                else if (pfp->buf.size() >= 4)
-                {
-                    // handle tun packet prefix, if enabled
-                    pfp->buf.advance(4);
-                    read_handler->tun_read_handler(pfp);
-                }
-                else
-                {
-                    OPENVPN_LOG_TUN_ERROR("TUN Read Error: cannot read prefix");
-                    tun_error(Error::TUN_READ_ERROR, nullptr);
-                }
+                OPENVPN_LOG_TUN_VERBOSE("TunIO: using io_uring");
+                uring->start([this](const IoUringReader::Completion &c)
+                             { handle_uring_read(c); });
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void handle_uring_read(const IoUringReader::Completion &c)
+    {
+        if (!uring_from)
+            uring_from.reset(new PacketFrom());
+        frame_context.prepare(uring_from->buf);
+        if (!c.error)
+            uring_from->buf.write(c.data, c.size);
+        const openvpn_io::error_code error(c.error, openvpn_io::system_category());
+        process_read(uring_from, error, c.size);
+    }
+#endif
+
+    // common to asio and io_uring reads, pfp may be taken by read_handler
+    void process_read(typename PacketFrom::SPtr &pfp, const openvpn_io::error_code &error, const size_t bytes_recvd)
+    {
+        if (!error)
+        {
+            pfp->buf.set_size(bytes_recvd);
+            if (stats)
+            {
+                stats->inc_stat(SessionStats::TUN_BYTES_IN, bytes_recvd);
+                stats->inc_stat(SessionStats::TUN_PACKETS_IN, 1);
+            }
+            if (!tun_prefix)
+            {
+                read_handler->tun_read_handler(pfp);
+            }
+            else if (pfp->buf.size() >= 4)
+            {
+                // handle tun packet prefix, if enabled
+                pfp->buf.advance(4);
+                read_handler->tun_read_handler(pfp);
             }
             else
             {
-                OPENVPN_LOG_TUN_ERROR("TUN Read Error: " << error.message());
-                tun_error(Error::TUN_READ_ERROR, &error);
+                OPENVPN_LOG_TUN_ERROR("TUN Read Error: cannot read prefix");
+                tun_error(Error::TUN_READ_ERROR, nullptr);
             }
-            if (!halt)
-                queue_read(pfp.release()); // reuse buffer if still available
+        }
+        else
+        {
+            OPENVPN_LOG_TUN_ERROR("TUN Read Error: " << error.message());
+            tun_error(Error::TUN_READ_ERROR, &error);
         }
     }
 
@@ -280,6 +339,11 @@ class TunIO : public RC<thread_unsafe_refcount>
     const Frame::Context frame_context;
     SessionStats::Ptr stats;
 
+#ifdef OPENVPN_IO_URING
+    IoUringReader::Ptr uring;
+    typename PacketFrom::SPtr uring_from; // recycled across reads
+#endif
+
     bool halt = false;
 };
 } // namespace openvpn
@@ -0,0 +1,198 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Helpers shared by the benchmark executables: a steady clock
+// stopwatch and a minimal JSON writer, so that results can be
+// emitted without depending on jsoncpp.
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace openvpn {
+namespace Bench {
+
+class Stopwatch
+{
+  public:
+    void start()
+    {
+        t0 = std::chrono::steady_clock::now();
+    }
+
+    void stop()
+    {
+        total += std::chrono::steady_clock::now() - t0;
+    }
+
+    std::uint64_t ns() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(total).count();
+    }
+
+    double seconds() const
+    {
+        return std::chrono::duration<double>(total).count();
+    }
+
+  private:
+    std::chrono::steady_clock::time_point t0;
+    std::chrono::steady_clock::duration total{0};
+};
+
+// Writes one JSON value to a stream.  Objects and arrays are opened
+// and closed explicitly, and commas are inserted as needed:
+//
+//   JSONWriter j(std::cout);
+//   j.begin_object();
+//   j.key("size").value(64);
+//   j.end_object();
+class JSONWriter
+{
+  public:
+    explicit JSONWriter(std::ostream &os_arg)
+        : os(os_arg)
+    {
+    }
+
+    JSONWriter &begin_object()
+    {
+        separate();
+        os << '{';
+        first.push_back(true);
+        return *this;
+    }
+
+    JSONWriter &end_object()
+    {
+        first.pop_back();
+        os << '}';
+        return *this;
+    }
+
+    JSONWriter &begin_array()
+    {
+        separate();
+        os << '[';
+        first.push_back(true);
+        return *this;
+    }
+
+    JSONWriter &end_array()
+    {
+        first.pop_back();
+        os << ']';
+        return *this;
+    }
+
+    JSONWriter &key(const std::string &k)
+    {
+        separate();
+        quote(k);
+        os << ':';
+        after_key = true;
+        return *this;
+    }
+
+    JSONWriter &value(const std::string &v)
+    {
+        separate();
+        quote(v);
+        return *this;
+    }
+
+    JSONWriter &value(const char *v)
+    {
+        return value(std::string(v));
+    }
+
+    JSONWriter &value(const bool v)
+    {
+        separate();
+        os << (v ? "true" : "false");
+        return *this;
+    }
+
+    // NaN and infinity have no JSON representation, write null
+    JSONWriter &value(const double v)
+    {
+        separate();
+        if (!std::isfinite(v))
+        {
+            os << "null";
+            return *this;
+        }
+        std::ostringstream s;
+        s << std::setprecision(6) << v;
+        os << s.str();
+        return *this;
+    }
+
+    template <typename T>
+    JSONWriter &value(const T v)
+    {
+        separate();
+        os << v;
+        return *this;
+    }
+
+  private:
+    void separate()
+    {
+        if (after_key)
+            after_key = false;
+        else if (!first.empty())
+        {
+            if (!first.back())
+                os << ',';
+            first.back() = false;
+        }
+    }
+
+    void quote(const std::string &s)
+    {
+        os << '"';
+        for (const char c : s)
+        {
+            if (c == '"' || c == '\\')
+                os << '\\' << c;
+            else if (static_cast<unsigned char>(c) < 0x20)
+                os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+            else
+                os << c;
+        }
+        os << '"';
+    }
+
+    std::ostream &os;
+    std::vector<bool> first;
+    bool after_key = false;
+};
+
+} // namespace Bench
+} // namespace openvpn
@@ -0,0 +1,405 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Compression benchmark.
+//
+// Replays the test/unittests/comp-testdata corpus, plus synthetic
+// incompressible and mixed traffic, through every compressor in
+// openvpn/compress/ in MTU-sized IPv4/UDP packets.  Each corpus file
+// and the synthetic random stream are sent as separate flows, so the
+// adaptive bypass (compadapt.hpp) sees realistic traffic.  Reports
+// MB/s, output/input ratio and per-packet compress latency for each
+// compressor and dataset.  Results are written to stdout as JSON,
+// progress to stderr.
+//
+//   compressionBench [--quick] [--time ms] [--mtu n]
+//                    [--compressor name] [--dataset name]
+
+#define OPENVPN_LOG_STREAM std::cerr
+#include <openvpn/log/logsimple.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <openvpn/common/exception.hpp>
+#include <openvpn/common/file.hpp>
+#include <openvpn/common/number.hpp>
+#include <openvpn/common/histogram.hpp>
+#include <openvpn/compress/compress.hpp>
+#include <openvpn/compress/lzoasym.hpp>
+#include <openvpn/frame/frame_init.hpp>
+#include <openvpn/ip/ipcommon.hpp>
+#include <openvpn/log/sessionstats.hpp>
+
+#include "bench_common.hpp"
+
+#ifndef COMP_TESTDATA_DIR
+#define COMP_TESTDATA_DIR "test/unittests/comp-testdata/"
+#endif
+
+using namespace openvpn;
+
+namespace {
+
+OPENVPN_SIMPLE_EXCEPTION(usage);
+
+const char *const corpus_files[] = {
+    "alice29.txt",
+    "asyoulik.txt",
+    "cp.html",
+    "fields.c",
+    "geo.protodata",
+    "grammar.lsp",
+    "house.jpg",
+    "html",
+    "html_x_4",
+    "kennedy.xls",
+    "kppkn.gtb",
+    "lcet10.txt",
+    "mapreduce-osdi-1.pdf",
+    "plrabn12.txt",
+    "ptt5",
+    "sum",
+    "urls.10K",
+    "xargs.1",
+};
+
+struct Options
+{
+    bool quick = false;
+    unsigned int time_ms = 300;
+    size_t mtu = 1500;
+    std::string compressor;
+    std::string dataset;
+};
+
+enum
+{
+    IP_UDP_HEADER = 28,
+    RANDOM_PORT = 443,
+    CORPUS_PORT = 2000, // + file index
+    PAYLOAD = 9000 + 512,
+};
+
+typedef std::vector<BufferAllocated> PacketList;
+
+// A compressor and the decompressor used by the peer
+struct Pair
+{
+    const char *name;
+    Compress::Ptr compress;
+    Compress::Ptr decompress;
+};
+
+std::vector<Pair> make_pairs(const Frame::Ptr &frame, const SessionStats::Ptr &stats)
+{
+    std::vector<Pair> ret;
+    ret.push_back({"stub-v2", new CompressStubV2(frame, stats), new CompressStubV2(frame, stats)});
+#ifdef HAVE_LZ4
+    ret.push_back({"lz4", new CompressLZ4(frame, stats, false), new CompressLZ4(frame, stats, false)});
+    ret.push_back({"lz4-v2", new CompressLZ4v2(frame, stats, false), new CompressLZ4v2(frame, stats, false)});
+#endif
+#ifdef HAVE_LZO
+    ret.push_back({"lzo", new CompressLZO(frame, stats, false, false), new CompressLZO(frame, stats, false, false)});
+    ret.push_back({"lzo-asym", new CompressLZO(frame, stats, false, false), new CompressLZOAsym(frame, stats, false, false)});
+#endif
+#ifdef HAVE_SNAPPY
+    ret.push_back({"snappy", new CompressSnappy(frame, stats, false), new CompressSnappy(frame, stats, false)});
+#endif
+    return ret;
+}
+
+// Wrap payload in an IPv4/UDP header so that each dataset has its
+// own flow, packets are at most mtu bytes.
+BufferAllocated make_packet(const unsigned char *payload, const size_t size, const std::uint16_t src_port)
+{
+    BufferAllocated buf(IP_UDP_HEADER + size, BufferAllocated::ARRAY);
+    unsigned char *p = buf.data();
+    std::memset(p, 0, IP_UDP_HEADER);
+    p[0] = 0x45;
+    p[2] = static_cast<unsigned char>((IP_UDP_HEADER + size) >> 8);
+    p[3] = static_cast<unsigned char>(IP_UDP_HEADER + size);
+    p[8] = 64;
+    p[9] = IPCommon::UDP;
+    const unsigned char addrs[8] = {10, 8, 0, 2, 10, 8, 0, 1};
+    std::memcpy(p + 12, addrs, sizeof(addrs));
+    p[20] = static_cast<unsigned char>(src_port >> 8);
+    p[21] = static_cast<unsigned char>(src_port);
+    p[23] = 53;
+    std::memcpy(p + IP_UDP_HEADER, payload, size);
+    return buf;
+}
+
+PacketList corpus_packets(const size_t mtu)
+{
+    PacketList ret;
+    const size_t chunk = mtu - IP_UDP_HEADER;
+    for (size_t f = 0; f < sizeof(corpus_files) / sizeof(corpus_files[0]); ++f)
+    {
+        BufferPtr data = read_binary(std::string(COMP_TESTDATA_DIR) + corpus_files[f]);
+        for (size_t off = 0; off < data->size(); off += chunk)
+            ret.push_back(make_packet(data->c_data() + off,
+                                      std::min(chunk, data->size() - off),
+                                      static_cast<std::uint16_t>(CORPUS_PORT + f)));
+    }
+    return ret;
+}
+
+// one flow of full-sized packets of pseudo-random bytes, like
+// TLS or QUIC payload
+PacketList random_packets(const size_t mtu, const size_t n)
+{
+    PacketList ret;
+    std::vector<unsigned char> payload(mtu - IP_UDP_HEADER);
+    std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+    for (size_t i = 0; i < n; ++i)
+    {
+        for (auto &c : payload)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            c = static_cast<unsigned char>(seed);
+        }
+        ret.push_back(make_packet(payload.data(), payload.size(), RANDOM_PORT));
+    }
+    return ret;
+}
+
+// corpus and random packets interleaved 1:1
+PacketList mixed_packets(const PacketList &corpus, const PacketList &random)
+{
+    PacketList ret;
+    for (size_t i = 0; i < corpus.size() || i < random.size(); ++i)
+    {
+        if (i < corpus.size())
+            ret.push_back(corpus[i]);
+        if (i < random.size())
+            ret.push_back(random[i]);
+    }
+    return ret;
+}
+
+struct Result
+{
+    size_t packets = 0;
+    size_t bytes_in = 0;
+    size_t bytes_out = 0;
+    count_t bypassed = 0;
+    std::uint64_t compress_ns = 0;
+    std::uint64_t decompress_ns = 0;
+    LogLinearHistogram latency; // per-packet compress ns
+};
+
+std::uint64_t elapsed_ns(const std::chrono::steady_clock::time_point &t0)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+}
+
+bool run(const char *name, const PacketList &packets, const Options &opt, const Frame::Ptr &frame, Result &result)
+{
+    // fresh compressor state, so that every run learns its flows from scratch
+    SessionStats::Ptr stats(new SessionStats());
+    Pair pair;
+    for (auto &p : make_pairs(frame, stats))
+        if (!std::strcmp(p.name, name))
+            pair = p;
+
+    const Frame::Context &fc = (*frame)[Frame::DECRYPT_WORK];
+    BufferAllocated buf;
+    const std::uint64_t budget = std::uint64_t(opt.time_ms) * 1000000;
+    while (result.compress_ns + result.decompress_ns < budget)
+    {
+        for (const auto &pkt : packets)
+        {
+            fc.prepare(buf);
+            buf.write(pkt.c_data(), pkt.size());
+
+            auto t0 = std::chrono::steady_clock::now();
+            pair.compress->compress(buf, true);
+            const std::uint64_t ns = elapsed_ns(t0);
+            result.compress_ns += ns;
+            result.latency.record(ns);
+            result.bytes_out += buf.size();
+
+            t0 = std::chrono::steady_clock::now();
+            pair.decompress->decompress(buf);
+            result.decompress_ns += elapsed_ns(t0);
+
+            if (buf.size() != pkt.size() || std::memcmp(buf.c_data(), pkt.c_data(), pkt.size()))
+            {
+                OPENVPN_LOG(name << ": round trip failed");
+                return false;
+            }
+            ++result.packets;
+            result.bytes_in += pkt.size();
+        }
+    }
+    result.bypassed = stats->get_stat(SessionStats::COMPRESS_BYPASS);
+    return true;
+}
+
+double mbps(const size_t bytes, const std::uint64_t ns)
+{
+    return ns ? bytes * 1e3 / ns : 0.0;
+}
+
+void write_direction(Bench::JSONWriter &j, const char *name, const std::uint64_t ns, const Result &r)
+{
+    j.key(name).begin_object();
+    j.key("mbps").value(mbps(r.bytes_in, ns));
+    j.key("ns_per_packet").value(double(ns) / r.packets);
+    j.end_object();
+}
+
+Options parse_args(int argc, char *argv[])
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--quick")
+        {
+            opt.quick = true;
+            opt.time_ms = 20;
+        }
+        else if (arg == "--time" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.time_ms))
+                throw usage();
+        }
+        else if (arg == "--mtu" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.mtu) || opt.mtu < 576 || opt.mtu > 9000)
+                throw usage();
+        }
+        else if (arg == "--compressor" && i + 1 < argc)
+            opt.compressor = argv[++i];
+        else if (arg == "--dataset" && i + 1 < argc)
+            opt.dataset = argv[++i];
+        else
+            throw usage();
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    try
+    {
+        opt = parse_args(argc, argv);
+    }
+    catch (const usage &)
+    {
+        std::cerr << "usage: compressionBench [--quick] [--time ms] [--mtu 576..9000] [--compressor name] [--dataset corpus|random|mixed]" << std::endl;
+        return 2;
+    }
+
+    CompressContext::init_static();
+    const Frame::Ptr frame = frame_init_simple(PAYLOAD);
+
+    struct Dataset
+    {
+        const char *name;
+        PacketList packets;
+    };
+    std::vector<Dataset> datasets;
+    try
+    {
+        PacketList corpus = corpus_packets(opt.mtu);
+        PacketList random = random_packets(opt.mtu, opt.quick ? 256 : 2048);
+        PacketList mixed = mixed_packets(corpus, random);
+        datasets.push_back({"corpus", std::move(corpus)});
+        datasets.push_back({"random", std::move(random)});
+        datasets.push_back({"mixed", std::move(mixed)});
+    }
+    catch (const std::exception &e)
+    {
+        OPENVPN_LOG("cannot read corpus from " << COMP_TESTDATA_DIR << ": " << e.what());
+        return 1;
+    }
+
+    bool ok = true;
+    Bench::JSONWriter j(std::cout);
+    j.begin_object();
+    j.key("benchmark").value("compressionBench");
+    j.key("mtu").value(opt.mtu);
+    j.key("results").begin_array();
+    for (const auto &pair : make_pairs(frame, new SessionStats()))
+    {
+        if (!opt.compressor.empty() && opt.compressor != pair.name)
+            continue;
+        for (const auto &ds : datasets)
+        {
+            if (!opt.dataset.empty() && opt.dataset != ds.name)
+                continue;
+
+            Result r;
+            try
+            {
+                if (!run(pair.name, ds.packets, opt, frame, r))
+                {
+                    ok = false;
+                    continue;
+                }
+            }
+            catch (const std::exception &e)
+            {
+                OPENVPN_LOG(pair.name << ": " << e.what());
+                ok = false;
+                continue;
+            }
+
+            const LogLinearHistogram::Snapshot lat = r.latency.snapshot();
+            const double ratio = double(r.bytes_out) / r.bytes_in;
+            j.begin_object();
+            j.key("compressor").value(pair.name);
+            j.key("dataset").value(ds.name);
+            j.key("packets").value(r.packets);
+            j.key("bytes").value(r.bytes_in);
+            j.key("ratio").value(ratio);
+            j.key("bypassed_packets").value(r.bypassed);
+            write_direction(j, "compress", r.compress_ns, r);
+            write_direction(j, "decompress", r.decompress_ns, r);
+            j.key("p50_ns").value(lat.percentile(50.0));
+            j.key("p99_ns").value(lat.percentile(99.0));
+            j.end_object();
+
+            OPENVPN_LOG(pair.name << " dataset=" << ds.name
+                                  << " ratio=" << ratio
+                                  << " comp=" << mbps(r.bytes_in, r.compress_ns) << "MB/s"
+                                  << " decomp=" << mbps(r.bytes_in, r.decompress_ns) << "MB/s"
+                                  << " p50=" << lat.percentile(50.0) << "ns"
+                                  << " p99=" << lat.percentile(99.0) << "ns");
+        }
+    }
+    j.end_array();
+    j.end_object();
+    std::cout << std::endl;
+
+    return ok ? 0 : 1;
+}
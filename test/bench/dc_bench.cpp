@@ -0,0 +1,397 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// Data channel microbenchmark.
+//
+// Measures packets/sec and ns/packet of the data channel crypto
+// (AEAD::Crypto and CryptoCHM) for a range of packet sizes, with and
+// without compression and MSS fixing, using the SSL library selected
+// at build time.  Results are written to stdout as JSON, progress to
+// stderr.
+//
+//   dataChannelBench [--quick] [--time ms] [--cipher name] [--size n]
+
+#define OPENVPN_LOG_STREAM std::cerr
+#include <openvpn/log/logsimple.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <openvpn/common/exception.hpp>
+#include <openvpn/common/number.hpp>
+#include <openvpn/ssl/sslchoose.hpp>
+#include <openvpn/crypto/cryptoalgs.hpp>
+#include <openvpn/crypto/crypto_aead.hpp>
+#include <openvpn/crypto/crypto_chm.hpp>
+#include <openvpn/compress/compress.hpp>
+#include <openvpn/frame/frame_init.hpp>
+#include <openvpn/transport/mssfix.hpp>
+#include <openvpn/ip/ip4.hpp>
+#include <openvpn/ip/tcp.hpp>
+#include <openvpn/ip/csum.hpp>
+#include <openvpn/log/sessionstats.hpp>
+
+#include "bench_common.hpp"
+
+using namespace openvpn;
+
+namespace {
+
+OPENVPN_SIMPLE_EXCEPTION(usage);
+
+struct CipherSpec
+{
+    const char *name;
+    CryptoAlgs::Type cipher;
+    CryptoAlgs::Type digest; // NONE for AEAD
+};
+
+const CipherSpec ciphers[] = {
+    {"AES-128-GCM", CryptoAlgs::AES_128_GCM, CryptoAlgs::NONE},
+    {"AES-256-GCM", CryptoAlgs::AES_256_GCM, CryptoAlgs::NONE},
+    {"CHACHA20-POLY1305", CryptoAlgs::CHACHA20_POLY1305, CryptoAlgs::NONE},
+    {"AES-128-CBC/SHA1", CryptoAlgs::AES_128_CBC, CryptoAlgs::SHA1},
+    {"AES-256-CBC/SHA256", CryptoAlgs::AES_256_CBC, CryptoAlgs::SHA256},
+};
+
+const size_t all_sizes[] = {64, 128, 256, 512, 1024, 1400, 1500, 4096, 9000};
+const size_t quick_sizes[] = {64, 1400, 9000};
+
+struct Options
+{
+    bool quick = false;
+    unsigned int time_ms = 300;
+    std::string cipher;
+    size_t size = 0;
+};
+
+struct Variant
+{
+    const char *compress; // "none" or a CompressContext method
+    bool mssfix;          // send SYNs with an MSS option for MSSFix to clamp
+};
+
+struct Result
+{
+    size_t packets = 0;
+    size_t bytes = 0;
+    Bench::Stopwatch encrypt;
+    Bench::Stopwatch decrypt;
+};
+
+enum
+{
+    BATCH = 64,
+    MSS = 1360,
+    PEER_MSS = 1460,
+    PAYLOAD = 9000 + 512,
+};
+
+// A TCP/IPv4 packet of the given total size carrying text, so that
+// compression has something to work with.  With syn set, the packet
+// is a SYN carrying an MSS option above MSS, so that MSSFix rewrites
+// it rather than returning early as it does for non-SYN packets.
+BufferAllocated make_packet(const size_t size, const std::uint32_t seq, const bool syn)
+{
+    static const char text[] = "Lorem ipsum dolor sit amet, consectetur adipisici elit, sed eiusmod "
+                               "tempor incidunt ut labore et dolore magna aliqua. ";
+    BufferAllocated buf(size, BufferAllocated::ARRAY);
+    std::memset(buf.data(), 0, size);
+
+    IPv4Header *ip = (IPv4Header *)buf.data();
+    ip->version_len = IPv4Header::ver_len(4, sizeof(IPv4Header));
+    ip->tot_len = htons(static_cast<std::uint16_t>(size));
+    ip->ttl = 64;
+    ip->protocol = IPCommon::TCP;
+    ip->saddr = htonl(0x0a080001);
+    ip->daddr = htonl(0x0a080002);
+    ip->check = IPChecksum::checksum(ip, sizeof(IPv4Header));
+
+    TCPHeader *tcp = (TCPHeader *)(buf.data() + sizeof(IPv4Header));
+    tcp->source = htons(40000);
+    tcp->dest = htons(443);
+    tcp->seq = htonl(seq);
+    tcp->flags = 0x10; // ACK
+    tcp->window = htons(65535);
+
+    size_t hdr = sizeof(IPv4Header) + sizeof(TCPHeader);
+    size_t tcp_hdr = sizeof(TCPHeader);
+    if (syn && size >= hdr + TCPHeader::OPTLEN_MAXSEG)
+    {
+        tcp->flags |= TCPHeader::FLAG_SYN;
+        buf[hdr] = TCPHeader::OPT_MAXSEG;
+        buf[hdr + 1] = TCPHeader::OPTLEN_MAXSEG;
+        buf[hdr + 2] = PEER_MSS >> 8;
+        buf[hdr + 3] = PEER_MSS & 0xff;
+        hdr += TCPHeader::OPTLEN_MAXSEG;
+        tcp_hdr += TCPHeader::OPTLEN_MAXSEG;
+    }
+    tcp->doff_res = static_cast<std::uint8_t>((tcp_hdr / 4) << 4);
+
+    for (size_t i = hdr; i < size; ++i)
+        buf[i] = text[(i - hdr) % (sizeof(text) - 1)];
+    return buf;
+}
+
+class Channel
+{
+  public:
+    Channel(const CipherSpec &spec, const Variant &variant, const Frame::Ptr &frame_arg)
+        : frame(frame_arg),
+          stats(new SessionStats()),
+          mssfix(variant.mssfix)
+    {
+        if (spec.digest == CryptoAlgs::NONE)
+            crypto.reset(new AEAD::Crypto<SSLLib::CryptoAPI>(nullptr, spec.cipher, frame, stats));
+        else
+            crypto.reset(new CryptoCHM<SSLLib::CryptoAPI>(nullptr, spec.cipher, spec.digest, frame, stats, new SSLLib::RandomAPI()));
+
+        unsigned char key[OpenVPNStaticKey::KEY_SIZE / 4];
+        for (size_t i = 0; i < sizeof(key); ++i)
+            key[i] = static_cast<unsigned char>(i * 13 + 7);
+        crypto->init_cipher(StaticKey(key, sizeof(key)), StaticKey(key, sizeof(key)));
+        crypto->init_hmac(StaticKey(key, sizeof(key)), StaticKey(key, sizeof(key)));
+        crypto->init_pid(PacketID::SHORT_FORM, PacketIDReceive::UDP_MODE, PacketID::SHORT_FORM, "DATA", 0, stats);
+
+        if (std::strcmp(variant.compress, "none"))
+        {
+            CompressContext cc(CompressContext::parse_method(variant.compress), false);
+            compress = cc.new_compressor(frame, stats);
+        }
+    }
+
+    // encrypt a batch of plaintext packets in place
+    void encrypt(BufferAllocated *bufs, const size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (mssfix)
+                MSSFix::mssfix(bufs[i], MSS);
+            if (compress)
+                compress->compress(bufs[i], true);
+            crypto->encrypt(bufs[i], now, op32);
+        }
+    }
+
+    // decrypt a batch of packets in place, returns false on error
+    bool decrypt(BufferAllocated *bufs, const size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (crypto->decrypt(bufs[i], now, op32) != Error::SUCCESS)
+                return false;
+            if (compress)
+                compress->decompress(bufs[i]);
+        }
+        return true;
+    }
+
+  private:
+    Frame::Ptr frame;
+    SessionStats::Ptr stats;
+    CryptoDCInstance::Ptr crypto;
+    Compress::Ptr compress;
+    const bool mssfix;
+    const PacketID::time_t now = 1;
+    const unsigned char op32[4] = {0x48, 0, 0, 1};
+};
+
+bool run(const CipherSpec &spec,
+         const Variant &variant,
+         const size_t size,
+         const Options &opt,
+         const Frame::Ptr &frame,
+         Result &result)
+{
+    Channel chan(spec, variant, frame);
+    const Frame::Context &fc = (*frame)[Frame::READ_TUN];
+
+    std::vector<BufferAllocated> plain;
+    for (size_t i = 0; i < BATCH; ++i)
+        plain.push_back(make_packet(size, static_cast<std::uint32_t>(i * size), variant.mssfix));
+
+    // what the peer should get back, with the MSS clamped
+    BufferAllocated expect(plain[0]);
+    if (variant.mssfix)
+        MSSFix::mssfix(expect, MSS);
+
+    BufferAllocated bufs[BATCH];
+    const std::uint64_t budget = std::uint64_t(opt.time_ms) * 1000000;
+    while (result.encrypt.ns() + result.decrypt.ns() < budget)
+    {
+        for (size_t i = 0; i < BATCH; ++i)
+        {
+            fc.prepare(bufs[i]);
+            bufs[i].write(plain[i].c_data(), plain[i].size());
+        }
+
+        result.encrypt.start();
+        chan.encrypt(bufs, BATCH);
+        result.encrypt.stop();
+
+        result.decrypt.start();
+        const bool ok = chan.decrypt(bufs, BATCH);
+        result.decrypt.stop();
+
+        if (!ok || bufs[0].size() != size || std::memcmp(bufs[0].c_data(), expect.c_data(), size))
+        {
+            OPENVPN_LOG(spec.name << ": round trip failed for size " << size);
+            return false;
+        }
+        result.packets += BATCH;
+        result.bytes += BATCH * size;
+    }
+    return true;
+}
+
+void write_direction(Bench::JSONWriter &j, const char *name, const Bench::Stopwatch &sw, const Result &r)
+{
+    const double secs = sw.seconds();
+    j.key(name).begin_object();
+    j.key("pps").value(r.packets / secs);
+    j.key("ns_per_packet").value(double(sw.ns()) / r.packets);
+    j.key("gbps").value(r.bytes * 8 / secs / 1e9);
+    j.end_object();
+}
+
+Options parse_args(int argc, char *argv[])
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--quick")
+        {
+            opt.quick = true;
+            opt.time_ms = 20;
+        }
+        else if (arg == "--time" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.time_ms))
+                throw usage();
+        }
+        else if (arg == "--cipher" && i + 1 < argc)
+            opt.cipher = argv[++i];
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.size) || opt.size < sizeof(IPv4Header) + sizeof(TCPHeader) || opt.size > 9000)
+                throw usage();
+        }
+        else
+            throw usage();
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    try
+    {
+        opt = parse_args(argc, argv);
+    }
+    catch (const usage &)
+    {
+        std::cerr << "usage: dataChannelBench [--quick] [--time ms] [--cipher name] [--size 40..9000]" << std::endl;
+        return 2;
+    }
+
+    std::vector<size_t> sizes;
+    if (opt.size)
+        sizes.push_back(opt.size);
+    else if (opt.quick)
+        sizes.assign(std::begin(quick_sizes), std::end(quick_sizes));
+    else
+        sizes.assign(std::begin(all_sizes), std::end(all_sizes));
+
+    std::vector<Variant> variants = {{"none", false}, {"none", true}, {"stub-v2", false}};
+    if (CompressContext::compressor_available(CompressContext::LZ4v2))
+    {
+        variants.push_back({"lz4-v2", false});
+        variants.push_back({"lz4-v2", true});
+    }
+
+    const Frame::Ptr frame = frame_init_simple(PAYLOAD);
+    bool ok = true;
+
+    Bench::JSONWriter j(std::cout);
+    j.begin_object();
+    j.key("benchmark").value("dataChannelBench");
+    j.key("ssl_library").value(SSL_LIB_NAME);
+    j.key("results").begin_array();
+    for (const auto &spec : ciphers)
+    {
+        if (!opt.cipher.empty() && opt.cipher != spec.name)
+            continue;
+        if (!SSLLib::CryptoAPI::CipherContextAEAD::is_supported(nullptr, spec.cipher)
+            && !SSLLib::CryptoAPI::CipherContext::is_supported(nullptr, spec.cipher))
+        {
+            OPENVPN_LOG(spec.name << ": not supported by " << SSL_LIB_NAME << ", skipped");
+            continue;
+        }
+        for (const auto &variant : variants)
+        {
+            for (const size_t size : sizes)
+            {
+                Result r;
+                try
+                {
+                    if (!run(spec, variant, size, opt, frame, r))
+                    {
+                        ok = false;
+                        continue;
+                    }
+                }
+                catch (const std::exception &e)
+                {
+                    OPENVPN_LOG(spec.name << ": " << e.what());
+                    ok = false;
+                    continue;
+                }
+
+                j.begin_object();
+                j.key("cipher").value(spec.name);
+                j.key("size").value(size);
+                j.key("compress").value(variant.compress);
+                j.key("mssfix").value(variant.mssfix);
+                j.key("packets").value(r.packets);
+                write_direction(j, "encrypt", r.encrypt, r);
+                write_direction(j, "decrypt", r.decrypt, r);
+                j.end_object();
+
+                OPENVPN_LOG(spec.name << " size=" << size
+                                      << " compress=" << variant.compress
+                                      << " mssfix=" << variant.mssfix
+                                      << " enc=" << (r.encrypt.ns() / r.packets) << "ns/pkt"
+                                      << " dec=" << (r.decrypt.ns() / r.packets) << "ns/pkt");
+            }
+        }
+    }
+    j.end_array();
+    j.end_object();
+    std::cout << std::endl;
+
+    return ok ? 0 : 1;
+}
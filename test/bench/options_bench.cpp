@@ -0,0 +1,239 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// OptionList parsing benchmark.
+//
+// Parses a synthetic client profile with many route directives and
+// inline certificates, and a large comma-separated push reply, the
+// way the client does at startup and on PUSH_REPLY: parse, build the
+// option index and look up directives.  Reports parses per second
+// and MB/s.  Results are written to stdout as JSON, progress to
+// stderr.
+//
+//   optionsBench [--quick] [--time ms] [--routes n]
+
+#define OPENVPN_LOG_STREAM std::cerr
+#include <openvpn/log/logsimple.hpp>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <openvpn/common/exception.hpp>
+#include <openvpn/common/number.hpp>
+#include <openvpn/common/options.hpp>
+
+#include "bench_common.hpp"
+
+using namespace openvpn;
+
+namespace {
+
+OPENVPN_SIMPLE_EXCEPTION(usage);
+
+struct Options
+{
+    bool quick = false;
+    unsigned int time_ms = 300;
+    unsigned int routes = 5000;
+};
+
+const char *const lookups[] = {"client", "dev", "remote", "route", "cipher", "ca", "cert", "key", "verb", "nonexistent"};
+
+// one base64-like line of a PEM body
+std::string pem_line(const unsigned int i)
+{
+    static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string ret;
+    for (unsigned int j = 0; j < 64; ++j)
+        ret += b64[(i * 31 + j * 7) % 64];
+    return ret;
+}
+
+void inline_block(std::ostringstream &os, const char *tag, const char *type, const unsigned int lines)
+{
+    os << '<' << tag << ">\n-----BEGIN " << type << "-----\n";
+    for (unsigned int i = 0; i < lines; ++i)
+        os << pem_line(i) << '\n';
+    os << "-----END " << type << "-----\n</" << tag << ">\n";
+}
+
+std::string make_config(const unsigned int routes)
+{
+    std::ostringstream os;
+    os << "# generated profile\n"
+          "client\n"
+          "dev tun\n"
+          "proto udp\n"
+          "remote vpn.example.com 1194\n"
+          "remote vpn2.example.com 443 tcp\n"
+          "nobind\n"
+          "persist-key\n"
+          "cipher AES-256-GCM\n"
+          "verb 3\n"
+          "setenv UV_ID \"quoted value\"\n";
+    for (unsigned int i = 0; i < routes; ++i)
+        os << "route 10." << (i >> 8 & 0xff) << '.' << (i & 0xff) << ".0 255.255.255.0 ; route " << i << "\r\n";
+    inline_block(os, "ca", "CERTIFICATE", 400);
+    inline_block(os, "cert", "CERTIFICATE", 30);
+    inline_block(os, "key", "PRIVATE KEY", 26);
+    return os.str();
+}
+
+std::string make_push_reply(const unsigned int routes)
+{
+    std::ostringstream os;
+    os << "route-gateway 10.8.0.1,topology subnet,ping 10,ping-restart 60,ifconfig 10.8.0.2 255.255.255.0,peer-id 0,cipher AES-256-GCM";
+    for (unsigned int i = 0; i < routes; ++i)
+        os << ",route 172." << (16 + (i >> 8 & 0xf)) << '.' << (i & 0xff) << ".0 255.255.255.0";
+    os << ",dhcp-option DNS 10.8.0.1,dhcp-option DOMAIN example.com";
+    return os.str();
+}
+
+struct Result
+{
+    size_t parses = 0;
+    size_t bytes = 0;
+    size_t options = 0;
+    size_t found = 0;
+    Bench::Stopwatch sw;
+};
+
+template <typename PARSE>
+void run(const std::string &input, const Options &opt, PARSE parse, Result &r)
+{
+    const std::uint64_t budget = std::uint64_t(opt.time_ms) * 1000000;
+    while (r.sw.ns() < budget)
+    {
+        r.sw.start();
+        OptionList::Limits lim("options too large", 64 * 1024 * 1024, 64, 16, 16 * 1024, 256);
+        OptionList ol = parse(input, &lim);
+        for (const char *name : lookups)
+            r.found += ol.exists(name);
+        r.sw.stop();
+
+        r.options = ol.size();
+        ++r.parses;
+        r.bytes += input.size();
+    }
+}
+
+Options parse_args(int argc, char *argv[])
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--quick")
+        {
+            opt.quick = true;
+            opt.time_ms = 20;
+            opt.routes = 500;
+        }
+        else if (arg == "--time" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.time_ms))
+                throw usage();
+        }
+        else if (arg == "--routes" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.routes))
+                throw usage();
+        }
+        else
+            throw usage();
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    try
+    {
+        opt = parse_args(argc, argv);
+    }
+    catch (const usage &)
+    {
+        std::cerr << "usage: optionsBench [--quick] [--time ms] [--routes n]" << std::endl;
+        return 2;
+    }
+
+    struct Case
+    {
+        const char *name;
+        std::string input;
+        OptionList (*parse)(const std::string &, OptionList::Limits *);
+        size_t expect; // number of options
+    };
+    const Case cases[] = {
+        {"config", make_config(opt.routes), OptionList::parse_from_config_static, 13 + size_t(opt.routes)},
+        {"push_reply", make_push_reply(opt.routes), OptionList::parse_from_csv_static, 9 + size_t(opt.routes)},
+    };
+
+    bool ok = true;
+    Bench::JSONWriter j(std::cout);
+    j.begin_object();
+    j.key("benchmark").value("optionsBench");
+    j.key("routes").value(opt.routes);
+    j.key("results").begin_array();
+    for (const auto &c : cases)
+    {
+        Result r;
+        try
+        {
+            run(c.input, opt, c.parse, r);
+        }
+        catch (const std::exception &e)
+        {
+            OPENVPN_LOG(c.name << ": " << e.what());
+            ok = false;
+            continue;
+        }
+        if (r.options != c.expect)
+        {
+            OPENVPN_LOG(c.name << ": parsed " << r.options << " options, expected " << c.expect);
+            ok = false;
+        }
+
+        const double secs = r.sw.seconds();
+        j.begin_object();
+        j.key("input").value(c.name);
+        j.key("bytes").value(c.input.size());
+        j.key("options").value(r.options);
+        j.key("parses_per_sec").value(r.parses / secs);
+        j.key("us_per_parse").value(secs * 1e6 / r.parses);
+        j.key("mbps").value(r.bytes / secs / 1e6);
+        j.end_object();
+
+        OPENVPN_LOG(c.name << " bytes=" << c.input.size()
+                           << " options=" << r.options
+                           << " " << (secs * 1e6 / r.parses) << "us/parse"
+                           << " " << (r.bytes / secs / 1e6) << "MB/s");
+    }
+    j.end_array();
+    j.end_object();
+    std::cout << std::endl;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,535 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+//    If not, see <http://www.gnu.org/licenses/>.
+
+// End-to-end in-process ProtoContext benchmark.
+//
+// Like test/unittests/test_proto.cpp, a client and a server
+// ProtoContext are connected back to back in memory, with simulated
+// time, but over a lossless wire.  Two modes:
+//
+// * throughput (default): after the handshake, tun-side packets are
+//   passed through the full data path -- MSS fix, compression,
+//   data_encrypt on one side, packet_type and data_decrypt on the
+//   other -- in both directions, with keepalive housekeeping running.
+//   Reports Gbit/s and p50/p99 per-packet latency.
+//
+// * --handshakes: full TLS negotiations per second.
+//
+// Results are written to stdout as JSON, progress to stderr.
+//
+//   protoBench [--quick] [--time ms] [--size n] [--cipher name]
+//              [--compress method] [--handshakes] [--keycert-dir dir]
+
+#define OPENVPN_LOG_STREAM std::cerr
+#include <openvpn/log/logsimple.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <openvpn/common/exception.hpp>
+#include <openvpn/common/file.hpp>
+#include <openvpn/common/number.hpp>
+#include <openvpn/time/time.hpp>
+#include <openvpn/init/initprocess.hpp>
+#include <openvpn/frame/frame_init.hpp>
+#include <openvpn/ssl/sslchoose.hpp>
+#include <openvpn/ssl/proto.hpp>
+#include <openvpn/crypto/cryptodcsel.hpp>
+#include <openvpn/ip/ip4.hpp>
+#include <openvpn/ip/tcp.hpp>
+#include <openvpn/ip/csum.hpp>
+
+#include "bench_common.hpp"
+
+#ifndef TEST_KEYCERT_DIR
+#define TEST_KEYCERT_DIR "test/ssl/"
+#endif
+
+using namespace openvpn;
+
+namespace {
+
+OPENVPN_SIMPLE_EXCEPTION(usage);
+OPENVPN_EXCEPTION(bench_error);
+
+struct Options
+{
+    bool quick = false;
+    bool handshakes = false;
+    unsigned int time_ms = 1000;
+    size_t size = 0;
+    std::string cipher;
+    std::string compress = "none";
+    std::string keycert_dir = TEST_KEYCERT_DIR;
+};
+
+struct CipherSpec
+{
+    const char *cipher;
+    const char *digest;
+};
+
+const CipherSpec ciphers[] = {
+    {"AES-128-GCM", "SHA256"},
+    {"AES-256-GCM", "SHA256"},
+    {"CHACHA20-POLY1305", "SHA256"},
+    {"AES-256-CBC", "SHA256"},
+};
+
+const size_t all_sizes[] = {64, 512, 1400};
+const size_t quick_sizes[] = {1400};
+
+// one side of the connection, queues outgoing control packets
+class BenchProto : public ProtoContext
+{
+  public:
+    BenchProto(const ProtoConfig::Ptr &config, const SessionStats::Ptr &stats)
+        : ProtoContext(config, stats)
+    {
+    }
+
+    void check_invalidated()
+    {
+        if (invalidated())
+            throw bench_error(std::string("session invalidated: ") + Error::name(invalidation_reason()));
+    }
+
+    std::deque<BufferPtr> net_out;
+
+  private:
+    void control_net_send(const Buffer &net_buf) override
+    {
+        net_out.push_back(BufferPtr(new BufferAllocated(net_buf, 0)));
+    }
+
+    void control_recv(BufferPtr &&app_bp) override
+    {
+    }
+
+    void client_auth(Buffer &buf) override
+    {
+        write_auth_string(std::string("foo"), buf);
+        write_auth_string(std::string("bar"), buf);
+    }
+
+    void server_auth(const std::string &username,
+                     const SafeString &password,
+                     const std::string &peer_info,
+                     const AuthCert::Ptr &auth_cert) override
+    {
+    }
+};
+
+// Client and server configuration and state shared between runs
+class Setup
+{
+    StrongRandomAPI::Ptr rng;
+    StrongRandomAPI::Ptr prng;
+
+  public:
+    Setup(const Options &opt, const CipherSpec &spec)
+        : rng(new SSLLib::RandomAPI()),
+          prng(new SSLLib::RandomAPI()),
+          frame(frame_init(true, 9000, 1250, false)),
+          cli_stats(new SessionStats()),
+          serv_stats(new SessionStats())
+    {
+        const std::string dir = opt.keycert_dir;
+        const std::string ca_crt = read_text(dir + "ca.crt");
+
+        SSLLib::SSLAPI::Config::Ptr cc(new SSLLib::SSLAPI::Config());
+        cc->set_mode(Mode(Mode::CLIENT));
+        cc->set_frame(frame);
+        cc->load_ca(ca_crt, true);
+        cc->load_cert(read_text(dir + "client.crt"));
+        cc->load_private_key(read_text(dir + "client.key"));
+        cc->set_tls_version_min(TLSVersion::Type::V1_2);
+        cc->set_rng(rng);
+
+        SSLLib::SSLAPI::Config::Ptr sc(new SSLLib::SSLAPI::Config());
+        sc->set_mode(Mode(Mode::SERVER));
+        sc->set_frame(frame);
+        sc->load_ca(ca_crt, true);
+        sc->load_cert(read_text(dir + "server.crt"));
+        sc->load_private_key(read_text(dir + "server.key"));
+        sc->load_dh(read_text(dir + "dh.pem"));
+        sc->set_tls_version_min(TLSVersion::Type::V1_2);
+        sc->set_rng(rng);
+
+        cp = proto_config(cc, cli_stats, opt, spec);
+        sp = proto_config(sc, serv_stats, opt, spec);
+        cp->remote_peer_id = 100;
+        sp->remote_peer_id = 101;
+    }
+
+    Frame::Ptr frame;
+    Time time;
+    ProtoContext::ProtoConfig::Ptr cp;
+    ProtoContext::ProtoConfig::Ptr sp;
+    SessionStats::Ptr cli_stats;
+    SessionStats::Ptr serv_stats;
+
+  private:
+    ProtoContext::ProtoConfig::Ptr proto_config(SSLLib::SSLAPI::Config::Ptr ssl,
+                                                const SessionStats::Ptr &stats,
+                                                const Options &opt,
+                                                const CipherSpec &spec)
+    {
+        ProtoContext::ProtoConfig::Ptr c(new ProtoContext::ProtoConfig);
+        c->ssl_factory = ssl->new_factory();
+        CryptoAlgs::allow_default_dc_algs<SSLLib::CryptoAPI>(c->ssl_factory->libctx(), false, false);
+        c->dc.set_factory(new CryptoDCSelect<SSLLib::CryptoAPI>(c->ssl_factory->libctx(), frame, stats, prng));
+        c->tlsprf_factory.reset(new CryptoTLSPRFFactory<SSLLib::CryptoAPI>());
+        c->frame = frame;
+        c->now = &time;
+        c->rng = rng;
+        c->prng = prng;
+        c->protocol = Protocol(Protocol::UDPv4);
+        c->layer = Layer(Layer::OSI_LAYER_3);
+        c->enable_op32 = true;
+        c->comp_ctx = CompressContext(CompressContext::parse_method(opt.compress), false);
+        c->dc.set_cipher(CryptoAlgs::lookup(spec.cipher));
+        c->dc.set_digest(CryptoAlgs::lookup(spec.digest));
+        c->pid_mode = PacketIDReceive::UDP_MODE;
+        c->handshake_window = Time::Duration::seconds(60);
+        c->become_primary = Time::Duration::seconds(10);
+        c->tls_timeout = Time::Duration::milliseconds(2000);
+        c->renegotiate = Time::Duration::infinite();
+        c->expire = Time::Duration::infinite();
+        c->keepalive_ping = Time::Duration::seconds(5);
+        c->keepalive_timeout = Time::Duration::seconds(60);
+        c->keepalive_timeout_early = c->keepalive_timeout;
+        return c;
+    }
+};
+
+// Run housekeeping on a, then move its queued control packets (and
+// any keepalives) to b.  Returns the number of packets moved.
+size_t xfer_control(BenchProto &a, BenchProto &b)
+{
+    a.check_invalidated();
+    if (a.now() >= a.next_housekeeping())
+        a.housekeeping();
+
+    size_t n = 0;
+    while (!a.net_out.empty())
+    {
+        BufferPtr bp = std::move(a.net_out.front());
+        a.net_out.pop_front();
+        const ProtoContext::PacketType pt = b.packet_type(*bp);
+        if (pt.is_control())
+            b.control_net_recv(pt, std::move(bp));
+        else if (pt.is_data())
+            b.data_decrypt(pt, *bp);
+        ++n;
+    }
+    b.flush(true);
+    return n;
+}
+
+// Run a full handshake to completion on both sides.
+void handshake(Setup &s, BenchProto &cli, BenchProto &serv)
+{
+    cli.reset();
+    serv.reset();
+    cli.conf().mss_parms.mssfix = MSSParms::MSSFIX_DEFAULT;
+    serv.conf().mss_parms.mssfix = MSSParms::MSSFIX_DEFAULT;
+    cli.start();
+    serv.start();
+    cli.flush(true);
+    for (int i = 0; i < 10000; ++i)
+    {
+        xfer_control(cli, serv);
+        xfer_control(serv, cli);
+        if (cli.data_channel_ready() && serv.data_channel_ready())
+            return;
+        s.time += Time::Duration::binary_ms(10);
+    }
+    throw bench_error("handshake did not complete");
+}
+
+// A TCP/IPv4 tun packet of the given size.  SYN packets carry an MSS
+// option, so that they go through MSS clamping on encrypt.
+void make_packet(BufferAllocated &buf, const Frame::Context &fc, const size_t size, const std::uint32_t seq, const bool syn)
+{
+    fc.prepare(buf);
+    unsigned char *p = buf.write_alloc(size);
+    std::memset(p, 'x', size);
+
+    IPv4Header *ip = (IPv4Header *)p;
+    std::memset(ip, 0, sizeof(IPv4Header));
+    ip->version_len = IPv4Header::ver_len(4, sizeof(IPv4Header));
+    ip->tot_len = htons(static_cast<std::uint16_t>(size));
+    ip->ttl = 64;
+    ip->protocol = IPCommon::TCP;
+    ip->saddr = htonl(0x0a080001);
+    ip->daddr = htonl(0x0a080002);
+    ip->check = IPChecksum::checksum(ip, sizeof(IPv4Header));
+
+    TCPHeader *tcp = (TCPHeader *)(p + sizeof(IPv4Header));
+    std::memset(tcp, 0, sizeof(TCPHeader));
+    tcp->source = htons(40000);
+    tcp->dest = htons(443);
+    tcp->seq = htonl(seq);
+    tcp->doff_res = (sizeof(TCPHeader) / 4) << 4;
+    tcp->flags = 0x10; // ACK
+    tcp->window = htons(65535);
+    if (syn && size >= sizeof(IPv4Header) + sizeof(TCPHeader) + 4)
+    {
+        unsigned char *opt = p + sizeof(IPv4Header) + sizeof(TCPHeader);
+        opt[0] = TCPHeader::OPT_MAXSEG;
+        opt[1] = TCPHeader::OPTLEN_MAXSEG;
+        opt[2] = 9000 >> 8;
+        opt[3] = 9000 & 0xff;
+        tcp->doff_res = ((sizeof(TCPHeader) + 4) / 4) << 4;
+        tcp->flags |= TCPHeader::FLAG_SYN;
+    }
+}
+
+struct Latency
+{
+    std::vector<std::uint32_t> ns;
+
+    std::uint32_t percentile(const double p)
+    {
+        if (ns.empty())
+            return 0;
+        const size_t i = std::min(ns.size() - 1, static_cast<size_t>(p * ns.size()));
+        std::nth_element(ns.begin(), ns.begin() + i, ns.end());
+        return ns[i];
+    }
+};
+
+void run_throughput(const Options &opt, const CipherSpec &spec, const size_t size, Bench::JSONWriter &j)
+{
+    Setup s(opt, spec);
+    BenchProto cli(s.cp, s.cli_stats);
+    BenchProto serv(s.sp, s.serv_stats);
+    handshake(s, cli, serv);
+
+    const Frame::Context &fc = (*s.frame)[Frame::READ_TUN];
+    // simulated time per batch, so that keepalives are exchanged
+    const Time::Duration step = Time::Duration::binary_ms(50);
+    const std::uint64_t budget = std::uint64_t(opt.time_ms) * 1000000;
+
+    BufferAllocated buf;
+    Latency lat;
+    lat.ns.reserve(1 << 20);
+    const auto begin = std::chrono::steady_clock::now();
+    std::uint64_t data_ns = 0;
+    size_t packets = 0;
+    size_t bytes = 0;
+    size_t control = 0;
+
+    while (std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count()) < budget)
+    {
+        // 64 packets in each direction per batch
+        for (int i = 0; i < 128; ++i)
+        {
+            BenchProto &a = (i & 1) ? serv : cli;
+            BenchProto &b = (i & 1) ? cli : serv;
+            make_packet(buf, fc, size, static_cast<std::uint32_t>(packets * size), i < 2);
+
+            const auto t0 = std::chrono::steady_clock::now();
+            a.data_encrypt(buf);
+            const ProtoContext::PacketType pt = b.packet_type(buf);
+            if (!pt.is_data() || !b.data_decrypt(pt, buf))
+                throw bench_error("data packet lost");
+            const auto t1 = std::chrono::steady_clock::now();
+
+            const std::uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+            data_ns += ns;
+            if (lat.ns.size() < lat.ns.capacity())
+                lat.ns.push_back(static_cast<std::uint32_t>(ns));
+            if (buf.size() != size)
+                throw bench_error("packet size changed in transit");
+            if (i < 2 && size >= sizeof(IPv4Header) + sizeof(TCPHeader) + 4
+                && buf[sizeof(IPv4Header) + sizeof(TCPHeader) + 2] == (9000 >> 8))
+                throw bench_error("MSS was not clamped");
+            ++packets;
+            bytes += size;
+        }
+
+        // keepalive and control channel housekeeping
+        s.time += step;
+        control += xfer_control(cli, serv);
+        control += xfer_control(serv, cli);
+    }
+
+    // rates cover the data path only, not packet generation or housekeeping
+    const double secs = data_ns * 1e-9;
+
+    j.begin_object();
+    j.key("mode").value("throughput");
+    j.key("cipher").value(spec.cipher);
+    j.key("compress").value(opt.compress);
+    j.key("size").value(size);
+    j.key("packets").value(packets);
+    j.key("control_packets").value(control);
+    j.key("gbps").value(bytes * 8 / secs / 1e9);
+    j.key("pps").value(packets / secs);
+    j.key("p50_ns").value(lat.percentile(0.50));
+    j.key("p99_ns").value(lat.percentile(0.99));
+    j.end_object();
+
+    OPENVPN_LOG(spec.cipher << " size=" << size << " compress=" << opt.compress
+                            << " " << (bytes * 8 / secs / 1e9) << " Gbit/s"
+                            << " p50=" << lat.percentile(0.50) << "ns"
+                            << " p99=" << lat.percentile(0.99) << "ns");
+}
+
+void run_handshakes(const Options &opt, const CipherSpec &spec, Bench::JSONWriter &j)
+{
+    Setup s(opt, spec);
+
+    Bench::Stopwatch sw;
+    Latency lat;
+    size_t n = 0;
+    const std::uint64_t budget = std::uint64_t(opt.time_ms) * 1000000;
+    while (sw.ns() < budget)
+    {
+        // each iteration is a new connection, with both sides starting
+        // from scratch
+        const auto t0 = std::chrono::steady_clock::now();
+        sw.start();
+        {
+            BenchProto cli(s.cp, s.cli_stats);
+            BenchProto serv(s.sp, s.serv_stats);
+            handshake(s, cli, serv);
+        }
+        sw.stop();
+        lat.ns.push_back(static_cast<std::uint32_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count()));
+        ++n;
+    }
+
+    j.begin_object();
+    j.key("mode").value("handshake");
+    j.key("cipher").value(spec.cipher);
+    j.key("handshakes").value(n);
+    j.key("per_second").value(n / sw.seconds());
+    j.key("p50_ns").value(lat.percentile(0.50));
+    j.key("p99_ns").value(lat.percentile(0.99));
+    j.end_object();
+
+    OPENVPN_LOG(spec.cipher << " handshakes=" << n << " " << (n / sw.seconds()) << "/s");
+}
+
+Options parse_args(int argc, char *argv[])
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        if (arg == "--quick")
+        {
+            opt.quick = true;
+            opt.time_ms = 50;
+        }
+        else if (arg == "--handshakes")
+            opt.handshakes = true;
+        else if (arg == "--time" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.time_ms))
+                throw usage();
+        }
+        else if (arg == "--size" && i + 1 < argc)
+        {
+            if (!parse_number(argv[++i], opt.size) || opt.size < sizeof(IPv4Header) + sizeof(TCPHeader) || opt.size > 9000)
+                throw usage();
+        }
+        else if (arg == "--cipher" && i + 1 < argc)
+            opt.cipher = argv[++i];
+        else if (arg == "--compress" && i + 1 < argc)
+            opt.compress = argv[++i];
+        else if (arg == "--keycert-dir" && i + 1 < argc)
+        {
+            opt.keycert_dir = argv[++i];
+            if (!opt.keycert_dir.empty() && opt.keycert_dir.back() != '/')
+                opt.keycert_dir += '/';
+        }
+        else
+            throw usage();
+    }
+    return opt;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    InitProcess::Init init;
+    Options opt;
+    try
+    {
+        opt = parse_args(argc, argv);
+    }
+    catch (const usage &)
+    {
+        std::cerr << "usage: protoBench [--quick] [--time ms] [--size 40..9000] [--cipher name]" << std::endl
+                  << "                  [--compress method] [--handshakes] [--keycert-dir dir]" << std::endl;
+        return 2;
+    }
+
+    std::vector<size_t> sizes;
+    if (opt.size)
+        sizes.push_back(opt.size);
+    else if (opt.quick)
+        sizes.assign(std::begin(quick_sizes), std::end(quick_sizes));
+    else
+        sizes.assign(std::begin(all_sizes), std::end(all_sizes));
+
+    bool ok = true;
+    Bench::JSONWriter j(std::cout);
+    j.begin_object();
+    j.key("benchmark").value("protoBench");
+    j.key("ssl_library").value(SSL_LIB_NAME);
+    j.key("results").begin_array();
+    for (const auto &spec : ciphers)
+    {
+        if (!opt.cipher.empty() && opt.cipher != spec.cipher)
+            continue;
+        if (opt.quick && opt.cipher.empty() && spec.cipher != ciphers[0].cipher)
+            continue;
+        try
+        {
+            if (opt.handshakes)
+                run_handshakes(opt, spec, j);
+            else
+                for (const size_t size : sizes)
+                    run_throughput(opt, spec, size, j);
+        }
+        catch (const std::exception &e)
+        {
+            OPENVPN_LOG(spec.cipher << ": " << e.what());
+            ok = false;
+        }
+    }
+    j.end_array();
+    j.end_object();
+    std::cout << std::endl;
+
+    return ok ? 0 : 1;
+}
@@ -1,6 +1,9 @@
 #include "test_common.h"
 
+#include <thread>
+
 #include <openvpn/buffer/bufstr.hpp>
+#include <openvpn/frame/frame_init.hpp>
 
 using namespace openvpn;
 
@@ -343,3 +346,100 @@ TEST(buffer, alloc_buffer_read1)
 
     EXPECT_EQ(memcmp(raw, data, sizeof(raw)), 0);
 }
+
+// pooled buffers recycle their data blocks through the thread's pool
+TEST(buffer, pool_hit_miss)
+{
+    BufferPool::purge();
+    BufferPool::reset_stats();
+    const unsigned char *data;
+    {
+        BufferAllocated buf(1000, BufferAllocated::POOL);
+        data = buf.c_data_raw();
+    }
+    EXPECT_EQ(BufferPool::stats().misses, 1u);
+    EXPECT_EQ(BufferPool::stats().recycled, 1u);
+    EXPECT_EQ(BufferPool::size(), 1u);
+
+    {
+        BufferAllocated buf(1000, BufferAllocated::POOL);
+        EXPECT_EQ(buf.c_data_raw(), data);
+        EXPECT_EQ(BufferPool::stats().hits, 1u);
+
+        // moved buffers keep their block and flags
+        BufferAllocated other(std::move(buf));
+        EXPECT_EQ(other.c_data_raw(), data);
+    }
+    EXPECT_EQ(BufferPool::size(), 1u);
+
+    // a different capacity gets its own size class
+    {
+        BufferAllocated buf(500, BufferAllocated::POOL);
+        EXPECT_EQ(BufferPool::stats().misses, 2u);
+    }
+    EXPECT_EQ(BufferPool::size(), 2u);
+
+    // grown buffers don't match a size class and are deleted
+    {
+        BufferAllocated buf(500, BufferAllocated::POOL | BufferAllocated::GROW);
+        EXPECT_EQ(BufferPool::stats().hits, 2u);
+        buf.write_alloc(3000);
+    }
+    EXPECT_EQ(BufferPool::stats().discarded, 1u);
+    EXPECT_EQ(BufferPool::size(), 2u);
+
+    // unpooled buffers don't touch the pool
+    {
+        BufferAllocated buf(1000, 0);
+    }
+    EXPECT_EQ(BufferPool::stats().hits, 2u);
+    EXPECT_EQ(BufferPool::stats().misses, 2u);
+
+    BufferPool::purge();
+    EXPECT_EQ(BufferPool::size(), 0u);
+}
+
+// frame contexts hand out pooled buffers of the standardized capacity
+TEST(buffer, pool_frame_context)
+{
+    Frame::Ptr frame = frame_init(false, 1500, 1024, false);
+    const Frame::Context &fc = (*frame)[Frame::READ_LINK_UDP];
+    EXPECT_TRUE(fc.buffer_flags() & BufferAllocated::POOL);
+
+    BufferPool::purge();
+    BufferPool::reset_stats();
+    for (int i = 0; i < 100; ++i)
+    {
+        BufferAllocated buf = fc.alloc();
+        buf_append_string(buf, "hello world");
+    }
+    EXPECT_EQ(BufferPool::stats().misses, 1u);
+    EXPECT_EQ(BufferPool::stats().hits, 99u);
+    BufferPool::purge();
+}
+
+// blocks may be released on another thread, and pools are per-thread
+TEST(buffer, pool_threads)
+{
+    BufferPool::purge();
+    BufferPool::reset_stats();
+    BufferAllocated buf(1000, BufferAllocated::POOL);
+
+    BufferPool::Stats stats;
+    std::thread thread([&buf, &stats]()
+                       {
+        // no size class yet on this thread
+        BufferAllocated b(std::move(buf));
+        b.clear();
+
+        BufferAllocated c(1000, BufferAllocated::POOL);
+        c.clear();
+        stats = BufferPool::stats(); });
+    thread.join();
+
+    EXPECT_EQ(stats.discarded, 1u);
+    EXPECT_EQ(stats.misses, 1u);
+    EXPECT_EQ(stats.recycled, 1u);
+    EXPECT_EQ(BufferPool::stats().recycled, 0u);
+    EXPECT_EQ(BufferPool::size(), 0u);
+}
@@ -269,3 +269,92 @@ TEST(Compression, lz4)
 }
 #endif
 } // namespace unittests
+
+namespace unittests {
+// Build an IPv4/UDP packet from src_port with payload_size bytes of
+// either random (incompressible) or repetitive payload.
+static void make_udp_packet(BufferAllocated &buf, const std::uint16_t src_port, const size_t payload_size, const bool random)
+{
+    static std::uint32_t seed = 1;
+    unsigned char hdr[28] = {0x45, 0, 0, 0, 0, 0, 0, 0, 64, IPCommon::UDP, 0, 0, 10, 8, 0, 2, 10, 8, 0, 1};
+    hdr[20] = static_cast<unsigned char>(src_port >> 8);
+    hdr[21] = static_cast<unsigned char>(src_port);
+    hdr[23] = 53;
+    buf.write(hdr, sizeof(hdr));
+    for (size_t i = 0; i < payload_size; ++i)
+    {
+        seed = seed * 1103515245 + 12345;
+        buf.push_back(random ? static_cast<unsigned char>(seed >> 16) : static_cast<unsigned char>('a' + i % 7));
+    }
+}
+
+TEST(Compression, adapt_flow)
+{
+    CompressAdapt::Flow flow;
+
+    // compressible flow is never bypassed
+    for (int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(flow.probe());
+        flow.update(1000, 500);
+    }
+
+    // once incompressible, it is bypassed for MIN_BACKOFF packets,
+    // then twice as long after each failed probe
+    int attempts = 0;
+    for (int i = 0; i < 1000; ++i)
+    {
+        if (flow.probe())
+        {
+            ++attempts;
+            flow.update(1000, 1000);
+        }
+    }
+    EXPECT_LT(attempts, 20);
+    EXPECT_TRUE(flow.bypassed() || flow.backoff);
+
+    // a successful probe restores normal compression
+    while (!flow.probe())
+        ;
+    flow.update(1000, 300);
+    EXPECT_EQ(flow.backoff, 0u);
+    EXPECT_TRUE(flow.probe());
+}
+
+#if defined(HAVE_LZ4)
+TEST(Compression, adapt_bypass)
+{
+    CompressContext::init_static();
+    MySessionStats::Ptr stats(new MySessionStats);
+    Frame::Ptr frame = frame_init(BLOCK_SIZE);
+    CompressLZ4 comp(frame, stats, false);
+
+    // interleave an incompressible flow with a compressible one
+    const int n = 500;
+    for (int i = 0; i < n; ++i)
+    {
+        for (const bool random : {true, false})
+        {
+            BufferAllocated pkt;
+            frame->prepare(Frame::DECRYPT_WORK, pkt);
+            make_udp_packet(pkt, random ? 443 : 1194, 1200, random);
+            BufferAllocated data(pkt);
+            comp.compress(data, true);
+            comp.decompress(data);
+            ASSERT_EQ(pkt, data);
+        }
+    }
+
+    EXPECT_EQ(stats->get_error_count(Error::COMPRESS_ERROR), 0);
+
+    // most of the incompressible packets skipped compression,
+    // the compressible flow was never bypassed
+    const count_t bypass = stats->get_stat(SessionStats::COMPRESS_BYPASS);
+    EXPECT_GT(bypass, n * 9 / 10);
+    EXPECT_LT(bypass, n);
+    EXPECT_GT(stats->get_stat(SessionStats::COMPRESS_BYTES_SAVED), n * 1000);
+    EXPECT_GT(stats->get_stat(SessionStats::COMPRESS_BYTES_IN), n * 1200);
+    EXPECT_GT(stats->get_stat(SessionStats::COMPRESS_NS), 0);
+}
+#endif
+} // namespace unittests
@@ -21,6 +21,7 @@
 // #define OPENVPN_BUFFER_ABORT
 
 #include <algorithm>
+#include <cstring>
 
 #include "test_common.h"
 
@@ -29,6 +30,8 @@
 
 #include <openvpn/options/continuation_fragment.hpp>
 #include <openvpn/options/continuation.hpp>
+#include <openvpn/options/pushcache.hpp>
+#include <openvpn/options/servpush.hpp>
 
 using namespace openvpn;
 
@@ -223,3 +226,109 @@ TEST(continuation, test2)
     }
 #endif
 }
+
+// Render a push list and per-client items the way a push reply
+// is built without the template cache.
+static std::vector<BufferPtr> push_reply_reference(const ServerPushList &common,
+                                                   const std::vector<std::string> &client_items)
+{
+    ServerPushList all = common;
+    all.extend(client_items);
+    std::ostringstream os;
+    os << "PUSH_REPLY";
+    all.output_csv(os);
+    const BufferPtr buf = buf_from_string(os.str());
+    if (!PushContinuationFragment::should_fragment(*buf))
+        return {buf};
+    return PushContinuationFragment(*buf);
+}
+
+static void require_equal(const std::vector<BufferPtr> &bv1, const std::vector<BufferPtr> &bv2)
+{
+    ASSERT_EQ(bv1.size(), bv2.size());
+    for (size_t i = 0; i < bv1.size(); ++i)
+        require_equal(*bv1[i], *bv2[i], "TEST_PUSH_TEMPLATE #" + std::to_string(i));
+}
+
+// template output must match fragmenting the full push list directly
+TEST(continuation, push_template)
+{
+    RandomAPI::Ptr prng(new MTRand);
+
+    for (int i = 0; i < 100; ++i)
+    {
+        ServerPushList common;
+        const OptionList opt = random_optionlist(*prng);
+        for (const auto &o : opt)
+            common.push_back(o.escape(false));
+        if (i == 0)
+            common.clear();
+
+        const std::vector<std::string> client_items = {
+            "ifconfig 10.8.0." + std::to_string(i + 2) + " 255.255.255.0",
+            "peer-id " + std::to_string(i),
+        };
+
+        const PushReplyTemplate tmpl(common, 1);
+        require_equal(push_reply_reference(common, client_items), tmpl.render(client_items));
+        require_equal(push_reply_reference(common, {}), tmpl.render({}));
+    }
+}
+
+// replies around FRAGMENT_SIZE are only fragmented if they don't fit
+TEST(continuation, push_template_boundary)
+{
+    const std::vector<std::string> client_items = {"peer-id 7"};
+    const std::string filler = "echo " + std::string(40, 'f');
+    const size_t base = std::strlen("PUSH_REPLY,echo ,peer-id 7") + 20 * (filler.size() + 1);
+    for (size_t size = PushContinuationFragment::FRAGMENT_SIZE - 30; size <= PushContinuationFragment::FRAGMENT_SIZE + 2; ++size)
+    {
+        ServerPushList common;
+        for (int i = 0; i < 20; ++i)
+            common.push_back(filler);
+        common.push_back("echo " + std::string(size - base, 'x'));
+
+        const PushReplyTemplate tmpl(common, 1);
+        const std::vector<BufferPtr> msgs = tmpl.render(client_items);
+        require_equal(push_reply_reference(common, client_items), msgs);
+        if (size <= PushContinuationFragment::FRAGMENT_SIZE)
+        {
+            ASSERT_EQ(1u, msgs.size());
+            ASSERT_EQ(size, msgs[0]->size());
+        }
+        else
+            ASSERT_EQ(2u, msgs.size());
+    }
+}
+
+TEST(continuation, push_template_cache)
+{
+    PushReplyCache cache;
+    ServerPushList group;
+    group.push_back("route 10.0.0.0 255.0.0.0");
+    group.push_back("echo a,b");
+    auto build = [&group]()
+    { return group; };
+
+    const PushReplyTemplate::Ptr t1 = cache.get("g", 1, build);
+    ASSERT_EQ(t1, cache.get("g", 1, build));
+    ASSERT_EQ(1u, cache.builds());
+
+    const std::vector<BufferPtr> msgs = t1->render({"ifconfig 10.8.0.2 255.255.255.0", "peer-id 7"});
+    ASSERT_EQ(1u, msgs.size());
+    ASSERT_EQ("PUSH_REPLY,route 10.0.0.0 255.0.0.0,\"echo a,b\",ifconfig 10.8.0.2 255.255.255.0,peer-id 7",
+              buf_to_string(*msgs[0]));
+
+    // new option-set version rebuilds, old template stays usable
+    group.push_back("ping 10");
+    const PushReplyTemplate::Ptr t2 = cache.get("g", 2, build);
+    ASSERT_NE(t1, t2);
+    ASSERT_EQ(2u, cache.builds());
+    ASSERT_EQ("PUSH_REPLY,route 10.0.0.0 255.0.0.0,\"echo a,b\",ping 10",
+              buf_to_string(*t2->render({})[0]));
+    ASSERT_EQ(1u, t1->render({}).size());
+
+    cache.invalidate("g");
+    cache.get("g", 2, build);
+    ASSERT_EQ(3u, cache.builds());
+}
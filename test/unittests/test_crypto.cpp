@@ -20,6 +20,7 @@
 //    If not, see <http://www.gnu.org/licenses/>.
 
 #include <iostream>
+#include <thread>
 
 #include "test_common.h"
 
@@ -172,3 +173,171 @@ TEST(crypto, dcaead)
 
     EXPECT_TRUE(std::memcmp(work.data(), plaintext, std::strlen(plaintext)) == 0);
 }
+
+TEST(crypto, dcaead_batch)
+{
+    auto frameptr = openvpn::Frame::Ptr{new openvpn::Frame{frame_ctx()}};
+    auto statsptr = openvpn::SessionStats::Ptr{new openvpn::SessionStats{}};
+
+    openvpn::AEAD::Crypto<openvpn::SSLLib::CryptoAPI> cryptodc{nullptr, openvpn::CryptoAlgs::AES_256_GCM, frameptr, statsptr};
+
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof(key); i++)
+        key[i] = static_cast<uint8_t>(i * 7);
+    uint8_t bigkey[openvpn::OpenVPNStaticKey::KEY_SIZE]{};
+    for (int i = 0; i < openvpn::OpenVPNStaticKey::KEY_SIZE; i++)
+        bigkey[i] = static_cast<uint8_t>(i);
+
+    cryptodc.init_cipher(openvpn::StaticKey{key, sizeof(key)}, openvpn::StaticKey{key, sizeof(key)});
+    cryptodc.init_hmac(openvpn::StaticKey{bigkey, sizeof(bigkey)}, openvpn::StaticKey{bigkey, sizeof(bigkey)});
+    cryptodc.init_pid(openvpn::PacketID::SHORT_FORM,
+                      0,
+                      openvpn::PacketID::SHORT_FORM,
+                      "DATA",
+                      0,
+                      statsptr);
+
+    constexpr size_t n = 8;
+    openvpn::BufferAllocated bufs[n];
+    for (size_t i = 0; i < n; i++)
+    {
+        bufs[i].init(2048, 0);
+        bufs[i].realign(128);
+        std::memset(bufs[i].write_alloc(100 + i), static_cast<int>(i), 100 + i);
+    }
+    /* an empty buffer in the batch must pass through untouched */
+    bufs[3].reset_size();
+
+    const openvpn::PacketID::time_t now = 42;
+    const unsigned char op32[]{7, 0, 0, 23};
+
+    ASSERT_FALSE(cryptodc.encrypt_batch(bufs, n, now, op32));
+
+    const unsigned char *op32s[n];
+    for (size_t i = 0; i < n; i++)
+    {
+        op32s[i] = op32;
+        if (i != 3)
+        {
+            EXPECT_EQ(bufs[i].size(), 100 + i + 4 + 16);
+        }
+    }
+    EXPECT_EQ(bufs[3].size(), 0u);
+
+    /* packet IDs are assigned in batch order, skipping empty buffers */
+    const uint8_t packetid5[]{0, 0, 0, 5};
+    EXPECT_TRUE(std::memcmp(bufs[5].data(), packetid5, 4) == 0);
+
+    /* keep a copy of one packet to check replay protection */
+    openvpn::BufferAllocated replay{bufs[2]};
+
+    openvpn::Error::Type errs[n];
+    cryptodc.decrypt_batch(bufs, n, now, op32s, errs);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        EXPECT_EQ(errs[i], openvpn::Error::SUCCESS);
+        if (i == 3)
+            continue;
+        ASSERT_EQ(bufs[i].size(), 100 + i);
+        for (size_t j = 0; j < bufs[i].size(); j++)
+            ASSERT_EQ(bufs[i][j], i);
+    }
+
+    EXPECT_EQ(cryptodc.decrypt(replay, now, op32), openvpn::Error::REPLAY_ERROR);
+}
+
+TEST(crypto, dcaead_worker)
+{
+    auto frameptr = openvpn::Frame::Ptr{new openvpn::Frame{frame_ctx()}};
+    auto statsptr = openvpn::SessionStats::Ptr{new openvpn::SessionStats{}};
+
+    openvpn::AEAD::Crypto<openvpn::SSLLib::CryptoAPI> cryptodc{nullptr, openvpn::CryptoAlgs::AES_256_GCM, frameptr, statsptr};
+
+    uint8_t key[32];
+    for (size_t i = 0; i < sizeof(key); i++)
+        key[i] = static_cast<uint8_t>(i * 7);
+    uint8_t bigkey[openvpn::OpenVPNStaticKey::KEY_SIZE]{};
+    for (int i = 0; i < openvpn::OpenVPNStaticKey::KEY_SIZE; i++)
+        bigkey[i] = static_cast<uint8_t>(i);
+
+    cryptodc.init_cipher(openvpn::StaticKey{key, sizeof(key)}, openvpn::StaticKey{key, sizeof(key)});
+    cryptodc.init_hmac(openvpn::StaticKey{bigkey, sizeof(bigkey)}, openvpn::StaticKey{bigkey, sizeof(bigkey)});
+    cryptodc.init_pid(openvpn::PacketID::SHORT_FORM,
+                      0,
+                      openvpn::PacketID::SHORT_FORM,
+                      "DATA",
+                      0,
+                      statsptr);
+
+    openvpn::CryptoDCWorker::Ptr worker = cryptodc.new_worker();
+    ASSERT_TRUE(worker);
+
+    constexpr size_t n = 8;
+    const openvpn::PacketID::time_t now = 42;
+    const unsigned char op32[]{7, 0, 0, 23};
+    openvpn::BufferAllocated bufs[n];
+    openvpn::CryptoDCJob jobs[n];
+
+    /* packet IDs are assigned serially, on this thread */
+    for (size_t i = 0; i < n; i++)
+    {
+        bufs[i].init(2048, 0);
+        bufs[i].realign(128);
+        std::memset(bufs[i].write_alloc(100 + i), static_cast<int>(i), 100 + i);
+        std::memcpy(jobs[i].op32, op32, sizeof(op32));
+        jobs[i].flags = openvpn::CryptoDCJob::OP32_DEFINED;
+        ASSERT_FALSE(cryptodc.encrypt_assign(bufs[i], jobs[i], now));
+    }
+
+    /* cipher operations run on another thread, in reverse order */
+    std::thread([&]()
+                {
+        for (size_t i = n; i-- > 0;)
+            worker->encrypt(bufs[i], jobs[i]); })
+        .join();
+
+    /* output is identical to the non-pipelined path */
+    openvpn::BufferAllocated replay;
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT_EQ(bufs[i].size(), 100 + i + 4 + 16);
+        const uint8_t packetid[]{0, 0, 0, static_cast<uint8_t>(i + 1)};
+        EXPECT_TRUE(std::memcmp(bufs[i].data(), packetid, 4) == 0);
+        if (i == 2)
+            replay = bufs[i];
+    }
+
+    for (size_t i = 0; i < n; i++)
+    {
+        jobs[i] = openvpn::CryptoDCJob();
+        std::memcpy(jobs[i].op32, op32, sizeof(op32));
+        jobs[i].flags = openvpn::CryptoDCJob::OP32_DEFINED;
+    }
+    std::thread([&]()
+                {
+        for (size_t i = 0; i < n; i++)
+            worker->decrypt(bufs[i], jobs[i]); })
+        .join();
+
+    for (size_t i = 0; i < n; i++)
+    {
+        ASSERT_EQ(cryptodc.decrypt_verify(bufs[i], jobs[i], now), openvpn::Error::SUCCESS);
+        ASSERT_EQ(bufs[i].size(), 100 + i);
+        for (size_t j = 0; j < bufs[i].size(); j++)
+            ASSERT_EQ(bufs[i][j], i);
+    }
+
+    /* replay check happens in the serialized stage */
+    EXPECT_EQ(cryptodc.decrypt(replay, now, op32), openvpn::Error::REPLAY_ERROR);
+
+    /* authentication failure is reported by the worker */
+    openvpn::BufferAllocated bad{2048, 0};
+    bad.realign(128);
+    std::memset(bad.write_alloc(40), 0x55, 40);
+    openvpn::CryptoDCJob badjob;
+    worker->decrypt(bad, badjob);
+    EXPECT_EQ(badjob.err, openvpn::Error::DECRYPT_ERROR);
+    EXPECT_EQ(cryptodc.decrypt_verify(bad, badjob, now), openvpn::Error::DECRYPT_ERROR);
+    EXPECT_EQ(bad.size(), 0u);
+}
@@ -5,6 +5,9 @@
 
 #include <openvpn/buffer/buffer.hpp>
 #include <openvpn/ip/csum.hpp>
+#include <openvpn/ip/ip4.hpp>
+#include <openvpn/ip/tcp.hpp>
+#include <openvpn/transport/mssfix.hpp>
 #include <openvpn/random/mtrandapi.hpp>
 
 using namespace openvpn;
@@ -65,3 +68,128 @@ TEST(misc, stress_csum)
             << std::endl;
     }
 }
+
+// reference sum, wide enough for any buffer size
+static std::uint16_t ip_checksum_ref(const std::uint8_t *buf, const size_t size)
+{
+    std::uint64_t sum = 0;
+    for (size_t i = 0; i + 1 < size; i += 2)
+    {
+        std::uint16_t w;
+        std::memcpy(&w, buf + i, sizeof(w));
+        sum += w;
+    }
+    if (size & 1)
+    {
+        const std::uint8_t last[2] = {buf[size - 1], 0};
+        std::uint16_t w;
+        std::memcpy(&w, last, sizeof(w));
+        sum += w;
+    }
+    while (sum >> 16)
+        sum = (sum & 0xffff) + (sum >> 16);
+    return static_cast<std::uint16_t>(~sum);
+}
+
+TEST(misc, csum_simd)
+{
+    RandomAPI::Ptr prng(new MTRand);
+    std::vector<std::uint8_t> data(1024 + 8);
+    prng->rand_bytes(data.data(), data.size());
+
+    // every length and alignment around the vector widths
+    for (size_t off = 0; off < 8; ++off)
+        for (size_t size = 0; size <= 1024; ++size)
+        {
+            const std::uint8_t *p = data.data() + off;
+            ASSERT_EQ(IPChecksum::checksum(p, size), ip_checksum_ref(p, size)) << "off=" << off << " size=" << size;
+            ASSERT_EQ(IPChecksum::internal::fold64(IPChecksum::internal::add_words(p, size & ~size_t(1))) % 0xffff,
+                      IPChecksum::internal::fold64(IPChecksum::internal::add_words_generic(p, size & ~size_t(1))) % 0xffff);
+        }
+
+    // all-ones data over more than one lane drain period
+    std::vector<std::uint8_t> ones(64 * IPChecksum::internal::LANE_ITER + 3, 0xff);
+    EXPECT_EQ(IPChecksum::checksum(ones.data(), ones.size()), ip_checksum_ref(ones.data(), ones.size()));
+    EXPECT_EQ(IPChecksum::checksum(ones.data() + 1, ones.size() - 1), ip_checksum_ref(ones.data() + 1, ones.size() - 1));
+}
+
+TEST(misc, csum_update)
+{
+    RandomAPI::Ptr prng(new MTRand);
+    std::uint8_t raw[64];
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        prng->rand_bytes(raw, sizeof(raw));
+        const std::uint16_t check = IPChecksum::checksum(raw, sizeof(raw));
+
+        const size_t idx = prng->randrange32(sizeof(raw) / 4) * 4;
+        std::uint32_t old32, new32;
+        std::memcpy(&old32, raw + idx, 4);
+        new32 = (i & 1) ? prng->rand_get<std::uint32_t>() : 0;
+        std::memcpy(raw + idx, &new32, 4);
+        ASSERT_EQ(IPChecksum::update32(check, old32, new32), IPChecksum::checksum(raw, sizeof(raw)));
+
+        const std::uint16_t check2 = IPChecksum::checksum(raw, sizeof(raw));
+        std::uint16_t old16, new16;
+        std::memcpy(&old16, raw + idx + 2, 2);
+        new16 = (i & 2) ? prng->rand_get<std::uint16_t>() : 0xffff;
+        std::memcpy(raw + idx + 2, &new16, 2);
+        ASSERT_EQ(IPChecksum::update16(check2, old16, new16), IPChecksum::checksum(raw, sizeof(raw)));
+    }
+}
+
+// IPv4 SYN with an MSS option, preceded by n_nop NOP options
+static BufferAllocated mss_syn(const int n_nop, const std::uint16_t mss)
+{
+    const size_t opt_len = (n_nop + 4 + 3) & ~3;
+    const size_t size = sizeof(IPv4Header) + sizeof(TCPHeader) + opt_len;
+    BufferAllocated buf(size, 0);
+    std::uint8_t *p = buf.write_alloc(size);
+    std::memset(p, 0, size);
+
+    IPv4Header *ip = (IPv4Header *)p;
+    ip->version_len = IPv4Header::ver_len(4, sizeof(IPv4Header));
+    ip->tot_len = htons(static_cast<std::uint16_t>(size));
+    ip->ttl = 64;
+    ip->protocol = IPCommon::TCP;
+    ip->saddr = htonl(0x0a000001);
+    ip->daddr = htonl(0x0a000002);
+
+    TCPHeader *tcp = (TCPHeader *)(p + sizeof(IPv4Header));
+    tcp->source = htons(1234);
+    tcp->dest = htons(80);
+    tcp->doff_res = static_cast<std::uint8_t>(((sizeof(TCPHeader) + opt_len) / 4) << 4);
+    tcp->flags = TCPHeader::FLAG_SYN;
+
+    std::uint8_t *opt = (std::uint8_t *)(tcp + 1);
+    std::memset(opt, TCPHeader::OPT_NOP, n_nop);
+    opt[n_nop] = TCPHeader::OPT_MAXSEG;
+    opt[n_nop + 1] = TCPHeader::OPTLEN_MAXSEG;
+    opt[n_nop + 2] = static_cast<std::uint8_t>(mss >> 8);
+    opt[n_nop + 3] = static_cast<std::uint8_t>(mss);
+
+    // checksum over the TCP segment only, enough to verify updates
+    tcp->check = IPChecksum::checksum(tcp, size - sizeof(IPv4Header));
+    return buf;
+}
+
+TEST(misc, csum_mssfix)
+{
+    for (int n_nop = 0; n_nop < 4; ++n_nop)
+    {
+        BufferAllocated buf = mss_syn(n_nop, 1460);
+        MSSFix::mssfix(buf, 1300);
+
+        const std::uint8_t *tcp = buf.c_data() + sizeof(IPv4Header);
+        const std::uint8_t *opt = tcp + sizeof(TCPHeader) + n_nop;
+        EXPECT_EQ((opt[2] << 8) | opt[3], 1300) << "n_nop=" << n_nop;
+        EXPECT_EQ(IPChecksum::checksum(tcp, buf.size() - sizeof(IPv4Header)), 0) << "n_nop=" << n_nop;
+    }
+
+    // smaller MSS is left alone
+    BufferAllocated buf = mss_syn(1, 1200);
+    const BufferAllocated orig(buf);
+    MSSFix::mssfix(buf, 1300);
+    EXPECT_EQ(std::memcmp(buf.c_data(), orig.c_data(), buf.size()), 0);
+}
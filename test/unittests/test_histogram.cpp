@@ -0,0 +1,109 @@
+#include "test_common.h"
+
+#include <thread>
+#include <vector>
+
+#include <openvpn/common/histogram.hpp>
+#include <openvpn/log/sessionstats.hpp>
+
+using namespace openvpn;
+
+TEST(histogram, buckets)
+{
+    // every value maps into a bucket whose bounds contain it, and
+    // the bucket width never exceeds 1/SUB_BUCKETS of its lower bound
+    for (std::uint64_t v = 0; v < 100000; v = v < 64 ? v + 1 : v * 9 / 8)
+    {
+        const size_t i = LogLinearHistogram::bucket_index(v);
+        ASSERT_LT(i, LogLinearHistogram::N_BUCKETS);
+        EXPECT_LE(LogLinearHistogram::bucket_lower(i), v);
+        EXPECT_GE(LogLinearHistogram::bucket_upper(i), v);
+        if (i >= LogLinearHistogram::SUB_BUCKETS)
+        {
+            const std::uint64_t width = LogLinearHistogram::bucket_upper(i) - LogLinearHistogram::bucket_lower(i) + 1;
+            EXPECT_LE(width * LogLinearHistogram::SUB_BUCKETS, LogLinearHistogram::bucket_lower(i));
+        }
+    }
+
+    // buckets are contiguous
+    for (size_t i = 1; i < LogLinearHistogram::N_BUCKETS; ++i)
+        EXPECT_EQ(LogLinearHistogram::bucket_lower(i), LogLinearHistogram::bucket_upper(i - 1) + 1);
+
+    // out of range values land in the last bucket
+    EXPECT_EQ(LogLinearHistogram::bucket_index(LogLinearHistogram::MAX_VALUE), LogLinearHistogram::N_BUCKETS - 1);
+    EXPECT_EQ(LogLinearHistogram::bucket_index(~std::uint64_t(0)), LogLinearHistogram::N_BUCKETS - 1);
+}
+
+TEST(histogram, percentiles)
+{
+    LogLinearHistogram h;
+    EXPECT_EQ(h.snapshot().count, 0u);
+    EXPECT_EQ(h.snapshot().percentile(50.0), 0u);
+
+    for (std::uint64_t v = 1; v <= 1000; ++v)
+        h.record(v * 1000);
+
+    const LogLinearHistogram::Snapshot snap = h.snapshot();
+    EXPECT_EQ(snap.count, 1000u);
+    EXPECT_EQ(snap.min, 1000u);
+    EXPECT_EQ(snap.max, 1000000u);
+    EXPECT_DOUBLE_EQ(snap.mean(), 500500.0);
+    EXPECT_EQ(snap.percentile(100.0), 1000000u);
+
+    // reported values are the upper bound of the bucket holding the
+    // percentile, clamped to the observed maximum
+    const std::pair<double, double> expect[] = {{0.0, 1000.0}, {50.0, 500000.0}, {90.0, 900000.0}, {99.0, 990000.0}};
+    for (const auto &e : expect)
+    {
+        const double p = static_cast<double>(snap.percentile(e.first));
+        EXPECT_GE(p, e.second);
+        EXPECT_LE(p, e.second * (1.0 + 1.0 / LogLinearHistogram::SUB_BUCKETS));
+    }
+
+    h.reset();
+    EXPECT_EQ(h.snapshot().count, 0u);
+    EXPECT_EQ(h.snapshot().max, 0u);
+}
+
+TEST(histogram, threads)
+{
+    LogLinearHistogram h;
+    const int n_threads = 4;
+    const int n_iter = 50000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t)
+        threads.emplace_back([&h, t]()
+                             {
+            for (int i = 0; i < n_iter; ++i)
+                h.record(static_cast<std::uint64_t>(t * n_iter + i)); });
+    for (auto &th : threads)
+        th.join();
+
+    const LogLinearHistogram::Snapshot snap = h.snapshot();
+    EXPECT_EQ(snap.count, static_cast<std::uint64_t>(n_threads * n_iter));
+    EXPECT_EQ(snap.min, 0u);
+    EXPECT_EQ(snap.max, static_cast<std::uint64_t>(n_threads * n_iter - 1));
+}
+
+TEST(histogram, datapath_stats)
+{
+    SessionStats::Ptr stats(new SessionStats());
+    EXPECT_EQ(stats->datapath_stats(), nullptr);
+
+    stats->enable_datapath_stats();
+    DataPathStats *dps = stats->datapath_stats();
+    ASSERT_NE(dps, nullptr);
+
+    const std::uint64_t start = DataPathStats::now_ns();
+    EXPECT_NE(start, 0u);
+    dps->record_since(DataPathStats::ENCRYPT, start);
+    dps->record(DataPathStats::TCP_SEND_QUEUE, 3);
+
+    EXPECT_EQ(dps->get(DataPathStats::ENCRYPT).snapshot().count, 1u);
+    EXPECT_EQ(dps->get(DataPathStats::TCP_SEND_QUEUE).snapshot().max, 3u);
+    EXPECT_EQ(dps->get(DataPathStats::DECRYPT).snapshot().count, 0u);
+    EXPECT_TRUE(DataPathStats::is_latency(DataPathStats::TUN_WRITE));
+    EXPECT_FALSE(DataPathStats::is_latency(DataPathStats::TCP_SEND_QUEUE));
+    EXPECT_STREQ(DataPathStats::type_name(DataPathStats::TUN_TO_TRANSPORT), "TUN_TO_TRANSPORT");
+}
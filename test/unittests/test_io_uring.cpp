@@ -0,0 +1,240 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+
+// Built as ioUringUnitTests with OPENVPN_IO_URING defined for the
+// whole target, since it changes the layout of UDPLink and TunIO.
+#ifndef OPENVPN_IO_URING
+#error test_io_uring.cpp requires OPENVPN_IO_URING
+#endif
+
+#include "test_common.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <openvpn/common/bigmutex.hpp>
+#include <openvpn/linux/io_uring.hpp>
+#include <openvpn/transport/udplink.hpp>
+#include <openvpn/tun/tunio.hpp>
+
+using namespace openvpn;
+
+namespace unittests {
+
+static bool io_uring_available(openvpn_io::io_context &io_context)
+{
+    openvpn_io::ip::udp::socket sock(io_context);
+    sock.open(openvpn_io::ip::udp::v4());
+    IoUringReader::Ptr r = IoUringReader::create(io_context, sock.native_handle(), 2048, 1, false);
+    if (!r)
+        return false;
+    r->stop();
+    return true;
+}
+
+class UringUDPHandler
+{
+  public:
+    void udp_read_handler(UDPTransport::PacketFrom::SPtr &pfp)
+    {
+        const Buffer &buf = pfp->buf;
+        if (buf.size() >= sizeof(std::uint32_t))
+        {
+            std::uint32_t seq;
+            std::memcpy(&seq, buf.c_data(), sizeof(seq));
+            if (seq != received)
+                ++out_of_order;
+        }
+        ++received;
+        bytes += buf.size();
+        from = pfp->sender_endpoint;
+    }
+
+    void udp_read_batch_handler(UDPTransport::PacketFrom::Batch &batch, const size_t n)
+    {
+        for (size_t i = 0; i < n; ++i)
+            udp_read_handler(batch[i]);
+    }
+
+    size_t received = 0;
+    size_t out_of_order = 0;
+    size_t bytes = 0;
+    UDPTransport::AsioEndpoint from;
+};
+
+// Push packets through a UDPLink using the io_uring reader over
+// loopback and report the throughput.
+TEST(io_uring, udp_loopback)
+{
+    openvpn_io::io_context io_context;
+    if (!io_uring_available(io_context))
+        GTEST_SKIP() << "io_uring not available";
+
+    openvpn_io::ip::udp::socket send_sock(io_context);
+    openvpn_io::ip::udp::socket recv_sock(io_context);
+    const UDPTransport::AsioEndpoint local(openvpn_io::ip::make_address("127.0.0.1"), 0);
+    recv_sock.open(local.protocol());
+    recv_sock.bind(local);
+    recv_sock.set_option(openvpn_io::socket_base::receive_buffer_size(1 << 20));
+    send_sock.open(local.protocol());
+    send_sock.bind(local);
+    send_sock.connect(recv_sock.local_endpoint());
+
+    const Frame::Context fc(128, 2048, 128, 0, 16, 0);
+    SessionStats::Ptr stats(new SessionStats());
+    UringUDPHandler handler;
+
+    typedef UDPTransport::UDPLink<UringUDPHandler *> Link;
+    Link::Ptr link(new Link(&handler, recv_sock, fc, stats));
+    link->start(16);
+
+    constexpr size_t n_packets = 20000;
+    constexpr size_t burst = 64;
+    constexpr size_t size = 1400;
+    std::vector<unsigned char> payload(size, 0x5a);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (std::uint32_t seq = 0; seq < n_packets;)
+    {
+        // send in bursts so that the socket buffer never overflows
+        for (size_t i = 0; i < burst && seq < n_packets; ++i, ++seq)
+        {
+            std::memcpy(payload.data(), &seq, sizeof(seq));
+            send_sock.send(openvpn_io::buffer(payload));
+        }
+        for (int i = 0; i < 1000 && handler.received < seq; ++i)
+            io_context.run_for(std::chrono::milliseconds(1));
+        ASSERT_EQ(handler.received, seq);
+    }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    link->stop();
+    recv_sock.close();
+
+    EXPECT_EQ(handler.received, n_packets);
+    EXPECT_EQ(handler.out_of_order, 0u);
+    EXPECT_EQ(handler.bytes, n_packets * size);
+    EXPECT_EQ(handler.from, send_sock.local_endpoint());
+    EXPECT_EQ(stats->get_stat(SessionStats::PACKETS_IN), static_cast<count_t>(n_packets));
+
+    std::cout << "io_uring UDP loopback: " << n_packets << " packets in " << elapsed.count() << " s, "
+              << (handler.bytes * 8 / elapsed.count() / 1e9) << " Gbit/s" << std::endl;
+}
+
+struct UringTunFrom
+{
+    typedef std::unique_ptr<UringTunFrom> SPtr;
+    BufferAllocated buf;
+};
+
+class UringTunHandler;
+
+// TunIO over one end of a SOCK_SEQPACKET socketpair, which like a
+// tun device returns exactly one packet per read
+class UringTun : public TunIO<UringTunHandler *, UringTunFrom, openvpn_io::posix::stream_descriptor>
+{
+    typedef TunIO<UringTunHandler *, UringTunFrom, openvpn_io::posix::stream_descriptor> Base;
+
+  public:
+    typedef RCPtr<UringTun> Ptr;
+
+    UringTun(openvpn_io::io_context &io_context,
+             UringTunHandler *handler,
+             const Frame::Context &fc,
+             const SessionStats::Ptr &stats,
+             const int fd)
+        : Base(handler, fc, stats)
+    {
+        Base::name_ = "uring-test";
+        Base::stream = new openvpn_io::posix::stream_descriptor(io_context, fd);
+    }
+
+    ~UringTun()
+    {
+        Base::stop();
+    }
+};
+
+class UringTunHandler
+{
+  public:
+    void tun_read_handler(UringTunFrom::SPtr &pfp)
+    {
+        packets.emplace_back(pfp->buf.c_data(), pfp->buf.c_data_end());
+        if (take_buffer)
+            pfp.reset();
+    }
+
+    void tun_error_handler(const Error::Type errtype, const openvpn_io::error_code *error)
+    {
+        ++errors;
+    }
+
+    std::vector<std::vector<unsigned char>> packets;
+    size_t errors = 0;
+    bool take_buffer = false;
+};
+
+TEST(io_uring, tun_socketpair)
+{
+    openvpn_io::io_context io_context;
+    if (!io_uring_available(io_context))
+        GTEST_SKIP() << "io_uring not available";
+
+    int sv[2];
+    ASSERT_EQ(::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv), 0);
+
+    const Frame::Context fc(128, 2048, 128, 0, 16, 0);
+    SessionStats::Ptr stats(new SessionStats());
+    UringTunHandler handler;
+    UringTun::Ptr tun(new UringTun(io_context, &handler, fc, stats, sv[0]));
+    tun->start(8);
+
+    std::vector<std::vector<unsigned char>> expected;
+    for (size_t i = 0; i < 100; ++i)
+    {
+        // alternately let the handler keep or release the buffer
+        expected.emplace_back(20 + i * 7, static_cast<unsigned char>(i));
+        ASSERT_EQ(::write(sv[1], expected.back().data(), expected.back().size()),
+                  static_cast<ssize_t>(expected.back().size()));
+        handler.take_buffer = (i % 2) != 0;
+        for (int j = 0; j < 1000 && handler.packets.size() < expected.size(); ++j)
+            io_context.run_for(std::chrono::milliseconds(1));
+    }
+
+    EXPECT_EQ(handler.packets, expected);
+    EXPECT_EQ(handler.errors, 0u);
+    EXPECT_EQ(stats->get_stat(SessionStats::TUN_PACKETS_IN), 100);
+
+    // writes still go through the stream
+    const unsigned char out[] = {1, 2, 3, 4};
+    BufferAllocated buf(out, sizeof(out), 0);
+    EXPECT_TRUE(tun->write(buf));
+    unsigned char in[16];
+    EXPECT_EQ(::read(sv[1], in, sizeof(in)), 4);
+
+    tun->stop();
+    ::close(sv[1]);
+}
+
+} // namespace unittests
@@ -76,12 +76,12 @@ TEST(IPAddr, pool)
                 break;
         }
     }
-    ASSERT_EQ("1.2.3.4 (1)\n"
-              "1.2.3.5 (2)\n"
-              "1.2.3.6 (3)\n"
-              "1.2.3.7 (4)\n"
-              "1.2.3.8 (5)\n"
-              "1.2.3.9 (6)\n"
+    ASSERT_EQ("1.2.3.4 (2)\n"
+              "1.2.3.5 (3)\n"
+              "1.2.3.6 (4)\n"
+              "1.2.3.7 (5)\n"
+              "1.2.3.8 (6)\n"
+              "1.2.3.9 (7)\n"
               "1.2.3.11 (8)\n"
               "1.2.3.12 (8)\n"
               "1.2.3.13 (9)\n"
@@ -96,12 +96,57 @@ TEST(IPAddr, pool)
               "fe80::23a1:b154 (16)\n"
               "fe80::23a1:b155 (17)\n"
               "10.10.1.1 (18)\n"
-              "1.2.3.7 (19)\n"
-              "1.2.3.4 (20)\n"
-              "1.2.3.5 (21)\n",
+              "1.2.3.4 (19)\n"
+              "1.2.3.5 (20)\n"
+              "1.2.3.7 (21)\n",
               s.str());
 }
 
+TEST(IPAddr, pool_overlap)
+{
+    IP::Pool pool;
+    pool.add_range(IP::Range(IP::Addr::from_string("10.0.0.10"), 10));
+    pool.add_range(IP::Range(IP::Addr::from_string("10.0.0.5"), 10));  // overlaps front
+    pool.add_range(IP::Range(IP::Addr::from_string("10.0.0.18"), 10)); // overlaps back
+    pool.add_range(IP::Range(IP::Addr::from_string("10.0.0.0"), 40));  // covers all
+    pool.add_addr(IP::Addr::from_string("10.0.0.12"));
+    EXPECT_EQ(pool.n_free(), 40u);
+
+    IP::Addr addr;
+    for (int i = 0; i < 40; ++i)
+        ASSERT_TRUE(pool.acquire_addr(addr));
+    EXPECT_FALSE(pool.acquire_addr(addr));
+    EXPECT_EQ(pool.n_in_use(), 40u);
+
+    pool.release_addr(IP::Addr::from_string("10.0.0.39"));
+    pool.release_addr(IP::Addr::from_string("10.0.0.39"));
+    pool.release_addr(IP::Addr::from_string("10.0.0.40")); // not owned
+    EXPECT_EQ(pool.n_free(), 1u);
+    ASSERT_TRUE(pool.acquire_addr(addr));
+    EXPECT_EQ(addr.to_string(), "10.0.0.39");
+}
+
+TEST(IPAddr, pool_large)
+{
+    // a /8 IPv4 and a /64 IPv6 client range only cost bitmap space
+    // for the addresses actually handed out
+    IP::Pool pool;
+    pool.add_range(IP::Range(IP::Addr::from_string("10.0.0.2"), (1 << 24) - 3));
+    pool.add_range(IP::Range(IP::Addr::from_string("fd00::2"), size_t(1) << 62));
+
+    IP::Addr addr;
+    for (int i = 0; i < 1000; ++i)
+        ASSERT_TRUE(pool.acquire_addr(addr));
+    EXPECT_EQ(addr.to_string(), "10.0.3.233");
+    EXPECT_LT(pool.load_factor(), 0.001f);
+
+    ASSERT_TRUE(pool.acquire_specific_addr(IP::Addr::from_string("fd00::1:0:0:5")));
+    EXPECT_FALSE(pool.acquire_specific_addr(IP::Addr::from_string("fd00::1:0:0:5")));
+    pool.release_addr(IP::Addr::from_string("fd00::1:0:0:5"));
+    ASSERT_TRUE(pool.acquire_specific_addr(IP::Addr::from_string("fd00::1:0:0:5")));
+    EXPECT_EQ(pool.n_in_use(), 1001u);
+}
+
 struct test_case
 {
     int shift;
@@ -0,0 +1,173 @@
+#include "test_common.h"
+
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+#include <openvpn/log/logasync.hpp>
+
+using namespace openvpn;
+
+namespace {
+class CollectLog : public LogBase
+{
+  public:
+    typedef RCPtr<CollectLog> Ptr;
+
+    void log(const std::string &str) override
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        lines.push_back(str);
+    }
+
+    std::vector<std::string> get()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return lines;
+    }
+
+  private:
+    std::mutex mutex;
+    std::vector<std::string> lines;
+};
+} // namespace
+
+TEST(logasync, ring)
+{
+    LogRing ring(5);
+    EXPECT_EQ(ring.capacity(), 8u);
+
+    std::string rec;
+    EXPECT_FALSE(ring.pop(rec));
+    for (int i = 0; i < 8; ++i)
+        EXPECT_TRUE(ring.push(std::to_string(i)));
+    EXPECT_FALSE(ring.push("full"));
+
+    // FIFO, and slots are reusable after wrapping around
+    for (int round = 0; round < 3; ++round)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            ASSERT_TRUE(ring.pop(rec));
+            EXPECT_EQ(rec, std::to_string(round * 8 + i));
+        }
+        EXPECT_FALSE(ring.pop(rec));
+        for (int i = 0; i < 8; ++i)
+            EXPECT_TRUE(ring.push(std::to_string((round + 1) * 8 + i)));
+    }
+}
+
+TEST(logasync, threads)
+{
+    CollectLog::Ptr sink(new CollectLog());
+    LogAsync::Config config;
+    config.capacity = 64;
+    config.rate = 0;
+    LogAsync::Ptr alog(new LogAsync(sink, config));
+
+    const int n_threads = 4;
+    const int n_iter = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t)
+        threads.emplace_back([&alog, t]()
+                             {
+            for (int i = 0; i < n_iter; ++i)
+                alog->log(std::to_string(t) + ' ' + std::to_string(i) + '\n'); });
+    for (auto &th : threads)
+        th.join();
+    alog->stop();
+
+    // every record is either delivered, in per-thread order, or counted
+    // as dropped, and drops are reported to the sink
+    std::vector<int> next(n_threads, 0);
+    size_t delivered = 0;
+    bool drop_report = false;
+    for (const auto &line : sink->get())
+    {
+        if (line.rfind("LogAsync:", 0) == 0)
+        {
+            drop_report = true;
+            continue;
+        }
+        const int t = std::stoi(line);
+        const int i = std::stoi(line.substr(line.find(' ') + 1));
+        EXPECT_GT(i, next[t] - 1);
+        next[t] = i + 1;
+        ++delivered;
+    }
+    EXPECT_EQ(delivered + alog->dropped(), static_cast<size_t>(n_threads * n_iter));
+    EXPECT_EQ(drop_report, alog->dropped() > 0);
+}
+
+TEST(logasync, rate_limit)
+{
+    CollectLog::Ptr sink(new CollectLog());
+    LogAsync::Config config;
+    config.rate = 10;
+    LogAsync::Ptr alog(new LogAsync(sink, config));
+
+    for (int i = 0; i < 100; ++i)
+        alog->log("error\n");
+    alog->flush();
+
+    // a window boundary may fall inside the loop
+    EXPECT_GE(alog->dropped(), 80);
+    EXPECT_LE(sink->get().size(), 20u);
+
+    alog->stop();
+    const std::vector<std::string> lines = sink->get();
+    ASSERT_FALSE(lines.empty());
+    EXPECT_EQ(lines.back(), "LogAsync: " + std::to_string(alog->dropped()) + " log messages dropped\n");
+}
+
+TEST(logasync, log_context)
+{
+    CollectLog::Ptr sink(new CollectLog());
+    LogAsync::Ptr alog(new LogAsync(sink));
+    {
+        SaveCurrentLogObject saved;
+        Log::Context ctx(alog.get());
+        OPENVPN_LOG("hello " << 42);
+    }
+    alog->flush();
+    ASSERT_EQ(sink->get().size(), 1u);
+    EXPECT_EQ(sink->get()[0], "hello 42\n");
+}
+
+TEST(logasync, wakeup)
+{
+    CollectLog::Ptr sink(new CollectLog());
+    LogAsync::Config config;
+    config.rate = 0;
+    LogAsync::Ptr alog(new LogAsync(sink, config));
+
+    // the drain thread sleeps without a timeout when idle, so a lost
+    // wakeup would leave a record undelivered
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        alog->log(std::to_string(i) + '\n');
+        while (sink->get().size() < i + 1)
+        {
+            ASSERT_LT(std::chrono::steady_clock::now(), deadline) << "record " << i << " not delivered";
+            std::this_thread::yield();
+        }
+    }
+    EXPECT_EQ(alog->dropped(), 0u);
+}
+
+TEST(logasync, log_after_stop)
+{
+    CollectLog::Ptr sink(new CollectLog());
+    LogAsync::Ptr alog(new LogAsync(sink));
+    alog->log("before\n");
+    alog->stop();
+    alog->log("after 1\n");
+    alog->log("after 2\n");
+
+    const std::vector<std::string> lines = sink->get();
+    ASSERT_EQ(lines.size(), 1u);
+    EXPECT_EQ(lines[0], "before\n");
+    EXPECT_EQ(alog->dropped(), 2u);
+}
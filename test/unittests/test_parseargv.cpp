@@ -234,3 +234,63 @@ TEST(argv, parsetest1)
     options_csv_test("V4,dev-type tun,link-mtu 1558,tun-mtu 1500,proto UDPv4,comp-lzo,keydir 1,cipher AES-256-CBC,auth SHA1,keysize 256,tls-auth,key-method 2,tls-client",
                      "");
 }
+
+// Lines without quotes or escapes skip the lexer, so check that they
+// split exactly as the lexer would.
+TEST(argv, plainlines)
+{
+    static const char *lines[] = {
+        "route 10.0.0.0 255.0.0.0",
+        "  remote\thost.example.com 1194 udp  ",
+        "verb 3 # trailing comment",
+        "ping;10 20",
+        "a#b",
+        ";",
+        "   ",
+        "",
+        "proto udp\r",
+        "setenv FOO \"bar baz\" ; comment",
+        "setenv FOO bar\\ baz",
+    };
+    for (const char *line : lines)
+    {
+        const Option expect = Split::by_space<Option, OptionList::LexComment, SpaceMatch, Split::NullLimit>(line);
+        const Option opt = OptionList::parse_option_from_line(line, nullptr);
+        ASSERT_EQ(expect.render(Option::RENDER_BRACKET), opt.render(Option::RENDER_BRACKET)) << line;
+    }
+}
+
+TEST(argv, plainconfig)
+{
+    OptionList::Limits limits("too large", 4096, 16, 8, 32, 64);
+    const OptionList opt = OptionList::parse_from_config_static("client\r\n"
+                                                                "  # comment\n"
+                                                                "remote host 1194 ; comment\r\n"
+                                                                "<ca>\r\n"
+                                                                "line 1\r\n"
+                                                                "line 2\n"
+                                                                "</ca>\n"
+                                                                "setenv A \"b c\"",
+                                                                &limits);
+    ASSERT_EQ("0 [client]\n"
+              "1 [remote] [host] [1194]\n"
+              "2 [ca] [line 1\nline 2\n]\n"
+              "3 [setenv] [A] [b c]\n",
+              opt.render(Option::RENDER_NUMBER | Option::RENDER_BRACKET | Option::RENDER_PASS_FMT));
+    ASSERT_EQ(217u, limits.get_bytes());
+
+    // raw line length, newline included, is limited to 32 characters
+    ASSERT_NO_THROW(OptionList::parse_from_config_static(std::string(31, 'x') + "\n", &limits));
+    ASSERT_THROW(OptionList::parse_from_config_static("client\n" + std::string(32, 'x') + "\n", &limits), option_error);
+}
+
+TEST(argv, plaincsv)
+{
+    OptionList::Limits limits("too large", 4096, 16, 8, 32, 64);
+    const OptionList opt = OptionList::parse_from_csv_static("route 10.0.0.0 255.0.0.0,, ping  10 ,topology subnet,", &limits);
+    ASSERT_EQ("route 10.0.0.0 255.0.0.0\n"
+              "ping 10\n"
+              "topology subnet\n",
+              opt.render(0));
+    ASSERT_EQ(197u, limits.get_bytes());
+}
@@ -1,5 +1,7 @@
 #include "test_common.h"
 
+#include <algorithm>
+
 #include <openvpn/crypto/packet_id.hpp>
 
 using namespace openvpn;
@@ -134,14 +136,18 @@ void perf(long &count)
 {
     typedef PacketIDReceiveType<ORDER, EXPIRE> PIDRecv;
 
-    perfiter<ORDER, EXPIRE>(20000, PIDRecv::REPLAY_WINDOW_SIZE * 3, 1, 10, count);
-    perfiter<ORDER, EXPIRE>(20000, PIDRecv::REPLAY_WINDOW_SIZE * 3, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
-    perfiter<ORDER, EXPIRE>(20000, PIDRecv::REPLAY_WINDOW_SIZE * 2, 1, 10, count);
-    perfiter<ORDER, EXPIRE>(20000, PIDRecv::REPLAY_WINDOW_SIZE * 2, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
-    perfiter<ORDER, EXPIRE>(20000, 16, 1, 10, count);
-    perfiter<ORDER, EXPIRE>(20000, 16, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
-    perfiter<ORDER, EXPIRE>(20000, 4, 1, 10, count);
-    perfiter<ORDER, EXPIRE>(20000, 4, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
+    // run over several windows' worth of IDs, so that the window wraps
+    // and old IDs fall off the back of it at every order
+    const long n = std::max(20000L, 4 * long(PIDRecv::REPLAY_WINDOW_SIZE));
+
+    perfiter<ORDER, EXPIRE>(n, PIDRecv::REPLAY_WINDOW_SIZE * 3, 1, 10, count);
+    perfiter<ORDER, EXPIRE>(n, PIDRecv::REPLAY_WINDOW_SIZE * 3, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
+    perfiter<ORDER, EXPIRE>(n, PIDRecv::REPLAY_WINDOW_SIZE * 2, 1, 10, count);
+    perfiter<ORDER, EXPIRE>(n, PIDRecv::REPLAY_WINDOW_SIZE * 2, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
+    perfiter<ORDER, EXPIRE>(n, 16, 1, 10, count);
+    perfiter<ORDER, EXPIRE>(n, 16, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
+    perfiter<ORDER, EXPIRE>(n, 4, 1, 10, count);
+    perfiter<ORDER, EXPIRE>(n, 4, PIDRecv::REPLAY_WINDOW_SIZE / 2, 10, count);
 }
 
 TEST(misc, pktid)
@@ -155,3 +161,10 @@ TEST(misc, pktid)
     }
     test();
 }
+
+TEST(misc, pktid_large_window)
+{
+    long count = 0;
+    perf<10, 5>(count);
+    perf<12, 5>(count);
+}
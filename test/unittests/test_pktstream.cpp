@@ -144,6 +144,93 @@ TEST(pktstream, test_32_residual)
     do_test<PacketStreamResidual<std::uint32_t>>(true, false);
 }
 
+// As do_test(), but reading with put_frames() in chunks that usually
+// hold several packets.
+template <typename PKTSTREAM>
+static void do_test_frames(const bool grow)
+{
+#ifdef HAVE_VALGRIND
+    const int n_iter = 500;
+#else
+    const int n_iter = 50000;
+#endif
+
+    const Frame::Context fc(256, 512, 256, 0, sizeof(size_t), grow ? BufferAllocated::GROW : 0);
+    const Frame::Context fc_big(256, 4096, 256, 0, sizeof(size_t), 0);
+
+    MTRand::Ptr prng(new MTRand());
+
+    for (int iter = 0; iter < n_iter; ++iter)
+    {
+        BufferAllocated big;
+        fc_big.prepare(big);
+        size_t nbig = 0;
+
+        {
+            BufferAllocated src;
+            while (true)
+            {
+                fc.prepare(src);
+                const size_t r = rand_size(*prng);
+                for (size_t i = 0; i < r; ++i)
+                    src.push_back('a' + static_cast<unsigned char>(i % 26));
+                PKTSTREAM::prepend_size(src);
+                if (src.size() > fc_big.remaining_payload(big))
+                    break;
+                big.write(src.data(), src.size());
+                ++nbig;
+            }
+        }
+
+        const Buffer bigorig(big);
+        BufferAllocated bigcmp;
+        fc_big.prepare(bigcmp);
+        size_t ncmp = 0;
+        size_t ninplace = 0;
+
+        {
+            PKTSTREAM pktstream;
+            BufferAllocated in;
+            while (big.size())
+            {
+                const size_t bytes = std::min(big.size(), prng->randbool() ? rand_size(*prng) : prng->randrange32(1, 4096));
+                fc_big.prepare(in);
+                in.write(big.data(), bytes);
+                big.advance(bytes);
+                const unsigned char *in_begin = in.c_data();
+                const unsigned char *in_end = in.c_data_end();
+                pktstream.put_frames(in,
+                                     fc,
+                                     [&](const Buffer &pkt)
+                                     {
+                    if (pkt.c_data() >= in_begin && pkt.c_data_end() <= in_end)
+                        ++ninplace;
+                    BufferAllocated out(pkt.size() + sizeof(std::uint32_t), 0);
+                    out.init_headroom(sizeof(std::uint32_t));
+                    out.write(pkt.c_data(), pkt.size());
+                    PKTSTREAM::prepend_size(out);
+                    bigcmp.write(out.data(), out.size());
+                    ++ncmp; });
+                ASSERT_TRUE(in.empty());
+            }
+        }
+
+        ASSERT_EQ(nbig, ncmp);
+        ASSERT_EQ(bigorig, bigcmp);
+        ASSERT_GT(ninplace, 0u);
+    }
+}
+
+TEST(pktstream, frames_16)
+{
+    do_test_frames<PacketStream<std::uint16_t>>(false);
+}
+
+TEST(pktstream, frames_32)
+{
+    do_test_frames<PacketStream<std::uint32_t>>(true);
+}
+
 template <typename PKTSTREAM>
 static void validate_size(const Frame::Context &fc, const size_t size, const bool expect_throw)
 {
@@ -31,6 +31,11 @@
 #include <cstring>
 #include <limits>
 #include <thread>
+#include <functional>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
 
 #define OPENVPN_DEBUG_COMPRESS 0 // debug level for compression objects (0)
 
@@ -181,10 +186,13 @@
 #include <openvpn/common/exception.hpp>
 #include <openvpn/common/file.hpp>
 #include <openvpn/common/count.hpp>
+#include <openvpn/common/cleanup.hpp>
 #include <openvpn/time/time.hpp>
 #include <openvpn/random/mtrandapi.hpp>
 #include <openvpn/frame/frame.hpp>
 #include <openvpn/ssl/proto.hpp>
+#include <openvpn/ssl/tlspool.hpp>
+#include <openvpn/ssl/dcpipeline.hpp>
 #include <openvpn/init/initprocess.hpp>
 
 #include <openvpn/crypto/cryptodcsel.hpp>
@@ -870,8 +878,67 @@ class MySessionStats : public SessionStats
     count_t errors[Error::N_ERRORS];
 };
 
-// execute the unit test in one thread
-int test(const int thread_num)
+// Passes jobs on to a TLSHandshakePool, counting them, so that the
+// simulation can wait for jobs in flight before advancing time
+class CountingOffload : public TLSOffload
+{
+  public:
+    typedef RCPtr<CountingOffload> Ptr;
+
+    CountingOffload(const TLSOffload::Ptr &offload_arg)
+        : offload(offload_arg)
+    {
+    }
+
+    void submit(std::unique_ptr<Job> job) override
+    {
+        ++n_jobs;
+        ++in_flight;
+        offload->submit(std::unique_ptr<Job>(new CountingJob(std::move(job), in_flight)));
+    }
+
+    size_t n_jobs = 0;
+    size_t in_flight = 0;
+
+  private:
+    struct CountingJob : public Job
+    {
+        CountingJob(std::unique_ptr<Job> job_arg, size_t &in_flight_arg)
+            : job(std::move(job_arg)),
+              in_flight(in_flight_arg)
+        {
+        }
+
+        void process() override
+        {
+            job->process();
+        }
+
+        void done() override
+        {
+            --in_flight;
+            job->done();
+        }
+
+        std::unique_ptr<Job> job;
+        size_t &in_flight;
+    };
+
+    TLSOffload::Ptr offload;
+};
+
+// called once both sides have a working data channel, step()
+// advances the simulation by one message loop iteration
+typedef std::function<void(TestProtoClient &cli, TestProtoServer &serv, MySessionStats &serv_stats, const std::function<void()> &step)> DataCheck;
+
+// execute the unit test in one thread, with server TLS handshakes
+// offloaded to a pool of tls_threads if non-zero.  If check is given,
+// the test ends after check() returns, failing if check() did.
+int test(const int thread_num,
+         const int iterations = ITER,
+         const unsigned int tls_threads = 0,
+         const DataCheck &check = nullptr,
+         const char *cipher = PROTO_CIPHER)
 {
     try
     {
@@ -939,7 +1006,7 @@ int test(const int thread_num)
         cp->remote_peer_id = 100;
 #endif
         cp->comp_ctx = CompressContext(COMP_METH, false);
-        cp->dc.set_cipher(CryptoAlgs::lookup(PROTO_CIPHER));
+        cp->dc.set_cipher(CryptoAlgs::lookup(cipher));
         cp->dc.set_digest(CryptoAlgs::lookup(PROTO_DIGEST));
 #ifdef USE_TLS_EKM
         cp->dc.set_key_derivation(CryptoAlgs::KeyDerivation::TLS_EKM);
@@ -1028,7 +1095,7 @@ int test(const int thread_num)
         sp->remote_peer_id = 101;
 #endif
         sp->comp_ctx = CompressContext(COMP_METH, false);
-        sp->dc.set_cipher(CryptoAlgs::lookup(PROTO_CIPHER));
+        sp->dc.set_cipher(CryptoAlgs::lookup(cipher));
         sp->dc.set_digest(CryptoAlgs::lookup(PROTO_DIGEST));
 #ifdef USE_TLS_EKM
         sp->dc.set_key_derivation(CryptoAlgs::KeyDerivation::TLS_EKM);
@@ -1095,6 +1162,23 @@ int test(const int thread_num)
         TestProtoClient cli_proto(cp, cli_stats);
         TestProtoServer serv_proto(sp, serv_stats);
 
+        openvpn_io::io_context io_context;
+        auto io_work = openvpn_io::make_work_guard(io_context);
+        TLSHandshakePool::Ptr tls_pool;
+        CountingOffload::Ptr offload;
+        if (tls_threads)
+        {
+            tls_pool.reset(new TLSHandshakePool(tls_threads));
+            offload.reset(new CountingOffload(tls_pool->offload(io_context)));
+            serv_proto.set_tls_offload(offload);
+        }
+
+        // join pool threads before io_context goes away
+        auto stop_pool = Cleanup([&tls_pool]()
+                                 {
+            if (tls_pool)
+                tls_pool->stop(); });
+
         for (int i = 0; i < SITER; ++i)
         {
 #ifdef VERBOSE
@@ -1118,12 +1202,34 @@ int test(const int thread_num)
                 serv_proto.app_send_templ_init(message);
 #endif
 
-                // message loop
-                for (j = 0; j < ITER; ++j)
+                auto step = [&]()
                 {
                     client_to_server.xfer(cli_proto, serv_proto);
                     server_to_client.xfer(serv_proto, cli_proto);
                     time += time_step;
+
+                    // deliver offloaded handshake steps
+                    if (offload)
+                    {
+                        while (offload->in_flight)
+                            io_context.run_one();
+                    }
+                };
+
+                // message loop
+                for (j = 0; j < iterations; ++j)
+                {
+                    step();
+                    if (check && cli_proto.data_channel_ready() && serv_proto.data_channel_ready())
+                    {
+                        check(cli_proto, serv_proto, *serv_stats, step);
+                        return ::testing::Test::HasFailure() ? 1 : 0;
+                    }
+                }
+                if (check)
+                {
+                    std::cerr << "data channel never came up" << std::endl;
+                    return 1;
                 }
             }
             catch (const std::exception &e)
@@ -1153,6 +1259,13 @@ int test(const int thread_num)
                   << " HE=" << cli_stats->get_error_count(Error::HANDSHAKE_TIMEOUT) << '/' << serv_stats->get_error_count(Error::HANDSHAKE_TIMEOUT)
                   << std::endl;
 
+        if (offload)
+        {
+            std::cerr << "*** offloaded TLS jobs=" << offload->n_jobs << std::endl;
+            if (!offload->n_jobs || serv_proto.negotiations() < 2)
+                return 1;
+        }
+
 #ifdef STATS
         std::cerr << "-------- CLIENT STATS --------" << std::endl;
         cli_stats->show_error_counts();
@@ -1216,3 +1329,616 @@ TEST(proto, base_1_thread)
 
     EXPECT_EQ(ret, 0);
 }
+
+TEST(proto, tls_offload)
+{
+    int ret = 1;
+    for (int i = 0; i < N_RETRIES && ret; ++i)
+        ret = test(1, std::min(ITER, 100000), 2);
+    EXPECT_EQ(ret, 0);
+}
+
+static std::string batch_payload(const char *tag, const size_t i)
+{
+    return std::string(tag) + " packet " + std::to_string(i) + " Waiting for godot...";
+}
+
+// plaintext packets for a batch, tagged so that they can be told apart
+static std::vector<BufferAllocated> batch_packets(const Frame &frame, const char *tag, const size_t n)
+{
+    std::vector<BufferAllocated> bufs(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        frame.prepare(Frame::READ_LINK_UDP, bufs[i]);
+        buf_append_string(bufs[i], batch_payload(tag, i));
+    }
+    return bufs;
+}
+
+// the key ID of an encrypted data channel packet
+static unsigned int batch_key_id(const Buffer &buf)
+{
+    return buf[0] & 0x07;
+}
+
+// Check the batch data channel API against the per-packet one on a live session.
+static void check_data_batch(TestProtoClient &cli, TestProtoServer &serv, MySessionStats &serv_stats, const std::function<void()> &step)
+{
+    const Frame &frame = *cli.conf().frame;
+    const size_t n = 8;
+
+    // batch encrypt matches per-packet encrypt in size, and the
+    // per-packet decrypt accepts it
+    {
+        std::vector<BufferAllocated> batch = batch_packets(frame, "A", n);
+        std::vector<BufferAllocated> single = batch_packets(frame, "A", n);
+        cli.data_encrypt_batch(batch.data(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            cli.data_encrypt(single[i]);
+            EXPECT_EQ(batch[i].size(), single[i].size());
+        }
+        for (size_t i = 0; i < n; ++i)
+        {
+            ASSERT_TRUE(serv.ProtoContext::data_decrypt(serv.packet_type(batch[i]), batch[i]));
+            EXPECT_EQ(buf_to_string(batch[i]), batch_payload("A", i));
+        }
+
+        // per-packet encrypt, batch decrypt, in the same packet ID stream
+        ASSERT_TRUE(serv.data_decrypt_batch(single.data(), n));
+        for (size_t i = 0; i < n; ++i)
+            EXPECT_EQ(buf_to_string(single[i]), batch_payload("A", i));
+    }
+
+    // replays are rejected inside a batch and across batches, like
+    // the per-packet path does
+    {
+        std::vector<BufferAllocated> batch = batch_packets(frame, "B", n);
+        cli.data_encrypt_batch(batch.data(), n);
+        const BufferAllocated replay0 = batch[0];
+        const BufferAllocated replay1 = batch[1];
+        batch.push_back(replay0);
+
+        const auto replays = serv_stats.get_error_count(Error::REPLAY_ERROR);
+        ASSERT_TRUE(serv.data_decrypt_batch(batch.data(), batch.size()));
+        for (size_t i = 0; i < n; ++i)
+            EXPECT_EQ(buf_to_string(batch[i]), batch_payload("B", i));
+        EXPECT_EQ(batch[n].size(), 0u);
+        EXPECT_EQ(serv_stats.get_error_count(Error::REPLAY_ERROR), replays + 1);
+
+        std::vector<BufferAllocated> again{replay1};
+        EXPECT_FALSE(serv.data_decrypt_batch(again.data(), again.size()));
+        BufferAllocated single = replay1;
+        EXPECT_FALSE(serv.ProtoContext::data_decrypt(serv.packet_type(single), single));
+        EXPECT_EQ(serv_stats.get_error_count(Error::REPLAY_ERROR), replays + 3);
+    }
+
+    // a batch straddling a key switch decrypts each run with its own key
+    {
+        std::vector<BufferAllocated> old_key = batch_packets(frame, "C", n);
+        cli.data_encrypt_batch(old_key.data(), n);
+        const unsigned int old_id = batch_key_id(old_key[0]);
+
+        cli.renegotiate();
+        unsigned int new_id = old_id;
+        for (int i = 0; i < 2000 && new_id == old_id; ++i)
+        {
+            step();
+            std::vector<BufferAllocated> probe = batch_packets(frame, "probe", 1);
+            cli.data_encrypt_batch(probe.data(), 1);
+            if (probe[0].size())
+                new_id = batch_key_id(probe[0]);
+        }
+        ASSERT_NE(new_id, old_id);
+
+        std::vector<BufferAllocated> new_key = batch_packets(frame, "D", n);
+        cli.data_encrypt_batch(new_key.data(), n);
+        for (const auto &b : new_key)
+            ASSERT_EQ(batch_key_id(b), new_id);
+
+        // old, new, old, and a packet for a key the server doesn't have
+        std::vector<BufferAllocated> mixed;
+        for (size_t i = 0; i < n / 2; ++i)
+            mixed.push_back(old_key[i]);
+        for (size_t i = 0; i < n; ++i)
+            mixed.push_back(new_key[i]);
+        for (size_t i = n / 2; i < n; ++i)
+            mixed.push_back(old_key[i]);
+        BufferAllocated unknown = new_key[0];
+        unknown[0] = static_cast<unsigned char>((unknown[0] & ~0x07) | ((new_id + 3) & 0x07));
+        mixed.push_back(unknown);
+
+        const auto key_errors = serv_stats.get_error_count(Error::KEY_STATE_ERROR);
+        ASSERT_TRUE(serv.data_decrypt_batch(mixed.data(), mixed.size()));
+        size_t k = 0;
+        for (size_t i = 0; i < n / 2; ++i)
+            EXPECT_EQ(buf_to_string(mixed[k++]), batch_payload("C", i));
+        for (size_t i = 0; i < n; ++i)
+            EXPECT_EQ(buf_to_string(mixed[k++]), batch_payload("D", i));
+        for (size_t i = n / 2; i < n; ++i)
+            EXPECT_EQ(buf_to_string(mixed[k++]), batch_payload("C", i));
+        EXPECT_EQ(mixed[k].size(), 0u);
+        EXPECT_EQ(serv_stats.get_error_count(Error::KEY_STATE_ERROR), key_errors + 1);
+    }
+}
+
+TEST(proto, data_batch)
+{
+    EXPECT_EQ(test(1, ITER, 0, check_data_batch), 0);
+}
+
+// DataChannelPipeline parent that runs stage 3 and records what it
+// was handed, in order
+class PipelineSink : public DataChannelPipelineParent
+{
+  public:
+    PipelineSink(ProtoContext &proto_arg)
+        : proto(proto_arg)
+    {
+    }
+
+    void dc_pipeline_done(ProtoContext::DataJob &job) override
+    {
+        if (job.encrypt)
+            proto.data_encrypt_finish(job);
+        else if (!proto.data_decrypt_finish(job))
+            job.buf.reset_size();
+        out.emplace_back(job.buf);
+        ++(job.encrypt ? n_encrypt_done : n_decrypt_done);
+    }
+
+    ProtoContext &proto;
+    std::vector<BufferAllocated> out;
+    size_t n_encrypt_done = 0;
+    size_t n_decrypt_done = 0;
+};
+
+// run the session thread until the pipeline has returned every job
+static void pipeline_wait(openvpn_io::io_context &io_context, DataChannelPipeline &pipeline)
+{
+    io_context.restart();
+    auto io_work = openvpn_io::make_work_guard(io_context);
+    while (pipeline.in_flight())
+        io_context.run_one();
+}
+
+static void pipeline_encrypt(ProtoContext &proto, DataChannelPipeline &pipeline, BufferAllocated &buf, const bool inline_job)
+{
+    std::unique_ptr<DataChannelPipeline::Job> job = pipeline.alloc();
+    job->buf.swap(buf);
+    proto.data_encrypt_job(*job, inline_job ? 0 : pipeline.n_threads());
+    ASSERT_EQ(job->pipelined(), !inline_job);
+    pipeline.submit(std::move(job));
+}
+
+static void pipeline_decrypt(ProtoContext &proto, DataChannelPipeline &pipeline, BufferAllocated &buf, const bool inline_job)
+{
+    std::unique_ptr<DataChannelPipeline::Job> job = pipeline.alloc();
+    job->buf.swap(buf);
+    proto.data_decrypt_job(proto.packet_type(job->buf), *job, inline_job ? 0 : pipeline.n_threads());
+    ASSERT_EQ(job->pipelined(), !inline_job);
+    pipeline.submit(std::move(job));
+}
+
+// Check the DataChannelPipeline contract on a live session.
+static void check_dc_pipeline(TestProtoClient &cli, TestProtoServer &serv, MySessionStats &serv_stats, const std::function<void()> &step)
+{
+    const Frame &frame = *cli.conf().frame;
+    const unsigned int n_threads = 4;
+    const size_t n = 512;
+    openvpn_io::io_context io_context;
+
+    // Packets come back in submission order although they finish out
+    // of order on the pipeline threads; payload sizes are varied so
+    // that the threads don't finish in lock step.
+    std::vector<BufferAllocated> wire;
+    {
+        PipelineSink cli_sink(cli);
+        PipelineSink serv_sink(serv);
+        DataChannelPipeline::Ptr cli_pipeline(new DataChannelPipeline(io_context, &cli_sink, n_threads));
+        DataChannelPipeline::Ptr serv_pipeline(new DataChannelPipeline(io_context, &serv_sink, n_threads));
+
+        std::vector<BufferAllocated> bufs = batch_packets(frame, "A", n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            buf_append_string(bufs[i], std::string((i * 37) % 400, 'x'));
+            pipeline_encrypt(cli, *cli_pipeline, bufs[i], false);
+        }
+        pipeline_wait(io_context, *cli_pipeline);
+        ASSERT_EQ(cli_sink.out.size(), n);
+
+        // the server decrypts them one by one, so packet IDs are in order
+        const auto replays = serv_stats.get_error_count(Error::REPLAY_ERROR);
+        for (size_t i = 0; i < n; ++i)
+        {
+            BufferAllocated b = cli_sink.out[i];
+            ASSERT_TRUE(serv.ProtoContext::data_decrypt(serv.packet_type(b), b));
+            EXPECT_EQ(buf_to_string(b).substr(0, batch_payload("A", i).length()), batch_payload("A", i));
+        }
+        EXPECT_EQ(serv_stats.get_error_count(Error::REPLAY_ERROR), replays);
+
+        // and the same in the decrypt direction
+        bufs = batch_packets(frame, "B", n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            buf_append_string(bufs[i], std::string((i * 53) % 400, 'y'));
+            cli.data_encrypt(bufs[i]);
+            pipeline_decrypt(serv, *serv_pipeline, bufs[i], false);
+        }
+        pipeline_wait(io_context, *serv_pipeline);
+        ASSERT_EQ(serv_sink.out.size(), n);
+        for (size_t i = 0; i < n; ++i)
+            EXPECT_EQ(buf_to_string(serv_sink.out[i]).substr(0, batch_payload("B", i).length()), batch_payload("B", i));
+        EXPECT_EQ(serv_stats.get_error_count(Error::REPLAY_ERROR), replays);
+
+        cli_pipeline->stop();
+        serv_pipeline->stop();
+    }
+
+    // Inline jobs wait behind pipelined jobs submitted before them,
+    // and the two directions don't hold each other up.
+    {
+        PipelineSink serv_sink(serv);
+        DataChannelPipeline::Ptr serv_pipeline(new DataChannelPipeline(io_context, &serv_sink, n_threads));
+
+        std::vector<BufferAllocated> rx = batch_packets(frame, "C", n);
+        std::vector<BufferAllocated> tx = batch_packets(frame, "D", n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            cli.data_encrypt(rx[i]);
+            pipeline_decrypt(serv, *serv_pipeline, rx[i], i % 3 == 0);
+            pipeline_encrypt(serv, *serv_pipeline, tx[i], i % 5 == 0);
+        }
+
+        // the first job in each direction is inline, so it's already out
+        EXPECT_GE(serv_sink.out.size(), 2u);
+        pipeline_wait(io_context, *serv_pipeline);
+        ASSERT_EQ(serv_sink.n_decrypt_done, n);
+        ASSERT_EQ(serv_sink.n_encrypt_done, n);
+
+        size_t ci = 0, di = 0;
+        for (auto &b : serv_sink.out)
+        {
+            // decrypted packets are plaintext, encrypted ones start with an op header
+            const std::string s = buf_to_string(b);
+            if (s.rfind("C packet ", 0) == 0)
+                EXPECT_EQ(s, batch_payload("C", ci++));
+            else
+            {
+                ASSERT_TRUE(cli.ProtoContext::data_decrypt(cli.packet_type(b), b));
+                EXPECT_EQ(buf_to_string(b), batch_payload("D", di++));
+            }
+        }
+        EXPECT_EQ(ci, n);
+        EXPECT_EQ(di, n);
+        serv_pipeline->stop();
+    }
+
+    // Stopping with jobs in flight returns a prefix of the jobs,
+    // each one once, and nothing after stop().
+    for (const size_t drained : {0u, 1u, 16u})
+    {
+        PipelineSink cli_sink(cli);
+        DataChannelPipeline::Ptr cli_pipeline(new DataChannelPipeline(io_context, &cli_sink, n_threads));
+
+        std::vector<BufferAllocated> bufs = batch_packets(frame, "E", n);
+        for (size_t i = 0; i < n; ++i)
+            pipeline_encrypt(cli, *cli_pipeline, bufs[i], false);
+
+        {
+            io_context.restart();
+            auto io_work = openvpn_io::make_work_guard(io_context);
+            for (size_t i = 0; i < drained && cli_pipeline->in_flight(); ++i)
+                io_context.run_one();
+        }
+        const size_t delivered = cli_sink.out.size();
+        cli_pipeline->stop();
+        EXPECT_EQ(cli_pipeline->in_flight(), 0u);
+
+        // completions posted before stop() must not deliver anything,
+        // and neither may a submit after it
+        std::vector<BufferAllocated> late = batch_packets(frame, "F", 1);
+        pipeline_encrypt(cli, *cli_pipeline, late[0], true);
+        io_context.restart();
+        io_context.poll();
+        EXPECT_EQ(cli_sink.out.size(), delivered);
+
+        for (size_t i = 0; i < delivered; ++i)
+        {
+            BufferAllocated b = cli_sink.out[i];
+            ASSERT_TRUE(serv.ProtoContext::data_decrypt(serv.packet_type(b), b));
+            EXPECT_EQ(buf_to_string(b), batch_payload("E", i));
+        }
+
+        // drop our reference while the pipeline may still be referenced
+        // by handlers that haven't run yet
+        cli_pipeline.reset();
+        io_context.restart();
+        io_context.poll();
+        EXPECT_EQ(cli_sink.out.size(), delivered);
+        step();
+    }
+}
+
+TEST(proto, dc_pipeline)
+{
+    // needs a cipher that supports pipelining
+    EXPECT_EQ(test(1, ITER, 0, check_dc_pipeline, "AES-256-GCM"), 0);
+}
+
+#if defined(USE_OPENSSL) || defined(USE_MBEDTLS)
+
+// Run a TLS handshake between cli and serv over in-memory buffers,
+// then exchange a little cleartext so that session tickets are delivered.
+static void ssl_handshake(SSLAPI &cli, SSLAPI &serv)
+{
+    unsigned char buf[1024];
+    cli.start_handshake();
+    serv.start_handshake();
+    for (int i = 0; i < 16; ++i)
+    {
+        if (i == 8)
+        {
+            cli.write_cleartext_unbuffered("ping", 4);
+            serv.write_cleartext_unbuffered("pong", 4);
+        }
+        while (cli.read_ciphertext_ready())
+            serv.write_ciphertext(cli.read_ciphertext());
+        serv.read_cleartext(buf, sizeof(buf));
+        while (serv.read_ciphertext_ready())
+            cli.write_ciphertext(serv.read_ciphertext());
+        cli.read_cleartext(buf, sizeof(buf));
+    }
+}
+
+TEST(proto, tls_send_window_option)
+{
+    const ProtoContextCompressionOptions pco;
+    auto load = [&pco](const std::string &config)
+    {
+        OptionList opt;
+        opt.parse_from_config(config, nullptr);
+        opt.update_map();
+        ProtoContext::ProtoConfig::Ptr pc(new ProtoContext::ProtoConfig);
+        pc->load(opt, pco, -1, false);
+        return pc->tls_send_window;
+    };
+
+    EXPECT_EQ(load("dev tun\n"), 0u);
+    EXPECT_EQ(load("dev tun\ntls-send-window 4\n"), 4u);
+    EXPECT_THROW(load("dev tun\ntls-send-window 0\n"), option_error);
+    EXPECT_THROW(load("dev tun\ntls-send-window 9\n"), option_error);
+}
+
+TEST(proto, session_cache_resume)
+{
+    Frame::Ptr frame(new Frame(Frame::Context(128, 378, 128, 0, 16, 0)));
+    const std::string ca_crt = read_text(TEST_KEYCERT_DIR "ca.crt");
+
+    ClientSSLAPI::Config::Ptr cc(new ClientSSLAPI::Config());
+    cc->set_mode(Mode(Mode::CLIENT));
+    cc->set_frame(frame);
+    cc->load_ca(ca_crt, true);
+    cc->load_cert(read_text(TEST_KEYCERT_DIR "client.crt"));
+    cc->load_private_key(read_text(TEST_KEYCERT_DIR "client.key"));
+    cc->set_rng(new ClientRandomAPI());
+    cc->set_client_session_tickets(true);
+    SSLFactoryAPI::Ptr cli_factory = cc->new_factory();
+
+    // two server "threads" sharing one cache, and a third with its own
+    TLSSessionCache::Ptr cache(new TLSSessionCache(64));
+    auto server_factory = [&](const TLSSessionCache::Ptr &c)
+    {
+        ClientSSLAPI::Config::Ptr sc(new ClientSSLAPI::Config());
+        sc->set_mode(Mode(Mode::SERVER));
+        sc->set_frame(frame);
+        sc->load_ca(ca_crt, true);
+        sc->load_cert(read_text(TEST_KEYCERT_DIR "server.crt"));
+        sc->load_private_key(read_text(TEST_KEYCERT_DIR "server.key"));
+        sc->load_dh(read_text(TEST_KEYCERT_DIR "dh.pem"));
+        sc->set_rng(new ServerRandomAPI());
+        sc->set_session_cache(c);
+        return sc->new_factory();
+    };
+    SSLFactoryAPI::Ptr serv_a = server_factory(cache);
+    SSLFactoryAPI::Ptr serv_b = server_factory(cache);
+    SSLFactoryAPI::Ptr serv_c = server_factory(new TLSSessionCache(64));
+
+    const std::string cache_key = "server:1194";
+    auto connect = [&](SSLFactoryAPI &serv_factory)
+    {
+        SSLAPI::Ptr cli = cli_factory->ssl(nullptr, &cache_key);
+        SSLAPI::Ptr serv = serv_factory.ssl();
+        ssl_handshake(*cli, *serv);
+        EXPECT_TRUE(serv->auth_cert()->defined());
+        EXPECT_EQ(serv->auth_cert()->get_cn(), "Test-Client");
+        return serv->did_full_handshake();
+    };
+
+    EXPECT_TRUE(connect(*serv_a));
+    EXPECT_GE(cache->size(), 1u); // TLS 1.3 servers issue two tickets by default
+
+    // reconnect to the other thread: resumed from the shared cache
+    EXPECT_FALSE(connect(*serv_b));
+    EXPECT_EQ(cache->stats().hits, 1u);
+
+    // a server with a separate cache must do a full handshake
+    EXPECT_TRUE(connect(*serv_c));
+}
+
+#if defined(USE_OPENSSL_SERVER)
+
+// A session ticket handler that is not thread-safe, and that records
+// whether it was ever entered by two threads at once.
+class RaceCheckTicketHandler : public TLSSessionTicketBase
+{
+  public:
+    RaceCheckTicketHandler(StrongRandomAPI &rng)
+        : name_(rng), key_(rng)
+    {
+    }
+
+    Status create_session_ticket_key(Name &name, Key &key) const override
+    {
+        enter();
+        OPENVPN_LOG("RaceCheckTicketHandler: create ticket");
+        name = name_;
+        key = key_;
+        leave();
+        return TICKET_AVAILABLE;
+    }
+
+    Status lookup_session_ticket_key(const Name &name, Key &key) const override
+    {
+        enter();
+        const bool found = (name == name_);
+        if (found)
+            key = key_;
+        leave();
+        return found ? TICKET_AVAILABLE : NO_TICKET;
+    }
+
+    std::string session_id_context() const override
+    {
+        return "RaceCheckTicketHandler";
+    }
+
+    mutable std::atomic<unsigned int> calls{0};
+    mutable std::atomic<unsigned int> max_active{0};
+
+  private:
+    void enter() const
+    {
+        ++calls;
+        const unsigned int a = ++active;
+        unsigned int m = max_active;
+        while (a > m && !max_active.compare_exchange_weak(m, a))
+            ;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    void leave() const
+    {
+        --active;
+    }
+
+    mutable std::atomic<unsigned int> active{0};
+    const Name name_;
+    const Key key_;
+};
+
+// Server handshakes of several sessions sharing one config, run
+// concurrently on a TLSHandshakePool.
+TEST(proto, tls_pool_concurrent_sessions)
+{
+    Frame::Ptr frame(new Frame(Frame::Context(128, 378, 128, 0, 16, 0)));
+    const std::string ca_crt = read_text(TEST_KEYCERT_DIR "ca.crt");
+
+    ClientSSLAPI::Config::Ptr cc(new ClientSSLAPI::Config());
+    cc->set_mode(Mode(Mode::CLIENT));
+    cc->set_frame(frame);
+    cc->load_ca(ca_crt, true);
+    cc->load_cert(read_text(TEST_KEYCERT_DIR "client.crt"));
+    cc->load_private_key(read_text(TEST_KEYCERT_DIR "client.key"));
+    cc->set_rng(new ClientRandomAPI());
+    SSLFactoryAPI::Ptr cli_factory = cc->new_factory();
+
+    ServerRandomAPI rng;
+    RaceCheckTicketHandler ticket_handler(rng);
+    ServerSSLAPI::Config::Ptr sc(new ServerSSLAPI::Config());
+    sc->set_mode(Mode(Mode::SERVER));
+    sc->set_frame(frame);
+    sc->load_ca(ca_crt, true);
+    sc->load_cert(read_text(TEST_KEYCERT_DIR "server.crt"));
+    sc->load_private_key(read_text(TEST_KEYCERT_DIR "server.key"));
+    sc->load_dh(read_text(TEST_KEYCERT_DIR "dh.pem"));
+    sc->set_rng(new ServerRandomAPI());
+    sc->set_session_ticket_handler(&ticket_handler);
+    SSLFactoryAPI::Ptr serv_factory = sc->new_factory();
+
+    // the workers inherit the log context of this thread
+    testLog->startCollecting();
+    openvpn_io::io_context io_context;
+    TLSHandshakePool::Ptr pool(new TLSHandshakePool(4));
+    TLSOffload::Ptr offload = pool->offload(io_context);
+
+    struct ReadJob : public TLSOffload::Job
+    {
+        ReadJob(SSLAPI &serv_arg, int &pending_arg)
+            : serv(serv_arg), pending(pending_arg)
+        {
+        }
+
+        void process() override
+        {
+            unsigned char buf[1024];
+            serv.read_cleartext(buf, sizeof(buf));
+        }
+
+        void done() override
+        {
+            --pending;
+        }
+
+        SSLAPI &serv;
+        int &pending;
+    };
+
+    std::vector<SSLAPI::Ptr> clients;
+    std::vector<SSLAPI::Ptr> servers;
+    for (int i = 0; i < 8; ++i)
+    {
+        clients.push_back(cli_factory->ssl());
+        servers.push_back(serv_factory->ssl());
+        clients.back()->start_handshake();
+        servers.back()->start_handshake();
+    }
+
+    // like ssl_handshake(), but with the server reads of all sessions
+    // in flight on the pool at the same time
+    unsigned char buf[1024];
+    for (int round = 0; round < 16; ++round)
+    {
+        int pending = 0;
+        for (size_t i = 0; i < servers.size(); ++i)
+        {
+            SSLAPI &cli = *clients[i];
+            SSLAPI &serv = *servers[i];
+            if (round == 8)
+            {
+                cli.write_cleartext_unbuffered("ping", 4);
+                serv.write_cleartext_unbuffered("pong", 4);
+            }
+            while (cli.read_ciphertext_ready())
+                serv.write_ciphertext(cli.read_ciphertext());
+            ++pending;
+            offload->submit(std::make_unique<ReadJob>(serv, pending));
+        }
+
+        io_context.restart();
+        auto work = openvpn_io::make_work_guard(io_context);
+        while (pending > 0)
+            io_context.run_one();
+
+        for (size_t i = 0; i < servers.size(); ++i)
+        {
+            SSLAPI &cli = *clients[i];
+            SSLAPI &serv = *servers[i];
+            while (serv.read_ciphertext_ready())
+                cli.write_ciphertext(serv.read_ciphertext());
+            cli.read_cleartext(buf, sizeof(buf));
+        }
+    }
+    pool->stop();
+    const std::string log = testLog->stopCollecting();
+
+    for (auto &serv : servers)
+        EXPECT_TRUE(serv->auth_cert()->defined());
+    EXPECT_GE(ticket_handler.calls, servers.size());
+    EXPECT_EQ(ticket_handler.max_active, 1u);
+    EXPECT_NE(log.find("RaceCheckTicketHandler: create ticket"), std::string::npos);
+}
+
+#endif
+
+#endif
@@ -17,6 +17,7 @@
 #include <openvpn/buffer/buffer.hpp>
 #include <openvpn/reliable/relrecv.hpp>
 #include <openvpn/reliable/relsend.hpp>
+#include <openvpn/transport/gremlin.hpp>
 #include <openvpn/reliable/relack.hpp>
 #include <openvpn/crypto/packet_id.hpp>
 
@@ -401,3 +402,287 @@ TEST(reliable, test2)
       test(rand, base, end, step, end_sends, relsize, wiresize, reorder_prob, drop_prob);
 }
 */
+
+// send a packet that only carries an empty buffer
+static ReliableSend::Message &send_packet(ReliableSend &send, const Time &now, const Time::Duration &tls_timeout)
+{
+    ReliableSend::Message &m = send.send(now, tls_timeout);
+    m.packet = Packet(BufferPtr(new BufferAllocated()));
+    return m;
+}
+
+TEST(reliable, rtt_estimate)
+{
+    const Time base = Time::now();
+    const Time::Duration tls_timeout = Time::Duration::seconds(2);
+    ReliableSend send(4);
+
+    // no RTT measured yet
+    EXPECT_EQ(send.rto(tls_timeout), tls_timeout);
+
+    // first sample: SRTT = R, RTTVAR = R/2, RTO = SRTT + 4 * RTTVAR
+    send_packet(send, base, tls_timeout);
+    send.ack(0, base + Time::Duration::binary_ms(100));
+    EXPECT_EQ(send.srtt().raw(), 100u);
+    EXPECT_EQ(send.rto(tls_timeout).raw(), 300u);
+
+    // a steady RTT lets the RTO converge towards it, down to the floor
+    for (openvpn::PacketID::id_t id = 1; id < 40; ++id)
+    {
+        const Time now = base + Time::Duration::seconds(id);
+        send_packet(send, now, tls_timeout);
+        send.ack(id, now + Time::Duration::binary_ms(100));
+    }
+    EXPECT_EQ(send.srtt().raw(), 100u);
+    EXPECT_EQ(send.rto(tls_timeout), Time::Duration::milliseconds(ReliableSend::rto_min_ms));
+
+    // a retransmitted packet yields no sample (Karn's algorithm)
+    const Time now = base + Time::Duration::seconds(100);
+    ReliableSend::Message &m = send_packet(send, now, tls_timeout);
+    send.retransmitted(m, now + Time::Duration::seconds(1), tls_timeout);
+    EXPECT_EQ(m.n_sent(), 2u);
+    send.ack(40, now + Time::Duration::seconds(5));
+    EXPECT_EQ(send.srtt().raw(), 100u);
+}
+
+TEST(reliable, backoff)
+{
+    const Time base = Time::now();
+    const Time::Duration tls_timeout = Time::Duration::seconds(2);
+    ReliableSend send(4);
+
+    // measured RTO is well below tls_timeout
+    send_packet(send, base, tls_timeout);
+    send.ack(0, base + Time::Duration::binary_ms(100));
+    const Time::Duration rto = send.rto(tls_timeout);
+
+    // the timeout doubles on each retransmission, up to tls_timeout
+    ReliableSend::Message &m = send_packet(send, base, tls_timeout);
+    EXPECT_EQ(m.until_retransmit(base), rto);
+    Time now = base;
+    Time::Duration expected = rto;
+    for (int i = 0; i < 6; ++i)
+    {
+        now += m.until_retransmit(now);
+        EXPECT_TRUE(m.ready_retransmit(now));
+        send.retransmitted(m, now, tls_timeout);
+        expected = expected * 2;
+        expected.min(tls_timeout);
+        EXPECT_EQ(m.until_retransmit(now), expected);
+    }
+    EXPECT_EQ(expected, tls_timeout);
+}
+
+TEST(reliable, fast_retransmit)
+{
+    const Time base = Time::now();
+    const Time::Duration tls_timeout = Time::Duration::seconds(2);
+    ReliableSend send(8);
+
+    for (int i = 0; i < 5; ++i)
+        send_packet(send, base, tls_timeout);
+
+    // packet 0 is lost, ACKs arrive for the packets after it
+    const Time now = base + Time::Duration::binary_ms(50);
+    for (openvpn::PacketID::id_t id = 1; id < ReliableSend::fast_retransmit_acks; ++id)
+    {
+        send.ack(id, now);
+        EXPECT_FALSE(send.ref_by_id(0).ready_retransmit(now));
+    }
+    send.ack(ReliableSend::fast_retransmit_acks, now);
+    EXPECT_TRUE(send.ref_by_id(0).ready_retransmit(now));
+    EXPECT_FALSE(send.until_retransmit(now).defined());
+
+    // once retransmitted, packet 0 waits for its timer again
+    send.retransmitted(send.ref_by_id(0), now, tls_timeout);
+    EXPECT_FALSE(send.ref_by_id(0).ready_retransmit(now));
+    EXPECT_EQ(send.n_unacked(), 2u);
+
+    // ACKs without a time don't count towards fast retransmit
+    ReliableSend legacy(8);
+    for (int i = 0; i < 5; ++i)
+        send_packet(legacy, base, tls_timeout);
+    for (openvpn::PacketID::id_t id = 1; id < 5; ++id)
+        legacy.ack(id);
+    EXPECT_FALSE(legacy.ref_by_id(0).ready_retransmit(now));
+}
+
+// Simulate a handshake of alternating flights of control packets over
+// a link with the delay and loss given by a gremlin profile, and
+// return the time until the client has received the last flight.
+// With adaptive false, the sender behaves as before RTT estimation and
+// fast retransmit were added: every packet is retransmitted after a
+// fixed tls_timeout.
+Time::Duration handshake_time(MTRand &rand,
+                              const Gremlin::Config &gremlin,
+                              const openvpn::PacketID::id_t send_window,
+                              const bool adaptive)
+{
+    struct WirePacket
+    {
+        Time arrive;
+        bool data;
+        openvpn::PacketID::id_t id;
+        BufferPtr buf;
+    };
+
+    struct Peer
+    {
+        Peer(const openvpn::PacketID::id_t send_window)
+            : send(send_window),
+              recv(ReliableAck::maximum_acks_ack_v1)
+        {
+        }
+
+        ReliableSend send;
+        ReliableRecv recv;
+        ReliableAck acks;
+        std::deque<BufferPtr> pending; // waiting for room in send window
+        size_t received = 0;
+        std::deque<WirePacket> wire; // packets on their way to this peer
+    };
+
+    // flights of a TLS 1.3 handshake with certificates, in packets
+    static const size_t flights[] = {1, 4, 3, 2, 1};
+    const size_t n_flights = sizeof(flights) / sizeof(flights[0]);
+
+    const Time::Duration tls_timeout = Time::Duration::seconds(2);
+    const Time::Duration step = Time::Duration::binary_ms(4);
+    const Time::Duration limit = Time::Duration::seconds(120);
+    const Time base = Time::now();
+    const unsigned int delay_ms[2] = {gremlin.recv_delay_ms, gremlin.send_delay_ms};
+    const unsigned int drop_prob[2] = {gremlin.recv_drop_probability, gremlin.send_drop_probability};
+
+    Peer peers[2] = {Peer(send_window), Peer(send_window)}; // client, server
+    size_t next_flight = 0;
+
+    // transmit from peer from to the other one, or drop
+    auto transmit = [&](const int from, const Time &now, const bool data, const openvpn::PacketID::id_t id, const BufferPtr &buf)
+    {
+        const int to = !from;
+        if (drop_prob[to] && !rand.randrange(drop_prob[to]))
+            return;
+        peers[to].wire.push_back({now + Time::Duration::milliseconds(delay_ms[to]), data, id, buf});
+    };
+
+    for (Time::Duration t; t < limit; t += step)
+    {
+        const Time now = base + t;
+        for (int p = 0; p < 2; ++p)
+        {
+            Peer &peer = peers[p];
+
+            // receive
+            while (!peer.wire.empty() && peer.wire.front().arrive <= now)
+            {
+                WirePacket wp = std::move(peer.wire.front());
+                peer.wire.pop_front();
+                if (wp.data)
+                {
+                    if (peer.recv.receive(Packet(wp.buf), wp.id) & ReliableRecv::ACK_TO_SENDER)
+                        peer.acks.push_back(wp.id);
+                }
+                else if (adaptive)
+                    ReliableAck::ack(peer.send, *wp.buf, true, now);
+                else
+                    ReliableAck::ack(peer.send, *wp.buf, true);
+            }
+            while (peer.recv.ready())
+            {
+                ++peer.received;
+                peer.recv.advance();
+            }
+
+            // the peer sends its next flight once it has received the
+            // previous one in full
+            size_t expect = 0;
+            for (size_t f = 0; f < next_flight; ++f)
+                if (f % 2 != size_t(p))
+                    expect += flights[f];
+            if (next_flight < n_flights && next_flight % 2 == size_t(p) && peer.received == expect)
+            {
+                for (size_t i = 0; i < flights[next_flight]; ++i)
+                    peer.pending.emplace_back(new BufferAllocated(256, 0));
+                ++next_flight;
+            }
+            else if (next_flight == n_flights && peer.received == expect && (n_flights - 1) % 2 != size_t(p))
+                return t;
+
+            // send new packets, then retransmissions, then ACKs
+            while (!peer.pending.empty() && peer.send.ready())
+            {
+                ReliableSend::Message &m = peer.send.send(now, tls_timeout);
+                m.packet = Packet(peer.pending.front());
+                peer.pending.pop_front();
+                transmit(p, now, true, m.id(), m.packet.buf);
+            }
+            for (openvpn::PacketID::id_t i = peer.send.head_id(); i < peer.send.tail_id(); ++i)
+            {
+                ReliableSend::Message &m = peer.send.ref_by_id(i);
+                if (m.ready_retransmit(now))
+                {
+                    transmit(p, now, true, m.id(), m.packet.buf);
+                    if (adaptive)
+                        peer.send.retransmitted(m, now, tls_timeout);
+                    else
+                        m.reset_retransmit(now, tls_timeout);
+                }
+            }
+            if (!peer.acks.empty())
+            {
+                BufferPtr buf(new BufferAllocated(256, 0));
+                buf->init_headroom(128);
+                peer.acks.prepend(*buf, true);
+                transmit(p, now, false, 0, buf);
+            }
+        }
+    }
+    return limit;
+}
+
+TEST(reliable, handshake_gremlin)
+{
+    MTRand rand(1);
+    const char *profiles[] = {
+        "0,0,0,0",
+        "20,20,10,10",
+        "50,50,5,5",
+        "150,150,4,4",
+        "300,300,3,3",
+    };
+    const int runs = 50;
+
+    for (const char *profile : profiles)
+    {
+        const Gremlin::Config gremlin(profile);
+        for (const openvpn::PacketID::id_t window : {4u, 6u, 8u})
+        {
+            std::vector<Time::Duration> fixed, adaptive;
+            Time::Duration fixed_total, adaptive_total;
+            for (int i = 0; i < runs; ++i)
+            {
+                fixed.push_back(handshake_time(rand, gremlin, window, false));
+                adaptive.push_back(handshake_time(rand, gremlin, window, true));
+                fixed_total += fixed.back();
+                adaptive_total += adaptive.back();
+            }
+            std::sort(fixed.begin(), fixed.end());
+            std::sort(adaptive.begin(), adaptive.end());
+
+            OPENVPN_LOG("gremlin " << gremlin.to_string() << " window=" << window
+                                   << " ms fixed/adaptive:"
+                                   << " mean=" << fixed_total.to_milliseconds() / runs << '/' << adaptive_total.to_milliseconds() / runs
+                                   << " median=" << fixed[runs / 2].to_milliseconds() << '/' << adaptive[runs / 2].to_milliseconds()
+                                   << " p90=" << fixed[runs * 9 / 10].to_milliseconds() << '/' << adaptive[runs * 9 / 10].to_milliseconds());
+
+            EXPECT_LT(adaptive.back(), Time::Duration::seconds(120)) << gremlin.to_string();
+            // Where packets are lost and the RTT is well below tls_timeout
+            // the adaptive timer should be a clear win, otherwise it must
+            // not do much worse.
+            if (gremlin.send_drop_probability && gremlin.send_delay_ms + gremlin.recv_delay_ms <= 100)
+                EXPECT_LT(adaptive_total.raw() * 4, fixed_total.raw() * 3) << gremlin.to_string();
+            else
+                EXPECT_LE(adaptive_total.raw() * 10, fixed_total.raw() * 11) << gremlin.to_string();
+        }
+    }
+}
@@ -6,6 +6,8 @@
 #include <openvpn/common/exception.hpp>
 
 #include <openvpn/addr/route.hpp>
+#include <openvpn/addr/routetrie.hpp>
+#include <openvpn/random/mtrandapi.hpp>
 
 using namespace openvpn;
 
@@ -123,4 +125,92 @@ TEST(IPAddr, parseRoutes)
     ASSERT_THROW(
         IP::Route("192.168.4.0/33"),
         std::exception);
-}
\ No newline at end of file
+}
+TEST(IPAddr, routeTrie)
+{
+    IP::RouteTrie<int> trie;
+    ASSERT_TRUE(trie.insert(IP::Route("10.0.0.0/8"), 1));
+    ASSERT_TRUE(trie.insert(IP::Route("10.1.0.0/16"), 2));
+    ASSERT_TRUE(trie.insert(IP::Route("10.1.2.0/24"), 3));
+    ASSERT_TRUE(trie.insert(IP::Route("0.0.0.0/0"), 4));
+    ASSERT_TRUE(trie.insert(IP::Route("2001:db8::/32"), 5));
+    ASSERT_FALSE(trie.insert(IP::Route("10.1.0.0/16"), 6)); // replace
+    ASSERT_EQ(trie.size(), 5u);
+
+    IP::Route matched;
+    ASSERT_EQ(*trie.match(IP::Addr::from_string("10.1.2.3"), &matched), 3);
+    ASSERT_EQ(matched.to_string(), "10.1.2.0/24");
+    ASSERT_EQ(*trie.match(IP::Addr::from_string("10.1.3.3")), 6);
+    ASSERT_EQ(*trie.match(IP::Addr::from_string("10.2.3.4")), 1);
+    ASSERT_EQ(*trie.match(IP::Addr::from_string("11.0.0.1")), 4);
+    ASSERT_EQ(*trie.match(IP::Addr::from_string("2001:db8::1")), 5);
+    ASSERT_EQ(trie.match(IP::Addr::from_string("2001:db9::1")), nullptr);
+
+    ASSERT_EQ(*trie.match(IP::Route("10.1.0.0/17"), &matched), 6);
+    ASSERT_EQ(matched.to_string(), "10.1.0.0/16");
+    ASSERT_EQ(*trie.find(IP::Route("10.0.0.0/8")), 1);
+    ASSERT_EQ(trie.find(IP::Route("10.0.0.0/9")), nullptr);
+
+    ASSERT_TRUE(trie.contains_more_specific(IP::Route("10.0.0.0/8")));
+    ASSERT_TRUE(trie.contains_more_specific(IP::Route("10.1.0.0/17")));
+    ASSERT_FALSE(trie.contains_more_specific(IP::Route("10.1.2.0/24")));
+    ASSERT_FALSE(trie.contains_more_specific(IP::Route("10.1.128.0/17")));
+    ASSERT_TRUE(trie.contains_more_specific(IP::Route("::/0")));
+
+    const std::vector<IP::Addr> addrs = {IP::Addr::from_string("10.1.2.3"),
+                                         IP::Addr::from_string("2001:db9::1")};
+    std::vector<const int *> results;
+    trie.match_batch(addrs.begin(), addrs.end(), std::back_inserter(results));
+    ASSERT_EQ(results.size(), 2u);
+    ASSERT_EQ(*results[0], 3);
+    ASSERT_EQ(results[1], nullptr);
+}
+
+TEST(IPAddr, routeTrieRandom)
+{
+    // compare against a linear scan over the same routes
+    MTRand rng(42);
+    IP::RouteList routes;
+    IP::RouteTrie<size_t> trie;
+    for (size_t i = 0; i < 2000; ++i)
+    {
+        const bool v6 = rng.randrange(4) == 0;
+        unsigned char bytes[16];
+        rng.rand_bytes(bytes, sizeof(bytes));
+        bytes[0] &= 0x0f; // cluster routes so that they nest
+        IP::Route r(v6 ? IP::Addr::from_ipv6(IPv6::Addr::from_byte_string(bytes))
+                       : IP::Addr::from_ipv4(IPv4::Addr::from_bytes_net(bytes)),
+                    rng.randrange(v6 ? 65u : 33u));
+        r.force_canonical();
+        if (!trie.find(r))
+        {
+            trie.insert(r, routes.size());
+            routes.push_back(r);
+        }
+    }
+    ASSERT_EQ(trie.size(), routes.size());
+
+    for (size_t i = 0; i < 5000; ++i)
+    {
+        const bool v6 = rng.randrange(4) == 0;
+        unsigned char bytes[16];
+        rng.rand_bytes(bytes, sizeof(bytes));
+        bytes[0] &= 0x0f;
+        const IP::Addr addr = v6 ? IP::Addr::from_ipv6(IPv6::Addr::from_byte_string(bytes))
+                                 : IP::Addr::from_ipv4(IPv4::Addr::from_bytes_net(bytes));
+
+        const IP::Route *best = nullptr;
+        for (const auto &r : routes)
+            if (r.contains(addr) && (!best || r.prefix_len > best->prefix_len))
+                best = &r;
+
+        const size_t *m = trie.match(addr);
+        if (best)
+        {
+            ASSERT_NE(m, nullptr) << addr;
+            ASSERT_EQ(routes[*m], *best) << addr;
+        }
+        else
+            ASSERT_EQ(m, nullptr) << addr;
+    }
+}
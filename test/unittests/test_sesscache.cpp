@@ -0,0 +1,107 @@
+#include "test_common.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openvpn/ssl/sesscache.hpp>
+
+using namespace openvpn;
+
+TEST(sesscache, insert_lookup)
+{
+    TLSSessionCache cache(16);
+    std::string sess;
+
+    EXPECT_FALSE(cache.lookup("a", sess));
+    cache.insert("a", "session-a");
+    ASSERT_TRUE(cache.lookup("a", sess));
+    EXPECT_EQ(sess, "session-a");
+
+    // replace
+    cache.insert("a", "session-a2");
+    ASSERT_TRUE(cache.lookup("a", sess));
+    EXPECT_EQ(sess, "session-a2");
+    EXPECT_EQ(cache.size(), 1u);
+
+    cache.erase("a");
+    EXPECT_FALSE(cache.lookup("a", sess));
+
+    const TLSSessionCache::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.inserts, 2u);
+    EXPECT_EQ(stats.evictions, 0u);
+}
+
+TEST(sesscache, lru_eviction)
+{
+    // single shard so that eviction order is deterministic
+    TLSSessionCache cache(3, 3600, 1);
+    std::string sess;
+
+    cache.insert("a", "1");
+    cache.insert("b", "2");
+    cache.insert("c", "3");
+    ASSERT_TRUE(cache.lookup("a", sess)); // a is now most recently used
+    cache.insert("d", "4");               // evicts b
+
+    EXPECT_EQ(cache.size(), 3u);
+    EXPECT_FALSE(cache.lookup("b", sess));
+    EXPECT_TRUE(cache.lookup("a", sess));
+    EXPECT_TRUE(cache.lookup("c", sess));
+    EXPECT_TRUE(cache.lookup("d", sess));
+    EXPECT_EQ(cache.stats().evictions, 1u);
+}
+
+TEST(sesscache, bounded)
+{
+    TLSSessionCache cache(100, 3600, 8);
+    for (int i = 0; i < 10000; ++i)
+        cache.insert(std::to_string(i), "x");
+    EXPECT_LE(cache.size(), cache.capacity());
+    EXPECT_GE(cache.capacity(), 100u);
+    EXPECT_LT(cache.capacity(), 108u);
+}
+
+TEST(sesscache, expire)
+{
+    TLSSessionCache cache(16, 0);
+    std::string sess;
+    cache.insert("a", "session-a");
+    EXPECT_FALSE(cache.lookup("a", sess));
+    EXPECT_EQ(cache.stats().expirations, 1u);
+    EXPECT_EQ(cache.size(), 0u);
+}
+
+TEST(sesscache, threads)
+{
+    TLSSessionCache::Ptr cache(new TLSSessionCache(1024));
+    const int n_threads = 4;
+    const int n_keys = 200;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t)
+        threads.emplace_back([&cache, t]()
+                             {
+            std::string sess;
+            for (int i = 0; i < n_keys; ++i)
+            {
+                const std::string key = std::to_string(t) + ':' + std::to_string(i);
+                cache->insert(key, key);
+                // sessions created by other threads are visible too
+                cache->lookup(std::to_string((t + 1) % n_threads) + ':' + std::to_string(i), sess);
+            } });
+    for (auto &th : threads)
+        th.join();
+
+    std::string sess;
+    for (int t = 0; t < n_threads; ++t)
+        for (int i = 0; i < n_keys; ++i)
+        {
+            const std::string key = std::to_string(t) + ':' + std::to_string(i);
+            ASSERT_TRUE(cache->lookup(key, sess));
+            EXPECT_EQ(sess, key);
+        }
+    EXPECT_EQ(cache->stats().inserts, static_cast<std::uint64_t>(n_threads * n_keys));
+}
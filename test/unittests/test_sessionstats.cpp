@@ -0,0 +1,68 @@
+#include "test_common.h"
+
+#include <thread>
+#include <vector>
+#include <atomic>
+
+#include <openvpn/log/sessionstats.hpp>
+
+using namespace openvpn;
+
+TEST(sessionstats, basic)
+{
+    SessionStats::Ptr stats(new SessionStats());
+    stats->inc_stat(SessionStats::BYTES_IN, 100);
+    stats->inc_stat(SessionStats::BYTES_IN, 50);
+    stats->inc_stat(SessionStats::PACKETS_IN, 2);
+    stats->inc_stat(SessionStats::N_STATS, 1); // ignored
+
+    EXPECT_EQ(stats->get_stat(SessionStats::BYTES_IN), 150);
+    EXPECT_EQ(stats->get_stat_fast(SessionStats::PACKETS_IN), 2);
+    EXPECT_EQ(stats->get_stat(SessionStats::BYTES_OUT), 0);
+    EXPECT_EQ(stats->get_stat(SessionStats::N_STATS), 0);
+
+    const SessionStats::Snapshot snap = stats->snapshot();
+    EXPECT_EQ(snap[SessionStats::BYTES_IN], 150);
+    EXPECT_EQ(snap[SessionStats::PACKETS_IN], 2);
+    EXPECT_EQ(snap[SessionStats::N_STATS], 0);
+}
+
+TEST(sessionstats, threads)
+{
+    SessionStats::Ptr stats(new SessionStats());
+    const int n_threads = 12; // more threads than shards
+    const int n_iter = 100000;
+    std::atomic<bool> done{false};
+
+    // a reader taking snapshots while the writers run must never see
+    // a counter go backwards
+    std::thread reader([&]()
+                       {
+        SessionStats::Snapshot prev;
+        while (!done)
+        {
+            const SessionStats::Snapshot snap = stats->snapshot();
+            for (size_t i = 0; i < SessionStats::N_STATS; ++i)
+                ASSERT_GE(snap[i], prev[i]);
+            prev = snap;
+        } });
+
+    std::vector<std::thread> writers;
+    for (int t = 0; t < n_threads; ++t)
+        writers.emplace_back([&stats]()
+                             {
+            for (int i = 0; i < n_iter; ++i)
+            {
+                stats->inc_stat(SessionStats::BYTES_OUT, 1500);
+                stats->inc_stat(SessionStats::PACKETS_OUT, 1);
+            } });
+    for (auto &w : writers)
+        w.join();
+    done = true;
+    reader.join();
+
+    const SessionStats::Snapshot snap = stats->snapshot();
+    EXPECT_EQ(snap[SessionStats::BYTES_OUT], count_t(1500) * n_threads * n_iter);
+    EXPECT_EQ(snap[SessionStats::PACKETS_OUT], count_t(n_threads) * n_iter);
+    EXPECT_EQ(stats->get_stat(SessionStats::PACKETS_OUT), count_t(n_threads) * n_iter);
+}
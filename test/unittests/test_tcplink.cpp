@@ -0,0 +1,229 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+
+#include "test_common.h"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <openvpn/io/io.hpp>
+#include <openvpn/frame/frame_init.hpp>
+#include <openvpn/random/mtrandapi.hpp>
+#include <openvpn/transport/tcplink.hpp>
+
+using namespace openvpn;
+
+namespace unittests {
+
+struct LinkHandler
+{
+    bool tcp_read_handler(BufferAllocated &buf)
+    {
+        received.emplace_back(buf.c_data(), buf.c_data_end());
+        capacities.push_back(buf.capacity());
+        return true;
+    }
+
+    void tcp_write_queue_needs_send()
+    {
+        ++drained;
+    }
+
+    void tcp_eof_handler()
+    {
+        error = "EOF";
+    }
+
+    void tcp_error_handler(const char *err)
+    {
+        error = err;
+    }
+
+    int drained = 0;
+    std::string error;
+    std::vector<std::vector<unsigned char>> received;
+    std::vector<size_t> capacities;
+};
+
+typedef TCPTransport::TCPLink<openvpn_io::ip::tcp, LinkHandler *, false> Link;
+
+static unsigned char pattern(const size_t pkt, const size_t i)
+{
+    return static_cast<unsigned char>(pkt * 31 + i);
+}
+
+// Queue many packets on a link whose socket has a small send buffer
+// while the peer isn't reading yet, so that the gathered writes end
+// part way through buffers, then check the stream the peer receives.
+TEST(tcplink, gather_send)
+{
+    openvpn_io::io_context io;
+    openvpn_io::ip::tcp::acceptor acceptor(io, openvpn_io::ip::tcp::endpoint(openvpn_io::ip::address_v4::loopback(), 0));
+    openvpn_io::ip::tcp::socket client(io);
+    openvpn_io::ip::tcp::socket server(io);
+    client.connect(acceptor.local_endpoint());
+    acceptor.accept(server);
+    client.set_option(openvpn_io::socket_base::send_buffer_size(4096));
+
+    RandomAPI::Ptr prng(new MTRand);
+    std::vector<size_t> sizes;
+    size_t total = 0;
+    for (int i = 0; i < 2000; ++i)
+    {
+        sizes.push_back(prng->randrange32(1, 1500));
+        total += sizes.back() + 2;
+    }
+
+    // peer: start reading only after everything has been queued
+    std::vector<unsigned char> received(total);
+    std::thread reader([&]()
+                       {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        openvpn_io::read(server, openvpn_io::buffer(received)); });
+
+    Frame::Ptr frame = frame_init_simple(2048);
+    SessionStats::Ptr stats(new SessionStats());
+    LinkHandler handler;
+    Link::Ptr link(new Link(&handler, client, 0, 64, (*frame)[Frame::READ_LINK_TCP], stats));
+
+    for (size_t n = 0; n < sizes.size(); ++n)
+    {
+        BufferAllocated buf;
+        (*frame)[Frame::WRITE_DC_MSG].prepare(buf);
+        unsigned char *p = buf.write_alloc(sizes[n]);
+        for (size_t i = 0; i < sizes[n]; ++i)
+            p[i] = pattern(n, i);
+        ASSERT_TRUE(link->send(buf));
+    }
+    EXPECT_FALSE(link->send_queue_empty());
+
+    while (!handler.drained && handler.error.empty())
+        io.run_one();
+    reader.join();
+    link->stop();
+
+    EXPECT_EQ(handler.error, "");
+    EXPECT_TRUE(link->send_queue_empty());
+    EXPECT_EQ(stats->get_stat(SessionStats::BYTES_OUT), total);
+    EXPECT_EQ(stats->get_stat(SessionStats::PACKETS_OUT), sizes.size());
+
+    size_t off = 0;
+    for (size_t n = 0; n < sizes.size(); ++n)
+    {
+        ASSERT_EQ((size_t(received[off]) << 8) | received[off + 1], sizes[n]) << "packet " << n;
+        off += 2;
+        for (size_t i = 0; i < sizes[n]; ++i)
+            ASSERT_EQ(received[off + i], pattern(n, i)) << "packet " << n << " byte " << i;
+        off += sizes[n];
+    }
+    EXPECT_EQ(off, total);
+}
+
+// The peer writes a framed stream in one go, so that reads of up to
+// 64 KB hold many packets and end part way through packets.
+TEST(tcplink, large_read)
+{
+    openvpn_io::io_context io;
+    openvpn_io::ip::tcp::acceptor acceptor(io, openvpn_io::ip::tcp::endpoint(openvpn_io::ip::address_v4::loopback(), 0));
+    openvpn_io::ip::tcp::socket client(io);
+    openvpn_io::ip::tcp::socket server(io);
+    client.connect(acceptor.local_endpoint());
+    acceptor.accept(server);
+
+    RandomAPI::Ptr prng(new MTRand);
+    std::vector<size_t> sizes;
+    std::vector<unsigned char> stream;
+    for (size_t n = 0; n < 5000; ++n)
+    {
+        sizes.push_back(prng->randrange32(1, 1500));
+        stream.push_back(static_cast<unsigned char>(sizes[n] >> 8));
+        stream.push_back(static_cast<unsigned char>(sizes[n]));
+        for (size_t i = 0; i < sizes[n]; ++i)
+            stream.push_back(pattern(n, i));
+    }
+    std::thread writer([&]()
+                       {
+        openvpn_io::write(server, openvpn_io::buffer(stream));
+        server.close(); });
+
+    Frame::Ptr frame = frame_init_simple(2048);
+    SessionStats::Ptr stats(new SessionStats());
+    LinkHandler handler;
+    Link::Ptr link(new Link(&handler, client, 0, 64, (*frame)[Frame::READ_LINK_TCP], stats));
+    link->set_read_size(65536);
+    link->start();
+
+    while (handler.error.empty())
+        io.run_one();
+    writer.join();
+    link->stop();
+
+    EXPECT_EQ(handler.error, "EOF");
+    EXPECT_EQ(stats->get_stat(SessionStats::BYTES_IN), stream.size());
+    ASSERT_EQ(handler.received.size(), sizes.size());
+    for (size_t n = 0; n < sizes.size(); ++n)
+    {
+        ASSERT_EQ(handler.received[n].size(), sizes[n]) << "packet " << n;
+        for (size_t i = 0; i < sizes[n]; ++i)
+            ASSERT_EQ(handler.received[n][i], pattern(n, i)) << "packet " << n << " byte " << i;
+    }
+}
+
+// With large reads enabled, a read holding exactly one packet is
+// handed up in the read buffer itself rather than copied out of it.
+TEST(tcplink, single_packet_read)
+{
+    openvpn_io::io_context io;
+    openvpn_io::ip::tcp::acceptor acceptor(io, openvpn_io::ip::tcp::endpoint(openvpn_io::ip::address_v4::loopback(), 0));
+    openvpn_io::ip::tcp::socket client(io);
+    openvpn_io::ip::tcp::socket server(io);
+    client.connect(acceptor.local_endpoint());
+    acceptor.accept(server);
+
+    Frame::Ptr frame = frame_init_simple(2048);
+    SessionStats::Ptr stats(new SessionStats());
+    LinkHandler handler;
+    Link::Ptr link(new Link(&handler, client, 0, 64, (*frame)[Frame::READ_LINK_TCP], stats));
+    link->set_read_size(65536);
+    link->start();
+
+    for (size_t n = 0; n < 10; ++n)
+    {
+        const size_t size = 100 + n * 100;
+        std::vector<unsigned char> pkt;
+        pkt.push_back(static_cast<unsigned char>(size >> 8));
+        pkt.push_back(static_cast<unsigned char>(size));
+        for (size_t i = 0; i < size; ++i)
+            pkt.push_back(pattern(n, i));
+        openvpn_io::write(server, openvpn_io::buffer(pkt));
+
+        while (handler.received.size() == n && handler.error.empty())
+            io.run_one();
+        ASSERT_EQ(handler.received.size(), n + 1);
+        ASSERT_EQ(handler.received[n].size(), size);
+        for (size_t i = 0; i < size; ++i)
+            ASSERT_EQ(handler.received[n][i], pattern(n, i)) << "packet " << n << " byte " << i;
+        EXPECT_GE(handler.capacities[n], 65536u) << "packet " << n << " was copied";
+    }
+    link->stop();
+}
+
+} // namespace unittests
@@ -0,0 +1,250 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+
+#include "test_common.h"
+
+#include <vector>
+
+#include <openvpn/frame/frame.hpp>
+#include <openvpn/tun/linux/client/tunvnet.hpp>
+
+using namespace openvpn;
+using namespace openvpn::TunLinux;
+
+namespace unittests {
+
+static const Frame::Context seg_fc(128, 2048, 128, 0, 16, 0);
+
+// Build a TCP packet with payload_size bytes of payload, preceded by
+// a virtio-net header describing it.
+static BufferAllocated make_packet(const bool ipv6,
+                                   const size_t payload_size,
+                                   const std::uint8_t gso_type,
+                                   const std::uint16_t gso_size)
+{
+    const size_t l4_off = ipv6 ? sizeof(IPv6Header) : sizeof(IPv4Header);
+    const size_t size = l4_off + sizeof(TCPHeader) + payload_size;
+    BufferAllocated buf(VnetHdr::SIZE + size, 0);
+
+    VnetHdr::Header vh;
+    std::memset(&vh, 0, sizeof(vh));
+    vh.flags = VnetHdr::F_NEEDS_CSUM;
+    vh.gso_type = gso_type;
+    vh.gso_size = gso_size;
+    vh.hdr_len = static_cast<std::uint16_t>(l4_off + sizeof(TCPHeader));
+    vh.csum_start = static_cast<std::uint16_t>(l4_off);
+    vh.csum_offset = offsetof(TCPHeader, check);
+    buf.write((const unsigned char *)&vh, sizeof(vh));
+
+    unsigned char *p = buf.write_alloc(size);
+    std::memset(p, 0, size);
+    if (ipv6)
+    {
+        IPv6Header *ip6 = (IPv6Header *)p;
+        ip6->version_prio = 6 << 4;
+        ip6->payload_len = htons(static_cast<std::uint16_t>(size - l4_off));
+        ip6->nexthdr = IPCommon::TCP;
+        ip6->hop_limit = 64;
+        std::memset(&ip6->saddr, 0x11, 16);
+        std::memset(&ip6->daddr, 0x22, 16);
+    }
+    else
+    {
+        IPv4Header *ip = (IPv4Header *)p;
+        ip->version_len = IPv4Header::ver_len(4, sizeof(IPv4Header));
+        ip->tot_len = htons(static_cast<std::uint16_t>(size));
+        ip->id = htons(1000);
+        ip->ttl = 64;
+        ip->protocol = IPCommon::TCP;
+        ip->saddr = htonl(0x0a000001);
+        ip->daddr = htonl(0x0a000002);
+        ip->check = IPChecksum::checksum(p, sizeof(IPv4Header));
+    }
+    TCPHeader *tcp = (TCPHeader *)(p + l4_off);
+    tcp->source = htons(1234);
+    tcp->dest = htons(80);
+    tcp->seq = htonl(0xfffff000); // wraps during segmentation
+    tcp->doff_res = (sizeof(TCPHeader) / 4) << 4;
+    tcp->flags = VnetHdr::TCP_PSH | VnetHdr::TCP_FIN | VnetHdr::TCP_CWR | 0x10; // ACK
+    tcp->window = htons(65535);
+    for (size_t i = 0; i < payload_size; ++i)
+        p[l4_off + sizeof(TCPHeader) + i] = static_cast<unsigned char>(i);
+    return buf;
+}
+
+struct Segment
+{
+    std::vector<unsigned char> data;
+};
+
+static void verify_segments(const bool ipv6,
+                            const std::vector<Segment> &segs,
+                            const size_t payload_size,
+                            const size_t mss)
+{
+    const size_t l4_off = ipv6 ? sizeof(IPv6Header) : sizeof(IPv4Header);
+    const size_t hdr_len = l4_off + sizeof(TCPHeader);
+    ASSERT_EQ(segs.size(), (payload_size + mss - 1) / mss);
+
+    size_t off = 0;
+    for (size_t i = 0; i < segs.size(); ++i)
+    {
+        const unsigned char *p = segs[i].data.data();
+        const size_t len = segs[i].data.size() - hdr_len;
+        EXPECT_EQ(len, std::min(mss, payload_size - off));
+
+        if (ipv6)
+            EXPECT_EQ(ntohs(((const IPv6Header *)p)->payload_len), sizeof(TCPHeader) + len);
+        else
+        {
+            const IPv4Header *ip = (const IPv4Header *)p;
+            EXPECT_EQ(ntohs(ip->tot_len), hdr_len + len);
+            EXPECT_EQ(ntohs(ip->id), 1000 + i);
+            EXPECT_EQ(IPChecksum::checksum(p, sizeof(IPv4Header)), 0);
+        }
+
+        const TCPHeader *tcp = (const TCPHeader *)(p + l4_off);
+        EXPECT_EQ(ntohl(tcp->seq), static_cast<std::uint32_t>(0xfffff000 + off));
+        const bool last = i == segs.size() - 1;
+        EXPECT_EQ(!!(tcp->flags & VnetHdr::TCP_FIN), last);
+        EXPECT_EQ(!!(tcp->flags & VnetHdr::TCP_PSH), last);
+        EXPECT_EQ(!!(tcp->flags & VnetHdr::TCP_CWR), i == 0);
+
+        // a correct checksum folds the pseudo-header sum to zero
+        EXPECT_EQ(VnetHdr::tcp_checksum(p, l4_off, sizeof(TCPHeader) + len, ipv6), 0);
+
+        for (size_t j = 0; j < len; ++j)
+            ASSERT_EQ(p[hdr_len + j], static_cast<unsigned char>(off + j));
+        off += len;
+    }
+    EXPECT_EQ(off, payload_size);
+}
+
+static void test_tso(const bool ipv6)
+{
+    const size_t payload_size = 20000;
+    const std::uint16_t mss = 1360;
+    BufferAllocated buf = make_packet(ipv6, payload_size, ipv6 ? VnetHdr::GSO_TCPV6 : VnetHdr::GSO_TCPV4, mss);
+
+    std::vector<Segment> segs;
+    BufferAllocated seg;
+    EXPECT_TRUE(VnetHdr::receive(
+        buf,
+        seg,
+        [](BufferAllocated &b)
+        { seg_fc.prepare(b); },
+        [&segs](BufferAllocated &b)
+        { segs.push_back(Segment{std::vector<unsigned char>(b.c_data(), b.c_data_end())}); }));
+    verify_segments(ipv6, segs, payload_size, mss);
+}
+
+TEST(tunvnet, tso4)
+{
+    test_tso(false);
+}
+
+TEST(tunvnet, tso6)
+{
+    test_tso(true);
+}
+
+TEST(tunvnet, csum_partial)
+{
+    for (const bool ipv6 : {false, true})
+    {
+        const size_t payload_size = 1001;
+        BufferAllocated buf = make_packet(ipv6, payload_size, VnetHdr::GSO_NONE, 0);
+        const size_t l4_off = ipv6 ? sizeof(IPv6Header) : sizeof(IPv4Header);
+
+        // the kernel leaves the pseudo-header sum in the checksum field
+        {
+            unsigned char *p = buf.data() + VnetHdr::SIZE;
+            const size_t l4_len = sizeof(TCPHeader) + payload_size;
+            TCPHeader *tcp = (TCPHeader *)(p + l4_off);
+            const std::uint16_t len = htons(static_cast<std::uint16_t>(l4_len));
+            std::uint32_t sum;
+            if (ipv6)
+            {
+                const IPv6Header *ip6 = (const IPv6Header *)p;
+                sum = IPChecksum::compute(&ip6->saddr, 32) + len + htons(IPCommon::TCP);
+            }
+            else
+            {
+                const IPv4Header *ip = (const IPv4Header *)p;
+                sum = IPChecksum::compute(&ip->saddr, 8) + len + htons(IPCommon::TCP);
+            }
+            tcp->check = IPChecksum::fold(sum);
+        }
+
+        size_t n = 0;
+        BufferAllocated seg;
+        EXPECT_TRUE(VnetHdr::receive(
+            buf,
+            seg,
+            [](BufferAllocated &b)
+            { seg_fc.prepare(b); },
+            [&](BufferAllocated &b)
+            {
+                ++n;
+                EXPECT_EQ(&b, &buf); // delivered in place
+                EXPECT_EQ(b.size(), l4_off + sizeof(TCPHeader) + payload_size);
+                EXPECT_EQ(VnetHdr::tcp_checksum(b.c_data(), l4_off, b.size() - l4_off, ipv6), 0);
+            }));
+        EXPECT_EQ(n, 1u);
+    }
+}
+
+TEST(tunvnet, malformed)
+{
+    BufferAllocated seg;
+    auto prepare = [](BufferAllocated &b)
+    { seg_fc.prepare(b); };
+    auto func = [](BufferAllocated &)
+    { FAIL() << "unexpected packet"; };
+
+    // truncated header
+    BufferAllocated buf(4, 0);
+    buf.write_alloc(4);
+    EXPECT_FALSE(VnetHdr::receive(buf, seg, prepare, func));
+
+    // unsupported GSO type (UDP)
+    buf = make_packet(false, 100, 3, 50);
+    EXPECT_FALSE(VnetHdr::receive(buf, seg, prepare, func));
+
+    // zero MSS
+    buf = make_packet(false, 100, VnetHdr::GSO_TCPV4, 0);
+    EXPECT_FALSE(VnetHdr::receive(buf, seg, prepare, func));
+}
+
+TEST(tunvnet, prepend)
+{
+    BufferAllocated buf(64, 0);
+    buf.init_headroom(VnetHdr::SIZE);
+    buf.push_back(0x45);
+    EXPECT_TRUE(VnetHdr::prepend(buf));
+    EXPECT_EQ(buf.size(), VnetHdr::SIZE + 1u);
+    EXPECT_EQ(buf[0], 0);
+    EXPECT_EQ(buf[VnetHdr::SIZE], 0x45);
+
+    // no headroom left
+    EXPECT_FALSE(VnetHdr::prepend(buf));
+}
+
+} // namespace unittests
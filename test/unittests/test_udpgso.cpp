@@ -0,0 +1,229 @@
+//    OpenVPN -- An application to securely tunnel IP networks
+//               over a single port, with support for SSL/TLS-based
+//               session authentication and key exchange,
+//               packet encryption, packet authentication, and
+//               packet compression.
+//
+//    Copyright (C) 2012-2022 OpenVPN Inc.
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU Affero General Public License Version 3
+//    as published by the Free Software Foundation.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU Affero General Public License for more details.
+//
+//    You should have received a copy of the GNU Affero General Public License
+//    along with this program in the COPYING file.
+
+#include "test_common.h"
+
+#include <vector>
+
+#include <openvpn/common/bigmutex.hpp>
+#include <openvpn/transport/udplink.hpp>
+
+using namespace openvpn;
+using namespace openvpn::UDPTransport;
+
+namespace unittests {
+
+static std::vector<struct iovec> make_iov(const std::vector<size_t> &sizes)
+{
+    std::vector<struct iovec> iov(sizes.size());
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        iov[i].iov_base = nullptr;
+        iov[i].iov_len = sizes[i];
+    }
+    return iov;
+}
+
+TEST(udpgso, segment_run)
+{
+    auto iov = make_iov({1400, 1400, 1400, 700, 1400});
+    EXPECT_EQ(GSO::segment_run(iov.data(), iov.size()), 4u);
+    EXPECT_EQ(GSO::segment_run(iov.data() + 4, 1), 1u);
+    EXPECT_EQ(GSO::segment_run(iov.data(), 0), 0u);
+
+    // larger packet ends the run
+    iov = make_iov({500, 500, 600, 600});
+    EXPECT_EQ(GSO::segment_run(iov.data(), iov.size()), 2u);
+
+    // total size is limited to the largest UDP datagram
+    iov = make_iov(std::vector<size_t>(64, 1400));
+    EXPECT_EQ(GSO::segment_run(iov.data(), iov.size()), size_t(GSO::MAX_DATAGRAM / 1400));
+
+    // segment count is limited by the kernel
+    iov = make_iov(std::vector<size_t>(100, 100));
+    EXPECT_EQ(GSO::segment_run(iov.data(), iov.size()), size_t(GSO::MAX_SEGMENTS));
+}
+
+TEST(udpgso, split)
+{
+    std::vector<unsigned char> data(1000);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<unsigned char>(i);
+
+    std::vector<size_t> sizes;
+    size_t offset = 0;
+    const size_t n = GSO::split(data.data(), data.size(), 300, [&](const unsigned char *seg, const size_t size)
+                                {
+        EXPECT_EQ(seg, data.data() + offset);
+        offset += size;
+        sizes.push_back(size); });
+    EXPECT_EQ(n, 4u);
+    EXPECT_EQ(sizes, (std::vector<size_t>{300, 300, 300, 100}));
+
+    // not coalesced
+    sizes.clear();
+    EXPECT_EQ(GSO::split(data.data(), data.size(), 0, [&](const unsigned char *, const size_t size)
+                         { sizes.push_back(size); }),
+              1u);
+    EXPECT_EQ(sizes, (std::vector<size_t>{1000}));
+}
+
+class GSOReadHandler
+{
+  public:
+    void udp_read_handler(PacketFrom::SPtr &pfp)
+    {
+        packets.emplace_back(pfp->buf.c_data(), pfp->buf.c_data_end());
+    }
+
+    void udp_read_batch_handler(PacketFrom::Batch &batch, const size_t n)
+    {
+        ++batches;
+        for (size_t i = 0; i < n; ++i)
+            udp_read_handler(batch[i]);
+    }
+
+    std::vector<std::vector<unsigned char>> packets;
+    size_t batches = 0;
+};
+
+// Send a series of packets through a GSO-enabled UDPLink to a
+// GRO-enabled UDPLink over loopback and check that the receiver
+// sees the original packets, in order.
+TEST(udpgso, loopback)
+{
+    openvpn_io::io_context io_context;
+    openvpn_io::ip::udp::socket send_sock(io_context);
+    openvpn_io::ip::udp::socket recv_sock(io_context);
+    const AsioEndpoint local(openvpn_io::ip::make_address("127.0.0.1"), 0);
+    recv_sock.open(local.protocol());
+    recv_sock.bind(local);
+    send_sock.open(local.protocol());
+    send_sock.bind(local);
+    send_sock.connect(recv_sock.local_endpoint());
+
+    if (!GSO::gso_supported(send_sock.native_handle()) || !GSO::enable_gro(recv_sock.native_handle()))
+        GTEST_SKIP() << "UDP GSO/GRO not supported by kernel";
+
+    const Frame::Context fc(128, 2048, 128, 0, 16, 0);
+    SessionStats::Ptr stats(new SessionStats());
+    GSOReadHandler handler;
+
+    UDPLink<GSOReadHandler *>::Ptr sender(new UDPLink<GSOReadHandler *>(&handler, send_sock, fc, stats));
+    UDPLink<GSOReadHandler *>::Ptr receiver(new UDPLink<GSOReadHandler *>(&handler, recv_sock, fc, stats));
+    sender->set_batch_size(64);
+    sender->set_gso(true);
+    receiver->set_batch_size(64);
+    receiver->set_gso(true);
+    receiver->start(1);
+
+    std::vector<std::vector<unsigned char>> expected;
+    for (size_t i = 0; i < 40; ++i)
+    {
+        // a run of equal sized packets, terminated by a short one
+        const size_t size = (i % 10 == 9) ? 100 : 1200;
+        expected.emplace_back(size, static_cast<unsigned char>(i));
+        Buffer buf(expected.back().data(), size, true);
+        ASSERT_EQ(sender->send(buf, nullptr), 0);
+    }
+
+    for (int i = 0; i < 100 && handler.packets.size() < expected.size(); ++i)
+        io_context.run_for(std::chrono::milliseconds(10));
+
+    EXPECT_EQ(handler.packets, expected);
+    EXPECT_EQ(stats->get_stat(SessionStats::PACKETS_OUT), 40);
+    EXPECT_EQ(stats->get_stat(SessionStats::PACKETS_IN), 40);
+
+    sender->stop();
+    receiver->stop();
+}
+
+// Batched recvmmsg/sendmmsg without segmentation offload.
+TEST(udpgso, batch_loopback)
+{
+    openvpn_io::io_context io_context;
+    openvpn_io::ip::udp::socket send_sock(io_context);
+    openvpn_io::ip::udp::socket recv_sock(io_context);
+    const AsioEndpoint local(openvpn_io::ip::make_address("127.0.0.1"), 0);
+    recv_sock.open(local.protocol());
+    recv_sock.bind(local);
+    send_sock.open(local.protocol());
+    send_sock.bind(local);
+    send_sock.connect(recv_sock.local_endpoint());
+
+    const Frame::Context fc(128, 2048, 128, 0, 16, 0);
+    SessionStats::Ptr stats(new SessionStats());
+    GSOReadHandler handler;
+
+    UDPLink<GSOReadHandler *>::Ptr sender(new UDPLink<GSOReadHandler *>(&handler, send_sock, fc, stats));
+    UDPLink<GSOReadHandler *>::Ptr receiver(new UDPLink<GSOReadHandler *>(&handler, recv_sock, fc, stats));
+    sender->set_batch_size(16);
+    receiver->set_batch_size(16);
+    receiver->start(1);
+
+    // more than one send batch, some flushed because the queue filled up
+    std::vector<std::vector<unsigned char>> expected;
+    for (size_t i = 0; i < 40; ++i)
+    {
+        expected.emplace_back(100 + i * 10, static_cast<unsigned char>(i));
+        Buffer buf(expected.back().data(), expected.back().size(), true);
+        ASSERT_EQ(sender->send(buf, nullptr), 0);
+    }
+
+    for (int i = 0; i < 100 && handler.packets.size() < expected.size(); ++i)
+        io_context.run_for(std::chrono::milliseconds(10));
+
+    EXPECT_EQ(handler.packets, expected);
+    EXPECT_GE(handler.batches, 1u);
+    EXPECT_EQ(stats->get_stat(SessionStats::PACKETS_OUT), 40);
+    EXPECT_EQ(stats->get_stat(SessionStats::PACKETS_IN), 40);
+
+    sender->stop();
+    receiver->stop();
+}
+
+// A send error from a deferred sendmmsg() is returned by the next send().
+TEST(udpgso, batch_send_error)
+{
+    openvpn_io::io_context io_context;
+    openvpn_io::ip::udp::socket sock(io_context);
+    const AsioEndpoint local(openvpn_io::ip::make_address("127.0.0.1"), 0);
+    sock.open(local.protocol());
+    sock.bind(local);
+
+    const Frame::Context fc(128, 2048, 128, 0, 16, 0);
+    SessionStats::Ptr stats(new SessionStats());
+    GSOReadHandler handler;
+
+    UDPLink<GSOReadHandler *>::Ptr link(new UDPLink<GSOReadHandler *>(&handler, sock, fc, stats));
+    link->set_batch_size(16);
+
+    // unconnected socket and no destination
+    unsigned char data[64] = {};
+    Buffer buf(data, sizeof(data), true);
+    ASSERT_EQ(link->send(buf, nullptr), 0);
+    io_context.poll();
+    EXPECT_EQ(link->send(buf, nullptr), EDESTADDRREQ);
+    EXPECT_EQ(link->send(buf, nullptr), 0);
+
+    link->stop();
+}
+
+} // namespace unittests